@@ -445,6 +445,34 @@ done:
   return ret;
 }
 
+/**
+ * camera-id of every source, indexed by the source id the frames carry. It
+ * is the serial the calibration records are looked up with.
+ */
+static guint *
+get_source_serials (NvDsConfig * config)
+{
+  guint *serials = g_new0 (guint, MAX (config->num_source_sub_bins, 1));
+  guint i;
+
+  for (i = 0; i < config->num_source_sub_bins; i++) {
+    serials[i] = config->multi_source_config[i].camera_id;
+  }
+  return serials;
+}
+
+/**
+ * The analysis bins send what they still hold at EOS on buffers without
+ * memory, see nvds_payload_buffer_new(). They are meant for the broker only.
+ */
+static GstPadProbeReturn
+common_que_buf_prob (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  if (gst_buffer_n_memory (GST_PAD_PROBE_INFO_BUFFER (info)) == 0)
+    return GST_PAD_PROBE_DROP;
+  return GST_PAD_PROBE_OK;
+}
+
 /**
  * Function to create common elements(Primary infer, tracker, secondary infer)
  * of the pipeline. These components operate on muxed data from all the
@@ -473,11 +501,25 @@ create_common_elements (NvDsConfig * config, NvDsPipeline *pipeline,
                     pipeline->common_que, NULL);
 
   link_element_to_tee_src_pad (pipeline->common_tee, pipeline->common_que);
+  NVGSTDS_ELEM_ADD_PROBE (pipeline->common_que_probe_id, pipeline->common_que,
+      "sink", common_que_buf_prob, GST_PAD_PROBE_TYPE_BUFFER, NULL);
 
   *src_elem = pipeline->common_que;
   *sink_elem = pipeline->common_tee;
 
   if (config->spot_config.enable) {
+    config->spot_config.source_serials = get_source_serials (config);
+    config->spot_config.num_sources = config->num_source_sub_bins;
+    config->spot_config.frame_width = config->streammux_config.pipeline_width;
+    config->spot_config.frame_height =
+        config->streammux_config.pipeline_height;
+    config->spot_config.payload_type = config->broker_config.payload_type;
+    if (config->spot_config.payload_type == NVDS_PAYLOAD_BINARY &&
+        config->spot_config.engine != NVDS_SPOT_ENGINE_APP) {
+      NVGSTDS_WARN_MSG_V ("payload-type=1 needs the in-app spot engine; "
+          "spot messages stay JSON");
+    }
+
     if (!create_spotanalysis_bin (&config->spot_config,
           &pipeline->common_elements.spot_bin)) {
       g_print("creating spotanalysis bin failed\n");
@@ -490,9 +532,26 @@ create_common_elements (NvDsConfig * config, NvDsPipeline *pipeline,
                           *sink_elem);
 
     *sink_elem = pipeline->common_elements.spot_bin.bin;
+    nvds_calib_handle_watch (config->spot_config.calibration,
+        config->spot_config.reload_interval);
   }
 
   if (config->aisle_config.enable) {
+    config->aisle_config.source_serials = get_source_serials (config);
+    config->aisle_config.num_sources = config->num_source_sub_bins;
+    config->aisle_config.frame_width = config->streammux_config.pipeline_width;
+    config->aisle_config.frame_height =
+        config->streammux_config.pipeline_height;
+    config->aisle_config.entry_latency = MAX (config->roi_entry_latency, 0);
+    config->aisle_config.exit_latency = MAX (config->roi_exit_latency, 0);
+    config->aisle_config.stop_latency = MAX (config->stop_rec_latency, 0);
+    config->aisle_config.payload_type = config->broker_config.payload_type;
+    if (config->aisle_config.payload_type == NVDS_PAYLOAD_BINARY &&
+        config->aisle_config.engine != NVDS_AISLE_ENGINE_APP) {
+      NVGSTDS_WARN_MSG_V ("payload-type=1 needs the in-app aisle engine; "
+          "aisle messages stay JSON");
+    }
+
     if (!create_aisle_analysis_bin (&config->aisle_config,
                                     &pipeline->common_elements.aisle_bin)) {
       g_print ("creating aisle analysis bin failed\n");
@@ -506,23 +565,69 @@ create_common_elements (NvDsConfig * config, NvDsPipeline *pipeline,
                               *sink_elem);
 
     *sink_elem = pipeline->common_elements.aisle_bin.bin;
+    nvds_calib_handle_watch (config->aisle_config.calibration,
+        config->aisle_config.reload_interval);
   }
 
   if (config->broker_config.enable) {
-    pipeline->msg_broker = gst_element_factory_make (NVDS_ELEM_MSG_BROKER, "nvmsgbroker");
-    if (!pipeline->msg_broker) {
-      NVGSTDS_ERR_MSG_V ("Failed to create 'nvmsgbroker'");
-      goto done;
+    NvDsMsgSenderConfig *sender_config = &config->broker_config.sender_config;
+    GstElement *broker_elem;
+
+    if (sender_config->spool.dir) {
+      /* nvmsgbroker sends as it gets the messages: spool them instead, so
+       * that they outlive an outage of the broker. */
+      sender_config->proto_lib = config->broker_config.proto_lib;
+      sender_config->conn_str = config->broker_config.conn_str;
+      sender_config->config_file = config->broker_config.config_file;
+      if (!create_msg_sender_bin (sender_config, &pipeline->msg_sender_bin)) {
+        g_print ("creating message sender bin failed\n");
+        goto done;
+      }
+      gst_bin_add (GST_BIN (pipeline->pipeline), pipeline->msg_sender_bin.bin);
+      broker_elem = pipeline->msg_sender_bin.bin;
+    } else {
+      pipeline->msg_broker = gst_element_factory_make (NVDS_ELEM_MSG_BROKER, "nvmsgbroker");
+      if (!pipeline->msg_broker) {
+        NVGSTDS_ERR_MSG_V ("Failed to create 'nvmsgbroker'");
+        goto done;
+      }
+
+      gst_bin_add_many (GST_BIN (pipeline->pipeline), pipeline->msg_broker, NULL);
+
+      g_object_set (G_OBJECT(pipeline->msg_broker), "proto-lib",
+                    config->broker_config.proto_lib, "conn-str",
+                    config->broker_config.conn_str, "config",
+                    config->broker_config.config_file, "sync", FALSE, NULL);
+      broker_elem = pipeline->msg_broker;
     }
 
-    gst_bin_add_many (GST_BIN (pipeline->pipeline), pipeline->msg_broker, NULL);
+    if (config->broker_config.batch_config.max_size) {
+      config->broker_config.batch_config.comp_id =
+          config->broker_config.comp_id;
+      if (!create_msg_batch_bin (&config->broker_config.batch_config,
+                                 &pipeline->msg_batch_bin)) {
+        g_print ("creating message batch bin failed\n");
+        goto done;
+      }
+      gst_bin_add (GST_BIN (pipeline->pipeline), pipeline->msg_batch_bin.bin);
+      NVGSTDS_LINK_ELEMENT (pipeline->msg_batch_bin.bin, broker_elem);
+      broker_elem = pipeline->msg_batch_bin.bin;
+    }
 
-    g_object_set (G_OBJECT(pipeline->msg_broker), "proto-lib",
-                  config->broker_config.proto_lib, "conn-str",
-                  config->broker_config.conn_str, "config",
-                  config->broker_config.config_file, "sync", FALSE, NULL);
+    if (config->broker_config.queue_config.max_size) {
+      /* Keeps a slow broker from holding up the tee, and the video with
+       * it. */
+      if (!create_msg_queue_bin (&config->broker_config.queue_config,
+                                 &pipeline->msg_queue_bin)) {
+        g_print ("creating message queue bin failed\n");
+        goto done;
+      }
+      gst_bin_add (GST_BIN (pipeline->pipeline), pipeline->msg_queue_bin.bin);
+      NVGSTDS_LINK_ELEMENT (pipeline->msg_queue_bin.bin, broker_elem);
+      broker_elem = pipeline->msg_queue_bin.bin;
+    }
 
-    link_element_to_tee_src_pad (pipeline->common_tee, pipeline->msg_broker);
+    link_element_to_tee_src_pad (pipeline->common_tee, broker_elem);
   }
 
   {
@@ -548,6 +653,23 @@ create_common_elements (NvDsConfig * config, NvDsPipeline *pipeline,
   if (config->enable_bboxfilter) {
     config->bboxfilter_config.aisle_calibration_file =
         g_strdup (config->aisle_config.calibration_file);
+    config->bboxfilter_config.aisle_calibration =
+        nvds_calib_handle_ref (config->aisle_config.calibration);
+    config->bboxfilter_config.engine =
+        config->enable_bboxfilter == NVDS_BBOXFILTER_ENGINE_APP ?
+        NVDS_BBOXFILTER_ENGINE_APP : NVDS_BBOXFILTER_ENGINE_PLUGIN;
+    config->bboxfilter_config.spot_calibration =
+        nvds_calib_handle_ref (config->spot_config.calibration);
+    config->bboxfilter_config.source_serials = get_source_serials (config);
+    config->bboxfilter_config.num_sources = config->num_source_sub_bins;
+    config->bboxfilter_config.frame_width =
+        config->streammux_config.pipeline_width;
+    config->bboxfilter_config.frame_height =
+        config->streammux_config.pipeline_height;
+    if (config->multi_source_config[0].dewarper_config.enable) {
+      config->bboxfilter_config.dewarper_config_file =
+          config->multi_source_config[0].dewarper_config.config_file;
+    }
 
     if (!create_bboxfilter_bin (&config->bboxfilter_config,
           &pipeline->common_elements.bboxfilter_bin)) {
@@ -872,6 +994,28 @@ destroy_pipeline (AppCtx * appCtx)
 
   if (appCtx->pipeline.pipeline)
     gst_object_unref (appCtx->pipeline.pipeline);
+
+  destroy_spotanalysis_bin (&appCtx->pipeline.common_elements.spot_bin);
+  destroy_aisle_analysis_bin (&appCtx->pipeline.common_elements.aisle_bin);
+  destroy_bboxfilter_bin (&appCtx->pipeline.common_elements.bboxfilter_bin);
+  destroy_msg_queue_bin (&appCtx->pipeline.msg_queue_bin);
+  destroy_msg_batch_bin (&appCtx->pipeline.msg_batch_bin);
+  destroy_msg_sender_bin (&appCtx->pipeline.msg_sender_bin);
+  g_free (config->spot_config.source_serials);
+  g_free (config->aisle_config.source_serials);
+  g_free (config->bboxfilter_config.source_serials);
+  config->spot_config.source_serials = NULL;
+  config->aisle_config.source_serials = NULL;
+  config->bboxfilter_config.source_serials = NULL;
+
+  nvds_calib_handle_unref (config->spot_config.calibration);
+  nvds_calib_handle_unref (config->aisle_config.calibration);
+  nvds_calib_handle_unref (config->bboxfilter_config.aisle_calibration);
+  nvds_calib_handle_unref (config->bboxfilter_config.spot_calibration);
+  config->spot_config.calibration = NULL;
+  config->aisle_config.calibration = NULL;
+  config->bboxfilter_config.aisle_calibration = NULL;
+  config->bboxfilter_config.spot_calibration = NULL;
 }
 
 gboolean
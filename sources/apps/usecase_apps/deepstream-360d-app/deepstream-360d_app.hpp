@@ -37,6 +37,9 @@ extern "C"
 #include "deepstream_spotanalysis.h"
 #include "deepstream_aisleanalysis.h"
 #include "deepstream_bboxfilter.h"
+#include "deepstream_msgbatch.h"
+#include "deepstream_msgsender.h"
+#include "deepstream_msgqueue.h"
 #include "deepstream_app_version.h"
 
 #define MAX_CATEGORY_LEN 32
@@ -50,6 +53,14 @@ typedef struct
   gchar *conn_str;
   gchar *config_file;
   guint comp_id;
+  /** Encoding of the in-app spot and aisle messages */
+  NvDsPayloadType payload_type;
+  /** Framing of the messages, off unless batch-max-size is set */
+  NvDsMsgBatchConfig batch_config;
+  /** Spooled sender used in place of nvmsgbroker, if spool-dir is set */
+  NvDsMsgSenderConfig sender_config;
+  /** Queue between common_tee and the broker branch, if queue-size is set */
+  NvDsMsgQueueConfig queue_config;
 } NvDsBrokerConfig;
 
 typedef struct
@@ -73,6 +84,9 @@ typedef struct
 {
   GstElement *pipeline;
   GstElement *msg_broker;
+  NvDsMsgBatchBin msg_batch_bin;
+  NvDsMsgSenderBin msg_sender_bin;
+  NvDsMsgQueueBin msg_queue_bin;
   GstElement *common_tee;
   GstElement *common_que;
   NvDsSrcParentBin multi_src_bin;
@@ -82,6 +96,7 @@ typedef struct
   GstElement *demuxer;
   gulong primary_bbox_buffer_probe_id;
   gulong spotanalysis_buffer_probe_id;
+  gulong common_que_probe_id;
   guint bus_id;
 } NvDsPipeline;
 
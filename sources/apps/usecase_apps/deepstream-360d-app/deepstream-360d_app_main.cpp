@@ -11,6 +11,9 @@
 
 #include "deepstream-360d_app.hpp"
 #include "deepstream_colors.h"
+#include "deepstream_cpu_dewarper.h"
+#include "deepstream_homography.h"
+#include "deepstream_occupancy.h"
 #include <string.h>
 #include <unistd.h>
 #include <termios.h>
@@ -26,6 +29,11 @@ static GThread *kb_input_thread = NULL;
 static gint return_value = 0;
 static gchar **cfg_files = NULL;
 static gchar **input_files = NULL;
+static gchar **calib_files = NULL;
+static gchar *benchmark_file = NULL;
+static gchar *homography_benchmark_file = NULL;
+static gchar *dewarper_config_file = NULL;
+static gchar **dewarp_images = NULL;
 static GMutex fps_lock;
 static gdouble fps[MAX_INSTANCES];
 static gdouble fps_avg[MAX_INSTANCES];
@@ -49,6 +57,24 @@ GOptionEntry entries[] = {
   {"input-file", 'i', 0, G_OPTION_ARG_FILENAME_ARRAY, &input_files,
       "Set the input file", NULL}
   ,
+  {"compile-calibration", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &calib_files,
+      "Compile a spot/aisle calibration CSV into <file>" NVDS_CALIB_FILE_EXT,
+      NULL}
+  ,
+  {"benchmark-occupancy", 0, 0, G_OPTION_ARG_FILENAME, &benchmark_file,
+      "Time the spot occupancy evaluators on a spot calibration file", NULL}
+  ,
+  {"benchmark-homography", 0, 0, G_OPTION_ARG_FILENAME,
+      &homography_benchmark_file,
+      "Check and time the homography kernels on an aisle calibration file",
+      NULL}
+  ,
+  {"dewarper-config", 0, 0, G_OPTION_ARG_FILENAME, &dewarper_config_file,
+      "Dewarper config file used by --dewarp-image", NULL}
+  ,
+  {"dewarp-image", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &dewarp_images,
+      "Dewarp a fisheye PPM image on the CPU into <file>.surfaceN.ppm", NULL}
+  ,
   {NULL}
   ,
 };
@@ -70,6 +96,179 @@ _intr_handler (int signum)
   cintr = TRUE;
 }
 
+static void
+print_calibration_stats (const gchar * name, NvDsCalibHandle * handle)
+{
+  NvDsCalibReloadStats stats;
+
+  if (!handle)
+    return;
+
+  nvds_calib_handle_get_stats (handle, &stats);
+  if (stats.num_reloads + stats.num_failures == 0)
+    return;
+
+  g_print ("**CALIB: %s reloads %u (failed %u), last load %.2f ms, swap %.2f ms\n",
+      name, stats.num_reloads, stats.num_failures, stats.last_load_ms,
+      stats.last_swap_ms);
+}
+
+static void
+print_spot_stats (NvDsSpotAnalysis * analysis)
+{
+  NvDsSpotAnalysisStats stats;
+
+  if (!analysis)
+    return;
+
+  nvds_spot_analysis_get_stats (analysis, &stats);
+  g_print ("**SPOT: occupancy changes seen %u, published %u in %u messages\n",
+      stats.raw_changes, stats.published_changes, stats.messages);
+}
+
+static void
+print_aisle_stats (NvDsAisleAnalysis * analysis)
+{
+  NvDsAisleAnalysisStats stats;
+
+  if (!analysis)
+    return;
+
+  nvds_aisle_analysis_get_stats (analysis, &stats);
+  if (stats.positions) {
+    g_print ("**AISLE: %u messages, trajectory positions %u reduced to %u "
+        "vertices\n", stats.messages, stats.positions, stats.vertices);
+  } else {
+    g_print ("**AISLE: %u messages\n", stats.messages);
+  }
+}
+
+static void
+add_rate_limit_stats (const NvDsRateLimitSensorStats * stats,
+    gpointer user_data)
+{
+  g_array_append_val ((GArray *) user_data, *stats);
+}
+
+/**
+ * Totals of @limiter, then the cameras that had messages suppressed or
+ * dropped.
+ */
+static void
+print_rate_limit_stats (const gchar * name, NvDsRateLimiter * limiter)
+{
+  GArray *sensors;
+  NvDsRateLimitSensorStats total = { 0 };
+  guint i;
+
+  if (!limiter)
+    return;
+
+  sensors = g_array_new (FALSE, FALSE, sizeof (NvDsRateLimitSensorStats));
+  nvds_rate_limiter_foreach_sensor (limiter, add_rate_limit_stats, sensors);
+  for (i = 0; i < sensors->len; i++) {
+    NvDsRateLimitSensorStats *stats =
+        &g_array_index (sensors, NvDsRateLimitSensorStats, i);
+
+    total.sent += stats->sent;
+    total.delayed += stats->delayed;
+    total.suppressed += stats->suppressed;
+    total.dropped += stats->dropped;
+    total.pending += stats->pending;
+  }
+  g_print ("**RATE: %s %u cameras, %" G_GUINT64_FORMAT " sent (%"
+      G_GUINT64_FORMAT " delayed), %" G_GUINT64_FORMAT " suppressed, %"
+      G_GUINT64_FORMAT " dropped, %u pending\n", name, sensors->len,
+      total.sent, total.delayed, total.suppressed, total.dropped,
+      total.pending);
+  for (i = 0; i < sensors->len; i++) {
+    NvDsRateLimitSensorStats *stats =
+        &g_array_index (sensors, NvDsRateLimitSensorStats, i);
+
+    if (stats->suppressed || stats->dropped) {
+      g_print ("  %s: %" G_GUINT64_FORMAT " suppressed, %" G_GUINT64_FORMAT
+          " dropped, %" G_GUINT64_FORMAT " delayed, %u pending\n",
+          stats->sensor, stats->suppressed, stats->dropped, stats->delayed,
+          stats->pending);
+    }
+  }
+  g_array_free (sensors, TRUE);
+}
+
+static void
+print_bboxfilter_stats (NvDsBboxFilter * filter)
+{
+  NvDsBboxFilterStats stats;
+
+  if (!filter)
+    return;
+
+  nvds_bbox_filter_get_stats (filter, &stats);
+  g_print ("**BBOX: %u objects, %u culled by size, %u outside ROI, "
+      "%u duplicates across surfaces (%s)\n", stats.objects,
+      stats.culled_size, stats.culled_roi, stats.culled_duplicate,
+      nvds_bbox_filter_kernel_name ());
+}
+
+static void
+print_msg_batch_stats (NvDsMsgBatcher * batcher, NvDsWireCodec codec)
+{
+  NvDsMsgBatchStats stats;
+
+  if (!batcher)
+    return;
+
+  nvds_msg_batcher_get_stats (batcher, &stats);
+  if (!stats.frames)
+    return;
+
+  g_print ("**BATCH: %" G_GUINT64_FORMAT " messages in %" G_GUINT64_FORMAT
+      " frames (%" G_GUINT64_FORMAT " full), %.1f messages and %.1f ms "
+      "linger per frame, %.2fx compression (%s)\n", stats.messages,
+      stats.frames, stats.full_frames,
+      (gdouble) stats.messages / stats.frames,
+      stats.linger_us / 1000.0 / stats.frames,
+      (gdouble) stats.message_bytes / MAX (stats.frame_bytes, 1),
+      nvds_msg_codec_name (codec));
+}
+
+static void
+print_msg_sender_stats (NvDsMsgSender * sender)
+{
+  NvDsMsgSenderStats stats;
+
+  if (!sender)
+    return;
+
+  nvds_msg_sender_get_stats (sender, &stats);
+  g_print ("**SPOOL: %s, %" G_GUINT64_FORMAT " messages (%.1f MB) pending, %"
+      G_GUINT64_FORMAT " sent, %" G_GUINT64_FORMAT " dropped, %"
+      G_GUINT64_FORMAT " corrupted, %" G_GUINT64_FORMAT " failures, %"
+      G_GUINT64_FORMAT " replayed at %.0f messages/s\n",
+      stats.connected ? "connected" : "disconnected", stats.spool.pending,
+      stats.spool.pending_bytes / (1024.0 * 1024.0), stats.sent,
+      stats.spool.dropped, stats.spool.corrupted, stats.failures,
+      stats.replayed, stats.replay_us ? stats.replayed * 1e6 /
+      stats.replay_us : 0.0);
+}
+
+static void
+print_msg_queue_stats (NvDsMsgQueue * queue, NvDsMsgQueuePolicy policy)
+{
+  NvDsMsgQueueStats stats;
+
+  if (!queue)
+    return;
+
+  nvds_msg_queue_get_stats (queue, &stats);
+  g_print ("**QUEUE: %u messages (%u max), %" G_GUINT64_FORMAT " dropped (%"
+      G_GUINT64_FORMAT " state changes), %.2f ms waited, %.2f ms mean in "
+      "queue (%s)\n", stats.depth, stats.max_depth, stats.dropped,
+      stats.dropped_state_changes, stats.wait_us / 1000.0,
+      stats.popped ? stats.queue_us / 1000.0 / stats.popped : 0.0,
+      nvds_msg_queue_policy_name (policy));
+}
+
 static void
 perf_cb (void *context, NvDsAppPerfStruct * str)
 {
@@ -112,6 +311,25 @@ perf_cb (void *context, NvDsAppPerfStruct * str)
   }
 
   g_print ("\n");
+  print_calibration_stats ("spot", appCtx->config.spot_config.calibration);
+  print_calibration_stats ("aisle", appCtx->config.aisle_config.calibration);
+  print_spot_stats (appCtx->pipeline.common_elements.spot_bin.analysis);
+  print_aisle_stats (appCtx->pipeline.common_elements.aisle_bin.analysis);
+  if (appCtx->pipeline.common_elements.spot_bin.analysis) {
+    print_rate_limit_stats ("spot", nvds_spot_analysis_get_rate_limiter (
+            appCtx->pipeline.common_elements.spot_bin.analysis));
+  }
+  if (appCtx->pipeline.common_elements.aisle_bin.analysis) {
+    print_rate_limit_stats ("aisle", nvds_aisle_analysis_get_rate_limiter (
+            appCtx->pipeline.common_elements.aisle_bin.analysis));
+  }
+  print_bboxfilter_stats (
+      appCtx->pipeline.common_elements.bboxfilter_bin.filter);
+  print_msg_batch_stats (appCtx->pipeline.msg_batch_bin.batcher,
+      appCtx->config.broker_config.batch_config.codec);
+  print_msg_sender_stats (appCtx->pipeline.msg_sender_bin.sender);
+  print_msg_queue_stats (appCtx->pipeline.msg_queue_bin.queue,
+      appCtx->config.broker_config.queue_config.policy);
 }
 
 /**
@@ -282,6 +500,36 @@ main (int argc, char *argv[])
     return 0;
   }
 
+  if (calib_files) {
+    for (i = 0; calib_files[i]; i++) {
+      gchar *image_path = g_strconcat (calib_files[i], NVDS_CALIB_FILE_EXT, NULL);
+      if (nvds_calibration_compile (calib_files[i], image_path)) {
+        g_print ("Compiled '%s' to '%s'\n", calib_files[i], image_path);
+      } else {
+        return_value = -1;
+      }
+      g_free (image_path);
+    }
+    return return_value;
+  }
+
+  if (benchmark_file) {
+    return nvds_occupancy_benchmark (benchmark_file) ? 0 : -1;
+  }
+
+  if (homography_benchmark_file) {
+    return nvds_homography_benchmark (homography_benchmark_file) ? 0 : -1;
+  }
+
+  if (dewarp_images) {
+    if (!dewarper_config_file) {
+      NVGSTDS_ERR_MSG_V ("--dewarp-image needs --dewarper-config");
+      return -1;
+    }
+    return nvds_cpu_dewarp_images (dewarper_config_file, dewarp_images) ?
+        0 : -1;
+  }
+
   num_instances = g_strv_length (cfg_files);
   if (input_files)
   {
@@ -12,6 +12,8 @@
 #include "deepstream-360d_app.hpp"
 #include "deepstream_common.h"
 #include "deepstream_config_file_parser.h"
+#include "deepstream_debounce.h"
+#include "deepstream_roimask.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,19 +32,56 @@ GST_DEBUG_CATEGORY_EXTERN (APP_CFG_PARSER_CAT);
 #define CONFIG_GROUP_APP_UDP_PORT_START "udp-port-start"
 
 #define CONFIG_GROUP_APP_ENABLE_SPOTBBOXFILTER "enable_bboxfilter"
+#define CONFIG_GROUP_APP_ROI_ENTRY_LATENCY "roi-entry-latency"
+#define CONFIG_GROUP_APP_ROI_EXIT_LATENCY "roi-exit-latency"
+#define CONFIG_GROUP_APP_STOP_REC_LATENCY "stop-rec-latency"
 
 #define CONFIG_GROUP_AISLE "aisle"
 #define CONFIG_GROUP_SPOT "spot"
 #define CONFIG_GROUP_BROKER "message-broker"
+#define CONFIG_GROUP_BBOXFILTER "bboxfilter"
 #define CONFIG_GROUP_SPOT_RESULT_THRESHOLD "result-threshold"
 
 #define CONFIG_KEY_ENABLE "enable"
 #define CONFIG_KEY_CALIBRATION_FILE "calibration-file"
+#define CONFIG_KEY_CALIBRATION_RELOAD_INTERVAL "calibration-reload-interval"
 #define CONFIG_KEY_CONFIG_FILE "proto-cfg-file"
 #define CONFIG_KEY_BROKER_PROTO_LIBRARY "broker-proto-lib"
 #define CONFIG_KEY_BROKER_CONNECTION_STRING "broker-conn-str"
 #define CONFIG_KEY_COMPONENT_ID "component-id"
+#define CONFIG_KEY_ENGINE "engine"
+#define CONFIG_KEY_ROI_MASK_CELL_SIZE "roi-mask-cell-size"
+#define CONFIG_KEY_OCCUPANCY_COVERAGE "occupancy-coverage"
+#define CONFIG_KEY_DEBOUNCE_FRAMES "debounce-frames"
+#define CONFIG_KEY_PUBLISH_MODE "publish-mode"
+#define CONFIG_KEY_PUBLISH_INTERVAL "publish-interval"
+#define CONFIG_KEY_ROLLUP_INTERVAL "rollup-interval"
+#define CONFIG_KEY_RATE_LIMIT "rate-limit"
+#define CONFIG_KEY_RATE_LIMIT_BURST "rate-limit-burst"
+#define CONFIG_KEY_FUSION_RADIUS "fusion-radius"
+#define CONFIG_KEY_FUSION_MAX_AGE "fusion-max-age"
+#define CONFIG_KEY_TRAJECTORY_TOLERANCE "trajectory-tolerance"
+#define CONFIG_KEY_TRAJECTORY_INTERVAL "trajectory-interval"
+#define CONFIG_KEY_ENABLE_SPEED "enable-speed"
+#define CONFIG_KEY_SPEED_PROCESS_NOISE "speed-process-noise"
+#define CONFIG_KEY_SPEED_MEASUREMENT_NOISE "speed-measurement-noise"
 #define CONFIG_KEY_PROTO_CFG "proto-cfg"
+#define CONFIG_KEY_PAYLOAD_TYPE "payload-type"
+#define CONFIG_KEY_BATCH_MAX_SIZE "batch-max-size"
+#define CONFIG_KEY_BATCH_LINGER "batch-linger"
+#define CONFIG_KEY_COMPRESSION "compression"
+#define CONFIG_KEY_COMPRESSION_LEVEL "compression-level"
+#define CONFIG_KEY_SPOOL_DIR "spool-dir"
+#define CONFIG_KEY_SPOOL_MAX_SIZE "spool-max-size"
+#define CONFIG_KEY_SPOOL_SEGMENT_SIZE "spool-segment-size"
+#define CONFIG_KEY_RETRY_INTERVAL "retry-interval"
+#define CONFIG_KEY_QUEUE_SIZE "queue-size"
+#define CONFIG_KEY_QUEUE_POLICY "queue-policy"
+#define CONFIG_KEY_DETECTED_MIN_W "detected-min-w"
+#define CONFIG_KEY_DETECTED_MIN_H "detected-min-h"
+#define CONFIG_KEY_DETECTED_MAX_W "detected-max-w"
+#define CONFIG_KEY_DETECTED_MAX_H "detected-max-h"
+#define CONFIG_KEY_SURFACE_NMS_OVERLAP "surface-nms-overlap"
 
 
 #define CONFIG_GROUP_TESTS "tests"
@@ -54,6 +93,54 @@ GST_DEBUG_CATEGORY_EXTERN (APP_CFG_PARSER_CAT);
         goto done; \
     }
 
+/**
+ * Read the integer @key of @group into @value, which must lie in
+ * [@min, @max]; enum keys pass their first and last value.
+ */
+static gboolean
+get_integer_in_range (GKeyFile * key_file, const gchar * group,
+    const gchar * key, gint min, gint max, gint * value)
+{
+  GError *error = NULL;
+
+  *value = g_key_file_get_integer (key_file, group, key, &error);
+  if (error) {
+    GST_CAT_ERROR (APP_CFG_PARSER_CAT, "%s", error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+  if (*value < min || *value > max) {
+    NVGSTDS_ERR_MSG_V ("'%s' of group [%s] is %d, must be %d to %d", key,
+        group, *value, min, max);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * Acquire the calibration named by a [spot] / [aisle] group from the process
+ * wide registry, so instances sharing a file share one copy. Both the CSV and
+ * the compiled image are accepted. The analysis plugins only read CSVs, so
+ * for an image the path is replaced by the CSV it was compiled from. The
+ * handle keeps watching both the configured file and that CSV.
+ */
+static gboolean
+load_calibration (gchar ** calibration_file, NvDsCalibHandle ** calibration,
+    NvDsCalibKind kind)
+{
+  NvDsCalibration *calib = nvds_calibration_acquire (*calibration_file, kind);
+  if (!calib) {
+    return FALSE;
+  }
+
+  *calibration = nvds_calib_handle_new (calib, *calibration_file);
+  if (g_strcmp0 (calib->source_path, calib->path)) {
+    g_free (*calibration_file);
+    *calibration_file = g_strdup (calib->source_path);
+  }
+  return TRUE;
+}
+
 static gboolean
 parse_broker (NvDsBrokerConfig * config, GKeyFile * key_file, gchar *cfg_file_path)
 {
@@ -61,6 +148,7 @@ parse_broker (NvDsBrokerConfig * config, GKeyFile * key_file, gchar *cfg_file_pa
   gchar **keys = NULL;
   gchar **key = NULL;
   GError *error = NULL;
+  gint value;
 
   keys = g_key_file_get_keys (key_file, CONFIG_GROUP_BROKER, NULL, &error);
   CHECK_ERROR (error);
@@ -100,6 +188,76 @@ parse_broker (NvDsBrokerConfig * config, GKeyFile * key_file, gchar *cfg_file_pa
           g_key_file_get_integer (key_file, CONFIG_GROUP_BROKER,
                                   CONFIG_KEY_COMPONENT_ID, &error);
       CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_PAYLOAD_TYPE)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BROKER,
+                                 CONFIG_KEY_PAYLOAD_TYPE, NVDS_PAYLOAD_JSON,
+                                 NVDS_PAYLOAD_BINARY, &value))
+        goto done;
+      config->payload_type = (NvDsPayloadType) value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_BATCH_MAX_SIZE)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BROKER,
+                                 CONFIG_KEY_BATCH_MAX_SIZE, 0,
+                                 NVDS_MSG_BATCH_MAX_SIZE, &value))
+        goto done;
+      config->batch_config.max_size = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_BATCH_LINGER)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BROKER,
+                                 CONFIG_KEY_BATCH_LINGER, 0,
+                                 NVDS_MSG_BATCH_MAX_LINGER, &value))
+        goto done;
+      config->batch_config.linger = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_COMPRESSION)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BROKER,
+                                 CONFIG_KEY_COMPRESSION, NVDS_WIRE_CODEC_NONE,
+                                 NVDS_WIRE_CODEC_ZSTD, &value))
+        goto done;
+      config->batch_config.codec = (NvDsWireCodec) value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_COMPRESSION_LEVEL)) {
+      config->batch_config.level =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_BROKER,
+                                  CONFIG_KEY_COMPRESSION_LEVEL, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_SPOOL_DIR)) {
+      config->sender_config.spool.dir =
+          get_absolute_file_path (cfg_file_path,
+                                  g_key_file_get_string (key_file,
+                                                         CONFIG_GROUP_BROKER,
+                                                         CONFIG_KEY_SPOOL_DIR,
+                                                         &error));
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_SPOOL_MAX_SIZE)) {
+      /* In MB. */
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BROKER,
+                                 CONFIG_KEY_SPOOL_MAX_SIZE, 1, G_MAXINT,
+                                 &value))
+        goto done;
+      config->sender_config.spool.max_size = (guint64) value * 1024 * 1024;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_SPOOL_SEGMENT_SIZE)) {
+      /* In MB, up to what the guint of the spool config holds. */
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BROKER,
+                                 CONFIG_KEY_SPOOL_SEGMENT_SIZE, 1,
+                                 G_MAXUINT / (1024 * 1024), &value))
+        goto done;
+      config->sender_config.spool.segment_size = (guint) value * 1024 * 1024;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_RETRY_INTERVAL)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BROKER,
+                                 CONFIG_KEY_RETRY_INTERVAL, 0,
+                                 NVDS_MSG_SENDER_MAX_RETRY_INTERVAL, &value))
+        goto done;
+      config->sender_config.retry_interval = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_QUEUE_SIZE)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BROKER,
+                                 CONFIG_KEY_QUEUE_SIZE, 0,
+                                 NVDS_MSG_QUEUE_MAX_SIZE, &value))
+        goto done;
+      config->queue_config.max_size = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_QUEUE_POLICY)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BROKER,
+                                 CONFIG_KEY_QUEUE_POLICY,
+                                 NVDS_MSG_QUEUE_DROP_OLDEST,
+                                 NVDS_MSG_QUEUE_BLOCK, &value))
+        goto done;
+      config->queue_config.policy = (NvDsMsgQueuePolicy) value;
     } else if (!g_strcmp0 (*key, CONFIG_KEY_PROTO_CFG)) {
       // Ignore the key. This will be parsed by protocol adapter library.
     } else {
@@ -134,6 +292,7 @@ parse_spot (NvDsSpotConfig * config, GKeyFile * key_file, gchar *cfg_file_path)
   gchar **keys = NULL;
   gchar **key = NULL;
   GError *error = NULL;
+  gint value;
 
   keys = g_key_file_get_keys (key_file, CONFIG_GROUP_SPOT, NULL, &error);
   CHECK_ERROR (error);
@@ -146,6 +305,12 @@ parse_spot (NvDsSpotConfig * config, GKeyFile * key_file, gchar *cfg_file_path)
                                         CONFIG_GROUP_SPOT,
                                         CONFIG_KEY_CALIBRATION_FILE, &error));
       CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_CALIBRATION_RELOAD_INTERVAL)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_SPOT,
+                                 CONFIG_KEY_CALIBRATION_RELOAD_INTERVAL, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->reload_interval = value;
     } else if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
       config->enable =
           g_key_file_get_boolean (key_file,
@@ -163,12 +328,65 @@ parse_spot (NvDsSpotConfig * config, GKeyFile * key_file, gchar *cfg_file_path)
           g_key_file_get_integer (key_file, CONFIG_GROUP_SPOT,
                                   CONFIG_KEY_COMPONENT_ID, &error);
       CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_ENGINE)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_SPOT,
+                                 CONFIG_KEY_ENGINE, NVDS_SPOT_ENGINE_PLUGIN,
+                                 NVDS_SPOT_ENGINE_APP, &value))
+        goto done;
+      config->engine = (NvDsSpotEngine) value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_OCCUPANCY_COVERAGE)) {
+      config->occupancy_coverage =
+          g_key_file_get_double (key_file, CONFIG_GROUP_SPOT,
+                                 CONFIG_KEY_OCCUPANCY_COVERAGE, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_DEBOUNCE_FRAMES)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_SPOT,
+                                 CONFIG_KEY_DEBOUNCE_FRAMES, 0,
+                                 NVDS_DEBOUNCE_MAX_WINDOW, &value))
+        goto done;
+      config->debounce_frames = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_PUBLISH_MODE)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_SPOT,
+                                 CONFIG_KEY_PUBLISH_MODE,
+                                 NVDS_SPOT_PUBLISH_PER_SPOT,
+                                 NVDS_SPOT_PUBLISH_BATCHED, &value))
+        goto done;
+      config->publish_mode = (NvDsSpotPublishMode) value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_PUBLISH_INTERVAL)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_SPOT,
+                                 CONFIG_KEY_PUBLISH_INTERVAL, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->publish_interval = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_ROLLUP_INTERVAL)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_SPOT,
+                                 CONFIG_KEY_ROLLUP_INTERVAL, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->rollup_interval = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_RATE_LIMIT)) {
+      config->rate_limit.rate =
+          g_key_file_get_double (key_file, CONFIG_GROUP_SPOT,
+                                 CONFIG_KEY_RATE_LIMIT, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_RATE_LIMIT_BURST)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_SPOT,
+                                 CONFIG_KEY_RATE_LIMIT_BURST, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->rate_limit.burst = value;
     } else {
       NVGSTDS_WARN_MSG_V ("Unknown key '%s' for group [%s]", *key,
                           CONFIG_GROUP_SPOT);
     }
   }
 
+  if (config->calibration_file &&
+      !load_calibration (&config->calibration_file, &config->calibration,
+          NVDS_CALIB_KIND_SPOT)) {
+    goto done;
+  }
+
   ret = TRUE;
 
 done:
@@ -192,6 +410,7 @@ parse_aisle (NvDsAisleConfig * config, GKeyFile * key_file, gchar *cfg_file_path
   gchar **keys = NULL;
   gchar **key = NULL;
   GError *error = NULL;
+  gint value;
 
   keys = g_key_file_get_keys (key_file, CONFIG_GROUP_AISLE, NULL, &error);
   CHECK_ERROR (error);
@@ -204,6 +423,12 @@ parse_aisle (NvDsAisleConfig * config, GKeyFile * key_file, gchar *cfg_file_path
                                         CONFIG_GROUP_AISLE,
                                         CONFIG_KEY_CALIBRATION_FILE, &error));
       CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_CALIBRATION_RELOAD_INTERVAL)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_CALIBRATION_RELOAD_INTERVAL, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->reload_interval = value;
     } else if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE)) {
       config->enable =
           g_key_file_get_boolean (key_file,
@@ -215,12 +440,147 @@ parse_aisle (NvDsAisleConfig * config, GKeyFile * key_file, gchar *cfg_file_path
           g_key_file_get_integer (key_file, CONFIG_GROUP_AISLE,
                                   CONFIG_KEY_COMPONENT_ID, &error);
       CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_ENGINE)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_ENGINE, NVDS_AISLE_ENGINE_PLUGIN,
+                                 NVDS_AISLE_ENGINE_APP, &value))
+        goto done;
+      config->engine = (NvDsAisleEngine) value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_ROI_MASK_CELL_SIZE)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_ROI_MASK_CELL_SIZE, 0,
+                                 NVDS_ROI_MASK_MAX_CELL_SIZE, &value))
+        goto done;
+      config->roi_cell_size = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_FUSION_RADIUS)) {
+      config->fusion_radius =
+          g_key_file_get_double (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_FUSION_RADIUS, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_FUSION_MAX_AGE)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_FUSION_MAX_AGE, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->fusion_max_age = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_TRAJECTORY_TOLERANCE)) {
+      config->trajectory_tolerance =
+          g_key_file_get_double (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_TRAJECTORY_TOLERANCE, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_TRAJECTORY_INTERVAL)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_TRAJECTORY_INTERVAL, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->trajectory_interval = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_ENABLE_SPEED)) {
+      config->enable_speed =
+          g_key_file_get_integer (key_file, CONFIG_GROUP_AISLE,
+                                  CONFIG_KEY_ENABLE_SPEED, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_SPEED_PROCESS_NOISE)) {
+      config->speed_process_noise =
+          g_key_file_get_double (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_SPEED_PROCESS_NOISE, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_SPEED_MEASUREMENT_NOISE)) {
+      config->speed_measurement_noise =
+          g_key_file_get_double (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_SPEED_MEASUREMENT_NOISE, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_RATE_LIMIT)) {
+      config->rate_limit.rate =
+          g_key_file_get_double (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_RATE_LIMIT, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_RATE_LIMIT_BURST)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_AISLE,
+                                 CONFIG_KEY_RATE_LIMIT_BURST, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->rate_limit.burst = value;
     } else {
       NVGSTDS_WARN_MSG_V ("Unknown key '%s' for group [%s]", *key,
                           CONFIG_GROUP_AISLE);
     }
   }
 
+  if (config->calibration_file &&
+      !load_calibration (&config->calibration_file, &config->calibration,
+          NVDS_CALIB_KIND_AISLE)) {
+    goto done;
+  }
+
+  ret = TRUE;
+
+done:
+  if (error) {
+    g_error_free (error);
+  }
+  if (keys) {
+    g_strfreev (keys);
+  }
+  if (!ret) {
+    NVGSTDS_ERR_MSG_V ("%s failed", __func__);
+  }
+  return ret;
+}
+
+static gboolean
+parse_bboxfilter (NvDsBboxFilterConfig * config, GKeyFile * key_file)
+{
+  gboolean ret = FALSE;
+  gchar **keys = NULL;
+  gchar **key = NULL;
+  GError *error = NULL;
+  gint value;
+
+  keys = g_key_file_get_keys (key_file, CONFIG_GROUP_BBOXFILTER, NULL, &error);
+  CHECK_ERROR (error);
+
+  for (key = keys; *key; key++) {
+    if (!g_strcmp0 (*key, CONFIG_KEY_DETECTED_MIN_W)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BBOXFILTER,
+                                 CONFIG_KEY_DETECTED_MIN_W, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->min_width = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_DETECTED_MIN_H)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BBOXFILTER,
+                                 CONFIG_KEY_DETECTED_MIN_H, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->min_height = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_DETECTED_MAX_W)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BBOXFILTER,
+                                 CONFIG_KEY_DETECTED_MAX_W, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->max_width = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_DETECTED_MAX_H)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BBOXFILTER,
+                                 CONFIG_KEY_DETECTED_MAX_H, 0,
+                                 G_MAXINT, &value))
+        goto done;
+      config->max_height = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_ROI_MASK_CELL_SIZE)) {
+      if (!get_integer_in_range (key_file, CONFIG_GROUP_BBOXFILTER,
+                                 CONFIG_KEY_ROI_MASK_CELL_SIZE, 0,
+                                 NVDS_ROI_MASK_MAX_CELL_SIZE, &value))
+        goto done;
+      config->roi_cell_size = value;
+    } else if (!g_strcmp0 (*key, CONFIG_KEY_SURFACE_NMS_OVERLAP)) {
+      config->surface_nms_overlap =
+          g_key_file_get_double (key_file, CONFIG_GROUP_BBOXFILTER,
+                                 CONFIG_KEY_SURFACE_NMS_OVERLAP, &error);
+      CHECK_ERROR(error);
+    } else {
+      NVGSTDS_WARN_MSG_V ("Unknown key '%s' for group [%s]", *key,
+                          CONFIG_GROUP_BBOXFILTER);
+    }
+  }
+
   ret = TRUE;
 
 done:
@@ -276,6 +636,24 @@ parse_app (NvDsConfig * config, GKeyFile * key_file, gchar *cfg_file_path)
               CONFIG_GROUP_APP,
               CONFIG_GROUP_APP_ENABLE_SPOTBBOXFILTER, &error);
       CHECK_ERROR(error);
+    } else if (!g_strcmp0(*key, CONFIG_GROUP_APP_ROI_ENTRY_LATENCY)) {
+      config->roi_entry_latency =
+          g_key_file_get_integer(key_file,
+              CONFIG_GROUP_APP,
+              CONFIG_GROUP_APP_ROI_ENTRY_LATENCY, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0(*key, CONFIG_GROUP_APP_ROI_EXIT_LATENCY)) {
+      config->roi_exit_latency =
+          g_key_file_get_integer(key_file,
+              CONFIG_GROUP_APP,
+              CONFIG_GROUP_APP_ROI_EXIT_LATENCY, &error);
+      CHECK_ERROR(error);
+    } else if (!g_strcmp0(*key, CONFIG_GROUP_APP_STOP_REC_LATENCY)) {
+      config->stop_rec_latency =
+          g_key_file_get_integer(key_file,
+              CONFIG_GROUP_APP,
+              CONFIG_GROUP_APP_STOP_REC_LATENCY, &error);
+      CHECK_ERROR(error);
     } else if (!g_strcmp0(*key, CONFIG_GROUP_APP_SELECT_RTP_PROTOCOL)) {
       config->select_rtp_protocol =
               g_key_file_get_integer(key_file,
@@ -376,6 +754,9 @@ parse_config_file (NvDsConfig * config, gchar * cfg_file_path)
     if (!g_strcmp0 (*group, CONFIG_GROUP_BROKER)) {
       parse_err = !parse_broker (&config->broker_config, cfg_file, cfg_file_path);
     }
+    if (!g_strcmp0 (*group, CONFIG_GROUP_BBOXFILTER)) {
+      parse_err = !parse_bboxfilter (&config->bboxfilter_config, cfg_file);
+    }
     if (!strncmp (*group, CONFIG_GROUP_SOURCE, sizeof (CONFIG_GROUP_SOURCE) - 1)) {
       if (config->num_source_sub_bins == MAX_SOURCE_BINS) {
         NVGSTDS_ERR_MSG_V ("App supports max %d sources", MAX_SOURCE_BINS);
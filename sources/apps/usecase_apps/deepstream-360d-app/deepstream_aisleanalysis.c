@@ -0,0 +1,784 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+
+#include "deepstream_common.h"
+#include "deepstream_aisleanalysis.h"
+#include "deepstream_homography.h"
+#include "deepstream_kalman.h"
+#include "deepstream_payload.h"
+#include "deepstream_roievents.h"
+#include "deepstream_roimask.h"
+#include "deepstream_trackfusion.h"
+#include "deepstream_trajectory.h"
+
+#define AISLE_DEFAULT_FUSION_MAX_AGE 1000
+
+typedef struct
+{
+  const NvDsAisleCalibRecord *record;
+  guint64 tracking_id;
+  gint frame_num;
+  guint64 timestamp;
+  /** Box in dewarped surface pixels, i.e. the space of the homography. */
+  gfloat left;
+  gfloat top;
+  gfloat width;
+  gfloat height;
+  /** NvDsAisleRoiStatus bits of the foot point */
+  guint roi_status;
+  /** Index of the foot point in NvDsAisleAnalysis::points */
+  guint point;
+  guint stream_id;
+  /** Vehicle of the object when tracks are fused, else NULL */
+  const NvDsFusedTrack *vehicle;
+  /** Filtered world units per second and heading in degrees, speed < 0 if
+   * not estimated */
+  gfloat speed;
+  gfloat heading;
+} NvDsAisleObject;
+
+/** What the ROI events and trajectories keep of the last observation of a
+ * track */
+typedef struct
+{
+  NvDsAisleObject obj;
+  guint64 object_id;
+  gfloat x;
+  gfloat y;
+} NvDsAisleObservation;
+
+/** Source of the observations of fused vehicles */
+#define AISLE_VEHICLE_SOURCE G_MAXUINT
+
+/** ROI, entry and exit mask of every aisle record */
+enum
+{
+  AISLE_MASK_ROI,
+  AISLE_MASK_ENTRY,
+  AISLE_MASK_EXIT,
+  AISLE_NUM_MASKS
+};
+
+struct _NvDsAisleAnalysis
+{
+  NvDsAisleConfig *config;
+  GQuark dsmeta_quark;
+  NvDsPointBatch points;
+  GArray *objects;
+  GPtrArray *payloads;
+  GString *message;
+  /** Used instead of message with the binary payload type */
+  NvDsWireWriter wire;
+
+  /** Calibration the masks were built for, referenced. */
+  NvDsCalibration *mask_calib;
+  NvDsRoiMask *masks;
+
+  /** Cross-camera vehicles, NULL unless fusion-radius is set */
+  NvDsTrackFusion *fusion;
+  /** Object reported for each vehicle of the batch */
+  GHashTable *representatives;
+
+  /** Confirmed entries and exits, NULL unless a ROI latency is set */
+  NvDsRoiEvents *roi_events;
+  /** Speed and heading filters, NULL unless enable-speed is set */
+  NvDsKalmanTable *kalman;
+  /** Simplified trajectories, NULL unless trajectory-tolerance is set */
+  NvDsTrajectories *trajectories;
+  /** Per-camera limit of the frame messages, NULL unless rate-limit is set */
+  NvDsRateLimiter *limiter;
+  /** Latest frame timestamp of the aisle surfaces of the batch */
+  guint64 batch_time;
+  /** Valid during nvds_aisle_analysis_process() */
+  const NvDsCalibration *calib;
+
+  /* Read from the perf callback, updated atomically. */
+  volatile gint positions;
+  volatile gint vertices;
+  volatile gint messages;
+};
+
+NvDsAisleAnalysis *
+nvds_aisle_analysis_new (NvDsAisleConfig * config)
+{
+  NvDsAisleAnalysis *analysis = g_new0 (NvDsAisleAnalysis, 1);
+
+  analysis->config = config;
+  analysis->dsmeta_quark = g_quark_from_static_string (NVDS_META_STRING);
+  nvds_point_batch_init (&analysis->points);
+  analysis->objects = g_array_new (FALSE, FALSE, sizeof (NvDsAisleObject));
+  analysis->payloads = g_ptr_array_new ();
+  analysis->message = g_string_sized_new (1024);
+  if (config->payload_type == NVDS_PAYLOAD_BINARY)
+    nvds_wire_writer_init (&analysis->wire);
+  if (config->fusion_radius > 0) {
+    analysis->fusion = nvds_track_fusion_new (config->fusion_radius,
+        config->fusion_max_age ? config->fusion_max_age :
+        AISLE_DEFAULT_FUSION_MAX_AGE);
+    analysis->representatives = g_hash_table_new (NULL, NULL);
+  }
+  if (config->entry_latency || config->exit_latency) {
+    analysis->roi_events = nvds_roi_events_new (config->entry_latency,
+        config->exit_latency, config->stop_latency,
+        sizeof (NvDsAisleObservation));
+  }
+  if (config->enable_speed) {
+    analysis->kalman = nvds_kalman_table_new (
+        config->speed_process_noise > 0 ? config->speed_process_noise :
+        NVDS_KALMAN_DEFAULT_PROCESS_NOISE,
+        config->speed_measurement_noise > 0 ?
+        config->speed_measurement_noise :
+        NVDS_KALMAN_DEFAULT_MEASUREMENT_NOISE,
+        config->stop_latency ? config->stop_latency :
+        NVDS_KALMAN_DEFAULT_MAX_AGE);
+  }
+  if (config->trajectory_tolerance > 0) {
+    analysis->trajectories =
+        nvds_trajectories_new (config->trajectory_tolerance,
+        config->trajectory_interval, config->stop_latency,
+        sizeof (NvDsAisleObservation));
+  }
+  if (config->rate_limit.rate > 0)
+    analysis->limiter = nvds_rate_limiter_new (&config->rate_limit);
+
+  GST_INFO ("Aisle analysis uses the %s homography kernel",
+      nvds_homography_kernel_name ());
+  return analysis;
+}
+
+static void on_trajectory (const NvDsTrajectoryPoint * points,
+    guint num_points, gboolean final, gconstpointer data, gpointer user_data);
+
+static void
+free_masks (NvDsAisleAnalysis * analysis)
+{
+  guint i;
+
+  if (!analysis->mask_calib)
+    return;
+
+  for (i = 0; i < analysis->mask_calib->num_records * AISLE_NUM_MASKS; i++)
+    nvds_roi_mask_clear (&analysis->masks[i]);
+  g_free (analysis->masks);
+  nvds_calibration_unref (analysis->mask_calib);
+  analysis->masks = NULL;
+  analysis->mask_calib = NULL;
+}
+
+/**
+ * Point a kept observation at the record of the same camera surface in the
+ * view being installed, analysis->calib. FALSE if that view has none.
+ */
+static gboolean
+move_observation (gpointer data, gpointer user_data)
+{
+  NvDsAisleAnalysis *analysis = (NvDsAisleAnalysis *) user_data;
+  NvDsAisleObservation *obs = (NvDsAisleObservation *) data;
+  const NvDsCalibRange *range;
+
+  range = nvds_calibration_lookup (analysis->calib,
+      analysis->config->source_serials[obs->obj.stream_id],
+      obs->obj.record->surface_index);
+  if (!range || range->count == 0)
+    return FALSE;
+  obs->obj.record = &nvds_calibration_aisles (analysis->calib)[range->first];
+  return TRUE;
+}
+
+/**
+ * Rasterize the ROI polygons of @calib, unless that was done already. Masks
+ * are rebuilt once after each calibration reload; a reference on the view
+ * keeps its address from being reused by a later one.
+ */
+static void
+update_masks (NvDsAisleAnalysis * analysis, const NvDsCalibration * calib)
+{
+  const NvDsAisleCalibRecord *records = nvds_calibration_aisles (calib);
+  guint cell_size = analysis->config->roi_cell_size ?
+      analysis->config->roi_cell_size : NVDS_ROI_MASK_DEFAULT_CELL_SIZE;
+  guint i;
+
+  if (analysis->mask_calib == calib)
+    return;
+
+  /* The tracks refer to records of the previous view: trajectories are
+   * reported while it is still referenced. */
+  if (analysis->trajectories && analysis->mask_calib) {
+    analysis->calib = analysis->mask_calib;
+    nvds_trajectories_flush (analysis->trajectories, on_trajectory, analysis);
+    analysis->calib = calib;
+  }
+  /* The pending entries and exits are kept, moved to the new view. */
+  if (analysis->roi_events && analysis->mask_calib)
+    nvds_roi_events_update (analysis->roi_events, move_observation, analysis);
+  free_masks (analysis);
+  analysis->mask_calib = nvds_calibration_ref ((NvDsCalibration *) calib);
+  analysis->masks = g_new0 (NvDsRoiMask, calib->num_records * AISLE_NUM_MASKS);
+
+  for (i = 0; i < calib->num_records; i++) {
+    const NvDsAisleCalibRecord *rec = &records[i];
+    NvDsRoiMask *masks = &analysis->masks[i * AISLE_NUM_MASKS];
+    gfloat y_offset = (gfloat) rec->surface_index * rec->dewarp_height;
+
+    nvds_roi_mask_build (&masks[AISLE_MASK_ROI], rec->roi,
+        MIN (rec->num_roi_points, NVDS_CALIB_MAX_ROI_POINTS), rec->dewarp_width,
+        rec->dewarp_height, y_offset, cell_size);
+    if (rec->entry) {
+      nvds_roi_mask_build (&masks[AISLE_MASK_ENTRY], rec->entry_roi,
+          NVDS_CALIB_QUAD_POINTS, rec->dewarp_width, rec->dewarp_height,
+          y_offset, cell_size);
+    }
+    if (rec->exit) {
+      nvds_roi_mask_build (&masks[AISLE_MASK_EXIT], rec->exit_roi,
+          NVDS_CALIB_QUAD_POINTS, rec->dewarp_width, rec->dewarp_height,
+          y_offset, cell_size);
+    }
+  }
+}
+
+static guint
+get_roi_status (const NvDsRoiMask * masks, gfloat x, gfloat y)
+{
+  guint status = 0;
+
+  if (!masks[AISLE_MASK_ROI].bits ||
+      nvds_roi_mask_test (&masks[AISLE_MASK_ROI], x, y))
+    status |= NVDS_AISLE_ROI_INSIDE;
+  if (nvds_roi_mask_test (&masks[AISLE_MASK_ENTRY], x, y))
+    status |= NVDS_AISLE_ROI_ENTRY;
+  if (nvds_roi_mask_test (&masks[AISLE_MASK_EXIT], x, y))
+    status |= NVDS_AISLE_ROI_EXIT;
+  return status;
+}
+
+void
+nvds_aisle_analysis_free (NvDsAisleAnalysis * analysis)
+{
+  if (!analysis)
+    return;
+
+  free_masks (analysis);
+  nvds_point_batch_free (&analysis->points);
+  g_array_free (analysis->objects, TRUE);
+  g_ptr_array_free (analysis->payloads, TRUE);
+  g_string_free (analysis->message, TRUE);
+  nvds_wire_writer_clear (&analysis->wire);
+  nvds_track_fusion_free (analysis->fusion);
+  if (analysis->representatives)
+    g_hash_table_destroy (analysis->representatives);
+  nvds_roi_events_free (analysis->roi_events);
+  nvds_trajectories_free (analysis->trajectories);
+  nvds_kalman_table_free (analysis->kalman);
+  nvds_rate_limiter_free (analysis->limiter);
+  g_free (analysis);
+}
+
+/**
+ * Start the message of @obj with its place and sensor. @object_id is the
+ * tracking id, or the vehicle id with fusion. A @suffix sets the message id
+ * apart from that of the frame message.
+ */
+static void
+begin_message (GString * str, const NvDsCalibration * calib,
+    const NvDsAisleObject * obj, guint64 object_id, const gchar * suffix)
+{
+  const NvDsAisleCalibRecord *rec = obj->record;
+  const gchar *sensor = nvds_calibration_string (calib, rec->sensor_str);
+
+  g_string_truncate (str, 0);
+  g_string_append (str, "{\"messageid\":");
+  g_string_append_printf (str, "\"%s-%d-%" G_GUINT64_FORMAT "%s%s\"", sensor,
+      obj->frame_num, object_id, suffix ? "-" : "", suffix ? suffix : "");
+  g_string_append (str, ",\"mdsversion\":\"1.0\",\"@timestamp\":");
+  nvds_json_append_timestamp (str, obj->timestamp);
+
+  g_string_append (str, ",\"place\":{\"id\":");
+  nvds_json_append_string (str, nvds_calibration_string (calib, rec->aisle_str));
+  g_string_append (str, ",\"name\":");
+  nvds_json_append_string (str, nvds_calibration_string (calib, rec->aisle_name));
+  g_string_append (str, ",\"level\":");
+  nvds_json_append_string (str, nvds_calibration_string (calib, rec->level));
+
+  g_string_append (str, "},\"sensor\":{\"id\":");
+  nvds_json_append_string (str, sensor);
+  g_string_append (str, ",\"type\":\"Camera\",\"description\":");
+  nvds_json_append_string (str, nvds_calibration_string (calib, rec->cam_desc));
+
+  g_string_append_printf (str, "},\"object\":{\"id\":\"%" G_GUINT64_FORMAT
+      "\",\"bbox\":{\"topleftx\":%.0f,\"toplefty\":%.0f,"
+      "\"bottomrightx\":%.0f,\"bottomrighty\":%.0f}",
+      object_id, obj->left, obj->top, obj->left + obj->width,
+      obj->top + obj->height);
+}
+
+/** Append the coordinate, plus the speed and heading if estimated. */
+static void
+append_coordinate (GString * str, const NvDsAisleObject * obj, gfloat x,
+    gfloat y)
+{
+  g_string_append_printf (str, ",\"coordinate\":{\"x\":%.4f,\"y\":%.4f,"
+      "\"z\":0}", x, y);
+  if (obj->speed >= 0) {
+    g_string_append_printf (str, ",\"speed\":%.2f,\"direction\":%.1f",
+        obj->speed, obj->heading);
+  }
+}
+
+/**
+ * Start the binary message of @obj with a record of its place, sensor, box
+ * and coordinate, up to its event. See nvds_wire.h.
+ */
+static void
+begin_wire_message (NvDsWireWriter * wire, const NvDsCalibration * calib,
+    const NvDsAisleObject * obj, guint64 object_id, gfloat x, gfloat y,
+    guint flags)
+{
+  const NvDsAisleCalibRecord *rec = obj->record;
+
+  if (obj->speed >= 0)
+    flags |= NVDS_WIRE_AISLE_HAS_SPEED;
+
+  nvds_wire_writer_begin (wire, NVDS_WIRE_KIND_AISLE, obj->timestamp);
+  nvds_wire_writer_record (wire);
+  nvds_wire_put_time (wire, obj->timestamp);
+  nvds_wire_put_string (wire, nvds_calibration_string (calib, rec->aisle_str));
+  nvds_wire_put_string (wire, nvds_calibration_string (calib, rec->aisle_name));
+  nvds_wire_put_string (wire, nvds_calibration_string (calib, rec->level));
+  nvds_wire_put_string (wire, nvds_calibration_string (calib,
+          rec->sensor_str));
+  nvds_wire_put_string (wire, nvds_calibration_string (calib, rec->cam_desc));
+  nvds_wire_put_uint (wire, object_id);
+  nvds_wire_put_uint (wire, MAX (obj->frame_num, 0));
+  nvds_wire_put_uint (wire, (guint) MAX (llroundf (obj->left), 0));
+  nvds_wire_put_uint (wire, (guint) MAX (llroundf (obj->top), 0));
+  nvds_wire_put_uint (wire, (guint) MAX (llroundf (obj->left + obj->width), 0));
+  nvds_wire_put_uint (wire, (guint) MAX (llroundf (obj->top + obj->height),
+          0));
+  nvds_wire_put_sint (wire, nvds_wire_quantize (x));
+  nvds_wire_put_sint (wire, nvds_wire_quantize (y));
+  nvds_wire_put_uint (wire, flags);
+  if (flags & NVDS_WIRE_AISLE_HAS_SPEED) {
+    nvds_wire_put_uint (wire, (guint) lroundf (obj->speed *
+            NVDS_WIRE_SPEED_QUANTUM));
+    nvds_wire_put_uint (wire, (guint) lroundf (obj->heading *
+            NVDS_WIRE_HEADING_QUANTUM));
+  }
+}
+
+static NvDsWireAisleEventType
+wire_event (const gchar * event)
+{
+  if (!g_strcmp0 (event, "entry"))
+    return NVDS_WIRE_AISLE_ENTRY;
+  if (!g_strcmp0 (event, "exit"))
+    return NVDS_WIRE_AISLE_EXIT;
+  return NVDS_WIRE_AISLE_MOVING;
+}
+
+/** The message id of a @confirmed event is set apart from the frame's. */
+static void
+build_message (NvDsAisleAnalysis * analysis, const NvDsCalibration * calib,
+    const NvDsAisleObject * obj, guint64 object_id, gfloat x, gfloat y,
+    const gchar * event, gboolean confirmed)
+{
+  GString *str = analysis->message;
+
+  if (analysis->config->payload_type == NVDS_PAYLOAD_BINARY) {
+    begin_wire_message (&analysis->wire, calib, obj, object_id, x, y,
+        confirmed ? NVDS_WIRE_AISLE_CONFIRMED : 0);
+    nvds_wire_put_uint (&analysis->wire, wire_event (event));
+    return;
+  }
+
+  begin_message (str, calib, obj, object_id, confirmed ? event : NULL);
+  append_coordinate (str, obj, x, y);
+  g_string_append_printf (str, "},\"event\":{\"type\":\"%s\"}}", event);
+}
+
+/**
+ * The trajectory is an array of [x, y, ms since @timestamp] vertices, the
+ * coordinate its last vertex. @obj is the last observation of the track.
+ */
+static void
+build_trajectory_message (NvDsAisleAnalysis * analysis,
+    const NvDsCalibration * calib, const NvDsAisleObject * obj,
+    guint64 object_id, const NvDsTrajectoryPoint * points, guint num_points,
+    gboolean final)
+{
+  GString *str = analysis->message;
+  NvDsAisleObject first = *obj;
+  const NvDsTrajectoryPoint *last = &points[num_points - 1];
+  guint i;
+
+  first.timestamp = points[0].timestamp;
+  if (analysis->config->payload_type == NVDS_PAYLOAD_BINARY) {
+    NvDsWireWriter *wire = &analysis->wire;
+    gint64 prev_x = 0, prev_y = 0;
+    guint prev_ms = 0;
+
+    begin_wire_message (wire, calib, &first, object_id, last->x, last->y,
+        final ? NVDS_WIRE_AISLE_FINAL : 0);
+    nvds_wire_put_uint (wire, NVDS_WIRE_AISLE_TRAJECTORY);
+    nvds_wire_put_uint (wire, num_points);
+    /* Deltas of the quantized vertices, so that errors do not add up. */
+    for (i = 0; i < num_points; i++) {
+      gint64 qx = nvds_wire_quantize (points[i].x);
+      gint64 qy = nvds_wire_quantize (points[i].y);
+      guint ms = (guint) ((points[i].timestamp - points[0].timestamp) /
+          1000000);
+
+      nvds_wire_put_sint (wire, qx - prev_x);
+      nvds_wire_put_sint (wire, qy - prev_y);
+      nvds_wire_put_uint (wire, ms - prev_ms);
+      prev_x = qx;
+      prev_y = qy;
+      prev_ms = ms;
+    }
+    return;
+  }
+
+  begin_message (str, calib, &first, object_id, "trajectory");
+  append_coordinate (str, obj, last->x, last->y);
+  g_string_append (str, ",\"trajectory\":[");
+  for (i = 0; i < num_points; i++) {
+    g_string_append_printf (str, "%s[%.4f,%.4f,%u]", i ? "," : "",
+        points[i].x, points[i].y,
+        (guint) ((points[i].timestamp - points[0].timestamp) / 1000000));
+  }
+  g_string_append_printf (str, "]},\"event\":{\"type\":\"trajectory\","
+      "\"final\":%s}}", final ? "true" : "false");
+}
+
+static const gchar *
+frame_event (NvDsAisleAnalysis * analysis, const NvDsAisleObject * obj)
+{
+  /* Entries and exits are reported on their own once confirmed. */
+  if (analysis->roi_events)
+    return "moving";
+  return (obj->roi_status & NVDS_AISLE_ROI_ENTRY) ? "entry" :
+      (obj->roi_status & NVDS_AISLE_ROI_EXIT) ? "exit" : "moving";
+}
+
+static NvDsPayload *
+finish_payload (NvDsAisleAnalysis * analysis)
+{
+  g_atomic_int_inc (&analysis->messages);
+  if (analysis->config->payload_type == NVDS_PAYLOAD_BINARY)
+    return nvds_wire_writer_finish (&analysis->wire, analysis->config->comp_id);
+  return nvds_payload_new (analysis->message->str, analysis->message->len,
+      analysis->config->comp_id);
+}
+
+static void
+add_payload (NvDsAisleAnalysis * analysis)
+{
+  g_ptr_array_add (analysis->payloads, finish_payload (analysis));
+}
+
+/**
+ * Queue the frame message of @obj, through the limiter if any: a track
+ * updated faster than its camera may send is only reported at its latest
+ * position. Confirmed entries, exits and trajectories are not limited.
+ */
+static void
+add_frame_payload (NvDsAisleAnalysis * analysis, const NvDsAisleObject * obj,
+    guint64 object_id)
+{
+  /* Vehicle ids are apart from the tracking ids of the camera. */
+  guint64 key = obj->vehicle ? object_id | G_GUINT64_CONSTANT (1) << 63 :
+      object_id;
+
+  if (!analysis->limiter) {
+    add_payload (analysis);
+    return;
+  }
+  nvds_rate_limiter_submit (analysis->limiter,
+      nvds_calibration_string (analysis->calib, obj->record->sensor_str), key,
+      finish_payload (analysis), analysis->payloads, g_get_monotonic_time ());
+}
+
+/**
+ * Gather the foot points of every object inside the ROI of an aisle surface
+ * of the batch. Each frame starts a run of the point batch, since all its
+ * objects are projected with the homography of that surface. The homography
+ * and the ROI polygons are given for all surfaces of a camera stacked
+ * vertically, so the foot point is offset by the surface index.
+ */
+static void
+collect_objects (NvDsAisleAnalysis * analysis, const NvDsCalibration * calib,
+    GstBuffer * buf)
+{
+  NvDsAisleConfig *config = analysis->config;
+  GstMeta *meta;
+  gpointer state = NULL;
+  guint i;
+
+  while ((meta = gst_buffer_iterate_meta (buf, &state))) {
+    NvDsMeta *dsmeta = (NvDsMeta *) meta;
+    NvDsFrameMeta *frame_meta;
+    const NvDsCalibRange *range;
+    const NvDsAisleCalibRecord *rec;
+    const NvDsRoiMask *masks;
+    gfloat scale_x, scale_y, y_offset;
+    guint64 timestamp;
+
+    if (!gst_meta_api_type_has_tag (meta->info->api, analysis->dsmeta_quark) ||
+        dsmeta->meta_type != NVDS_META_FRAME_INFO) {
+      continue;
+    }
+
+    frame_meta = (NvDsFrameMeta *) dsmeta->meta_data;
+    if (frame_meta->surface_type != NVDS_CALIB_SURFACE_VERTRADCYL)
+      continue;
+
+    timestamp = nvds_frame_timestamp (frame_meta);
+    analysis->batch_time = MAX (analysis->batch_time, timestamp);
+    if (frame_meta->num_rects == 0 ||
+        frame_meta->stream_id >= config->num_sources) {
+      continue;
+    }
+
+    range = nvds_calibration_lookup (calib,
+        config->source_serials[frame_meta->stream_id],
+        frame_meta->surface_index);
+    if (!range || range->count == 0)
+      continue;
+
+    rec = &nvds_calibration_aisles (calib)[range->first];
+    masks = &analysis->masks[range->first * AISLE_NUM_MASKS];
+    y_offset = (gfloat) rec->surface_index * rec->dewarp_height;
+    scale_x = (gfloat) rec->dewarp_width / config->frame_width;
+    scale_y = (gfloat) rec->dewarp_height / config->frame_height;
+
+    nvds_point_batch_begin_run (&analysis->points, rec->homography);
+    for (i = 0; i < frame_meta->num_rects; i++) {
+      const NvOSD_RectParams *rect = &frame_meta->obj_params[i].rect_params;
+      NvDsAisleObject obj;
+
+      obj.record = rec;
+      obj.stream_id = frame_meta->stream_id;
+      obj.vehicle = NULL;
+      obj.speed = -1;
+      obj.heading = 0;
+      obj.tracking_id = frame_meta->obj_params[i].tracking_id;
+      obj.frame_num = frame_meta->frame_num;
+      obj.timestamp = timestamp;
+      obj.left = rect->left * scale_x;
+      obj.top = rect->top * scale_y;
+      obj.width = rect->width * scale_x;
+      obj.height = rect->height * scale_y;
+      obj.roi_status = get_roi_status (masks, obj.left + obj.width / 2,
+          obj.top + obj.height);
+      if (!(obj.roi_status & NVDS_AISLE_ROI_INSIDE))
+        continue;
+
+      obj.point = nvds_point_batch_add (&analysis->points,
+          obj.left + obj.width / 2, obj.top + obj.height + y_offset);
+      g_array_append_val (analysis->objects, obj);
+    }
+  }
+}
+
+/**
+ * Bind the objects of the batch to their vehicle, and pick the one reported
+ * for each vehicle: the largest box, which is usually the nearest camera.
+ */
+static void
+fuse_objects (NvDsAisleAnalysis * analysis)
+{
+  guint64 now = 0;
+  guint i;
+
+  for (i = 0; i < analysis->objects->len; i++)
+    now = MAX (now, g_array_index (analysis->objects, NvDsAisleObject,
+            i).timestamp);
+  nvds_track_fusion_begin (analysis->fusion, now);
+  g_hash_table_remove_all (analysis->representatives);
+
+  for (i = 0; i < analysis->objects->len; i++) {
+    NvDsAisleObject *obj = &g_array_index (analysis->objects, NvDsAisleObject,
+        i);
+    gpointer best;
+
+    obj->vehicle = nvds_track_fusion_assign (analysis->fusion, obj->stream_id,
+        obj->tracking_id, analysis->points.world_x[obj->point],
+        analysis->points.world_y[obj->point], obj->timestamp);
+    if (!g_hash_table_lookup_extended (analysis->representatives,
+            obj->vehicle, NULL, &best) ||
+        obj->height > g_array_index (analysis->objects, NvDsAisleObject,
+            GPOINTER_TO_UINT (best)).height) {
+      g_hash_table_insert (analysis->representatives, (gpointer) obj->vehicle,
+          GUINT_TO_POINTER (i));
+    }
+  }
+}
+
+static void
+on_roi_event (NvDsRoiEventType type, guint64 timestamp_ns, gconstpointer data,
+    gpointer user_data)
+{
+  NvDsAisleAnalysis *analysis = (NvDsAisleAnalysis *) user_data;
+  NvDsAisleObservation obs = *(const NvDsAisleObservation *) data;
+
+  obs.obj.timestamp = timestamp_ns;
+  build_message (analysis, analysis->calib, &obs.obj, obs.object_id,
+      obs.x, obs.y, type == NVDS_ROI_EVENT_ENTRY ? "entry" : "exit", TRUE);
+  add_payload (analysis);
+}
+
+static void
+on_trajectory (const NvDsTrajectoryPoint * points, guint num_points,
+    gboolean final, gconstpointer data, gpointer user_data)
+{
+  NvDsAisleAnalysis *analysis = (NvDsAisleAnalysis *) user_data;
+  const NvDsAisleObservation *obs = (const NvDsAisleObservation *) data;
+
+  g_atomic_int_add (&analysis->vertices, num_points);
+  build_trajectory_message (analysis, analysis->calib, &obs->obj,
+      obs->object_id, points, num_points, final);
+  add_payload (analysis);
+}
+
+/** Feed the reported objects to the ROI events and trajectories. */
+static void
+observe_object (NvDsAisleAnalysis * analysis, const NvDsAisleObject * obj,
+    guint64 object_id, gfloat x, gfloat y)
+{
+  guint source = obj->vehicle ? AISLE_VEHICLE_SOURCE : obj->stream_id;
+  NvDsAisleObservation obs;
+
+  obs.obj = *obj;
+  obs.obj.vehicle = NULL;
+  obs.object_id = object_id;
+  obs.x = x;
+  obs.y = y;
+  if (analysis->roi_events) {
+    nvds_roi_events_observe (analysis->roi_events, source, object_id,
+        (obj->roi_status & NVDS_AISLE_ROI_ENTRY) != 0,
+        (obj->roi_status & NVDS_AISLE_ROI_EXIT) != 0, obj->timestamp, &obs);
+  }
+  if (analysis->trajectories) {
+    g_atomic_int_inc (&analysis->positions);
+    nvds_trajectories_add (analysis->trajectories, source, object_id, x, y,
+        obj->timestamp, &obs);
+  }
+}
+
+GstBuffer *
+nvds_aisle_analysis_process (NvDsAisleAnalysis * analysis, GstBuffer * buf)
+{
+  NvDsAisleConfig *config = analysis->config;
+  const NvDsCalibration *calib;
+  gint phase;
+  guint i;
+
+  if (!config->calibration || !config->frame_width || !config->frame_height)
+    return buf;
+
+  nvds_point_batch_reset (&analysis->points);
+  g_array_set_size (analysis->objects, 0);
+  analysis->batch_time = 0;
+
+  calib = nvds_calib_read_begin (config->calibration, &phase);
+  analysis->calib = calib;
+  update_masks (analysis, calib);
+  collect_objects (analysis, calib, buf);
+  nvds_homography_project_batch (&analysis->points);
+  if (analysis->fusion)
+    fuse_objects (analysis);
+
+  for (i = 0; i < analysis->objects->len; i++) {
+    NvDsAisleObject *obj =
+        &g_array_index (analysis->objects, NvDsAisleObject, i);
+    guint64 object_id;
+    gfloat x, y;
+
+    /* One message per vehicle, at the mean of its observations. */
+    if (obj->vehicle) {
+      if (GPOINTER_TO_UINT (g_hash_table_lookup (analysis->representatives,
+                  obj->vehicle)) != i)
+        continue;
+      object_id = obj->vehicle->id;
+      x = obj->vehicle->x;
+      y = obj->vehicle->y;
+    } else {
+      object_id = obj->tracking_id;
+      x = analysis->points.world_x[obj->point];
+      y = analysis->points.world_y[obj->point];
+    }
+    if (analysis->kalman) {
+      const NvDsKalmanTrack *track = nvds_kalman_table_update (analysis->kalman,
+          obj->vehicle ? AISLE_VEHICLE_SOURCE : obj->stream_id, object_id, x,
+          y, obj->timestamp);
+
+      obj->speed = nvds_kalman_track_speed (track);
+      obj->heading = nvds_kalman_track_heading (track);
+    }
+    /* Trajectories replace the frame messages. */
+    if (!analysis->trajectories) {
+      build_message (analysis, calib, obj, object_id, x, y,
+          frame_event (analysis, obj), FALSE);
+      add_frame_payload (analysis, obj, object_id);
+    }
+    if (analysis->roi_events || analysis->trajectories)
+      observe_object (analysis, obj, object_id, x, y);
+  }
+  if (analysis->kalman && analysis->batch_time)
+    nvds_kalman_table_expire (analysis->kalman, analysis->batch_time);
+  if (analysis->roi_events && analysis->batch_time) {
+    nvds_roi_events_advance (analysis->roi_events, analysis->batch_time,
+        on_roi_event, analysis);
+  }
+  if (analysis->trajectories && analysis->batch_time) {
+    nvds_trajectories_advance (analysis->trajectories, analysis->batch_time,
+        on_trajectory, analysis);
+  }
+  if (analysis->limiter) {
+    nvds_rate_limiter_flush (analysis->limiter, analysis->payloads,
+        g_get_monotonic_time ());
+  }
+  analysis->calib = NULL;
+  nvds_calib_read_end (config->calibration, phase);
+
+  /* Payloads are attached after the meta iteration above. */
+  return nvds_payload_attach (buf, analysis->payloads);
+}
+
+GstBuffer *
+nvds_aisle_analysis_flush (NvDsAisleAnalysis * analysis)
+{
+  /* The tracks refer to records of the view the masks hold. */
+  if (analysis->trajectories && analysis->mask_calib) {
+    analysis->calib = analysis->mask_calib;
+    nvds_trajectories_flush (analysis->trajectories, on_trajectory, analysis);
+    analysis->calib = NULL;
+  }
+  if (analysis->limiter)
+    nvds_rate_limiter_drain (analysis->limiter, analysis->payloads);
+  return nvds_payload_buffer_new (analysis->payloads);
+}
+
+void
+nvds_aisle_analysis_get_stats (NvDsAisleAnalysis * analysis,
+    NvDsAisleAnalysisStats * stats)
+{
+  stats->positions = g_atomic_int_get (&analysis->positions);
+  stats->vertices = g_atomic_int_get (&analysis->vertices);
+  stats->messages = g_atomic_int_get (&analysis->messages);
+}
+
+NvDsRateLimiter *
+nvds_aisle_analysis_get_rate_limiter (NvDsAisleAnalysis * analysis)
+{
+  return analysis->limiter;
+}
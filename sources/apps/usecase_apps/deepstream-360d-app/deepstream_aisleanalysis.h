@@ -19,23 +19,131 @@ extern "C"
 
 #include <gst/gst.h>
 
+#include "deepstream_calibration_watch.h"
+#include "deepstream_ratelimit.h"
+#include "deepstream_wire.h"
+
+/** Which implementation analyses the aisle surfaces. */
+typedef enum
+{
+  /** nvaisle + nvmsgconv plugins */
+  NVDS_AISLE_ENGINE_PLUGIN = 0,
+  /** In-app analysis, see deepstream_aisleanalysis.c */
+  NVDS_AISLE_ENGINE_APP = 1,
+} NvDsAisleEngine;
+
+/** Bits of the ROI status of an object on an aisle surface. */
+typedef enum
+{
+  NVDS_AISLE_ROI_INSIDE = 1 << 0,
+  NVDS_AISLE_ROI_ENTRY = 1 << 1,
+  NVDS_AISLE_ROI_EXIT = 1 << 2,
+} NvDsAisleRoiStatus;
+
+typedef struct _NvDsAisleAnalysis NvDsAisleAnalysis;
+
+/** Counts since the start, read by the perf callback. */
+typedef struct
+{
+  /** Positions fed to the trajectories, and vertices they were reduced to */
+  guint positions;
+  guint vertices;
+  /** Messages attached */
+  guint messages;
+} NvDsAisleAnalysisStats;
+
 typedef struct
 {
   GstElement *bin;
   GstElement *sink_queue;
   GstElement *aisle;
   GstElement *msg_conv;
+  NvDsAisleAnalysis *analysis;
+  gulong probe_id;
 } NvDsAisleBin;
 
 typedef struct
 {
   gboolean enable;
   gchar *calibration_file;
+  NvDsCalibHandle *calibration;
+  /** Calibration file poll interval in ms, 0 disables reloading. */
+  guint reload_interval;
   guint comp_id;
+  NvDsAisleEngine engine;
+  /** Pixels per side of a cell of the rasterized ROI masks */
+  guint roi_cell_size;
+  /** World distance within which tracks of different cameras are fused
+   * into one vehicle, 0 to report every camera track */
+  gdouble fusion_radius;
+  /** ms after which a vehicle that was not seen is forgotten */
+  guint fusion_max_age;
+  /** World distance the simplified trajectories of the tracks stay within;
+   * when set they replace the message of every frame */
+  gdouble trajectory_tolerance;
+  /** ms between trajectory messages of a track, 0 to send one at its end */
+  guint trajectory_interval;
+  /** Add the speed and heading of a constant-velocity Kalman filter of each
+   * track to its messages */
+  gboolean enable_speed;
+  /** Acceleration noise density (units^2/s^3) and position noise (units)
+   * of the filter, 0 for the defaults */
+  gdouble speed_process_noise;
+  gdouble speed_measurement_noise;
+  /** Limit of the frame messages of each camera, see NvDsRateLimiter */
+  NvDsRateLimitConfig rate_limit;
+
+  /* Filled in by the pipeline for the in-app analysis. */
+  /** camera-id of each source, i.e. its calibration serial */
+  guint *source_serials;
+  guint num_sources;
+  /** Resolution of the batched frames the object boxes refer to. */
+  guint frame_width;
+  guint frame_height;
+  /** [application] roi-entry-latency and roi-exit-latency: ms a track must
+   * stay in the entry ROI, and out of the exit ROI, before its entry or exit
+   * is reported; both 0 report the ROI status of every frame instead */
+  guint entry_latency;
+  guint exit_latency;
+  /** [application] stop-rec-latency: ms after which a track that was not
+   * seen is forgotten, or its trajectory ends */
+  guint stop_latency;
+  /** [message-broker] payload-type */
+  NvDsPayloadType payload_type;
 } NvDsAisleConfig;
 
 gboolean create_aisle_analysis_bin (NvDsAisleConfig * config, NvDsAisleBin * bin);
 
+void destroy_aisle_analysis_bin (NvDsAisleBin * bin);
+
+NvDsAisleAnalysis *nvds_aisle_analysis_new (NvDsAisleConfig * config);
+
+void nvds_aisle_analysis_free (NvDsAisleAnalysis * analysis);
+
+/**
+ * Project the objects of every aisle surface in @buf to world coordinates
+ * and attach one message payload per object, or per vehicle if tracks are
+ * fused, plus one per entry or exit confirmed by the latencies. With
+ * trajectories, the objects are instead reported by trajectory messages. Returns @buf,
+ * or a writable copy of it if payloads were attached.
+ */
+GstBuffer *nvds_aisle_analysis_process (NvDsAisleAnalysis * analysis,
+    GstBuffer * buf);
+
+/**
+ * Report the open trajectories as final, and queue the messages held back by
+ * the rate limiter, at EOS. Returns a buffer carrying the payloads, see
+ * nvds_payload_buffer_new(), or NULL.
+ */
+GstBuffer *nvds_aisle_analysis_flush (NvDsAisleAnalysis * analysis);
+
+void nvds_aisle_analysis_get_stats (NvDsAisleAnalysis * analysis,
+    NvDsAisleAnalysisStats * stats);
+
+/** NULL unless rate-limit is set. */
+NvDsRateLimiter *nvds_aisle_analysis_get_rate_limiter (NvDsAisleAnalysis *
+    analysis);
+
 #ifdef __cplusplus
 }
 #endif
@@ -12,6 +12,36 @@
 #include "deepstream_common.h"
 #include "deepstream_aisleanalysis.h"
 
+static GstPadProbeReturn
+aisle_analysis_buf_prob (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  NvDsAisleAnalysis *analysis = (NvDsAisleAnalysis *) u_data;
+
+  GST_PAD_PROBE_INFO_DATA (info) =
+      nvds_aisle_analysis_process (analysis, GST_PAD_PROBE_INFO_BUFFER (info));
+  return GST_PAD_PROBE_OK;
+}
+
+/**
+ * No frame follows EOS to carry what the analysis still holds, so it goes
+ * out on a buffer of its own ahead of it.
+ */
+static GstPadProbeReturn
+aisle_analysis_eos_prob (GstPad * pad, GstPadProbeInfo * info,
+    gpointer u_data)
+{
+  NvDsAisleAnalysis *analysis = (NvDsAisleAnalysis *) u_data;
+  GstBuffer *buf;
+
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) != GST_EVENT_EOS)
+    return GST_PAD_PROBE_OK;
+
+  buf = nvds_aisle_analysis_flush (analysis);
+  if (buf)
+    gst_pad_push (pad, buf);
+  return GST_PAD_PROBE_OK;
+}
+
 gboolean
 create_aisle_analysis_bin (NvDsAisleConfig * config, NvDsAisleBin * bin)
 {
@@ -29,6 +59,22 @@ create_aisle_analysis_bin (NvDsAisleConfig * config, NvDsAisleBin * bin)
     goto done;
   }
 
+  if (config->engine == NVDS_AISLE_ENGINE_APP) {
+    /* Analysis and message payloads are done in the app, on the streaming
+     * thread of the queue. */
+    gst_bin_add (GST_BIN (bin->bin), bin->sink_queue);
+    bin->analysis = nvds_aisle_analysis_new (config);
+    NVGSTDS_ELEM_ADD_PROBE (bin->probe_id, bin->sink_queue, "src",
+        aisle_analysis_buf_prob, GST_PAD_PROBE_TYPE_BUFFER, bin->analysis);
+    NVGSTDS_ELEM_ADD_PROBE (bin->probe_id, bin->sink_queue, "src",
+        aisle_analysis_eos_prob, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        bin->analysis);
+    NVGSTDS_BIN_ADD_GHOST_PAD (bin->bin, bin->sink_queue, "sink");
+    NVGSTDS_BIN_ADD_GHOST_PAD (bin->bin, bin->sink_queue, "src");
+    ret = TRUE;
+    goto done;
+  }
+
   bin->aisle = gst_element_factory_make (NVDS_ELEM_NVAISLEMETADATA, "aisle_analysis");
   if (!bin->aisle) {
     NVGSTDS_ERR_MSG_V ("Failed to create 'aisle_analysis'");
@@ -63,3 +109,10 @@ done:
   }
   return ret;
 }
+
+void
+destroy_aisle_analysis_bin (NvDsAisleBin * bin)
+{
+  nvds_aisle_analysis_free (bin->analysis);
+  bin->analysis = NULL;
+}
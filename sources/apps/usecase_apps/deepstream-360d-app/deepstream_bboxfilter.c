@@ -0,0 +1,533 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <float.h>
+#include <string.h>
+
+#include "gstnvdsmeta.h"
+#include "deepstream_common.h"
+#include "deepstream_bboxfilter.h"
+#include "deepstream_roimask.h"
+#include "deepstream_surfacenms.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BBOXFILTER_X86 1
+#endif
+
+/** Boxes are tested in blocks of 8 lanes; arrays are padded to a block. */
+#define BBOX_BLOCK 8
+#define BBOX_WORDS(n) (((n) + 31) / 32)
+
+/** Object boxes of one frame as structure of arrays, in frame pixels. */
+typedef struct
+{
+  guint count;
+  guint capacity;
+  gfloat *left;
+  gfloat *top;
+  gfloat *width;
+  gfloat *height;
+  /** Bit sets of the boxes within the size limits and the region */
+  guint32 *size_ok;
+  guint32 *region_ok;
+} NvDsBoxBatch;
+
+/** A box is kept if its size is within the limits and it overlaps region. */
+typedef struct
+{
+  gfloat min_width;
+  gfloat min_height;
+  gfloat max_width;
+  gfloat max_height;
+  /** left, top, right, bottom */
+  gfloat region[4];
+} NvDsBoxLimits;
+
+typedef void (*CullFunc) (NvDsBoxBatch * boxes, const NvDsBoxLimits * limits);
+
+struct _NvDsBboxFilter
+{
+  NvDsBboxFilterConfig *config;
+  GQuark dsmeta_quark;
+  NvDsBoxBatch boxes;
+  NvDsBoxLimits size_limits;
+
+  /** Aisle calibration the ROI masks were built for, referenced */
+  NvDsCalibration *mask_calib;
+  NvDsRoiMask *masks;
+  /** Spot calibration the bounds were computed for, referenced */
+  NvDsCalibration *bounds_calib;
+  /** Box around the spots of each calibration range, in surface pixels */
+  gfloat *spot_bounds;
+  NvDsSurfaceNms *nms;
+
+  /* Read from the perf callback, updated atomically. */
+  volatile gint objects;
+  volatile gint culled_size;
+  volatile gint culled_roi;
+  volatile gint culled_duplicate;
+};
+
+static void
+cull_scalar (NvDsBoxBatch * boxes, const NvDsBoxLimits * limits)
+{
+  guint i;
+
+  memset (boxes->size_ok, 0, BBOX_WORDS (boxes->count) * sizeof (guint32));
+  memset (boxes->region_ok, 0, BBOX_WORDS (boxes->count) * sizeof (guint32));
+  for (i = 0; i < boxes->count; i++) {
+    gfloat l = boxes->left[i];
+    gfloat t = boxes->top[i];
+    gfloat w = boxes->width[i];
+    gfloat h = boxes->height[i];
+
+    if (w >= limits->min_width && w <= limits->max_width &&
+        h >= limits->min_height && h <= limits->max_height)
+      boxes->size_ok[i / 32] |= 1u << (i % 32);
+    if (l < limits->region[2] && l + w > limits->region[0] &&
+        t < limits->region[3] && t + h > limits->region[1])
+      boxes->region_ok[i / 32] |= 1u << (i % 32);
+  }
+}
+
+#ifdef BBOXFILTER_X86
+__attribute__ ((target ("avx2")))
+static void
+cull_avx2 (NvDsBoxBatch * boxes, const NvDsBoxLimits * limits)
+{
+  __m256 min_w = _mm256_set1_ps (limits->min_width);
+  __m256 min_h = _mm256_set1_ps (limits->min_height);
+  __m256 max_w = _mm256_set1_ps (limits->max_width);
+  __m256 max_h = _mm256_set1_ps (limits->max_height);
+  __m256 rl = _mm256_set1_ps (limits->region[0]);
+  __m256 rt = _mm256_set1_ps (limits->region[1]);
+  __m256 rr = _mm256_set1_ps (limits->region[2]);
+  __m256 rb = _mm256_set1_ps (limits->region[3]);
+  guint i;
+
+  memset (boxes->size_ok, 0, BBOX_WORDS (boxes->count) * sizeof (guint32));
+  memset (boxes->region_ok, 0, BBOX_WORDS (boxes->count) * sizeof (guint32));
+  for (i = 0; i < boxes->count; i += BBOX_BLOCK) {
+    __m256 l = _mm256_loadu_ps (boxes->left + i);
+    __m256 t = _mm256_loadu_ps (boxes->top + i);
+    __m256 w = _mm256_loadu_ps (boxes->width + i);
+    __m256 h = _mm256_loadu_ps (boxes->height + i);
+    __m256 size = _mm256_and_ps (
+        _mm256_and_ps (_mm256_cmp_ps (w, min_w, _CMP_GE_OQ),
+            _mm256_cmp_ps (w, max_w, _CMP_LE_OQ)),
+        _mm256_and_ps (_mm256_cmp_ps (h, min_h, _CMP_GE_OQ),
+            _mm256_cmp_ps (h, max_h, _CMP_LE_OQ)));
+    __m256 region = _mm256_and_ps (
+        _mm256_and_ps (_mm256_cmp_ps (l, rr, _CMP_LT_OQ),
+            _mm256_cmp_ps (_mm256_add_ps (l, w), rl, _CMP_GT_OQ)),
+        _mm256_and_ps (_mm256_cmp_ps (t, rb, _CMP_LT_OQ),
+            _mm256_cmp_ps (_mm256_add_ps (t, h), rt, _CMP_GT_OQ)));
+
+    boxes->size_ok[i / 32] |= (guint32) _mm256_movemask_ps (size) << (i % 32);
+    boxes->region_ok[i / 32] |=
+        (guint32) _mm256_movemask_ps (region) << (i % 32);
+  }
+}
+#endif
+
+static CullFunc cull_func;
+static const gchar *cull_func_name;
+
+static CullFunc
+get_cull_func (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    cull_func = cull_scalar;
+    cull_func_name = "scalar";
+#ifdef BBOXFILTER_X86
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2")) {
+      cull_func = cull_avx2;
+      cull_func_name = "avx2";
+    }
+#endif
+    g_once_init_leave (&init, 1);
+  }
+  return cull_func;
+}
+
+const gchar *
+nvds_bbox_filter_kernel_name (void)
+{
+  get_cull_func ();
+  return cull_func_name;
+}
+
+static void
+box_batch_reset (NvDsBoxBatch * boxes, guint count)
+{
+  guint capacity = (count + BBOX_BLOCK - 1) / BBOX_BLOCK * BBOX_BLOCK;
+
+  if (capacity > boxes->capacity) {
+    boxes->capacity = MAX (capacity, 2 * boxes->capacity);
+    boxes->left = g_renew (gfloat, boxes->left, boxes->capacity);
+    boxes->top = g_renew (gfloat, boxes->top, boxes->capacity);
+    boxes->width = g_renew (gfloat, boxes->width, boxes->capacity);
+    boxes->height = g_renew (gfloat, boxes->height, boxes->capacity);
+    boxes->size_ok = g_renew (guint32, boxes->size_ok,
+        BBOX_WORDS (boxes->capacity));
+    boxes->region_ok = g_renew (guint32, boxes->region_ok,
+        BBOX_WORDS (boxes->capacity));
+  }
+  /* Padding lanes are tested too, their bits are never looked at. */
+  memset (boxes->width + count, 0, (capacity - count) * sizeof (gfloat));
+  memset (boxes->height + count, 0, (capacity - count) * sizeof (gfloat));
+  memset (boxes->left + count, 0, (capacity - count) * sizeof (gfloat));
+  memset (boxes->top + count, 0, (capacity - count) * sizeof (gfloat));
+  boxes->count = count;
+}
+
+static void
+box_batch_free (NvDsBoxBatch * boxes)
+{
+  g_free (boxes->left);
+  g_free (boxes->top);
+  g_free (boxes->width);
+  g_free (boxes->height);
+  g_free (boxes->size_ok);
+  g_free (boxes->region_ok);
+}
+
+NvDsBboxFilter *
+nvds_bbox_filter_new (NvDsBboxFilterConfig * config)
+{
+  NvDsBboxFilter *filter = g_new0 (NvDsBboxFilter, 1);
+
+  filter->config = config;
+  filter->dsmeta_quark = g_quark_from_static_string (NVDS_META_STRING);
+  filter->size_limits.min_width = config->min_width;
+  filter->size_limits.min_height = config->min_height;
+  filter->size_limits.max_width = config->max_width ? config->max_width :
+      FLT_MAX;
+  filter->size_limits.max_height = config->max_height ? config->max_height :
+      FLT_MAX;
+
+  if (config->surface_nms_overlap > 0) {
+    NvDsDewarpSurface surfaces[NVDS_DEWARP_MAX_SURFACES];
+    guint num_surfaces = 0;
+
+    /* Without the surfaces the duplicates are kept, as with no setting. */
+    if (!config->dewarper_config_file) {
+      NVGSTDS_WARN_MSG_V ("surface-nms-overlap needs the dewarper");
+    } else if (nvds_dewarp_parse_surfaces (config->dewarper_config_file,
+            surfaces, &num_surfaces)) {
+      filter->nms = nvds_surface_nms_new (surfaces, num_surfaces,
+          config->frame_width, config->frame_height,
+          config->surface_nms_overlap);
+    }
+  }
+
+  GST_INFO ("Bbox filter uses the %s kernel", nvds_bbox_filter_kernel_name ());
+  return filter;
+}
+
+static void
+free_masks (NvDsBboxFilter * filter)
+{
+  guint i;
+
+  if (!filter->mask_calib)
+    return;
+
+  for (i = 0; i < filter->mask_calib->num_records; i++)
+    nvds_roi_mask_clear (&filter->masks[i]);
+  g_free (filter->masks);
+  nvds_calibration_unref (filter->mask_calib);
+  filter->masks = NULL;
+  filter->mask_calib = NULL;
+}
+
+static void
+free_bounds (NvDsBboxFilter * filter)
+{
+  if (!filter->bounds_calib)
+    return;
+
+  g_free (filter->spot_bounds);
+  nvds_calibration_unref (filter->bounds_calib);
+  filter->spot_bounds = NULL;
+  filter->bounds_calib = NULL;
+}
+
+void
+nvds_bbox_filter_free (NvDsBboxFilter * filter)
+{
+  if (!filter)
+    return;
+
+  free_masks (filter);
+  free_bounds (filter);
+  nvds_surface_nms_free (filter->nms);
+  box_batch_free (&filter->boxes);
+  g_free (filter);
+}
+
+/** Rasterize the aisle ROIs of @calib, as the aisle analysis does. */
+static void
+update_masks (NvDsBboxFilter * filter, const NvDsCalibration * calib)
+{
+  const NvDsAisleCalibRecord *records = nvds_calibration_aisles (calib);
+  guint cell_size = filter->config->roi_cell_size ?
+      filter->config->roi_cell_size : NVDS_ROI_MASK_DEFAULT_CELL_SIZE;
+  guint i;
+
+  if (filter->mask_calib == calib)
+    return;
+
+  free_masks (filter);
+  filter->mask_calib = nvds_calibration_ref ((NvDsCalibration *) calib);
+  filter->masks = g_new0 (NvDsRoiMask, calib->num_records);
+  for (i = 0; i < calib->num_records; i++) {
+    const NvDsAisleCalibRecord *rec = &records[i];
+
+    nvds_roi_mask_build (&filter->masks[i], rec->roi,
+        MIN (rec->num_roi_points, NVDS_CALIB_MAX_ROI_POINTS), rec->dewarp_width,
+        rec->dewarp_height, (gfloat) rec->surface_index * rec->dewarp_height,
+        cell_size);
+  }
+}
+
+/** Compute the box around the spots of each surface of @calib. */
+static void
+update_bounds (NvDsBboxFilter * filter, const NvDsCalibration * calib)
+{
+  const NvDsSpotCalibRecord *records = nvds_calibration_spots (calib);
+  guint num_ranges = calib->num_cameras * calib->num_surfaces;
+  guint r, i;
+
+  if (filter->bounds_calib == calib)
+    return;
+
+  free_bounds (filter);
+  filter->bounds_calib = nvds_calibration_ref ((NvDsCalibration *) calib);
+  filter->spot_bounds = g_new (gfloat, 4 * num_ranges);
+  for (r = 0; r < num_ranges; r++) {
+    const NvDsCalibRange *range = &calib->ranges[r];
+    gfloat *bounds = &filter->spot_bounds[4 * r];
+
+    bounds[0] = bounds[1] = FLT_MAX;
+    bounds[2] = bounds[3] = -FLT_MAX;
+    for (i = range->first; i < range->first + range->count; i++) {
+      const gfloat *roi = records[i].spot_roi;
+
+      bounds[0] = MIN (bounds[0], MIN (roi[0], roi[2]));
+      bounds[1] = MIN (bounds[1], MIN (roi[1], roi[3]));
+      bounds[2] = MAX (bounds[2], MAX (roi[0], roi[2]));
+      bounds[3] = MAX (bounds[3], MAX (roi[1], roi[3]));
+    }
+  }
+}
+
+static guint
+count_bits (const guint32 * bits, guint count)
+{
+  guint n = 0;
+  guint i;
+
+  for (i = 0; i < BBOX_WORDS (count); i++) {
+    guint32 word = bits[i];
+
+    if ((i + 1) * 32 > count)
+      word &= (1u << (count % 32)) - 1;
+    n += __builtin_popcount (word);
+  }
+  return n;
+}
+
+void
+nvds_frame_remove_objects (NvDsFrameMeta * frame_meta,
+    NvDsObjectKeepFunc keep, gpointer user_data)
+{
+  guint i, n;
+
+  /* The labels of the objects removed are owned by the frame meta. */
+  for (i = 0, n = 0; i < frame_meta->num_rects; i++) {
+    NvDsObjectParams *obj = &frame_meta->obj_params[i];
+
+    if (keep (i, user_data)) {
+      if (n != i)
+        frame_meta->obj_params[n] = *obj;
+      n++;
+    } else if (obj->text_params.display_text) {
+      g_free (obj->text_params.display_text);
+      obj->text_params.display_text = NULL;
+      if (frame_meta->num_strings)
+        frame_meta->num_strings--;
+    }
+  }
+  frame_meta->num_rects = n;
+}
+
+static gboolean
+box_kept (guint index, gpointer user_data)
+{
+  const NvDsBoxBatch *boxes = (const NvDsBoxBatch *) user_data;
+
+  return (boxes->region_ok[index / 32] >> (index % 32)) & 1;
+}
+
+/**
+ * Test the objects of @frame_meta and keep those that pass, in order.
+ * @spot_calib and @aisle_calib are NULL without the calibration.
+ */
+static void
+filter_frame (NvDsBboxFilter * filter, NvDsFrameMeta * frame_meta,
+    const NvDsCalibration * spot_calib, const NvDsCalibration * aisle_calib)
+{
+  NvDsBboxFilterConfig *config = filter->config;
+  NvDsBoxBatch *boxes = &filter->boxes;
+  NvDsBoxLimits limits = filter->size_limits;
+  const NvDsCalibRange *range = NULL;
+  const NvDsRoiMask *mask = NULL;
+  gfloat scale_x = 1, scale_y = 1;
+  guint num_size_ok, num_kept, i;
+
+  limits.region[0] = limits.region[1] = -FLT_MAX;
+  limits.region[2] = limits.region[3] = FLT_MAX;
+
+  if (frame_meta->stream_id < config->num_sources) {
+    guint serial = config->source_serials[frame_meta->stream_id];
+
+    if (frame_meta->surface_type == NVDS_CALIB_SURFACE_PUSHBROOM &&
+        spot_calib) {
+      range = nvds_calibration_lookup (spot_calib, serial,
+          frame_meta->surface_index);
+      if (range && range->count) {
+        const NvDsSpotCalibRecord *rec =
+            &nvds_calibration_spots (spot_calib)[range->first];
+        const gfloat *bounds =
+            &filter->spot_bounds[4 * (range - spot_calib->ranges)];
+
+        /* The spots are in dewarped surface pixels. */
+        scale_x = (gfloat) config->frame_width / rec->dewarp_width;
+        scale_y = (gfloat) config->frame_height / rec->dewarp_height;
+        limits.region[0] = bounds[0] * scale_x;
+        limits.region[1] = bounds[1] * scale_y;
+        limits.region[2] = bounds[2] * scale_x;
+        limits.region[3] = bounds[3] * scale_y;
+      }
+    } else if (frame_meta->surface_type == NVDS_CALIB_SURFACE_VERTRADCYL &&
+        aisle_calib) {
+      range = nvds_calibration_lookup (aisle_calib, serial,
+          frame_meta->surface_index);
+      if (range && range->count) {
+        const NvDsAisleCalibRecord *rec =
+            &nvds_calibration_aisles (aisle_calib)[range->first];
+
+        /* An aisle without ROI polygon keeps everything. */
+        if (filter->masks[range->first].bits)
+          mask = &filter->masks[range->first];
+        scale_x = (gfloat) rec->dewarp_width / config->frame_width;
+        scale_y = (gfloat) rec->dewarp_height / config->frame_height;
+      }
+    }
+  }
+
+  box_batch_reset (boxes, frame_meta->num_rects);
+  for (i = 0; i < frame_meta->num_rects; i++) {
+    const NvOSD_RectParams *rect = &frame_meta->obj_params[i].rect_params;
+
+    boxes->left[i] = rect->left;
+    boxes->top[i] = rect->top;
+    boxes->width[i] = rect->width;
+    boxes->height[i] = rect->height;
+  }
+  get_cull_func () (boxes, &limits);
+  num_size_ok = count_bits (boxes->size_ok, boxes->count);
+
+  /* Foot points of the objects left, against the ROI of the aisle. */
+  for (i = 0; i < BBOX_WORDS (boxes->count); i++)
+    boxes->region_ok[i] &= boxes->size_ok[i];
+  if (mask) {
+    for (i = 0; i < boxes->count; i++) {
+      if (((boxes->region_ok[i / 32] >> (i % 32)) & 1) &&
+          !nvds_roi_mask_test (mask,
+              (boxes->left[i] + boxes->width[i] / 2) * scale_x,
+              (boxes->top[i] + boxes->height[i]) * scale_y))
+        boxes->region_ok[i / 32] &= ~(1u << (i % 32));
+    }
+  }
+  num_kept = count_bits (boxes->region_ok, boxes->count);
+
+  g_atomic_int_add (&filter->objects, boxes->count);
+  g_atomic_int_add (&filter->culled_size, boxes->count - num_size_ok);
+  g_atomic_int_add (&filter->culled_roi, num_size_ok - num_kept);
+  if (num_kept == boxes->count)
+    return;
+
+  nvds_frame_remove_objects (frame_meta, box_kept, boxes);
+}
+
+void
+nvds_bbox_filter_process (NvDsBboxFilter * filter, GstBuffer * buf)
+{
+  NvDsBboxFilterConfig *config = filter->config;
+  const NvDsCalibration *spot_calib = NULL;
+  const NvDsCalibration *aisle_calib = NULL;
+  gint spot_phase = 0, aisle_phase = 0;
+  GstMeta *meta;
+  gpointer state = NULL;
+
+  if (!config->frame_width || !config->frame_height)
+    return;
+
+  if (config->spot_calibration) {
+    spot_calib = nvds_calib_read_begin (config->spot_calibration, &spot_phase);
+    update_bounds (filter, spot_calib);
+  }
+  if (config->aisle_calibration) {
+    aisle_calib = nvds_calib_read_begin (config->aisle_calibration,
+        &aisle_phase);
+    update_masks (filter, aisle_calib);
+  }
+
+  while ((meta = gst_buffer_iterate_meta (buf, &state))) {
+    NvDsMeta *dsmeta = (NvDsMeta *) meta;
+    NvDsFrameMeta *frame_meta;
+
+    if (!gst_meta_api_type_has_tag (meta->info->api, filter->dsmeta_quark) ||
+        dsmeta->meta_type != NVDS_META_FRAME_INFO) {
+      continue;
+    }
+
+    frame_meta = (NvDsFrameMeta *) dsmeta->meta_data;
+    if (frame_meta->num_rects)
+      filter_frame (filter, frame_meta, spot_calib, aisle_calib);
+  }
+
+  if (aisle_calib)
+    nvds_calib_read_end (config->aisle_calibration, aisle_phase);
+  if (spot_calib)
+    nvds_calib_read_end (config->spot_calibration, spot_phase);
+
+  if (filter->nms) {
+    g_atomic_int_add (&filter->culled_duplicate,
+        nvds_surface_nms_process (filter->nms, buf));
+  }
+}
+
+void
+nvds_bbox_filter_get_stats (NvDsBboxFilter * filter,
+    NvDsBboxFilterStats * stats)
+{
+  stats->objects = g_atomic_int_get (&filter->objects);
+  stats->culled_size = g_atomic_int_get (&filter->culled_size);
+  stats->culled_roi = g_atomic_int_get (&filter->culled_roi);
+  stats->culled_duplicate = g_atomic_int_get (&filter->culled_duplicate);
+}
@@ -19,22 +19,105 @@ extern "C"
 
 #include <gst/gst.h>
 
+#include "gstnvdsmeta.h"
+#include "deepstream_calibration_watch.h"
+
+/** Which implementation filters the detections, from enable_bboxfilter. */
+typedef enum
+{
+  /** enable_bboxfilter=1: nvbboxfilter plugin */
+  NVDS_BBOXFILTER_ENGINE_PLUGIN = 1,
+  /** enable_bboxfilter=2: in-app filter, see deepstream_bboxfilter.c */
+  NVDS_BBOXFILTER_ENGINE_APP = 2,
+} NvDsBboxFilterEngine;
+
+typedef struct _NvDsBboxFilter NvDsBboxFilter;
+
 typedef struct
 {
   GstElement *bin;
   GstElement *sink_queue;
   GstElement *src_queue;
   GstElement *nvbboxfilter;
+  NvDsBboxFilter *filter;
+  gulong probe_id;
 } NvDsBboxFilterBin;
 
 typedef struct
 {
   gboolean enable;
   gchar *aisle_calibration_file;
+  NvDsCalibHandle *aisle_calibration;
+
+  /* In-app filter only. */
+  NvDsBboxFilterEngine engine;
+  /** Size limits in frame pixels, 0 for none */
+  guint min_width;
+  guint min_height;
+  guint max_width;
+  guint max_height;
+  /** Pixels per side of a cell of the rasterized aisle ROI masks */
+  guint roi_cell_size;
+  /**
+   * Part of a detection covered by one of a sibling surface for it to be
+   * removed as a duplicate, 0 to keep them; see deepstream_surfacenms.h.
+   */
+  gdouble surface_nms_overlap;
+
+  /* Filled in by the pipeline for the in-app filter. */
+  NvDsCalibHandle *spot_calibration;
+  /** camera-id of each source, i.e. its calibration serial */
+  guint *source_serials;
+  guint num_sources;
+  /** Resolution of the batched frames the object boxes refer to. */
+  guint frame_width;
+  guint frame_height;
+  /** Config file of the dewarper, for the geometry of the surfaces */
+  const gchar *dewarper_config_file;
 } NvDsBboxFilterConfig;
 
+/** Counts since the start, read by the perf callback. */
+typedef struct
+{
+  guint objects;
+  guint culled_size;
+  guint culled_roi;
+  guint culled_duplicate;
+} NvDsBboxFilterStats;
+
 gboolean create_bboxfilter_bin (NvDsBboxFilterConfig * config, NvDsBboxFilterBin * bin);
 
+void destroy_bboxfilter_bin (NvDsBboxFilterBin * bin);
+
+NvDsBboxFilter *nvds_bbox_filter_new (NvDsBboxFilterConfig * config);
+
+void nvds_bbox_filter_free (NvDsBboxFilter * filter);
+
+/**
+ * Remove from every frame of @buf the objects outside the size limits, and
+ * on the surfaces of a calibrated camera those that can not matter to the
+ * analysis: on aisle surfaces, objects whose foot point is outside the aisle
+ * ROI; on spot surfaces, objects that overlap no spot. Then remove the
+ * objects seen again on an overlapping surface of the same camera.
+ */
+void nvds_bbox_filter_process (NvDsBboxFilter * filter, GstBuffer * buf);
+
+void nvds_bbox_filter_get_stats (NvDsBboxFilter * filter,
+    NvDsBboxFilterStats * stats);
+
+const gchar *nvds_bbox_filter_kernel_name (void);
+
+/** Whether object @index of a frame is kept by nvds_frame_remove_objects(). */
+typedef gboolean (*NvDsObjectKeepFunc) (guint index, gpointer user_data);
+
+/**
+ * Remove the objects of @frame_meta @keep returns FALSE for, keeping the
+ * others in order, and free their labels. Shared by the filters of the
+ * detections, which all remove objects in place.
+ */
+void nvds_frame_remove_objects (NvDsFrameMeta * frame_meta,
+    NvDsObjectKeepFunc keep, gpointer user_data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -12,6 +12,15 @@
 #include "deepstream_common.h"
 #include "deepstream_bboxfilter.h"
 
+static GstPadProbeReturn
+bboxfilter_buf_prob (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  NvDsBboxFilter *filter = (NvDsBboxFilter *) u_data;
+
+  nvds_bbox_filter_process (filter, GST_PAD_PROBE_INFO_BUFFER (info));
+  return GST_PAD_PROBE_OK;
+}
+
 gboolean
 create_bboxfilter_bin (NvDsBboxFilterConfig * config, NvDsBboxFilterBin * bin)
 {
@@ -29,6 +38,19 @@ create_bboxfilter_bin (NvDsBboxFilterConfig * config, NvDsBboxFilterBin * bin)
     goto done;
   }
 
+  if (config->engine == NVDS_BBOXFILTER_ENGINE_APP) {
+    /* Detections are filtered in the app, on the streaming thread of the
+     * queue, before the tracker sees them. */
+    gst_bin_add (GST_BIN (bin->bin), bin->sink_queue);
+    bin->filter = nvds_bbox_filter_new (config);
+    NVGSTDS_ELEM_ADD_PROBE (bin->probe_id, bin->sink_queue, "src",
+        bboxfilter_buf_prob, GST_PAD_PROBE_TYPE_BUFFER, bin->filter);
+    NVGSTDS_BIN_ADD_GHOST_PAD (bin->bin, bin->sink_queue, "sink");
+    NVGSTDS_BIN_ADD_GHOST_PAD (bin->bin, bin->sink_queue, "src");
+    ret = TRUE;
+    goto done;
+  }
+
   bin->src_queue = gst_element_factory_make (NVDS_ELEM_QUEUE, "bboxfilter_src_queue");
   if (!bin->src_queue) {
     NVGSTDS_ERR_MSG_V ("Failed to create 'bboxfilter_src_queue'");
@@ -60,3 +82,10 @@ done:
   }
   return ret;
 }
+
+void
+destroy_bboxfilter_bin (NvDsBboxFilterBin * bin)
+{
+  nvds_bbox_filter_free (bin->filter);
+  bin->filter = NULL;
+}
@@ -0,0 +1,952 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "deepstream_common.h"
+#include "deepstream_calibration.h"
+#include "deepstream_homography.h"
+
+G_STATIC_ASSERT (sizeof (NvDsCalibImageHeader) % NVDS_CALIB_ALIGN == 0);
+G_STATIC_ASSERT (sizeof (NvDsSpotCalibRecord) % NVDS_CALIB_ALIGN == 0);
+G_STATIC_ASSERT (sizeof (NvDsAisleCalibRecord) % NVDS_CALIB_ALIGN == 0);
+
+static GMutex registry_lock;
+static GHashTable *registry;
+
+#define CALIB_ALIGN_UP(x) (((x) + NVDS_CALIB_ALIGN - 1) & ~((guint64) NVDS_CALIB_ALIGN - 1))
+
+typedef enum
+{
+  CALIB_FIELD_STRING,
+  CALIB_FIELD_UINT,
+  CALIB_FIELD_FLOAT,
+  CALIB_FIELD_DOUBLE,
+} NvDsCalibFieldType;
+
+typedef struct
+{
+  const gchar *column;
+  NvDsCalibFieldType type;
+  gsize offset;
+} NvDsCalibField;
+
+#define SPOT_FIELD(col, type, member) \
+  { col, type, G_STRUCT_OFFSET (NvDsSpotCalibRecord, member) }
+#define AISLE_FIELD(col, type, member) \
+  { col, type, G_STRUCT_OFFSET (NvDsAisleCalibRecord, member) }
+
+static const NvDsCalibField spot_fields[] = {
+  SPOT_FIELD ("serial", CALIB_FIELD_UINT, serial),
+  SPOT_FIELD ("sensorId", CALIB_FIELD_STRING, sensor_str),
+  SPOT_FIELD ("camDesc", CALIB_FIELD_STRING, cam_desc),
+  SPOT_FIELD ("cameraId", CALIB_FIELD_STRING, camera_str),
+  SPOT_FIELD ("spotId", CALIB_FIELD_STRING, spot_str),
+  SPOT_FIELD ("type", CALIB_FIELD_STRING, type),
+  SPOT_FIELD ("level", CALIB_FIELD_STRING, level),
+  SPOT_FIELD ("surfaceid", CALIB_FIELD_UINT, surface_index),
+  SPOT_FIELD ("spot_index", CALIB_FIELD_UINT, spot_index),
+  SPOT_FIELD ("dewarpTopAngle", CALIB_FIELD_FLOAT, dewarp_top_angle),
+  SPOT_FIELD ("dewarpBottomAngle", CALIB_FIELD_FLOAT, dewarp_bottom_angle),
+  SPOT_FIELD ("dewarpPitch", CALIB_FIELD_FLOAT, dewarp_pitch),
+  SPOT_FIELD ("dewarpYaw", CALIB_FIELD_FLOAT, dewarp_yaw),
+  SPOT_FIELD ("dewarpRoll", CALIB_FIELD_FLOAT, dewarp_roll),
+  SPOT_FIELD ("vertical_left", CALIB_FIELD_FLOAT, vertical_left),
+  SPOT_FIELD ("vertical_right", CALIB_FIELD_FLOAT, vertical_right),
+  SPOT_FIELD ("Horizon_x1", CALIB_FIELD_FLOAT, horizon[0]),
+  SPOT_FIELD ("Horizon_y1", CALIB_FIELD_FLOAT, horizon[1]),
+  SPOT_FIELD ("Horizon_x2", CALIB_FIELD_FLOAT, horizon[2]),
+  SPOT_FIELD ("Horizon_y2", CALIB_FIELD_FLOAT, horizon[3]),
+  SPOT_FIELD ("spot_roi_x1", CALIB_FIELD_FLOAT, spot_roi[0]),
+  SPOT_FIELD ("spot_roi_y1", CALIB_FIELD_FLOAT, spot_roi[1]),
+  SPOT_FIELD ("spot_roi_x2", CALIB_FIELD_FLOAT, spot_roi[2]),
+  SPOT_FIELD ("spot_roi_y2", CALIB_FIELD_FLOAT, spot_roi[3]),
+  SPOT_FIELD ("x0", CALIB_FIELD_DOUBLE, world[0]),
+  SPOT_FIELD ("y0", CALIB_FIELD_DOUBLE, world[1]),
+  SPOT_FIELD ("x1", CALIB_FIELD_DOUBLE, world[2]),
+  SPOT_FIELD ("y1", CALIB_FIELD_DOUBLE, world[3]),
+  SPOT_FIELD ("x2", CALIB_FIELD_DOUBLE, world[4]),
+  SPOT_FIELD ("y2", CALIB_FIELD_DOUBLE, world[5]),
+  SPOT_FIELD ("x3", CALIB_FIELD_DOUBLE, world[6]),
+  SPOT_FIELD ("y3", CALIB_FIELD_DOUBLE, world[7]),
+  SPOT_FIELD ("dewarpFocalLength", CALIB_FIELD_FLOAT, dewarp_focal_length),
+  SPOT_FIELD ("dewarpWidth", CALIB_FIELD_UINT, dewarp_width),
+  SPOT_FIELD ("dewarpHeight", CALIB_FIELD_UINT, dewarp_height),
+};
+
+static const NvDsCalibField aisle_fields[] = {
+  AISLE_FIELD ("serial", CALIB_FIELD_UINT, serial),
+  AISLE_FIELD ("sensorId", CALIB_FIELD_STRING, sensor_str),
+  AISLE_FIELD ("camDesc", CALIB_FIELD_STRING, cam_desc),
+  AISLE_FIELD ("cameraIDString", CALIB_FIELD_STRING, camera_str),
+  AISLE_FIELD ("aisleId", CALIB_FIELD_STRING, aisle_str),
+  AISLE_FIELD ("aisleName", CALIB_FIELD_STRING, aisle_name),
+  AISLE_FIELD ("level", CALIB_FIELD_STRING, level),
+  AISLE_FIELD ("dewarpTopAngle", CALIB_FIELD_FLOAT, dewarp_top_angle),
+  AISLE_FIELD ("dewarpBottomAngle", CALIB_FIELD_FLOAT, dewarp_bottom_angle),
+  AISLE_FIELD ("dewarpPitch", CALIB_FIELD_FLOAT, dewarp_pitch),
+  AISLE_FIELD ("dewarpYaw", CALIB_FIELD_FLOAT, dewarp_yaw),
+  AISLE_FIELD ("dewarpRoll", CALIB_FIELD_FLOAT, dewarp_roll),
+  AISLE_FIELD ("numROIPoints", CALIB_FIELD_UINT, num_roi_points),
+  AISLE_FIELD ("ROI_x0", CALIB_FIELD_FLOAT, roi[0]),
+  AISLE_FIELD ("ROI_y0", CALIB_FIELD_FLOAT, roi[1]),
+  AISLE_FIELD ("ROI_x1", CALIB_FIELD_FLOAT, roi[2]),
+  AISLE_FIELD ("ROI_y1", CALIB_FIELD_FLOAT, roi[3]),
+  AISLE_FIELD ("ROI_x2", CALIB_FIELD_FLOAT, roi[4]),
+  AISLE_FIELD ("ROI_y2", CALIB_FIELD_FLOAT, roi[5]),
+  AISLE_FIELD ("ROI_x3", CALIB_FIELD_FLOAT, roi[6]),
+  AISLE_FIELD ("ROI_y3", CALIB_FIELD_FLOAT, roi[7]),
+  AISLE_FIELD ("ROI_x4", CALIB_FIELD_FLOAT, roi[8]),
+  AISLE_FIELD ("ROI_y4", CALIB_FIELD_FLOAT, roi[9]),
+  AISLE_FIELD ("ROI_x5", CALIB_FIELD_FLOAT, roi[10]),
+  AISLE_FIELD ("ROI_y5", CALIB_FIELD_FLOAT, roi[11]),
+  AISLE_FIELD ("ROI_x6", CALIB_FIELD_FLOAT, roi[12]),
+  AISLE_FIELD ("ROI_y6", CALIB_FIELD_FLOAT, roi[13]),
+  AISLE_FIELD ("ROI_x7", CALIB_FIELD_FLOAT, roi[14]),
+  AISLE_FIELD ("ROI_y7", CALIB_FIELD_FLOAT, roi[15]),
+  AISLE_FIELD ("gx0", CALIB_FIELD_DOUBLE, world_points[0]),
+  AISLE_FIELD ("gy0", CALIB_FIELD_DOUBLE, world_points[1]),
+  AISLE_FIELD ("gx1", CALIB_FIELD_DOUBLE, world_points[2]),
+  AISLE_FIELD ("gy1", CALIB_FIELD_DOUBLE, world_points[3]),
+  AISLE_FIELD ("gx2", CALIB_FIELD_DOUBLE, world_points[4]),
+  AISLE_FIELD ("gy2", CALIB_FIELD_DOUBLE, world_points[5]),
+  AISLE_FIELD ("gx3", CALIB_FIELD_DOUBLE, world_points[6]),
+  AISLE_FIELD ("gy3", CALIB_FIELD_DOUBLE, world_points[7]),
+  AISLE_FIELD ("cx0", CALIB_FIELD_FLOAT, image_points[0]),
+  AISLE_FIELD ("cy0", CALIB_FIELD_FLOAT, image_points[1]),
+  AISLE_FIELD ("cx1", CALIB_FIELD_FLOAT, image_points[2]),
+  AISLE_FIELD ("cy1", CALIB_FIELD_FLOAT, image_points[3]),
+  AISLE_FIELD ("cx2", CALIB_FIELD_FLOAT, image_points[4]),
+  AISLE_FIELD ("cy2", CALIB_FIELD_FLOAT, image_points[5]),
+  AISLE_FIELD ("cx3", CALIB_FIELD_FLOAT, image_points[6]),
+  AISLE_FIELD ("cy3", CALIB_FIELD_FLOAT, image_points[7]),
+  AISLE_FIELD ("H0", CALIB_FIELD_DOUBLE, homography[0]),
+  AISLE_FIELD ("H1", CALIB_FIELD_DOUBLE, homography[1]),
+  AISLE_FIELD ("H2", CALIB_FIELD_DOUBLE, homography[2]),
+  AISLE_FIELD ("H3", CALIB_FIELD_DOUBLE, homography[3]),
+  AISLE_FIELD ("H4", CALIB_FIELD_DOUBLE, homography[4]),
+  AISLE_FIELD ("H5", CALIB_FIELD_DOUBLE, homography[5]),
+  AISLE_FIELD ("H6", CALIB_FIELD_DOUBLE, homography[6]),
+  AISLE_FIELD ("H7", CALIB_FIELD_DOUBLE, homography[7]),
+  AISLE_FIELD ("H8", CALIB_FIELD_DOUBLE, homography[8]),
+  AISLE_FIELD ("dewarpFocalLength", CALIB_FIELD_FLOAT, dewarp_focal_length),
+  AISLE_FIELD ("dewarpWidth", CALIB_FIELD_UINT, dewarp_width),
+  AISLE_FIELD ("dewarpHeight", CALIB_FIELD_UINT, dewarp_height),
+  AISLE_FIELD ("entry", CALIB_FIELD_UINT, entry),
+  AISLE_FIELD ("entry_ROI_x0", CALIB_FIELD_FLOAT, entry_roi[0]),
+  AISLE_FIELD ("entry_ROI_y0", CALIB_FIELD_FLOAT, entry_roi[1]),
+  AISLE_FIELD ("entry_ROI_x1", CALIB_FIELD_FLOAT, entry_roi[2]),
+  AISLE_FIELD ("entry_ROI_y1", CALIB_FIELD_FLOAT, entry_roi[3]),
+  AISLE_FIELD ("entry_ROI_x2", CALIB_FIELD_FLOAT, entry_roi[4]),
+  AISLE_FIELD ("entry_ROI_y2", CALIB_FIELD_FLOAT, entry_roi[5]),
+  AISLE_FIELD ("entry_ROI_x3", CALIB_FIELD_FLOAT, entry_roi[6]),
+  AISLE_FIELD ("entry_ROI_y3", CALIB_FIELD_FLOAT, entry_roi[7]),
+  AISLE_FIELD ("exit", CALIB_FIELD_UINT, exit),
+  AISLE_FIELD ("exit_ROI_x0", CALIB_FIELD_FLOAT, exit_roi[0]),
+  AISLE_FIELD ("exit_ROI_y0", CALIB_FIELD_FLOAT, exit_roi[1]),
+  AISLE_FIELD ("exit_ROI_x1", CALIB_FIELD_FLOAT, exit_roi[2]),
+  AISLE_FIELD ("exit_ROI_y1", CALIB_FIELD_FLOAT, exit_roi[3]),
+  AISLE_FIELD ("exit_ROI_x2", CALIB_FIELD_FLOAT, exit_roi[4]),
+  AISLE_FIELD ("exit_ROI_y2", CALIB_FIELD_FLOAT, exit_roi[5]),
+  AISLE_FIELD ("exit_ROI_x3", CALIB_FIELD_FLOAT, exit_roi[6]),
+  AISLE_FIELD ("exit_ROI_y3", CALIB_FIELD_FLOAT, exit_roi[7]),
+};
+
+typedef struct
+{
+  NvDsCalibKind kind;
+  const NvDsCalibField *fields;
+  guint num_fields;
+  guint record_size;
+  gsize serial_offset;
+  gsize camera_offset;
+  gsize surface_offset;
+  gsize index_offset;
+  /* Column index of each field in the CSV being parsed. */
+  gint columns[G_N_ELEMENTS (aisle_fields)];
+} NvDsCalibTable;
+
+typedef struct
+{
+  GString *data;
+  GHashTable *ids;
+} NvDsCalibStrings;
+
+static guint32
+intern_string (NvDsCalibStrings * strings, const gchar * str)
+{
+  gpointer id;
+
+  if (!*str)
+    return 0;
+
+  if (g_hash_table_lookup_extended (strings->ids, str, NULL, &id))
+    return GPOINTER_TO_UINT (id);
+
+  id = GUINT_TO_POINTER (strings->data->len);
+  g_string_append_len (strings->data, str, strlen (str) + 1);
+  g_hash_table_insert (strings->ids, g_strdup (str), id);
+  return GPOINTER_TO_UINT (id);
+}
+
+static gboolean
+init_table (NvDsCalibTable * table, gchar ** header)
+{
+  guint i;
+  gint j;
+
+  for (j = 0; header[j]; j++) {
+    g_strstrip (header[j]);
+    if (!g_strcmp0 (header[j], "spot_index"))
+      table->kind = NVDS_CALIB_KIND_SPOT;
+    else if (!g_strcmp0 (header[j], "H0"))
+      table->kind = NVDS_CALIB_KIND_AISLE;
+  }
+
+  if (table->kind == NVDS_CALIB_KIND_SPOT) {
+    table->fields = spot_fields;
+    table->num_fields = G_N_ELEMENTS (spot_fields);
+    table->record_size = sizeof (NvDsSpotCalibRecord);
+    table->serial_offset = G_STRUCT_OFFSET (NvDsSpotCalibRecord, serial);
+    table->camera_offset = G_STRUCT_OFFSET (NvDsSpotCalibRecord, camera_str);
+    table->surface_offset = G_STRUCT_OFFSET (NvDsSpotCalibRecord, surface_index);
+    table->index_offset = G_STRUCT_OFFSET (NvDsSpotCalibRecord, spot_index);
+  } else if (table->kind == NVDS_CALIB_KIND_AISLE) {
+    table->fields = aisle_fields;
+    table->num_fields = G_N_ELEMENTS (aisle_fields);
+    table->record_size = sizeof (NvDsAisleCalibRecord);
+    table->serial_offset = G_STRUCT_OFFSET (NvDsAisleCalibRecord, serial);
+    table->camera_offset = G_STRUCT_OFFSET (NvDsAisleCalibRecord, camera_str);
+    table->surface_offset = G_STRUCT_OFFSET (NvDsAisleCalibRecord, surface_index);
+    table->index_offset = G_STRUCT_OFFSET (NvDsAisleCalibRecord, surface_index);
+  } else {
+    NVGSTDS_ERR_MSG_V ("Unrecognized calibration CSV header");
+    return FALSE;
+  }
+
+  for (i = 0; i < table->num_fields; i++) {
+    table->columns[i] = -1;
+    for (j = 0; header[j]; j++) {
+      if (!g_strcmp0 (header[j], table->fields[i].column)) {
+        table->columns[i] = j;
+        break;
+      }
+    }
+    if (table->columns[i] < 0) {
+      NVGSTDS_ERR_MSG_V ("Missing column '%s' in calibration CSV",
+          table->fields[i].column);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static gboolean
+parse_row (NvDsCalibTable * table, NvDsCalibStrings * strings,
+    gchar ** values, guint8 * record)
+{
+  guint num_values = g_strv_length (values);
+  guint i;
+
+  for (i = 0; i < table->num_fields; i++) {
+    const NvDsCalibField *field = &table->fields[i];
+    gchar *value, *end = NULL;
+
+    if ((guint) table->columns[i] >= num_values)
+      return FALSE;
+
+    value = g_strstrip (values[table->columns[i]]);
+    switch (field->type) {
+      case CALIB_FIELD_STRING:
+        *(guint32 *) (record + field->offset) = intern_string (strings, value);
+        continue;
+      case CALIB_FIELD_UINT:
+        *(guint32 *) (record + field->offset) =
+            (guint32) g_ascii_strtoull (value, &end, 10);
+        break;
+      case CALIB_FIELD_FLOAT:
+        *(gfloat *) (record + field->offset) = g_ascii_strtod (value, &end);
+        break;
+      case CALIB_FIELD_DOUBLE:
+        *(gdouble *) (record + field->offset) = g_ascii_strtod (value, &end);
+        break;
+    }
+    if (end == value || *end) {
+      NVGSTDS_ERR_MSG_V ("Invalid value '%s' for column '%s'", value,
+          field->column);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+typedef struct
+{
+  const NvDsCalibTable *table;
+  const guint8 *records;
+} NvDsCalibSortCtx;
+
+#define RECORD_U32(rec, off) (*(const guint32 *) ((rec) + (off)))
+
+static gint
+compare_rows (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const NvDsCalibSortCtx *ctx = (const NvDsCalibSortCtx *) user_data;
+  const NvDsCalibTable *table = ctx->table;
+  guint ia = *(const guint *) a;
+  guint ib = *(const guint *) b;
+  const guint8 *ra = ctx->records + (gsize) ia * table->record_size;
+  const guint8 *rb = ctx->records + (gsize) ib * table->record_size;
+  gsize keys[] = { table->serial_offset, table->camera_offset,
+    table->surface_offset, table->index_offset
+  };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (keys); i++) {
+    guint32 ka = RECORD_U32 (ra, keys[i]);
+    guint32 kb = RECORD_U32 (rb, keys[i]);
+    if (ka != kb)
+      return ka < kb ? -1 : 1;
+  }
+  /* Keep file order for duplicates. */
+  return ia < ib ? -1 : (ia > ib);
+}
+
+/**
+ * Serialize parsed rows into an image. Rows are sorted by camera so that
+ * every camera owns a contiguous record range.
+ */
+static guint8 *
+build_image (NvDsCalibTable * table, NvDsCalibStrings * strings,
+    GArray * rows, guint num_rows, const gchar * source_path,
+    struct stat *source_stat, gsize * image_size)
+{
+  NvDsCalibImageHeader *header;
+  NvDsCalibCamera *cameras;
+  NvDsCalibSortCtx sort_ctx = { table, (const guint8 *) rows->data };
+  guint *order = g_new (guint, MAX (num_rows, 1));
+  guint num_cameras = 0;
+  guint64 cameras_offset, records_offset, strings_offset, size;
+  guint32 source_id = intern_string (strings, source_path);
+  guint8 *image, *records;
+  guint i;
+
+  for (i = 0; i < num_rows; i++)
+    order[i] = i;
+  g_qsort_with_data (order, num_rows, sizeof (guint), compare_rows, &sort_ctx);
+
+  for (i = 0; i < num_rows; i++) {
+    const guint8 *rec = sort_ctx.records + (gsize) order[i] * table->record_size;
+    const guint8 *prev;
+    if (i == 0) {
+      num_cameras++;
+      continue;
+    }
+    prev = sort_ctx.records + (gsize) order[i - 1] * table->record_size;
+    if (RECORD_U32 (rec, table->serial_offset) !=
+        RECORD_U32 (prev, table->serial_offset) ||
+        RECORD_U32 (rec, table->camera_offset) !=
+        RECORD_U32 (prev, table->camera_offset))
+      num_cameras++;
+  }
+
+  cameras_offset = CALIB_ALIGN_UP (sizeof (NvDsCalibImageHeader));
+  records_offset =
+      CALIB_ALIGN_UP (cameras_offset + num_cameras * sizeof (NvDsCalibCamera));
+  strings_offset =
+      CALIB_ALIGN_UP (records_offset + (guint64) num_rows * table->record_size);
+  size = strings_offset + strings->data->len;
+
+  image = (guint8 *) g_malloc0 (size);
+  header = (NvDsCalibImageHeader *) image;
+  cameras = (NvDsCalibCamera *) (image + cameras_offset);
+  records = image + records_offset;
+
+  num_cameras = 0;
+  for (i = 0; i < num_rows; i++) {
+    guint8 *rec = records + (gsize) i * table->record_size;
+    memcpy (rec, sort_ctx.records + (gsize) order[i] * table->record_size,
+        table->record_size);
+
+    if (num_cameras == 0 ||
+        cameras[num_cameras - 1].serial != RECORD_U32 (rec, table->serial_offset) ||
+        cameras[num_cameras - 1].camera_str !=
+        RECORD_U32 (rec, table->camera_offset)) {
+      cameras[num_cameras].serial = RECORD_U32 (rec, table->serial_offset);
+      cameras[num_cameras].camera_str = RECORD_U32 (rec, table->camera_offset);
+      cameras[num_cameras].first_record = i;
+      num_cameras++;
+    }
+    cameras[num_cameras - 1].num_records++;
+  }
+
+  memcpy (image + strings_offset, strings->data->str, strings->data->len);
+
+  header->magic = NVDS_CALIB_MAGIC;
+  header->version_major = NVDS_CALIB_VERSION_MAJOR;
+  header->version_minor = NVDS_CALIB_VERSION_MINOR;
+  header->kind = table->kind;
+  header->header_size = sizeof (NvDsCalibImageHeader);
+  header->record_size = table->record_size;
+  header->num_records = num_rows;
+  header->num_cameras = num_cameras;
+  header->source_path = source_id;
+  header->source_mtime = source_stat->st_mtim.tv_sec * G_GUINT64_CONSTANT
+      (1000000000) + source_stat->st_mtim.tv_nsec;
+  header->source_size = source_stat->st_size;
+  header->cameras_offset = cameras_offset;
+  header->records_offset = records_offset;
+  header->strings_offset = strings_offset;
+  header->strings_size = strings->data->len;
+  header->file_size = size;
+  header->checksum = crc32 (0L, image + header->header_size,
+      size - header->header_size);
+
+  g_free (order);
+  *image_size = size;
+  return image;
+}
+
+/**
+ * Parse a calibration CSV into a freshly allocated image.
+ */
+static guint8 *
+parse_csv (const gchar * csv_path, gsize * image_size)
+{
+  NvDsCalibTable table;
+  NvDsCalibStrings strings;
+  GError *error = NULL;
+  gchar *contents = NULL;
+  gchar **lines = NULL;
+  gchar **header = NULL;
+  gchar *abs_path = NULL;
+  GArray *rows = NULL;
+  guint8 *image = NULL;
+  guint num_rows = 0;
+  struct stat st;
+  guint i;
+
+  memset (&table, 0, sizeof (table));
+  strings.data = g_string_new (NULL);
+  g_string_append_len (strings.data, "", 1);
+  strings.ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if (stat (csv_path, &st) != 0 ||
+      !g_file_get_contents (csv_path, &contents, NULL, &error)) {
+    NVGSTDS_ERR_MSG_V ("Failed to read calibration file '%s'", csv_path);
+    goto done;
+  }
+
+  lines = g_strsplit (contents, "\n", -1);
+  if (!lines[0]) {
+    NVGSTDS_ERR_MSG_V ("Empty calibration file '%s'", csv_path);
+    goto done;
+  }
+
+  header = g_strsplit (lines[0], ",", -1);
+  table.kind = NVDS_CALIB_KIND_ANY;
+  if (!init_table (&table, header))
+    goto done;
+
+  rows = g_array_sized_new (FALSE, TRUE, table.record_size,
+      g_strv_length (lines));
+
+  for (i = 1; lines[i]; i++) {
+    gchar **values;
+    gboolean ok;
+
+    if (!*g_strstrip (lines[i]))
+      continue;
+
+    g_array_set_size (rows, num_rows + 1);
+    values = g_strsplit (lines[i], ",", -1);
+    ok = parse_row (&table, &strings, values,
+        (guint8 *) rows->data + (gsize) num_rows * table.record_size);
+    g_strfreev (values);
+    if (!ok) {
+      NVGSTDS_ERR_MSG_V ("Invalid row %u in calibration file '%s'", i,
+          csv_path);
+      goto done;
+    }
+    num_rows++;
+  }
+
+  if (table.kind == NVDS_CALIB_KIND_AISLE) {
+    /* Aisle rows carry no surface column; the rows of a camera map to its
+     * VertRadCyl surfaces in file order. */
+    for (i = 0; i < num_rows; i++) {
+      NvDsAisleCalibRecord *rec =
+          &g_array_index (rows, NvDsAisleCalibRecord, i);
+      guint j, surface = 0;
+      for (j = 0; j < i; j++) {
+        NvDsAisleCalibRecord *prev =
+            &g_array_index (rows, NvDsAisleCalibRecord, j);
+        if (prev->serial == rec->serial && prev->camera_str == rec->camera_str)
+          surface++;
+      }
+      rec->surface_index = surface;
+    }
+  }
+
+  abs_path = realpath (csv_path, NULL);
+  image = build_image (&table, &strings, rows, num_rows,
+      abs_path ? abs_path : csv_path, &st, image_size);
+
+done:
+  if (error)
+    g_error_free (error);
+  if (rows)
+    g_array_free (rows, TRUE);
+  g_strfreev (header);
+  g_strfreev (lines);
+  g_free (contents);
+  free (abs_path);
+  g_string_free (strings.data, TRUE);
+  g_hash_table_destroy (strings.ids);
+  return image;
+}
+
+/**
+ * Validate an image and point the calibration tables into it. Every offset,
+ * including each string id of the records, is bounds checked against the
+ * header, so the records can be used without any further checks.
+ */
+static gboolean
+attach_image (NvDsCalibration * calib, const guint8 * image, gsize size,
+    NvDsCalibKind kind)
+{
+  const NvDsCalibImageHeader *header = (const NvDsCalibImageHeader *) image;
+  const NvDsCalibField *fields;
+  guint num_fields;
+  guint expected_size;
+  guint i;
+  guint j;
+
+  if (size < sizeof (NvDsCalibImageHeader) ||
+      header->magic != NVDS_CALIB_MAGIC) {
+    NVGSTDS_ERR_MSG_V ("'%s' is not a calibration image", calib->path);
+    return FALSE;
+  }
+  if (header->version_major != NVDS_CALIB_VERSION_MAJOR ||
+      header->header_size != sizeof (NvDsCalibImageHeader)) {
+    NVGSTDS_ERR_MSG_V ("Unsupported calibration image version %u.%u in '%s'",
+        header->version_major, header->version_minor, calib->path);
+    return FALSE;
+  }
+
+  if (header->kind == NVDS_CALIB_KIND_SPOT) {
+    expected_size = sizeof (NvDsSpotCalibRecord);
+    fields = spot_fields;
+    num_fields = G_N_ELEMENTS (spot_fields);
+  } else if (header->kind == NVDS_CALIB_KIND_AISLE) {
+    expected_size = sizeof (NvDsAisleCalibRecord);
+    fields = aisle_fields;
+    num_fields = G_N_ELEMENTS (aisle_fields);
+  } else {
+    NVGSTDS_ERR_MSG_V ("Unknown calibration kind %u in '%s'", header->kind,
+        calib->path);
+    return FALSE;
+  }
+  if (kind != NVDS_CALIB_KIND_ANY && kind != (NvDsCalibKind) header->kind) {
+    NVGSTDS_ERR_MSG_V ("'%s' is not %s calibration", calib->path,
+        kind == NVDS_CALIB_KIND_SPOT ? "a spot" : "an aisle");
+    return FALSE;
+  }
+
+  if (header->record_size != expected_size || header->file_size != size ||
+      header->cameras_offset % NVDS_CALIB_ALIGN ||
+      header->records_offset % NVDS_CALIB_ALIGN ||
+      header->cameras_offset + (guint64) header->num_cameras *
+      sizeof (NvDsCalibCamera) > header->records_offset ||
+      header->records_offset + (guint64) header->num_records *
+      header->record_size > header->strings_offset ||
+      header->strings_size == 0 ||
+      header->strings_offset + header->strings_size != size ||
+      image[size - 1] != '\0' ||
+      header->source_path >= header->strings_size) {
+    NVGSTDS_ERR_MSG_V ("Corrupted calibration image '%s'", calib->path);
+    return FALSE;
+  }
+
+  if (crc32 (0L, image + header->header_size, size - header->header_size) !=
+      header->checksum) {
+    NVGSTDS_ERR_MSG_V ("Checksum mismatch in calibration image '%s'",
+        calib->path);
+    return FALSE;
+  }
+
+  calib->kind = (NvDsCalibKind) header->kind;
+  calib->header = header;
+  calib->cameras = (const NvDsCalibCamera *) (image + header->cameras_offset);
+  calib->num_cameras = header->num_cameras;
+  calib->records = image + header->records_offset;
+  calib->num_records = header->num_records;
+  calib->strings = (const gchar *) image + header->strings_offset;
+  calib->strings_size = header->strings_size;
+  calib->source_path = calib->strings + header->source_path;
+
+  for (i = 0; i < calib->num_cameras; i++) {
+    const NvDsCalibCamera *cam = &calib->cameras[i];
+    if (cam->first_record + (guint64) cam->num_records > calib->num_records ||
+        cam->camera_str >= calib->strings_size) {
+      NVGSTDS_ERR_MSG_V ("Corrupted camera table in '%s'", calib->path);
+      return FALSE;
+    }
+  }
+
+  /* The string table ends with a NUL, so an id inside it is a valid string. */
+  for (i = 0; i < calib->num_records; i++) {
+    const guint8 *record =
+        (const guint8 *) calib->records + (gsize) i * header->record_size;
+    for (j = 0; j < num_fields; j++) {
+      if (fields[j].type == CALIB_FIELD_STRING &&
+          *(const guint32 *) (record + fields[j].offset) >=
+          calib->strings_size) {
+        NVGSTDS_ERR_MSG_V ("Corrupted record %u in '%s'", i, calib->path);
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+static guint32
+record_surface (const NvDsCalibration * calib, guint i)
+{
+  if (calib->kind == NVDS_CALIB_KIND_SPOT)
+    return nvds_calibration_spots (calib)[i].surface_index;
+  return nvds_calibration_aisles (calib)[i].surface_index;
+}
+
+/**
+ * Build the serial -> camera table and the per-surface record ranges, so
+ * the per-frame lookup is a couple of array loads.
+ */
+static gboolean
+build_index (NvDsCalibration * calib)
+{
+  guint max_serial = 0;
+  guint i;
+  guint r;
+
+  calib->num_surfaces = 1;
+  for (i = 0; i < calib->num_records; i++) {
+    guint32 surface = record_surface (calib, i);
+    if (surface >= NVDS_CALIB_MAX_SURFACES) {
+      NVGSTDS_ERR_MSG_V ("Surface index %u exceeds %u in '%s'", surface,
+          NVDS_CALIB_MAX_SURFACES, calib->path);
+      return FALSE;
+    }
+    calib->num_surfaces = MAX (calib->num_surfaces, surface + 1);
+  }
+
+  for (i = 0; i < calib->num_cameras; i++) {
+    if (i > 0 && calib->cameras[i].serial < calib->cameras[i - 1].serial) {
+      NVGSTDS_ERR_MSG_V ("Camera table is not sorted in '%s'", calib->path);
+      return FALSE;
+    }
+    max_serial = MAX (max_serial, calib->cameras[i].serial);
+  }
+
+  if (max_serial <= NVDS_CALIB_MAX_DENSE_SERIAL) {
+    calib->num_camera_slots = max_serial + 1;
+    calib->camera_slots = g_new (gint32, calib->num_camera_slots);
+    for (i = 0; i < calib->num_camera_slots; i++)
+      calib->camera_slots[i] = -1;
+  }
+
+  calib->ranges = g_new0 (NvDsCalibRange,
+      calib->num_cameras * calib->num_surfaces);
+  for (i = 0; i < calib->num_cameras; i++) {
+    const NvDsCalibCamera *cam = &calib->cameras[i];
+    NvDsCalibRange *ranges = &calib->ranges[i * calib->num_surfaces];
+
+    if (i > 0 && cam->serial == calib->cameras[i - 1].serial) {
+      NVGSTDS_WARN_MSG_V ("Serial %u is used by more than one camera in '%s', "
+          "only the first one is used", cam->serial, calib->path);
+    } else if (calib->camera_slots) {
+      calib->camera_slots[cam->serial] = i;
+    }
+
+    /* Records of a camera are sorted by surface, so each surface is one
+     * contiguous range. */
+    for (r = cam->first_record; r < cam->first_record + cam->num_records; r++) {
+      NvDsCalibRange *range = &ranges[record_surface (calib, r)];
+      if (range->count == 0) {
+        range->first = r;
+      } else if (range->first + range->count != r) {
+        NVGSTDS_ERR_MSG_V ("Records of camera %u are not sorted in '%s'",
+            cam->serial, calib->path);
+        return FALSE;
+      }
+      range->count++;
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * Every aisle row carries both the homography and the reference points it
+ * was fitted to. Catch rows where the two disagree, e.g. after editing one
+ * without the other.
+ */
+static void
+check_homographies (NvDsCalibration * calib)
+{
+  const NvDsAisleCalibRecord *records = nvds_calibration_aisles (calib);
+  guint i;
+
+  for (i = 0; i < calib->num_records; i++) {
+    gdouble error = nvds_homography_reprojection_error (&records[i]);
+    if (!(error <= NVDS_CALIB_MAX_REPROJECTION_ERROR)) {
+      NVGSTDS_WARN_MSG_V ("Homography of aisle '%s' (serial %u) is off by %.3f "
+          "at its reference points in '%s'",
+          nvds_calibration_string (calib, records[i].aisle_str),
+          records[i].serial, error, calib->path);
+    }
+  }
+}
+
+gint
+nvds_calibration_find_camera (const NvDsCalibration * calib, guint serial)
+{
+  guint lo = 0;
+  guint hi = calib->num_cameras;
+
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+    if (calib->cameras[mid].serial < serial)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < calib->num_cameras && calib->cameras[lo].serial == serial)
+    return lo;
+  return -1;
+}
+
+gboolean
+nvds_calibration_is_image (const gchar * path)
+{
+  guint32 magic = 0;
+  gboolean ret = FALSE;
+  FILE *file = fopen (path, "rb");
+
+  if (file) {
+    ret = fread (&magic, sizeof (magic), 1, file) == 1 &&
+        magic == NVDS_CALIB_MAGIC;
+    fclose (file);
+  }
+  return ret;
+}
+
+static void calibration_free (NvDsCalibration * calib);
+
+/**
+ * Whether the CSV a compiled image was built from has changed since. The
+ * analysis plugins read the CSV itself, so the app must not go on with an
+ * image that disagrees with it.
+ */
+static gboolean
+source_changed (const NvDsCalibration * calib)
+{
+  struct stat st;
+
+  if (stat (calib->source_path, &st) != 0) {
+    NVGSTDS_WARN_MSG_V ("Source '%s' of calibration image '%s' not found",
+        calib->source_path, calib->path);
+    return FALSE;
+  }
+  return calib->header->source_mtime != st.st_mtim.tv_sec *
+      G_GUINT64_CONSTANT (1000000000) + st.st_mtim.tv_nsec ||
+      calib->header->source_size != (guint64) st.st_size;
+}
+
+static NvDsCalibration *
+calibration_load (const gchar * path, NvDsCalibKind kind)
+{
+  NvDsCalibration *calib = g_new0 (NvDsCalibration, 1);
+  GError *error = NULL;
+  gboolean ret = FALSE;
+  const guint8 *image;
+  gsize size = 0;
+
+  calib->path = g_strdup (path);
+
+  if (nvds_calibration_is_image (path)) {
+    calib->mapped = g_mapped_file_new (path, FALSE, &error);
+    if (!calib->mapped) {
+      NVGSTDS_ERR_MSG_V ("Failed to map '%s': %s", path, error->message);
+      g_error_free (error);
+      goto done;
+    }
+    image = (const guint8 *) g_mapped_file_get_contents (calib->mapped);
+    size = g_mapped_file_get_length (calib->mapped);
+  } else {
+    calib->image = parse_csv (path, &size);
+    if (!calib->image)
+      goto done;
+    image = calib->image;
+  }
+
+  if (!attach_image (calib, image, size, kind))
+    goto done;
+
+  if (calib->mapped && source_changed (calib)) {
+    gchar *source_path = g_strdup (calib->source_path);
+
+    NVGSTDS_WARN_MSG_V ("'%s' changed after '%s' was compiled, rebuilding "
+        "the calibration from it", source_path, path);
+    g_mapped_file_unref (calib->mapped);
+    calib->mapped = NULL;
+    calib->image = parse_csv (source_path, &size);
+    g_free (source_path);
+    if (!calib->image || !attach_image (calib, calib->image, size, kind))
+      goto done;
+  }
+
+  if (!build_index (calib))
+    goto done;
+  if (calib->kind == NVDS_CALIB_KIND_AISLE)
+    check_homographies (calib);
+
+  ret = TRUE;
+done:
+  if (!ret) {
+    NVGSTDS_ERR_MSG_V ("%s failed", __func__);
+    calibration_free (calib);
+    calib = NULL;
+  }
+  return calib;
+}
+
+static void
+calibration_free (NvDsCalibration * calib)
+{
+  if (calib->mapped)
+    g_mapped_file_unref (calib->mapped);
+  g_free (calib->image);
+  g_free (calib->camera_slots);
+  g_free (calib->ranges);
+  g_free (calib->path);
+  g_free (calib->key);
+  g_free (calib);
+}
+
+NvDsCalibration *
+nvds_calibration_acquire (const gchar * path, NvDsCalibKind kind)
+{
+  NvDsCalibration *calib = NULL;
+  gchar *real_path = NULL;
+  gchar *key = NULL;
+  struct stat st;
+
+  real_path = realpath (path, NULL);
+  if (!real_path || stat (real_path, &st) != 0) {
+    NVGSTDS_ERR_MSG_V ("Calibration file '%s' not found", path);
+    goto done;
+  }
+  key = g_strdup_printf ("%s:%ld.%09ld:%ld", real_path, (glong) st.st_mtim.tv_sec,
+      (glong) st.st_mtim.tv_nsec, (glong) st.st_size);
+
+  /* Loading under the lock keeps concurrent pipelines from parsing the same
+   * file twice. Removal also happens under the lock, so an entry found here
+   * always holds a reference. */
+  g_mutex_lock (&registry_lock);
+  if (!registry)
+    registry = g_hash_table_new (g_str_hash, g_str_equal);
+
+  calib = (NvDsCalibration *) g_hash_table_lookup (registry, key);
+  if (calib && source_changed (calib)) {
+    /* Same image, but its CSV was edited. Holders keep the old snapshot;
+     * it is no longer handed out and leaves the registry here. */
+    g_hash_table_remove (registry, calib->key);
+    calib = NULL;
+  }
+  if (calib) {
+    if (kind != NVDS_CALIB_KIND_ANY && kind != calib->kind) {
+      NVGSTDS_ERR_MSG_V ("'%s' is not %s calibration", path,
+          kind == NVDS_CALIB_KIND_SPOT ? "a spot" : "an aisle");
+      calib = NULL;
+    } else {
+      g_atomic_int_inc (&calib->ref_count);
+    }
+  } else {
+    calib = calibration_load (real_path, kind);
+    if (calib) {
+      calib->ref_count = 1;
+      calib->key = key;
+      key = NULL;
+      g_hash_table_insert (registry, calib->key, calib);
+    }
+  }
+  g_mutex_unlock (&registry_lock);
+
+done:
+  free (real_path);
+  g_free (key);
+  return calib;
+}
+
+NvDsCalibration *
+nvds_calibration_ref (NvDsCalibration * calib)
+{
+  if (calib)
+    g_atomic_int_inc (&calib->ref_count);
+  return calib;
+}
+
+void
+nvds_calibration_unref (NvDsCalibration * calib)
+{
+  if (!calib)
+    return;
+
+  g_mutex_lock (&registry_lock);
+  if (g_atomic_int_dec_and_test (&calib->ref_count)) {
+    if (g_hash_table_lookup (registry, calib->key) == calib)
+      g_hash_table_remove (registry, calib->key);
+    calibration_free (calib);
+  }
+  g_mutex_unlock (&registry_lock);
+}
+
+gboolean
+nvds_calibration_compile (const gchar * csv_path, const gchar * image_path)
+{
+  GError *error = NULL;
+  gboolean ret = FALSE;
+  guint8 *image = NULL;
+  gsize size = 0;
+
+  image = parse_csv (csv_path, &size);
+  if (!image)
+    goto done;
+
+  /* Written to a temporary file and renamed, so running pipelines never
+   * observe a partially written image. */
+  if (!g_file_set_contents (image_path, (const gchar *) image, size, &error)) {
+    NVGSTDS_ERR_MSG_V ("Failed to write '%s': %s", image_path, error->message);
+    g_error_free (error);
+    goto done;
+  }
+
+  ret = TRUE;
+done:
+  g_free (image);
+  if (!ret) {
+    NVGSTDS_ERR_MSG_V ("%s failed", __func__);
+  }
+  return ret;
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_CALIBRATION_H__
+#define __NVGSTDS_CALIBRATION_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+/**
+ * Spot / aisle calibration tables.
+ *
+ * The calibration CSVs (nvspot_*.csv, nvaisle_*.csv) can be compiled into a
+ * binary image which is mmap'ed read-only at startup. Both formats are
+ * loaded into the same in-memory layout:
+ *
+ *   NvDsCalibImageHeader
+ *   NvDsCalibCamera   [num_cameras]   per-camera offset table
+ *   record            [num_records]   fixed width, sorted by camera
+ *   string table                      NUL terminated, interned
+ *
+ * String fields of the records are byte offsets into the string table.
+ * Offset 0 is always the empty string.
+ */
+
+#define NVDS_CALIB_MAGIC 0x4243564e     /* "NVCB" */
+#define NVDS_CALIB_VERSION_MAJOR 1
+#define NVDS_CALIB_VERSION_MINOR 1
+#define NVDS_CALIB_ALIGN 8
+#define NVDS_CALIB_FILE_EXT ".calib"
+
+#define NVDS_CALIB_MAX_ROI_POINTS 8
+#define NVDS_CALIB_QUAD_POINTS 4
+#define NVDS_CALIB_MAX_SURFACES 16
+/** Largest accepted distance between H * (cx, cy) and (gx, gy). */
+#define NVDS_CALIB_MAX_REPROJECTION_ERROR 1.0
+
+/** Dewarper projection-type of the surfaces spot / aisle records apply to. */
+#define NVDS_CALIB_SURFACE_PUSHBROOM 1
+#define NVDS_CALIB_SURFACE_VERTRADCYL 2
+/** Serials up to this value are looked up through a dense table. */
+#define NVDS_CALIB_MAX_DENSE_SERIAL 4095
+
+typedef enum
+{
+  NVDS_CALIB_KIND_ANY = 0,
+  NVDS_CALIB_KIND_SPOT = 1,
+  NVDS_CALIB_KIND_AISLE = 2,
+} NvDsCalibKind;
+
+typedef struct
+{
+  guint32 magic;
+  guint16 version_major;
+  guint16 version_minor;
+  guint32 kind;
+  guint32 header_size;
+  guint32 record_size;
+  guint32 num_records;
+  guint32 num_cameras;
+  /** String id of the absolute path of the CSV this image was built from. */
+  guint32 source_path;
+  /** Modification time (ns) and size of the CSV when the image was built;
+   * an image whose CSV no longer matches is rebuilt from the CSV on load. */
+  guint64 source_mtime;
+  guint64 source_size;
+  guint64 cameras_offset;
+  guint64 records_offset;
+  guint64 strings_offset;
+  guint64 strings_size;
+  guint64 file_size;
+  /** CRC32 of everything following the header. */
+  guint32 checksum;
+  guint32 reserved;
+} NvDsCalibImageHeader;
+
+typedef struct
+{
+  /** cameraId / cameraIDString column */
+  guint32 camera_str;
+  /** serial column, same as camera-id of the [sourceX] group */
+  guint32 serial;
+  guint32 first_record;
+  guint32 num_records;
+} NvDsCalibCamera;
+
+/** Records of one camera surface: records[first] .. records[first + count - 1] */
+typedef struct
+{
+  guint32 first;
+  guint32 count;
+} NvDsCalibRange;
+
+/** One row of the spot calibration CSV. */
+typedef struct
+{
+  guint32 serial;
+  guint32 sensor_str;
+  guint32 cam_desc;
+  guint32 camera_str;
+  guint32 spot_str;
+  guint32 type;
+  guint32 level;
+  guint32 surface_index;
+  guint32 spot_index;
+  guint32 dewarp_width;
+  guint32 dewarp_height;
+  gfloat dewarp_top_angle;
+  gfloat dewarp_bottom_angle;
+  gfloat dewarp_pitch;
+  gfloat dewarp_yaw;
+  gfloat dewarp_roll;
+  gfloat dewarp_focal_length;
+  gfloat vertical_left;
+  gfloat vertical_right;
+  /** Horizon_x1, Horizon_y1, Horizon_x2, Horizon_y2 */
+  gfloat horizon[4];
+  /** spot_roi_x1, spot_roi_y1, spot_roi_x2, spot_roi_y2 */
+  gfloat spot_roi[4];
+  guint32 reserved;
+  /** x0, y0 .. x3, y3 world coordinates of the spot corners */
+  gdouble world[2 * NVDS_CALIB_QUAD_POINTS];
+} NvDsSpotCalibRecord;
+
+/** One row of the aisle calibration CSV. */
+typedef struct
+{
+  guint32 serial;
+  guint32 sensor_str;
+  guint32 cam_desc;
+  guint32 camera_str;
+  guint32 aisle_str;
+  guint32 aisle_name;
+  guint32 level;
+  /** Order of the row within its camera, i.e. the VertRadCyl surface index. */
+  guint32 surface_index;
+  guint32 num_roi_points;
+  guint32 entry;
+  guint32 exit;
+  guint32 dewarp_width;
+  guint32 dewarp_height;
+  gfloat dewarp_top_angle;
+  gfloat dewarp_bottom_angle;
+  gfloat dewarp_pitch;
+  gfloat dewarp_yaw;
+  gfloat dewarp_roll;
+  gfloat dewarp_focal_length;
+  /** ROI_x0, ROI_y0 .. ROI_x7, ROI_y7; unused points are -1 */
+  gfloat roi[2 * NVDS_CALIB_MAX_ROI_POINTS];
+  gfloat entry_roi[2 * NVDS_CALIB_QUAD_POINTS];
+  gfloat exit_roi[2 * NVDS_CALIB_QUAD_POINTS];
+  /** cx0, cy0 .. cx3, cy3 reference image points */
+  gfloat image_points[2 * NVDS_CALIB_QUAD_POINTS];
+  guint32 reserved;
+  /** gx0, gy0 .. gx3, gy3 world points of image_points */
+  gdouble world_points[2 * NVDS_CALIB_QUAD_POINTS];
+  /** H0 .. H8, row major image to world homography */
+  gdouble homography[9];
+} NvDsAisleCalibRecord;
+
+/**
+ * Immutable calibration view. Views are shared process wide through
+ * nvds_calibration_acquire() and must only be released with
+ * nvds_calibration_unref().
+ */
+typedef struct
+{
+  volatile gint ref_count;
+  /** Registry key: canonical path, mtime and size of the file. */
+  gchar *key;
+  NvDsCalibKind kind;
+  /** File the calibration was loaded from (CSV or compiled image). */
+  gchar *path;
+  /** CSV path handed to the analysis plugins. */
+  const gchar *source_path;
+
+  const NvDsCalibImageHeader *header;
+  const NvDsCalibCamera *cameras;
+  guint num_cameras;
+  gconstpointer records;
+  guint num_records;
+  const gchar *strings;
+  gsize strings_size;
+
+  GMappedFile *mapped;
+  guint8 *image;
+
+  /** Lookup index, see nvds_calibration_lookup(). camera_slots maps a serial
+   * to its camera, or -1. It is NULL when the serials are too sparse, and
+   * the (serial sorted) camera table is searched instead. */
+  gint32 *camera_slots;
+  guint num_camera_slots;
+  /** [num_cameras][num_surfaces] */
+  NvDsCalibRange *ranges;
+  guint num_surfaces;
+} NvDsCalibration;
+
+/**
+ * Return the calibration stored in @path. Files are loaded once per process
+ * and shared by every caller until they are modified on disk.
+ */
+NvDsCalibration *nvds_calibration_acquire (const gchar * path,
+    NvDsCalibKind kind);
+
+NvDsCalibration *nvds_calibration_ref (NvDsCalibration * calib);
+
+void nvds_calibration_unref (NvDsCalibration * calib);
+
+gboolean nvds_calibration_compile (const gchar * csv_path, const gchar * image_path);
+
+gboolean nvds_calibration_is_image (const gchar * path);
+
+gint nvds_calibration_find_camera (const NvDsCalibration * calib, guint serial);
+
+static inline gint
+nvds_calibration_camera_index (const NvDsCalibration * calib, guint serial)
+{
+  if (!calib->camera_slots)
+    return nvds_calibration_find_camera (calib, serial);
+  return serial < calib->num_camera_slots ? calib->camera_slots[serial] : -1;
+}
+
+/**
+ * Return the records of surface @surface of the camera with serial @serial,
+ * or NULL. The serial is the camera-id of the [sourceX] group, so a frame is
+ * resolved with multi_source_config[stream id].camera_id and its dewarped
+ * surface index, without comparing any strings.
+ */
+static inline const NvDsCalibRange *
+nvds_calibration_lookup (const NvDsCalibration * calib, guint serial,
+    guint surface)
+{
+  gint camera = nvds_calibration_camera_index (calib, serial);
+
+  if (camera < 0 || surface >= calib->num_surfaces)
+    return NULL;
+  return &calib->ranges[camera * calib->num_surfaces + surface];
+}
+
+static inline const gchar *
+nvds_calibration_string (const NvDsCalibration * calib, guint32 id)
+{
+  return calib->strings + id;
+}
+
+static inline const NvDsSpotCalibRecord *
+nvds_calibration_spots (const NvDsCalibration * calib)
+{
+  return (const NvDsSpotCalibRecord *) calib->records;
+}
+
+static inline const NvDsAisleCalibRecord *
+nvds_calibration_aisles (const NvDsCalibration * calib)
+{
+  return (const NvDsAisleCalibRecord *) calib->records;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include "deepstream_common.h"
+#include "deepstream_calibration_watch.h"
+
+static void
+file_state_init (NvDsCalibFileState * state, const gchar * path)
+{
+  struct stat st;
+
+  memset (state, 0, sizeof (*state));
+  if (stat (path, &st) == 0) {
+    state->loaded_mtime = state->pending_mtime = st.st_mtim;
+    state->loaded_size = state->pending_size = st.st_size;
+  }
+}
+
+NvDsCalibHandle *
+nvds_calib_handle_new (NvDsCalibration * calib, const gchar * path)
+{
+  NvDsCalibHandle *handle = g_new0 (NvDsCalibHandle, 1);
+
+  handle->ref_count = 1;
+  handle->current = calib;
+  handle->kind = calib->kind;
+  handle->path = g_strdup (path);
+  handle->source_path = g_strdup (calib->source_path);
+  g_mutex_init (&handle->lock);
+
+  file_state_init (&handle->file, handle->path);
+  file_state_init (&handle->source, handle->source_path);
+  return handle;
+}
+
+NvDsCalibHandle *
+nvds_calib_handle_ref (NvDsCalibHandle * handle)
+{
+  if (handle)
+    g_atomic_int_inc (&handle->ref_count);
+  return handle;
+}
+
+void
+nvds_calib_handle_unref (NvDsCalibHandle * handle)
+{
+  if (!handle || !g_atomic_int_dec_and_test (&handle->ref_count))
+    return;
+
+  if (handle->watch_id)
+    g_source_remove (handle->watch_id);
+  if (handle->reload_thread)
+    g_thread_join (handle->reload_thread);
+
+  nvds_calibration_unref (handle->current);
+  g_mutex_clear (&handle->lock);
+  g_free (handle->path);
+  g_free (handle->source_path);
+  g_free (handle);
+}
+
+/**
+ * Wait until no reader can still hold a snapshot published before this call.
+ * The phase is flipped twice so a reader that sampled the phase just before
+ * a flip, and registered on the old counter after it drained, is still
+ * waited for on the second pass.
+ */
+static void
+synchronize_readers (NvDsCalibHandle * handle)
+{
+  guint i;
+
+  for (i = 0; i < 2; i++) {
+    gint phase = g_atomic_int_get (&handle->phase) & 1;
+
+    g_atomic_int_set (&handle->phase, phase ^ 1);
+    while (g_atomic_int_get (&handle->readers[phase]) > 0)
+      g_usleep (50);
+  }
+}
+
+static gpointer
+reload_thread_func (gpointer data)
+{
+  NvDsCalibHandle *handle = (NvDsCalibHandle *) data;
+  NvDsCalibration *calib = NULL;
+  NvDsCalibration *old = NULL;
+  gint64 start = g_get_monotonic_time ();
+  gint64 loaded;
+  gint64 swapped;
+
+  calib = nvds_calibration_acquire (handle->path, handle->kind);
+  if (calib && calib->num_records == 0) {
+    NVGSTDS_ERR_MSG_V ("Calibration '%s' has no records", handle->path);
+    nvds_calibration_unref (calib);
+    calib = NULL;
+  }
+  loaded = g_get_monotonic_time ();
+
+  if (!calib) {
+    NVGSTDS_WARN_MSG_V ("Keeping previous calibration for '%s'", handle->path);
+    g_mutex_lock (&handle->lock);
+    handle->num_failures++;
+    g_mutex_unlock (&handle->lock);
+    goto done;
+  }
+
+  if (calib == handle->current) {
+    /* Touched without changing the registry key, nothing to publish. */
+    nvds_calibration_unref (calib);
+    goto done;
+  }
+
+  old = (NvDsCalibration *) g_atomic_pointer_get (&handle->current);
+  g_atomic_pointer_set (&handle->current, calib);
+  synchronize_readers (handle);
+  nvds_calibration_unref (old);
+  swapped = g_get_monotonic_time ();
+
+  g_mutex_lock (&handle->lock);
+  handle->num_reloads++;
+  handle->last_load_ms = (loaded - start) / 1000.0;
+  handle->last_swap_ms = (swapped - loaded) / 1000.0;
+  g_mutex_unlock (&handle->lock);
+
+  g_print ("Reloaded calibration '%s' (%u records) in %.2f ms\n",
+      handle->path, calib->num_records, (swapped - start) / 1000.0);
+
+done:
+  g_atomic_int_set (&handle->reloading, 0);
+  return NULL;
+}
+
+static gboolean
+same_time (const struct timespec *a, const struct timespec *b)
+{
+  return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+/**
+ * Whether the file has stayed unchanged since the previous poll. @changed is
+ * set if it differs from the state that was last loaded.
+ */
+static gboolean
+file_settled (const struct stat *st, NvDsCalibFileState * state,
+    gboolean * changed)
+{
+  if (!same_time (&st->st_mtim, &state->pending_mtime) ||
+      st->st_size != state->pending_size) {
+    state->pending_mtime = st->st_mtim;
+    state->pending_size = st->st_size;
+    return FALSE;
+  }
+
+  if (!same_time (&st->st_mtim, &state->loaded_mtime) ||
+      st->st_size != state->loaded_size)
+    *changed = TRUE;
+  return TRUE;
+}
+
+static void
+file_state_loaded (NvDsCalibFileState * state)
+{
+  state->loaded_mtime = state->pending_mtime;
+  state->loaded_size = state->pending_size;
+}
+
+/**
+ * Runs in the main loop. A reload is started once the calibration file or
+ * its source CSV has changed and both then stayed unchanged for one poll
+ * interval, so a file that is still being written is not picked up half way.
+ * A compiled image whose CSV changed is rebuilt from the CSV by the load.
+ */
+static gboolean
+watch_cb (gpointer data)
+{
+  NvDsCalibHandle *handle = (NvDsCalibHandle *) data;
+  const gchar *source_path;
+  gboolean changed = FALSE;
+  gboolean settled;
+  struct stat st;
+
+  if (g_atomic_int_get (&handle->reloading) || stat (handle->path, &st) != 0)
+    return TRUE;
+
+  /* Only the reload thread replaces the snapshot, and it is not running. */
+  source_path = handle->current->source_path;
+  if (g_strcmp0 (source_path, handle->source_path)) {
+    g_free (handle->source_path);
+    handle->source_path = g_strdup (source_path);
+    file_state_init (&handle->source, handle->source_path);
+  }
+
+  settled = file_settled (&st, &handle->file, &changed);
+  /* A missing CSV leaves the image in use, see nvds_calibration_acquire(). */
+  if (stat (handle->source_path, &st) == 0 &&
+      !file_settled (&st, &handle->source, &changed))
+    settled = FALSE;
+
+  if (!settled || !changed)
+    return TRUE;
+
+  file_state_loaded (&handle->file);
+  file_state_loaded (&handle->source);
+
+  if (handle->reload_thread)
+    g_thread_join (handle->reload_thread);
+  g_atomic_int_set (&handle->reloading, 1);
+  handle->reload_thread =
+      g_thread_new ("calib-reload", reload_thread_func, handle);
+  return TRUE;
+}
+
+void
+nvds_calib_handle_watch (NvDsCalibHandle * handle, guint interval_ms)
+{
+  if (!handle || !interval_ms || handle->watch_id)
+    return;
+
+  handle->watch_id = g_timeout_add (interval_ms, watch_cb, handle);
+}
+
+void
+nvds_calib_handle_get_stats (NvDsCalibHandle * handle,
+    NvDsCalibReloadStats * stats)
+{
+  g_mutex_lock (&handle->lock);
+  stats->num_reloads = handle->num_reloads;
+  stats->num_failures = handle->num_failures;
+  stats->last_load_ms = handle->last_load_ms;
+  stats->last_swap_ms = handle->last_swap_ms;
+  g_mutex_unlock (&handle->lock);
+}
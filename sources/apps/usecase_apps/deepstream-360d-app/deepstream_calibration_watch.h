@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_CALIBRATION_WATCH_H__
+#define __NVGSTDS_CALIBRATION_WATCH_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "deepstream_calibration.h"
+
+/** Last seen and last loaded state of a watched file */
+typedef struct
+{
+  /** Full resolution, as in the key of the calibration registry */
+  struct timespec pending_mtime;
+  struct timespec loaded_mtime;
+  off_t pending_size;
+  off_t loaded_size;
+} NvDsCalibFileState;
+
+/**
+ * Handle to the current calibration snapshot of a [spot] / [aisle] group.
+ *
+ * The configured file and the CSV it was compiled from are polled from the
+ * main loop. A change of either one is loaded and validated on a separate
+ * thread and then published with a single pointer swap. Readers bracket
+ * their use of a snapshot with nvds_calib_read_begin() /
+ * nvds_calib_read_end(); they never block, and a replaced snapshot is only
+ * released once every reader that could have seen it has finished.
+ */
+typedef struct
+{
+  volatile gint ref_count;
+  NvDsCalibration *current;
+  volatile gint phase;
+  volatile gint readers[2];
+
+  gchar *path;
+  NvDsCalibKind kind;
+  guint watch_id;
+  GThread *reload_thread;
+  volatile gint reloading;
+  GMutex lock;
+  NvDsCalibFileState file;
+  /** CSV the current snapshot was built from, the file itself for a CSV */
+  gchar *source_path;
+  NvDsCalibFileState source;
+
+  guint num_reloads;
+  guint num_failures;
+  gdouble last_load_ms;
+  gdouble last_swap_ms;
+} NvDsCalibHandle;
+
+typedef struct
+{
+  guint num_reloads;
+  guint num_failures;
+  gdouble last_load_ms;
+  gdouble last_swap_ms;
+} NvDsCalibReloadStats;
+
+/** Takes ownership of @calib, which was acquired from @path. */
+NvDsCalibHandle *nvds_calib_handle_new (NvDsCalibration * calib,
+    const gchar * path);
+
+NvDsCalibHandle *nvds_calib_handle_ref (NvDsCalibHandle * handle);
+
+void nvds_calib_handle_unref (NvDsCalibHandle * handle);
+
+/**
+ * Poll the calibration file and its source CSV every @interval_ms and reload
+ * the calibration when either one changes.
+ */
+void nvds_calib_handle_watch (NvDsCalibHandle * handle, guint interval_ms);
+
+void nvds_calib_handle_get_stats (NvDsCalibHandle * handle,
+    NvDsCalibReloadStats * stats);
+
+static inline const NvDsCalibration *
+nvds_calib_read_begin (NvDsCalibHandle * handle, gint * phase)
+{
+  *phase = g_atomic_int_get (&handle->phase) & 1;
+  g_atomic_int_inc (&handle->readers[*phase]);
+  return (const NvDsCalibration *) g_atomic_pointer_get (&handle->current);
+}
+
+static inline void
+nvds_calib_read_end (NvDsCalibHandle * handle, gint phase)
+{
+  g_atomic_int_add (&handle->readers[phase], -1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,891 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "deepstream_common.h"
+#include "deepstream_cpu_dewarper.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DEWARP_X86 1
+#endif
+
+#define CONFIG_GROUP_SURFACE "surface"
+#define CONFIG_KEY_PROJECTION_TYPE "projection-type"
+#define CONFIG_KEY_SURFACE_INDEX "surface-index"
+#define CONFIG_KEY_WIDTH "width"
+#define CONFIG_KEY_HEIGHT "height"
+#define CONFIG_KEY_TOP_ANGLE "top-angle"
+#define CONFIG_KEY_BOTTOM_ANGLE "bottom-angle"
+#define CONFIG_KEY_PITCH "pitch"
+#define CONFIG_KEY_YAW "yaw"
+#define CONFIG_KEY_ROLL "roll"
+#define CONFIG_KEY_FOCAL_LENGTH "focal-length"
+
+/** Rows of a surface handled by one job of the thread pool */
+#define DEWARP_ROWS_PER_JOB 32
+#define DEWARP_BENCHMARK_FRAMES 10
+/** Fraction bits of the remap tables, fewer for sources wider than 2047 */
+#define DEWARP_MAX_FRAC_BITS 8
+#define DEWARP_MIN_FRAC_BITS 2
+
+typedef void (*RemapFunc) (const NvDsDewarpMap * map, guint row,
+    const guint8 * src, guint src_stride, guint8 * dst);
+
+typedef enum
+{
+  DEWARP_JOB_BUILD,
+  DEWARP_JOB_REMAP,
+} DewarpJobType;
+
+typedef struct
+{
+  guint surface;
+  guint first_row;
+  guint num_rows;
+} DewarpJob;
+
+struct _NvDsCpuDewarper
+{
+  NvDsDewarpSurface surfaces[NVDS_DEWARP_MAX_SURFACES];
+  /** Shared remap tables, referenced */
+  NvDsDewarpMap *maps[NVDS_DEWARP_MAX_SURFACES];
+  guint num_surfaces;
+  guint src_width;
+  guint src_height;
+
+  GThreadPool *pool;
+  DewarpJob *jobs;
+  guint num_jobs;
+
+  /* State of the jobs being run, see run_jobs(). */
+  DewarpJobType job_type;
+  const guint8 *src;
+  guint src_stride;
+  guint8 *const *dst;
+  const guint *dst_strides;
+  GMutex lock;
+  GCond done;
+  guint pending;
+};
+
+/* Remap tables by geometry, see map_acquire_locked(). */
+static GMutex cache_lock;
+static GHashTable *cache;
+
+/** FNV-1a hash of the geometry of a remap table. */
+static guint
+map_key_hash (gconstpointer key)
+{
+  const guint8 *bytes = (const guint8 *) key;
+  guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+  gsize i;
+
+  for (i = 0; i < sizeof (NvDsDewarpMapKey); i++)
+    hash = (hash ^ bytes[i]) * G_GUINT64_CONSTANT (0x100000001b3);
+  return (guint) (hash ^ (hash >> 32));
+}
+
+static gboolean
+map_key_equal (gconstpointer a, gconstpointer b)
+{
+  return memcmp (a, b, sizeof (NvDsDewarpMapKey)) == 0;
+}
+
+static void
+map_key_init (NvDsDewarpMapKey * key, const NvDsDewarpSurface * surface,
+    guint src_width, guint src_height)
+{
+  /* Zeroed so that padding does not change the hash. */
+  memset (key, 0, sizeof (NvDsDewarpMapKey));
+  key->projection_type = surface->projection_type;
+  key->width = surface->width;
+  key->height = surface->height;
+  key->src_width = src_width;
+  key->src_height = src_height;
+  key->top_angle = surface->top_angle;
+  key->bottom_angle = surface->bottom_angle;
+  key->pitch = surface->pitch;
+  key->yaw = surface->yaw;
+  key->roll = surface->roll;
+  key->focal_length = surface->focal_length;
+}
+
+/**
+ * Return the shared remap table for @key, with a reference. *@created is
+ * set if the table is new and still has to be filled; that has to be done
+ * before cache_lock is released. Must be called with cache_lock held.
+ */
+static NvDsDewarpMap *
+map_acquire_locked (const NvDsDewarpMapKey * key, gboolean * created)
+{
+  NvDsDewarpMap *map;
+
+  if (!cache)
+    cache = g_hash_table_new (map_key_hash, map_key_equal);
+
+  map = (NvDsDewarpMap *) g_hash_table_lookup (cache, key);
+  if (map) {
+    g_atomic_int_inc (&map->ref_count);
+    *created = FALSE;
+    return map;
+  }
+
+  map = g_new0 (NvDsDewarpMap, 1);
+  map->ref_count = 1;
+  map->key = *key;
+  map->width = key->width;
+  map->height = key->height;
+  map->frac_bits = MIN (DEWARP_MAX_FRAC_BITS,
+      16 - g_bit_storage (MAX (key->src_width, key->src_height)));
+  map->xy = g_new (guint16, 2 * (gsize) map->width * map->height);
+  g_hash_table_insert (cache, &map->key, map);
+  *created = TRUE;
+  return map;
+}
+
+static void
+map_unref (NvDsDewarpMap * map)
+{
+  if (!map)
+    return;
+
+  g_mutex_lock (&cache_lock);
+  if (g_atomic_int_dec_and_test (&map->ref_count)) {
+    g_hash_table_remove (cache, &map->key);
+    g_free (map->xy);
+    g_free (map);
+  }
+  g_mutex_unlock (&cache_lock);
+}
+
+gsize
+nvds_dewarp_map_cache_size (guint * num_maps)
+{
+  GHashTableIter iter;
+  gpointer value;
+  gsize size = 0;
+  guint count = 0;
+
+  g_mutex_lock (&cache_lock);
+  if (cache) {
+    g_hash_table_iter_init (&iter, cache);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+      NvDsDewarpMap *map = (NvDsDewarpMap *) value;
+      size += 2 * sizeof (guint16) * (gsize) map->width * map->height;
+      count++;
+    }
+  }
+  g_mutex_unlock (&cache_lock);
+
+  if (num_maps)
+    *num_maps = count;
+  return size;
+}
+
+gboolean
+nvds_dewarp_parse_surfaces (const gchar * config_file,
+    NvDsDewarpSurface * surfaces, guint * num_surfaces)
+{
+  GKeyFile *key_file = g_key_file_new ();
+  gchar **groups = NULL;
+  gchar **group;
+  GError *error = NULL;
+  gboolean ret = FALSE;
+
+  *num_surfaces = 0;
+  if (!g_key_file_load_from_file (key_file, config_file, G_KEY_FILE_NONE,
+          &error)) {
+    NVGSTDS_ERR_MSG_V ("Failed to load '%s': %s", config_file, error->message);
+    goto done;
+  }
+
+  groups = g_key_file_get_groups (key_file, NULL);
+  for (group = groups; *group; group++) {
+    NvDsDewarpSurface *surface = &surfaces[*num_surfaces];
+
+    if (!g_str_has_prefix (*group, CONFIG_GROUP_SURFACE))
+      continue;
+    if (*num_surfaces == NVDS_DEWARP_MAX_SURFACES) {
+      NVGSTDS_WARN_MSG_V ("Only %d surfaces are supported, ignoring [%s]",
+          NVDS_DEWARP_MAX_SURFACES, *group);
+      continue;
+    }
+
+    memset (surface, 0, sizeof (NvDsDewarpSurface));
+    surface->projection_type = g_key_file_get_integer (key_file, *group,
+        CONFIG_KEY_PROJECTION_TYPE, &error);
+    if (!error)
+      surface->width = g_key_file_get_integer (key_file, *group,
+          CONFIG_KEY_WIDTH, &error);
+    if (!error)
+      surface->height = g_key_file_get_integer (key_file, *group,
+          CONFIG_KEY_HEIGHT, &error);
+    if (!error)
+      surface->focal_length = g_key_file_get_double (key_file, *group,
+          CONFIG_KEY_FOCAL_LENGTH, &error);
+    if (error) {
+      NVGSTDS_ERR_MSG_V ("[%s] of '%s': %s", *group, config_file,
+          error->message);
+      goto done;
+    }
+
+    /* Angles default to 0 like in the plugin. */
+    surface->surface_index = g_key_file_get_integer (key_file, *group,
+        CONFIG_KEY_SURFACE_INDEX, NULL);
+    surface->top_angle = g_key_file_get_double (key_file, *group,
+        CONFIG_KEY_TOP_ANGLE, NULL);
+    surface->bottom_angle = g_key_file_get_double (key_file, *group,
+        CONFIG_KEY_BOTTOM_ANGLE, NULL);
+    surface->pitch = g_key_file_get_double (key_file, *group,
+        CONFIG_KEY_PITCH, NULL);
+    surface->yaw = g_key_file_get_double (key_file, *group,
+        CONFIG_KEY_YAW, NULL);
+    surface->roll = g_key_file_get_double (key_file, *group,
+        CONFIG_KEY_ROLL, NULL);
+
+    if (surface->projection_type != NVDS_DEWARP_PROJECTION_PUSHBROOM &&
+        surface->projection_type != NVDS_DEWARP_PROJECTION_VERTRADCYL) {
+      NVGSTDS_ERR_MSG_V ("[%s] of '%s': projection-type %u is not supported",
+          *group, config_file, surface->projection_type);
+      goto done;
+    }
+    if (!surface->width || !surface->height || surface->focal_length <= 0) {
+      NVGSTDS_ERR_MSG_V ("[%s] of '%s': invalid surface size or focal-length",
+          *group, config_file);
+      goto done;
+    }
+    (*num_surfaces)++;
+  }
+
+  if (*num_surfaces == 0) {
+    NVGSTDS_ERR_MSG_V ("No [surfaceN] group in '%s'", config_file);
+    goto done;
+  }
+  ret = TRUE;
+
+done:
+  if (error)
+    g_error_free (error);
+  g_strfreev (groups);
+  g_key_file_free (key_file);
+  return ret;
+}
+
+/** Rotation of a surface's view, by yaw, pitch and roll. */
+typedef struct
+{
+  gdouble cp, sp;
+  gdouble cyw, syw;
+  gdouble cr, sr;
+} ViewRotation;
+
+static void
+view_rotation_init (ViewRotation * rot, gdouble pitch, gdouble yaw,
+    gdouble roll)
+{
+  rot->cp = cos (pitch * G_PI / 180);
+  rot->sp = sin (pitch * G_PI / 180);
+  rot->cyw = cos (yaw * G_PI / 180);
+  rot->syw = sin (yaw * G_PI / 180);
+  rot->cr = cos (roll * G_PI / 180);
+  rot->sr = sin (roll * G_PI / 180);
+}
+
+/**
+ * Line of sight, in the frame of the fisheye, of the surface point at
+ * elevation @a (radians) and horizontal position @h (focal lengths).
+ *
+ * A PushBroom surface sweeps a line of sight along x, perspective
+ * horizontally, with the rows going from top-angle to bottom-angle of
+ * elevation. A VertRadCyl surface unrolls the fisheye around its optical
+ * axis: columns are azimuth, rows go from top-angle to bottom-angle of
+ * elevation above the image plane. The view is then rotated by yaw, pitch
+ * and roll.
+ */
+static inline void
+view_ray (guint projection_type, const ViewRotation * rot, gdouble a,
+    gdouble h, gdouble * ray)
+{
+  gdouble dx, dy, dz, t;
+
+  if (projection_type == NVDS_DEWARP_PROJECTION_PUSHBROOM) {
+    gdouble n = sqrt (1 + h * h);
+    dx = cos (a) * h / n;
+    dy = -sin (a);
+    dz = cos (a) / n;
+  } else {
+    dx = cos (a) * cos (h);
+    dy = cos (a) * sin (h);
+    dz = sin (a);
+  }
+
+  /* yaw about y, pitch about x, roll about the optical axis */
+  t = rot->cyw * dx + rot->syw * dz;
+  dz = -rot->syw * dx + rot->cyw * dz;
+  dx = t;
+  t = rot->cp * dy - rot->sp * dz;
+  dz = rot->sp * dy + rot->cp * dz;
+  dy = t;
+  t = rot->cr * dx - rot->sr * dy;
+  dy = rot->sr * dx + rot->cr * dy;
+  dx = t;
+
+  ray[0] = dx;
+  ray[1] = dy;
+  ray[2] = dz;
+}
+
+void
+nvds_dewarp_surface_ray (const NvDsDewarpSurface * surface, gdouble u,
+    gdouble v, gdouble * ray)
+{
+  ViewRotation rot;
+  gdouble a = (surface->top_angle + (surface->bottom_angle -
+          surface->top_angle) * v / surface->height) * G_PI / 180;
+  gdouble h = (u - surface->width / 2.0) / surface->focal_length;
+
+  view_rotation_init (&rot, surface->pitch, surface->yaw, surface->roll);
+  view_ray (surface->projection_type, &rot, a, h, ray);
+}
+
+/**
+ * Fill rows @first_row .. @first_row + @num_rows - 1 of @map.
+ *
+ * The source is taken to be an equidistant fisheye (r = focal-length * angle
+ * from the optical axis) centered in the frame, see view_ray() for the
+ * surfaces.
+ *
+ * Positions are stored in fixed point, rounded down, so that the bilinear
+ * filter never reads past the last row or column.
+ */
+static void
+build_map_rows (NvDsDewarpMap * map, guint first_row, guint num_rows)
+{
+  const NvDsDewarpMapKey *surface = &map->key;
+  guint src_width = surface->src_width;
+  guint src_height = surface->src_height;
+  gdouble scale = 1 << map->frac_bits;
+  gdouble f = surface->focal_length;
+  gdouble cx = src_width / 2.0, cy = src_height / 2.0;
+  gdouble max_x = src_width - 1 - 1e-3, max_y = src_height - 1 - 1e-3;
+  ViewRotation rot;
+  guint u, v;
+
+  view_rotation_init (&rot, surface->pitch, surface->yaw, surface->roll);
+  for (v = first_row; v < first_row + num_rows; v++) {
+    gdouble a = (surface->top_angle + (surface->bottom_angle -
+            surface->top_angle) * (v + 0.5) / surface->height) * G_PI / 180;
+    guint16 *row = map->xy + 2 * (gsize) v * map->width;
+
+    for (u = 0; u < map->width; u++) {
+      gdouble h = (u + 0.5 - map->width / 2.0) / f;
+      gdouble ray[3], theta, r, sx, sy;
+
+      view_ray (surface->projection_type, &rot, a, h, ray);
+      theta = acos (CLAMP (ray[2] / sqrt (ray[0] * ray[0] + ray[1] * ray[1] +
+                  ray[2] * ray[2]), -1, 1));
+      r = f * theta / MAX (sqrt (ray[0] * ray[0] + ray[1] * ray[1]), 1e-12);
+      sx = cx + r * ray[0];
+      sy = cy + r * ray[1];
+
+      if (sx < 0 || sy < 0 || sx > src_width - 1 || sy > src_height - 1) {
+        row[2 * u] = row[2 * u + 1] = NVDS_DEWARP_MAP_INVALID;
+      } else {
+        /* Keep x + 1 and y + 1 inside the frame for the bilinear filter. */
+        row[2 * u] = (guint16) (MIN (sx, max_x) * scale);
+        row[2 * u + 1] = (guint16) (MIN (sy, max_y) * scale);
+      }
+    }
+  }
+}
+
+/**
+ * The fraction of the table coordinates is widened to 8 bits, so that the
+ * four weights add up to 1 << 16 and every channel is rounded the same way
+ * by all kernels.
+ */
+static void
+remap_row_scalar (const NvDsDewarpMap * map, guint row, const guint8 * src,
+    guint src_stride, guint8 * dst)
+{
+  const guint16 *xy = map->xy + 2 * (gsize) row * map->width;
+  guint frac_mask = (1u << map->frac_bits) - 1;
+  guint frac_shift = 8 - map->frac_bits;
+  guint32 *out = (guint32 *) dst;
+  guint u, c;
+
+  for (u = 0; u < map->width; u++) {
+    const guint8 *p00, *p10;
+    guint fx, fy, w00, w01, w10, w11;
+    guint32 pixel = 0;
+
+    if (xy[2 * u] == NVDS_DEWARP_MAP_INVALID) {
+      out[u] = 0;
+      continue;
+    }
+
+    fx = (xy[2 * u] & frac_mask) << frac_shift;
+    fy = (xy[2 * u + 1] & frac_mask) << frac_shift;
+    w00 = (256 - fx) * (256 - fy);
+    w01 = fx * (256 - fy);
+    w10 = (256 - fx) * fy;
+    w11 = fx * fy;
+    p00 = src + (gsize) (xy[2 * u + 1] >> map->frac_bits) * src_stride +
+        4 * (xy[2 * u] >> map->frac_bits);
+    p10 = p00 + src_stride;
+
+    for (c = 0; c < 4; c++) {
+      guint32 value = w00 * p00[c] + w01 * p00[4 + c] + w10 * p10[c] +
+          w11 * p10[4 + c];
+      pixel |= ((value + (1 << 15)) >> 16) << (8 * c);
+    }
+    out[u] = GUINT32_FROM_LE (pixel);
+  }
+}
+
+#ifdef DEWARP_X86
+/**
+ * Eight pixels at a time, with the four neighbours fetched by gathers.
+ * Gives the same result as remap_row_scalar().
+ */
+__attribute__ ((target ("avx2")))
+static void
+remap_row_avx2 (const NvDsDewarpMap * map, guint row, const guint8 * src,
+    guint src_stride, guint8 * dst)
+{
+  const guint16 *xy = map->xy + 2 * (gsize) row * map->width;
+  const gint *base = (const gint *) src;
+  __m128i frac_bits = _mm_cvtsi32_si128 (map->frac_bits);
+  __m128i frac_shift = _mm_cvtsi32_si128 (8 - map->frac_bits);
+  __m256i frac_mask = _mm256_set1_epi32 ((1 << map->frac_bits) - 1);
+  __m256i low = _mm256_set1_epi32 (0xffff);
+  __m256i one = _mm256_set1_epi32 (256);
+  __m256i half = _mm256_set1_epi32 (1 << 15);
+  __m256i stride = _mm256_set1_epi32 (src_stride / 4);
+  __m256i byte = _mm256_set1_epi32 (0xff);
+  guint u, c;
+
+  for (u = 0; u + 8 <= map->width; u += 8) {
+    /* x in the low, y in the high half of each lane */
+    __m256i mxy = _mm256_loadu_si256 ((const __m256i *) (xy + 2 * u));
+    __m256i mx = _mm256_and_si256 (mxy, low);
+    __m256i my = _mm256_srli_epi32 (mxy, 16);
+    __m256i mask = _mm256_andnot_si256 (_mm256_cmpeq_epi32 (mx, low),
+        _mm256_set1_epi32 (-1));
+    __m256i fx = _mm256_sll_epi32 (_mm256_and_si256 (mx, frac_mask),
+        frac_shift);
+    __m256i fy = _mm256_sll_epi32 (_mm256_and_si256 (my, frac_mask),
+        frac_shift);
+    __m256i gx = _mm256_sub_epi32 (one, fx);
+    __m256i gy = _mm256_sub_epi32 (one, fy);
+    __m256i w00 = _mm256_mullo_epi32 (gx, gy);
+    __m256i w01 = _mm256_mullo_epi32 (fx, gy);
+    __m256i w10 = _mm256_mullo_epi32 (gx, fy);
+    __m256i w11 = _mm256_mullo_epi32 (fx, fy);
+    __m256i idx = _mm256_add_epi32 (_mm256_mullo_epi32 (_mm256_srl_epi32 (my,
+                frac_bits), stride), _mm256_srl_epi32 (mx, frac_bits));
+    __m256i p00 = _mm256_mask_i32gather_epi32 (_mm256_setzero_si256 (), base,
+        idx, mask, 4);
+    __m256i p01 = _mm256_mask_i32gather_epi32 (_mm256_setzero_si256 (), base,
+        _mm256_add_epi32 (idx, _mm256_set1_epi32 (1)), mask, 4);
+    __m256i p10 = _mm256_mask_i32gather_epi32 (_mm256_setzero_si256 (), base,
+        _mm256_add_epi32 (idx, stride), mask, 4);
+    __m256i p11 = _mm256_mask_i32gather_epi32 (_mm256_setzero_si256 (), base,
+        _mm256_add_epi32 (_mm256_add_epi32 (idx, stride),
+            _mm256_set1_epi32 (1)), mask, 4);
+    __m256i out = _mm256_setzero_si256 ();
+
+    for (c = 0; c < 4; c++) {
+      __m256i value = _mm256_add_epi32 (_mm256_add_epi32 (
+              _mm256_mullo_epi32 (w00, _mm256_and_si256 (
+                      _mm256_srli_epi32 (p00, 8 * c), byte)),
+              _mm256_mullo_epi32 (w01, _mm256_and_si256 (
+                      _mm256_srli_epi32 (p01, 8 * c), byte))),
+          _mm256_add_epi32 (
+              _mm256_mullo_epi32 (w10, _mm256_and_si256 (
+                      _mm256_srli_epi32 (p10, 8 * c), byte)),
+              _mm256_mullo_epi32 (w11, _mm256_and_si256 (
+                      _mm256_srli_epi32 (p11, 8 * c), byte))));
+      value = _mm256_srli_epi32 (_mm256_add_epi32 (value, half), 16);
+      out = _mm256_or_si256 (out, _mm256_slli_epi32 (value, 8 * c));
+    }
+    _mm256_storeu_si256 ((__m256i *) (dst + 4 * u),
+        _mm256_and_si256 (out, mask));
+  }
+
+  if (u < map->width) {
+    NvDsDewarpMap tail = *map;
+
+    /* Remaining pixels of the row, as a row of their own. */
+    tail.width = map->width - u;
+    tail.xy = (guint16 *) xy + 2 * u;
+    remap_row_scalar (&tail, 0, src, src_stride, dst + 4 * u);
+  }
+}
+#endif
+
+static RemapFunc remap_func;
+static const gchar *remap_func_name;
+
+static RemapFunc
+get_remap_func (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    remap_func = remap_row_scalar;
+    remap_func_name = "scalar";
+#ifdef DEWARP_X86
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2")) {
+      remap_func = remap_row_avx2;
+      remap_func_name = "avx2";
+    }
+#endif
+    g_once_init_leave (&init, 1);
+  }
+  return remap_func;
+}
+
+const gchar *
+nvds_dewarp_kernel_name (void)
+{
+  get_remap_func ();
+  return remap_func_name;
+}
+
+static void
+run_job (gpointer data, gpointer user_data)
+{
+  NvDsCpuDewarper *dewarper = (NvDsCpuDewarper *) user_data;
+  DewarpJob *job = (DewarpJob *) data;
+  NvDsDewarpMap *map = dewarper->maps[job->surface];
+  guint row;
+
+  if (dewarper->job_type == DEWARP_JOB_BUILD) {
+    build_map_rows (map, job->first_row, job->num_rows);
+  } else {
+    RemapFunc remap = get_remap_func ();
+    guint8 *dst = dewarper->dst[job->surface];
+    guint dst_stride = dewarper->dst_strides[job->surface];
+
+    for (row = job->first_row; row < job->first_row + job->num_rows; row++) {
+      remap (map, row, dewarper->src, dewarper->src_stride,
+          dst + (gsize) row * dst_stride);
+    }
+  }
+
+  g_mutex_lock (&dewarper->lock);
+  if (--dewarper->pending == 0)
+    g_cond_signal (&dewarper->done);
+  g_mutex_unlock (&dewarper->lock);
+}
+
+/**
+ * Run the jobs of @type of the surfaces set in the bit mask @surfaces on the
+ * pool and wait for them.
+ */
+static void
+run_jobs (NvDsCpuDewarper * dewarper, DewarpJobType type, guint surfaces)
+{
+  guint i;
+
+  dewarper->job_type = type;
+  dewarper->pending = 0;
+  for (i = 0; i < dewarper->num_jobs; i++) {
+    if (surfaces & (1u << dewarper->jobs[i].surface))
+      dewarper->pending++;
+  }
+  if (!dewarper->pending)
+    return;
+
+  for (i = 0; i < dewarper->num_jobs; i++) {
+    if (surfaces & (1u << dewarper->jobs[i].surface))
+      g_thread_pool_push (dewarper->pool, &dewarper->jobs[i], NULL);
+  }
+
+  g_mutex_lock (&dewarper->lock);
+  while (dewarper->pending)
+    g_cond_wait (&dewarper->done, &dewarper->lock);
+  g_mutex_unlock (&dewarper->lock);
+}
+
+NvDsCpuDewarper *
+nvds_cpu_dewarper_new (const gchar * config_file, guint src_width,
+    guint src_height, guint num_threads)
+{
+  NvDsCpuDewarper *dewarper = g_new0 (NvDsCpuDewarper, 1);
+  GError *error = NULL;
+  guint created = 0, num_created = 0;
+  guint i, row;
+
+  g_mutex_init (&dewarper->lock);
+  g_cond_init (&dewarper->done);
+  dewarper->src_width = src_width;
+  dewarper->src_height = src_height;
+
+  if (src_width < 2 || src_height < 2 ||
+      !nvds_dewarp_parse_surfaces (config_file, dewarper->surfaces,
+          &dewarper->num_surfaces)) {
+    goto error;
+  }
+  if (16 - (gint) g_bit_storage (MAX (src_width, src_height)) <
+      DEWARP_MIN_FRAC_BITS) {
+    NVGSTDS_ERR_MSG_V ("%ux%u is too large for the dewarp tables", src_width,
+        src_height);
+    goto error;
+  }
+
+  dewarper->pool = g_thread_pool_new (run_job, dewarper,
+      num_threads ? num_threads : g_get_num_processors (), FALSE, &error);
+  if (!dewarper->pool) {
+    NVGSTDS_ERR_MSG_V ("Failed to create dewarp threads: %s", error->message);
+    g_error_free (error);
+    goto error;
+  }
+
+  for (i = 0; i < dewarper->num_surfaces; i++) {
+    dewarper->num_jobs += (dewarper->surfaces[i].height +
+        DEWARP_ROWS_PER_JOB - 1) / DEWARP_ROWS_PER_JOB;
+  }
+
+  /* Bands of rows of all surfaces, so that surfaces of different sizes
+   * keep all threads busy. */
+  dewarper->jobs = g_new (DewarpJob, dewarper->num_jobs);
+  dewarper->num_jobs = 0;
+  for (i = 0; i < dewarper->num_surfaces; i++) {
+    guint height = dewarper->surfaces[i].height;
+
+    for (row = 0; row < height; row += DEWARP_ROWS_PER_JOB) {
+      DewarpJob *job = &dewarper->jobs[dewarper->num_jobs++];
+      job->surface = i;
+      job->first_row = row;
+      job->num_rows = MIN (DEWARP_ROWS_PER_JOB, height - row);
+    }
+  }
+
+  /* Tables of cameras with the same geometry are built once. The lock is
+   * held while building so that no other dewarper picks up a table that is
+   * not filled yet. */
+  g_mutex_lock (&cache_lock);
+  for (i = 0; i < dewarper->num_surfaces; i++) {
+    NvDsDewarpMapKey key;
+    gboolean is_new;
+
+    map_key_init (&key, &dewarper->surfaces[i], src_width, src_height);
+    dewarper->maps[i] = map_acquire_locked (&key, &is_new);
+    if (is_new) {
+      created |= 1u << i;
+      num_created++;
+    }
+  }
+  run_jobs (dewarper, DEWARP_JOB_BUILD, created);
+  g_mutex_unlock (&cache_lock);
+
+  GST_INFO ("CPU dewarper: %u surfaces, %u new tables, %s kernel",
+      dewarper->num_surfaces, num_created, nvds_dewarp_kernel_name ());
+  return dewarper;
+
+error:
+  nvds_cpu_dewarper_free (dewarper);
+  return NULL;
+}
+
+void
+nvds_cpu_dewarper_free (NvDsCpuDewarper * dewarper)
+{
+  guint i;
+
+  if (!dewarper)
+    return;
+
+  if (dewarper->pool)
+    g_thread_pool_free (dewarper->pool, FALSE, TRUE);
+  for (i = 0; i < NVDS_DEWARP_MAX_SURFACES; i++)
+    map_unref (dewarper->maps[i]);
+  g_free (dewarper->jobs);
+  g_mutex_clear (&dewarper->lock);
+  g_cond_clear (&dewarper->done);
+  g_free (dewarper);
+}
+
+guint
+nvds_cpu_dewarper_num_surfaces (NvDsCpuDewarper * dewarper)
+{
+  return dewarper->num_surfaces;
+}
+
+const NvDsDewarpSurface *
+nvds_cpu_dewarper_surface (NvDsCpuDewarper * dewarper, guint index)
+{
+  return index < dewarper->num_surfaces ? &dewarper->surfaces[index] : NULL;
+}
+
+void
+nvds_cpu_dewarper_process (NvDsCpuDewarper * dewarper, const guint8 * src,
+    guint src_stride, guint8 * const *dst, const guint * dst_strides)
+{
+  dewarper->src = src;
+  dewarper->src_stride = src_stride;
+  dewarper->dst = dst;
+  dewarper->dst_strides = dst_strides;
+  run_jobs (dewarper, DEWARP_JOB_REMAP, (1u << dewarper->num_surfaces) - 1);
+  dewarper->src = NULL;
+  dewarper->dst = NULL;
+}
+
+/** Load a binary (P6) PPM with a maxval of 255 as RGBA. */
+static guint8 *
+load_ppm (const gchar * path, guint * width, guint * height)
+{
+  gchar *contents = NULL;
+  gsize length, header, i;
+  guint maxval;
+  gint consumed = 0;
+  guint8 *rgba = NULL;
+
+  if (!g_file_get_contents (path, &contents, &length, NULL)) {
+    NVGSTDS_ERR_MSG_V ("Failed to read '%s'", path);
+    goto done;
+  }
+  if (sscanf (contents, "P6 %u %u %u%n", width, height, &maxval,
+          &consumed) != 3 || maxval != 255 || *width == 0 || *height == 0) {
+    NVGSTDS_ERR_MSG_V ("'%s' is not an 8 bit binary PPM", path);
+    goto done;
+  }
+  header = consumed + 1;
+  if (length < header + (gsize) *width * *height * 3) {
+    NVGSTDS_ERR_MSG_V ("'%s' is truncated", path);
+    goto done;
+  }
+
+  rgba = g_malloc ((gsize) *width * *height * 4);
+  for (i = 0; i < (gsize) *width * *height; i++) {
+    memcpy (rgba + 4 * i, contents + header + 3 * i, 3);
+    rgba[4 * i + 3] = 0xff;
+  }
+
+done:
+  g_free (contents);
+  return rgba;
+}
+
+static gboolean
+save_ppm (const gchar * path, const guint8 * rgba, guint width, guint height)
+{
+  gchar *header = g_strdup_printf ("P6\n%u %u\n255\n", width, height);
+  gsize header_size = strlen (header);
+  gchar *contents = g_malloc (header_size + (gsize) width * height * 3);
+  gboolean ret;
+  gsize i;
+
+  memcpy (contents, header, header_size);
+  for (i = 0; i < (gsize) width * height; i++)
+    memcpy (contents + header_size + 3 * i, rgba + 4 * i, 3);
+
+  ret = g_file_set_contents (path, contents,
+      header_size + (gsize) width * height * 3, NULL);
+  if (!ret)
+    NVGSTDS_ERR_MSG_V ("Failed to write '%s'", path);
+  g_free (header);
+  g_free (contents);
+  return ret;
+}
+
+/**
+ * Dewarp one image. The dewarper is kept in @dewarpers until all images are
+ * done, like the one of each source in a pipeline, so images with the same
+ * geometry share the remap tables.
+ */
+static gboolean
+dewarp_image (const gchar * config_file, const gchar * image_path,
+    GPtrArray * dewarpers)
+{
+  NvDsCpuDewarper *dewarper = NULL;
+  guint8 *src, *dst[NVDS_DEWARP_MAX_SURFACES] = { NULL };
+  guint dst_strides[NVDS_DEWARP_MAX_SURFACES];
+  guint width, height, i;
+  guint num_maps, num_maps_before;
+  gdouble elapsed;
+  gsize size;
+  gint64 start;
+  gboolean ret = FALSE;
+
+  src = load_ppm (image_path, &width, &height);
+  if (!src)
+    goto done;
+
+  nvds_dewarp_map_cache_size (&num_maps_before);
+  start = g_get_monotonic_time ();
+  dewarper = nvds_cpu_dewarper_new (config_file, width, height, 0);
+  if (!dewarper)
+    goto done;
+  g_ptr_array_add (dewarpers, dewarper);
+  elapsed = (g_get_monotonic_time () - start) / 1000.0;
+  size = nvds_dewarp_map_cache_size (&num_maps);
+  g_print ("Set up %u surfaces for %ux%u in %.1f ms, %u new remap tables, "
+      "%" G_GSIZE_FORMAT " KiB in total\n", dewarper->num_surfaces, width,
+      height, elapsed, num_maps - num_maps_before, size / 1024);
+
+  for (i = 0; i < dewarper->num_surfaces; i++) {
+    dst_strides[i] = 4 * dewarper->surfaces[i].width;
+    dst[i] = g_malloc ((gsize) dst_strides[i] * dewarper->surfaces[i].height);
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < DEWARP_BENCHMARK_FRAMES; i++)
+    nvds_cpu_dewarper_process (dewarper, src, 4 * width, dst, dst_strides);
+  g_print ("Dewarped in %.2f ms per frame (%s)\n",
+      (g_get_monotonic_time () - start) / 1000.0 / DEWARP_BENCHMARK_FRAMES,
+      nvds_dewarp_kernel_name ());
+
+  ret = TRUE;
+  for (i = 0; i < dewarper->num_surfaces && ret; i++) {
+    gchar *path = g_strdup_printf ("%s.surface%u.ppm", image_path, i);
+    ret = save_ppm (path, dst[i], dewarper->surfaces[i].width,
+        dewarper->surfaces[i].height);
+    if (ret)
+      g_print ("Wrote '%s'\n", path);
+    g_free (path);
+  }
+
+done:
+  for (i = 0; i < NVDS_DEWARP_MAX_SURFACES; i++)
+    g_free (dst[i]);
+  g_free (src);
+  return ret;
+}
+
+gboolean
+nvds_cpu_dewarp_images (const gchar * config_file, gchar ** image_paths)
+{
+  GPtrArray *dewarpers = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      nvds_cpu_dewarper_free);
+  gboolean ret = TRUE;
+  guint num_maps;
+  gsize size;
+  guint i;
+
+  for (i = 0; image_paths[i]; i++) {
+    if (!dewarp_image (config_file, image_paths[i], dewarpers))
+      ret = FALSE;
+  }
+
+  size = nvds_dewarp_map_cache_size (&num_maps);
+  g_print ("%u dewarpers share %u remap tables, %" G_GSIZE_FORMAT " KiB\n",
+      dewarpers->len, num_maps, size / 1024);
+  g_ptr_array_free (dewarpers, TRUE);
+  return ret;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_CPU_DEWARPER_H__
+#define __NVGSTDS_CPU_DEWARPER_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+/**
+ * CPU implementation of the fisheye dewarping done by the nvdewarper plugin,
+ * for hosts without a GPU and for regression tests of the surface
+ * definitions. The [surfaceN] groups of the dewarper config file are turned
+ * into remap tables once, which are then applied to RGBA frames with a
+ * bilinear gather, split by rows over a thread pool.
+ */
+
+#define NVDS_DEWARP_MAX_SURFACES 4
+
+#define NVDS_DEWARP_PROJECTION_PUSHBROOM 1
+#define NVDS_DEWARP_PROJECTION_VERTRADCYL 2
+
+/** One [surfaceN] group of the dewarper config file; angles in degrees. */
+typedef struct
+{
+  guint projection_type;
+  guint surface_index;
+  guint width;
+  guint height;
+  gdouble top_angle;
+  gdouble bottom_angle;
+  gdouble pitch;
+  gdouble yaw;
+  gdouble roll;
+  gdouble focal_length;
+} NvDsDewarpSurface;
+
+/** Geometry a remap table depends on; surfaces with equal keys share one. */
+typedef struct
+{
+  guint projection_type;
+  guint width;
+  guint height;
+  guint src_width;
+  guint src_height;
+  gdouble top_angle;
+  gdouble bottom_angle;
+  gdouble pitch;
+  gdouble yaw;
+  gdouble roll;
+  gdouble focal_length;
+} NvDsDewarpMapKey;
+
+/** Marks a pixel of a remap table outside of the source frame. */
+#define NVDS_DEWARP_MAP_INVALID 0xffff
+
+/**
+ * Source position of every pixel of a dewarped surface. Tables are shared
+ * process wide by all dewarpers with the same geometry, see
+ * nvds_dewarp_map_cache_size().
+ */
+typedef struct
+{
+  volatile gint ref_count;
+  NvDsDewarpMapKey key;
+  guint width;
+  guint height;
+  /** Fraction bits of the fixed point coordinates */
+  guint frac_bits;
+  /** x, y pairs of unsigned fixed point source coordinates; x is
+   * NVDS_DEWARP_MAP_INVALID where the pixel falls outside of the source. */
+  guint16 *xy;
+} NvDsDewarpMap;
+
+typedef struct _NvDsCpuDewarper NvDsCpuDewarper;
+
+/** Read the [surfaceN] groups of the nvdewarper config file @config_file. */
+gboolean nvds_dewarp_parse_surfaces (const gchar * config_file,
+    NvDsDewarpSurface * surfaces, guint * num_surfaces);
+
+/**
+ * Create a dewarper for @src_width x @src_height fisheye frames. @num_threads
+ * 0 uses one thread per processor.
+ */
+NvDsCpuDewarper *nvds_cpu_dewarper_new (const gchar * config_file,
+    guint src_width, guint src_height, guint num_threads);
+
+void nvds_cpu_dewarper_free (NvDsCpuDewarper * dewarper);
+
+guint nvds_cpu_dewarper_num_surfaces (NvDsCpuDewarper * dewarper);
+
+const NvDsDewarpSurface *nvds_cpu_dewarper_surface (NvDsCpuDewarper * dewarper,
+    guint index);
+
+/**
+ * Dewarp the RGBA frame @src into the RGBA surfaces @dst, whose strides
+ * (bytes) are @dst_strides. Strides must be multiples of 4.
+ */
+void nvds_cpu_dewarper_process (NvDsCpuDewarper * dewarper,
+    const guint8 * src, guint src_stride, guint8 * const *dst,
+    const guint * dst_strides);
+
+/**
+ * Unit line of sight, in the frame of the fisheye (z along the optical
+ * axis), seen at pixel position @u, @v of @surface.
+ */
+void nvds_dewarp_surface_ray (const NvDsDewarpSurface * surface, gdouble u,
+    gdouble v, gdouble * ray);
+
+const gchar *nvds_dewarp_kernel_name (void);
+
+/** Memory held by the shared remap tables, and their number. */
+gsize nvds_dewarp_map_cache_size (guint * num_maps);
+
+/**
+ * Dewarp the fisheye PPM images @image_paths with the surfaces of
+ * @config_file, write <image_path>.surfaceN.ppm and print the time taken.
+ * One dewarper per image is kept until the last one is done, as for the
+ * sources of a pipeline, so the remap tables shared between them show up.
+ */
+gboolean nvds_cpu_dewarp_images (const gchar * config_file,
+    gchar ** image_paths);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+
+#include "deepstream_common.h"
+#include "deepstream_debounce.h"
+
+void
+nvds_debouncer_init (NvDsDebouncer * debouncer, const guint * num_spots,
+    guint num_views, guint window, gboolean time_based)
+{
+  guint num_words, i;
+
+  memset (debouncer, 0, sizeof (NvDsDebouncer));
+  if (window > NVDS_DEBOUNCE_MAX_WINDOW) {
+    NVGSTDS_WARN_MSG_V ("Debounce window %u %s is too long, using %u",
+        window, time_based ? "ms" : "frames", NVDS_DEBOUNCE_MAX_WINDOW);
+    window = NVDS_DEBOUNCE_MAX_WINDOW;
+  }
+  /* A window of one frame passes every observation through. */
+  debouncer->window = window ? window : 1;
+  debouncer->time_based = time_based && window;
+  debouncer->num_views = num_views;
+
+  /* Views start on a word boundary of the bit sets. */
+  debouncer->offsets = g_new (guint, num_views + 1);
+  debouncer->offsets[0] = 0;
+  for (i = 0; i < num_views; i++) {
+    debouncer->offsets[i + 1] = debouncer->offsets[i] +
+        (num_spots[i] + 31) / 32 * 32;
+  }
+
+  num_words = debouncer->offsets[num_views] / 32;
+  debouncer->levels = g_new (guint16, debouncer->offsets[num_views]);
+  for (i = 0; i < debouncer->offsets[num_views]; i++)
+    debouncer->levels[i] = debouncer->window / 2;
+  debouncer->observed = g_new0 (guint32, num_words);
+  debouncer->state = g_new0 (guint32, num_words);
+  debouncer->decided = g_new0 (guint32, num_words);
+  debouncer->last_time = g_new0 (guint64, num_views);
+}
+
+void
+nvds_debouncer_clear (NvDsDebouncer * debouncer)
+{
+  g_free (debouncer->offsets);
+  g_free (debouncer->levels);
+  g_free (debouncer->observed);
+  g_free (debouncer->state);
+  g_free (debouncer->decided);
+  g_free (debouncer->last_time);
+  memset (debouncer, 0, sizeof (NvDsDebouncer));
+}
+
+/**
+ * Step the counters of 32 spots by @step towards 0 or @window. Returns the
+ * spots that reached @window in *@full and those at 0 in *@empty.
+ */
+static void
+step_levels (guint16 * levels, guint32 observed, guint step, guint window,
+    guint32 * full, guint32 * empty)
+{
+  guint32 at_window = 0, at_zero = 0;
+  guint i;
+
+  for (i = 0; i < 32; i++) {
+    guint level = levels[i];
+
+    if ((observed >> i) & 1)
+      level = MIN (level + step, window);
+    else
+      level = level > step ? level - step : 0;
+    levels[i] = level;
+    at_window |= (guint32) (level == window) << i;
+    at_zero |= (guint32) (level == 0) << i;
+  }
+  *full = at_window;
+  *empty = at_zero;
+}
+
+guint
+nvds_debouncer_update (NvDsDebouncer * debouncer, guint view,
+    const guint32 * observed, guint64 timestamp_ns)
+{
+  guint first = debouncer->offsets[view];
+  guint num_words = (debouncer->offsets[view + 1] - first) / 32;
+  guint32 *last_observed = debouncer->observed + first / 32;
+  guint32 *state = debouncer->state + first / 32;
+  guint32 *decided = debouncer->decided + first / 32;
+  guint64 last_time = debouncer->last_time[view];
+  guint raw_changes = 0;
+  guint step = 1;
+  guint w;
+
+  /* In time mode the first frame of a view, or a timestamp going back, only
+   * records the observation. */
+  if (debouncer->time_based) {
+    if (last_time == 0 || timestamp_ns < last_time)
+      step = 0;
+    else
+      step = MIN ((timestamp_ns - last_time) / GST_MSECOND,
+          (guint64) debouncer->window);
+  }
+
+  for (w = 0; w < num_words; w++) {
+    guint32 full, empty;
+
+    step_levels (debouncer->levels + first + 32 * w, observed[w], step,
+        debouncer->window, &full, &empty);
+    if (last_time)
+      raw_changes += __builtin_popcount (observed[w] ^ last_observed[w]);
+    last_observed[w] = observed[w];
+    state[w] = (state[w] | full) & ~empty;
+    decided[w] |= full | empty;
+  }
+
+  debouncer->last_time[view] = MAX (timestamp_ns, 1);
+  return raw_changes;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_DEBOUNCE_H__
+#define __NVGSTDS_DEBOUNCE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+/**
+ * Temporal filter of the spot occupancy. Every spot has a saturating
+ * counter between 0 and the window, which goes up while the spot is seen
+ * occupied and down while it is seen empty, by one per frame or by the ms
+ * elapsed since the previous frame of the view. A spot only becomes occupied
+ * when its counter reaches the window and only becomes empty when it
+ * reaches 0, so flicker shorter than the window never changes its state.
+ * Counters start half way, and a spot has no state until it reaches either
+ * end once.
+ *
+ * The counters and state bit sets of all views are packed in single
+ * arrays, only touched by the streaming thread, so no locking is needed.
+ */
+
+/** Largest window, in frames or ms */
+#define NVDS_DEBOUNCE_MAX_WINDOW G_MAXUINT16
+
+typedef struct
+{
+  guint window;
+  gboolean time_based;
+  guint num_views;
+  /** First spot of each view, multiples of 32; [num_views + 1] */
+  guint *offsets;
+  guint16 *levels;
+  /** Bit sets, word offsets[v] / 32 is the first one of view v */
+  guint32 *observed;
+  guint32 *state;
+  guint32 *decided;
+  /** Timestamp (ns) of the last update of each view, 0 if none */
+  guint64 *last_time;
+} NvDsDebouncer;
+
+/**
+ * Set up @debouncer for @num_views views of @num_spots[v] spots. @window
+ * is a number of frames, or of ms if @time_based; 0 disables filtering.
+ */
+void nvds_debouncer_init (NvDsDebouncer * debouncer, const guint * num_spots,
+    guint num_views, guint window, gboolean time_based);
+
+void nvds_debouncer_clear (NvDsDebouncer * debouncer);
+
+/**
+ * Feed the occupancy @observed of the spots of @view, seen at
+ * @timestamp_ns, to the filter. Returns the number of spots whose observed
+ * occupancy changed since the previous update, confirmed or not.
+ */
+guint nvds_debouncer_update (NvDsDebouncer * debouncer, guint view,
+    const guint32 * observed, guint64 timestamp_ns);
+
+/** Confirmed occupancy of the spots of @view. */
+static inline const guint32 *
+nvds_debouncer_state (const NvDsDebouncer * debouncer, guint view)
+{
+  return debouncer->state + debouncer->offsets[view] / 32;
+}
+
+/** Spots of @view whose occupancy has been confirmed at least once. */
+static inline const guint32 *
+nvds_debouncer_decided (const NvDsDebouncer * debouncer, guint view)
+{
+  return debouncer->decided + debouncer->offsets[view] / 32;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "deepstream_common.h"
+#include "deepstream_homography.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HOMOGRAPHY_X86 1
+#endif
+
+typedef void (*ProjectFunc) (const gfloat * h, const gfloat * x,
+    const gfloat * y, gfloat * world_x, gfloat * world_y, guint n);
+
+static void
+project_scalar (const gfloat * h, const gfloat * x, const gfloat * y,
+    gfloat * world_x, gfloat * world_y, guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    gfloat w = h[6] * x[i] + h[7] * y[i] + h[8];
+    world_x[i] = (h[0] * x[i] + h[1] * y[i] + h[2]) / w;
+    world_y[i] = (h[3] * x[i] + h[4] * y[i] + h[5]) / w;
+  }
+}
+
+#ifdef HOMOGRAPHY_X86
+__attribute__ ((target ("sse2")))
+static void
+project_sse2 (const gfloat * h, const gfloat * x, const gfloat * y,
+    gfloat * world_x, gfloat * world_y, guint n)
+{
+  __m128 h0 = _mm_set1_ps (h[0]), h1 = _mm_set1_ps (h[1]);
+  __m128 h2 = _mm_set1_ps (h[2]), h3 = _mm_set1_ps (h[3]);
+  __m128 h4 = _mm_set1_ps (h[4]), h5 = _mm_set1_ps (h[5]);
+  __m128 h6 = _mm_set1_ps (h[6]), h7 = _mm_set1_ps (h[7]);
+  __m128 h8 = _mm_set1_ps (h[8]);
+  guint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128 vx = _mm_loadu_ps (x + i);
+    __m128 vy = _mm_loadu_ps (y + i);
+    __m128 w = _mm_add_ps (_mm_add_ps (_mm_mul_ps (h6, vx),
+            _mm_mul_ps (h7, vy)), h8);
+    __m128 px = _mm_add_ps (_mm_add_ps (_mm_mul_ps (h0, vx),
+            _mm_mul_ps (h1, vy)), h2);
+    __m128 py = _mm_add_ps (_mm_add_ps (_mm_mul_ps (h3, vx),
+            _mm_mul_ps (h4, vy)), h5);
+    _mm_storeu_ps (world_x + i, _mm_div_ps (px, w));
+    _mm_storeu_ps (world_y + i, _mm_div_ps (py, w));
+  }
+  project_scalar (h, x + i, y + i, world_x + i, world_y + i, n - i);
+}
+
+__attribute__ ((target ("avx2,fma")))
+static void
+project_avx2 (const gfloat * h, const gfloat * x, const gfloat * y,
+    gfloat * world_x, gfloat * world_y, guint n)
+{
+  __m256 h0 = _mm256_set1_ps (h[0]), h1 = _mm256_set1_ps (h[1]);
+  __m256 h2 = _mm256_set1_ps (h[2]), h3 = _mm256_set1_ps (h[3]);
+  __m256 h4 = _mm256_set1_ps (h[4]), h5 = _mm256_set1_ps (h[5]);
+  __m256 h6 = _mm256_set1_ps (h[6]), h7 = _mm256_set1_ps (h[7]);
+  __m256 h8 = _mm256_set1_ps (h[8]);
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256 vx = _mm256_loadu_ps (x + i);
+    __m256 vy = _mm256_loadu_ps (y + i);
+    __m256 w = _mm256_fmadd_ps (h6, vx, _mm256_fmadd_ps (h7, vy, h8));
+    __m256 px = _mm256_fmadd_ps (h0, vx, _mm256_fmadd_ps (h1, vy, h2));
+    __m256 py = _mm256_fmadd_ps (h3, vx, _mm256_fmadd_ps (h4, vy, h5));
+    _mm256_storeu_ps (world_x + i, _mm256_div_ps (px, w));
+    _mm256_storeu_ps (world_y + i, _mm256_div_ps (py, w));
+  }
+  /* The compiler does not clear the upper halves before the tail call, and
+   * the legacy SSE code of project_sse2 would pay for the transition. */
+  _mm256_zeroupper ();
+  project_sse2 (h, x + i, y + i, world_x + i, world_y + i, n - i);
+}
+#endif
+
+/** Image points per aisle projected by the benchmark */
+#define BENCHMARK_POINTS_PER_AISLE 256
+#define BENCHMARK_ITERATIONS 2000
+/** Largest distance (world units) allowed between the results of a vector
+ * kernel and the scalar one */
+#define BENCHMARK_KERNEL_TOLERANCE 1e-3
+
+#define MAX_KERNELS 3
+
+typedef struct
+{
+  const gchar *name;
+  ProjectFunc func;
+} Kernel;
+
+/** Fill @kernels with those this CPU supports, fastest last. */
+static guint
+get_kernels (Kernel * kernels)
+{
+  guint n = 0;
+
+  kernels[n].name = "scalar";
+  kernels[n++].func = project_scalar;
+#ifdef HOMOGRAPHY_X86
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("sse2")) {
+    kernels[n].name = "sse2";
+    kernels[n++].func = project_sse2;
+  }
+  if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma")) {
+    kernels[n].name = "avx2";
+    kernels[n++].func = project_avx2;
+  }
+#endif
+  return n;
+}
+
+static ProjectFunc project_func;
+static const gchar *project_func_name;
+
+static ProjectFunc
+get_project_func (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    Kernel kernels[MAX_KERNELS];
+    guint n = get_kernels (kernels);
+
+    project_func = kernels[n - 1].func;
+    project_func_name = kernels[n - 1].name;
+    g_once_init_leave (&init, 1);
+  }
+  return project_func;
+}
+
+const gchar *
+nvds_homography_kernel_name (void)
+{
+  get_project_func ();
+  return project_func_name;
+}
+
+static void
+to_float (const gdouble * homography, gfloat * h)
+{
+  guint i;
+
+  for (i = 0; i < 9; i++)
+    h[i] = (gfloat) homography[i];
+}
+
+void
+nvds_homography_project (const gdouble * homography, const gfloat * x,
+    const gfloat * y, gfloat * world_x, gfloat * world_y, guint n)
+{
+  gfloat h[9];
+
+  to_float (homography, h);
+  get_project_func () (h, x, y, world_x, world_y, n);
+}
+
+void
+nvds_point_batch_init (NvDsPointBatch * batch)
+{
+  memset (batch, 0, sizeof (NvDsPointBatch));
+}
+
+void
+nvds_point_batch_free (NvDsPointBatch * batch)
+{
+  g_free (batch->x);
+  g_free (batch->y);
+  g_free (batch->world_x);
+  g_free (batch->world_y);
+  g_free (batch->runs);
+  nvds_point_batch_init (batch);
+}
+
+void
+nvds_point_batch_begin_run (NvDsPointBatch * batch,
+    const gdouble * homography)
+{
+  NvDsHomographyRun *run;
+
+  if (batch->num_runs == batch->run_capacity) {
+    batch->run_capacity = MAX (16, batch->run_capacity * 2);
+    batch->runs = g_renew (NvDsHomographyRun, batch->runs,
+        batch->run_capacity);
+  }
+  run = &batch->runs[batch->num_runs++];
+  run->homography = homography;
+  run->first = batch->count;
+  run->count = 0;
+}
+
+guint
+nvds_point_batch_add (NvDsPointBatch * batch, gfloat x, gfloat y)
+{
+  if (batch->count == batch->capacity) {
+    batch->capacity = MAX (64, batch->capacity * 2);
+    batch->x = g_renew (gfloat, batch->x, batch->capacity);
+    batch->y = g_renew (gfloat, batch->y, batch->capacity);
+    batch->world_x = g_renew (gfloat, batch->world_x, batch->capacity);
+    batch->world_y = g_renew (gfloat, batch->world_y, batch->capacity);
+  }
+  batch->x[batch->count] = x;
+  batch->y[batch->count] = y;
+  batch->runs[batch->num_runs - 1].count++;
+  return batch->count++;
+}
+
+void
+nvds_homography_project_batch (NvDsPointBatch * batch)
+{
+  guint i;
+
+  for (i = 0; i < batch->num_runs; i++) {
+    const NvDsHomographyRun *run = &batch->runs[i];
+    if (run->count == 0)
+      continue;
+    nvds_homography_project (run->homography, batch->x + run->first,
+        batch->y + run->first, batch->world_x + run->first,
+        batch->world_y + run->first, run->count);
+  }
+}
+
+gdouble
+nvds_homography_reprojection_error (const NvDsAisleCalibRecord * record)
+{
+  const gdouble *h = record->homography;
+  gdouble error = 0;
+  guint i;
+
+  for (i = 0; i < NVDS_CALIB_QUAD_POINTS; i++) {
+    gdouble x = record->image_points[2 * i];
+    gdouble y = record->image_points[2 * i + 1];
+    gdouble w = h[6] * x + h[7] * y + h[8];
+    gdouble dx = (h[0] * x + h[1] * y + h[2]) / w -
+        record->world_points[2 * i];
+    gdouble dy = (h[3] * x + h[4] * y + h[5]) / w -
+        record->world_points[2 * i + 1];
+    error = MAX (error, sqrt (dx * dx + dy * dy));
+  }
+  return error;
+}
+
+/** Largest distance between the points of two projections. */
+static gdouble
+max_distance (const gfloat * x0, const gfloat * y0, const gfloat * x1,
+    const gfloat * y1, guint n)
+{
+  gdouble distance = 0;
+  guint i;
+
+  for (i = 0; i < n; i++)
+    distance = MAX (distance, hypot (x0[i] - x1[i], y0[i] - y1[i]));
+  return distance;
+}
+
+gboolean
+nvds_homography_benchmark (const gchar * path)
+{
+  NvDsCalibration *calib = nvds_calibration_acquire (path,
+      NVDS_CALIB_KIND_AISLE);
+  const NvDsAisleCalibRecord *records;
+  Kernel kernels[MAX_KERNELS];
+  guint num_kernels = get_kernels (kernels);
+  gfloat *h = NULL, *x = NULL, *y, *world_x, *world_y, *ref_x, *ref_y;
+  gdouble csv_error = 0, kernel_error, ns;
+  gboolean ret = FALSE;
+  guint num_points, i, j, k, n;
+  gint64 start;
+
+  if (!calib)
+    goto done;
+
+  records = nvds_calibration_aisles (calib);
+  num_points = calib->num_records * BENCHMARK_POINTS_PER_AISLE;
+  h = g_new (gfloat, 9 * calib->num_records);
+  x = g_new (gfloat, 6 * num_points);
+  y = x + num_points;
+  world_x = y + num_points;
+  world_y = world_x + num_points;
+  ref_x = world_y + num_points;
+  ref_y = ref_x + num_points;
+
+  /* The cx* / cy* reference points of each aisle, repeated. */
+  for (i = 0; i < calib->num_records; i++) {
+    to_float (records[i].homography, h + 9 * i);
+    for (j = 0; j < BENCHMARK_POINTS_PER_AISLE; j++) {
+      k = j % NVDS_CALIB_QUAD_POINTS;
+      x[i * BENCHMARK_POINTS_PER_AISLE + j] = records[i].image_points[2 * k];
+      y[i * BENCHMARK_POINTS_PER_AISLE + j] =
+          records[i].image_points[2 * k + 1];
+    }
+  }
+
+  /* The scalar kernel must land on the gx* / gy* points of the CSV, and the
+   * others on the results of the scalar kernel. */
+  for (i = 0; i < calib->num_records; i++) {
+    guint first = i * BENCHMARK_POINTS_PER_AISLE;
+
+    project_scalar (h + 9 * i, x + first, y + first, ref_x + first,
+        ref_y + first, BENCHMARK_POINTS_PER_AISLE);
+    for (j = 0; j < BENCHMARK_POINTS_PER_AISLE; j++) {
+      k = j % NVDS_CALIB_QUAD_POINTS;
+      csv_error = MAX (csv_error, hypot (ref_x[first + j] -
+              records[i].world_points[2 * k], ref_y[first + j] -
+              records[i].world_points[2 * k + 1]));
+    }
+  }
+  if (!(csv_error <= NVDS_CALIB_MAX_REPROJECTION_ERROR)) {
+    NVGSTDS_ERR_MSG_V ("Projected reference points are off by %.3f from the "
+        "world points of '%s'", csv_error, path);
+    goto done;
+  }
+
+  g_print ("Homography of %u aisles, %u points each, %.4f off the world "
+      "points of the CSV:\n", calib->num_records, BENCHMARK_POINTS_PER_AISLE,
+      csv_error);
+  for (k = 0; k < num_kernels; k++) {
+    for (i = 0; i < calib->num_records; i++) {
+      guint first = i * BENCHMARK_POINTS_PER_AISLE;
+      kernels[k].func (h + 9 * i, x + first, y + first, world_x + first,
+          world_y + first, BENCHMARK_POINTS_PER_AISLE);
+    }
+    kernel_error = max_distance (world_x, world_y, ref_x, ref_y, num_points);
+    if (!(kernel_error <= BENCHMARK_KERNEL_TOLERANCE)) {
+      NVGSTDS_ERR_MSG_V ("%s kernel is off by %g from the scalar one",
+          kernels[k].name, kernel_error);
+      goto done;
+    }
+
+    start = g_get_monotonic_time ();
+    for (n = 0; n < BENCHMARK_ITERATIONS; n++) {
+      for (i = 0; i < calib->num_records; i++) {
+        guint first = i * BENCHMARK_POINTS_PER_AISLE;
+        kernels[k].func (h + 9 * i, x + first, y + first, world_x + first,
+            world_y + first, BENCHMARK_POINTS_PER_AISLE);
+      }
+    }
+    ns = (g_get_monotonic_time () - start) * 1000.0 /
+        ((gdouble) BENCHMARK_ITERATIONS * num_points);
+    g_print ("  %-6s %6.2f ns/point, %.2g off the scalar kernel%s\n",
+        kernels[k].name, ns, kernel_error,
+        kernels[k].func == get_project_func () ? " (selected)" : "");
+  }
+
+  ret = TRUE;
+done:
+  g_free (h);
+  g_free (x);
+  nvds_calibration_unref (calib);
+  return ret;
+}
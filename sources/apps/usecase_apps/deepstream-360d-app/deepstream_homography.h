@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_HOMOGRAPHY_H__
+#define __NVGSTDS_HOMOGRAPHY_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#include "deepstream_calibration.h"
+
+/** Points [first, first + count) of a batch share one homography. */
+typedef struct
+{
+  const gdouble *homography;
+  guint first;
+  guint count;
+} NvDsHomographyRun;
+
+/**
+ * Structure of arrays of image points of a whole batch, projected to world
+ * coordinates in one pass by nvds_homography_project_batch().
+ */
+typedef struct
+{
+  guint count;
+  guint capacity;
+  gfloat *x;
+  gfloat *y;
+  gfloat *world_x;
+  gfloat *world_y;
+
+  guint num_runs;
+  guint run_capacity;
+  NvDsHomographyRun *runs;
+} NvDsPointBatch;
+
+void nvds_point_batch_init (NvDsPointBatch * batch);
+
+void nvds_point_batch_free (NvDsPointBatch * batch);
+
+static inline void
+nvds_point_batch_reset (NvDsPointBatch * batch)
+{
+  batch->count = 0;
+  batch->num_runs = 0;
+}
+
+/** Start a run of points projected with the row major 3x3 @homography. */
+void nvds_point_batch_begin_run (NvDsPointBatch * batch,
+    const gdouble * homography);
+
+/** Append a point to the current run and return its index in the batch. */
+guint nvds_point_batch_add (NvDsPointBatch * batch, gfloat x, gfloat y);
+
+void nvds_homography_project_batch (NvDsPointBatch * batch);
+
+/**
+ * Project @n points with one homography, including the perspective divide.
+ * Uses AVX2 or SSE2 when the CPU supports it.
+ */
+void nvds_homography_project (const gdouble * homography, const gfloat * x,
+    const gfloat * y, gfloat * world_x, gfloat * world_y, guint n);
+
+/** Name of the kernel selected for this CPU. */
+const gchar *nvds_homography_kernel_name (void);
+
+/**
+ * Largest distance between the projected cx* / cy* reference points of
+ * @record and its gx* / gy* world points.
+ */
+gdouble nvds_homography_reprojection_error (const NvDsAisleCalibRecord *
+    record);
+
+/**
+ * Check every kernel this CPU supports on the reference points of the aisle
+ * calibration @path, the scalar one against the world points of the file and
+ * the others against the scalar one, and print the cost per point of each.
+ */
+gboolean nvds_homography_benchmark (const gchar * path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
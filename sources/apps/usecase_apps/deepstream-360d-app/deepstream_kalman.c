@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include "deepstream_kalman.h"
+
+#define NS_PER_MS 1000000
+#define KALMAN_MIN_CAPACITY 64
+/** Variance of the velocity of a new track, i.e. up to about 10 units/s */
+#define KALMAN_INITIAL_VELOCITY_VAR 100.0f
+
+struct _NvDsKalmanTable
+{
+  gfloat process_noise;
+  gfloat measurement_var;
+  guint64 max_age;
+
+  /** Linear probing, capacity a power of 2 at most half full */
+  NvDsKalmanTrack *tracks;
+  guint capacity;
+  guint size;
+};
+
+static inline guint
+home_slot (const NvDsKalmanTable * table, guint source, guint64 tracking_id)
+{
+  guint64 h = tracking_id ^ ((guint64) source << 48);
+
+  /* splitmix64 finalizer */
+  h ^= h >> 30;
+  h *= G_GUINT64_CONSTANT (0xbf58476d1ce4e5b9);
+  h ^= h >> 27;
+  h *= G_GUINT64_CONSTANT (0x94d049bb133111eb);
+  h ^= h >> 31;
+  return (guint) h & (table->capacity - 1);
+}
+
+NvDsKalmanTable *
+nvds_kalman_table_new (gfloat process_noise, gfloat measurement_noise,
+    guint max_age_ms)
+{
+  NvDsKalmanTable *table = g_new0 (NvDsKalmanTable, 1);
+
+  table->process_noise = process_noise;
+  table->measurement_var = measurement_noise * measurement_noise;
+  table->max_age = (guint64) max_age_ms * NS_PER_MS;
+  table->capacity = KALMAN_MIN_CAPACITY;
+  table->tracks = g_new0 (NvDsKalmanTrack, table->capacity);
+  return table;
+}
+
+void
+nvds_kalman_table_free (NvDsKalmanTable * table)
+{
+  if (!table)
+    return;
+
+  g_free (table->tracks);
+  g_free (table);
+}
+
+guint
+nvds_kalman_table_size (NvDsKalmanTable * table)
+{
+  return table->size;
+}
+
+static NvDsKalmanTrack *
+find_slot (NvDsKalmanTable * table, guint source, guint64 tracking_id)
+{
+  guint mask = table->capacity - 1;
+  guint i = home_slot (table, source, tracking_id);
+
+  while (table->tracks[i].used && (table->tracks[i].tracking_id != tracking_id
+          || table->tracks[i].source != source))
+    i = (i + 1) & mask;
+  return &table->tracks[i];
+}
+
+static void
+grow (NvDsKalmanTable * table)
+{
+  NvDsKalmanTrack *old = table->tracks;
+  guint old_capacity = table->capacity;
+  guint i;
+
+  table->capacity *= 2;
+  table->tracks = g_new0 (NvDsKalmanTrack, table->capacity);
+  for (i = 0; i < old_capacity; i++) {
+    if (old[i].used)
+      *find_slot (table, old[i].source, old[i].tracking_id) = old[i];
+  }
+  g_free (old);
+}
+
+/**
+ * Empty slot @i, moving back the following entries of its cluster that
+ * would no longer be found past the hole.
+ */
+static void
+remove_slot (NvDsKalmanTable * table, guint i)
+{
+  guint mask = table->capacity - 1;
+  guint j = i;
+
+  for (;;) {
+    guint k;
+
+    j = (j + 1) & mask;
+    if (!table->tracks[j].used)
+      break;
+    k = home_slot (table, table->tracks[j].source,
+        table->tracks[j].tracking_id);
+    /* Move the entry unless its home lies cyclically in (i, j]. */
+    if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+      table->tracks[i] = table->tracks[j];
+      i = j;
+    }
+  }
+  table->tracks[i].used = FALSE;
+  table->size--;
+}
+
+const NvDsKalmanTrack *
+nvds_kalman_table_update (NvDsKalmanTable * table, guint source,
+    guint64 tracking_id, gfloat x, gfloat y, guint64 timestamp_ns)
+{
+  NvDsKalmanTrack *track;
+  gfloat dt, q, s, k_pos, k_vel, dx, dy, p_cross;
+
+  if (2 * (table->size + 1) > table->capacity)
+    grow (table);
+
+  track = find_slot (table, source, tracking_id);
+  if (!track->used || timestamp_ns > track->timestamp + table->max_age) {
+    if (!track->used)
+      table->size++;
+    track->used = TRUE;
+    track->source = source;
+    track->tracking_id = tracking_id;
+    track->timestamp = timestamp_ns;
+    track->x = x;
+    track->y = y;
+    track->vx = track->vy = 0;
+    track->p_pos = table->measurement_var;
+    track->p_cross = 0;
+    track->p_vel = KALMAN_INITIAL_VELOCITY_VAR;
+    return track;
+  }
+
+  /* Same frame seen again, or out of order. */
+  if (timestamp_ns <= track->timestamp)
+    return track;
+
+  /* Predict: x += v dt, P = F P F' + Q. */
+  dt = (gfloat) ((timestamp_ns - track->timestamp) / 1e9);
+  q = table->process_noise;
+  track->x += track->vx * dt;
+  track->y += track->vy * dt;
+  track->p_pos += dt * (2 * track->p_cross + dt * track->p_vel) +
+      q * dt * dt * dt / 3;
+  track->p_cross += dt * track->p_vel + q * dt * dt / 2;
+  track->p_vel += q * dt;
+
+  /* Update with the measured position. */
+  s = track->p_pos + table->measurement_var;
+  k_pos = track->p_pos / s;
+  k_vel = track->p_cross / s;
+  dx = x - track->x;
+  dy = y - track->y;
+  track->x += k_pos * dx;
+  track->y += k_pos * dy;
+  track->vx += k_vel * dx;
+  track->vy += k_vel * dy;
+  p_cross = track->p_cross;
+  track->p_vel -= k_vel * p_cross;
+  track->p_cross -= k_pos * p_cross;
+  track->p_pos -= k_pos * track->p_pos;
+  track->timestamp = timestamp_ns;
+  return track;
+}
+
+void
+nvds_kalman_table_expire (NvDsKalmanTable * table, guint64 now_ns)
+{
+  guint i = 0;
+
+  /* A removal may move a later entry into slot i, which is then checked
+   * again. */
+  while (i < table->capacity) {
+    const NvDsKalmanTrack *track = &table->tracks[i];
+
+    if (track->used && track->timestamp + table->max_age < now_ns)
+      remove_slot (table, i);
+    else
+      i++;
+  }
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_KALMAN_H__
+#define __NVGSTDS_KALMAN_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <math.h>
+#include <gst/gst.h>
+
+/**
+ * Constant-velocity Kalman filters of the world positions of tracks, for
+ * smoothed speed and heading. The process noise is white acceleration and
+ * the measurement noise isotropic, so both axes share one 2x2 covariance.
+ * The tracks live in an open-addressing table of fixed-size entries.
+ */
+
+#define NVDS_KALMAN_DEFAULT_PROCESS_NOISE 1.0
+#define NVDS_KALMAN_DEFAULT_MEASUREMENT_NOISE 0.3
+#define NVDS_KALMAN_DEFAULT_MAX_AGE 2000
+
+typedef struct
+{
+  guint64 tracking_id;
+  guint source;
+  gboolean used;
+  /** Timestamp (ns) of the last position */
+  guint64 timestamp;
+  /** Position and velocity per second, in world units */
+  gfloat x;
+  gfloat y;
+  gfloat vx;
+  gfloat vy;
+  /** Position and velocity covariance of each axis */
+  gfloat p_pos;
+  gfloat p_cross;
+  gfloat p_vel;
+} NvDsKalmanTrack;
+
+typedef struct _NvDsKalmanTable NvDsKalmanTable;
+
+/**
+ * @process_noise: spectral density of the acceleration, in units^2/s^3.
+ * @measurement_noise: standard deviation of a position, in world units.
+ * @max_age_ms: time after which a track that was not seen is forgotten.
+ */
+NvDsKalmanTable *nvds_kalman_table_new (gfloat process_noise,
+    gfloat measurement_noise, guint max_age_ms);
+
+void nvds_kalman_table_free (NvDsKalmanTable * table);
+
+/**
+ * Filter the position @x, @y of track @tracking_id of @source, seen at
+ * @timestamp_ns. The pointer is valid until the next call.
+ */
+const NvDsKalmanTrack *nvds_kalman_table_update (NvDsKalmanTable * table,
+    guint source, guint64 tracking_id, gfloat x, gfloat y,
+    guint64 timestamp_ns);
+
+/** Forget the tracks not seen for the maximum age before @now_ns. */
+void nvds_kalman_table_expire (NvDsKalmanTable * table, guint64 now_ns);
+
+guint nvds_kalman_table_size (NvDsKalmanTable * table);
+
+/** World units per second */
+static inline gfloat
+nvds_kalman_track_speed (const NvDsKalmanTrack * track)
+{
+  return sqrtf (track->vx * track->vx + track->vy * track->vy);
+}
+
+/** Degrees counterclockwise from the world x axis, in [0, 360) */
+static inline gfloat
+nvds_kalman_track_heading (const NvDsKalmanTrack * track)
+{
+  gfloat heading = atan2f (track->vy, track->vx) * (gfloat) (180 / G_PI);
+
+  return heading < 0 ? heading + 360 : heading;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+#include <lz4.h>
+#include <lz4hc.h>
+#include <zstd.h>
+
+#include "gstnvdsmeta.h"
+#include "deepstream_msgbatch.h"
+#include "deepstream_payload.h"
+#include "deepstream_wire.h"
+
+struct _NvDsMsgBatcher
+{
+  NvDsMsgBatchConfig *config;
+  /** Messages of the frame being filled, as laid out in its body */
+  GString *body;
+  guint num_messages;
+  /** Monotonic time the first of them arrived, and the buffer did, in us */
+  gint64 first_time;
+  gint64 now;
+
+  /* Reused from frame to frame. */
+  GString *frame;
+  gchar *compressed;
+  gsize compressed_capacity;
+  ZSTD_CCtx *zstd;
+  /** Frames to attach to the buffer */
+  GPtrArray *frames;
+
+  GMutex lock;
+  NvDsMsgBatchStats stats;
+};
+
+const gchar *
+nvds_msg_codec_name (NvDsWireCodec codec)
+{
+  switch (codec) {
+    case NVDS_WIRE_CODEC_LZ4:
+      return "lz4";
+    case NVDS_WIRE_CODEC_ZSTD:
+      return "zstd";
+    default:
+      return "none";
+  }
+}
+
+NvDsMsgBatcher *
+nvds_msg_batcher_new (NvDsMsgBatchConfig * config)
+{
+  NvDsMsgBatcher *batcher = g_new0 (NvDsMsgBatcher, 1);
+
+  batcher->config = config;
+  batcher->body = g_string_sized_new (config->max_size + 64);
+  batcher->frame = g_string_sized_new (config->max_size + 64);
+  if (config->codec == NVDS_WIRE_CODEC_ZSTD)
+    batcher->zstd = ZSTD_createCCtx ();
+  batcher->frames = g_ptr_array_new ();
+  g_mutex_init (&batcher->lock);
+  return batcher;
+}
+
+void
+nvds_msg_batcher_free (NvDsMsgBatcher * batcher)
+{
+  if (!batcher)
+    return;
+
+  /* Messages still waiting are dropped with the pipeline. */
+  g_string_free (batcher->body, TRUE);
+  g_string_free (batcher->frame, TRUE);
+  g_free (batcher->compressed);
+  ZSTD_freeCCtx (batcher->zstd);
+  g_ptr_array_free (batcher->frames, TRUE);
+  g_mutex_clear (&batcher->lock);
+  g_free (batcher);
+}
+
+/**
+ * Compress the body of the frame into compressed. Returns the compressed
+ * size, or 0 if it failed or did not make the body smaller.
+ */
+static gsize
+compress_body (NvDsMsgBatcher * batcher)
+{
+  NvDsMsgBatchConfig *config = batcher->config;
+  GString *body = batcher->body;
+  gsize bound, size = 0;
+
+  if (config->codec == NVDS_WIRE_CODEC_LZ4)
+    bound = LZ4_compressBound (body->len);
+  else if (config->codec == NVDS_WIRE_CODEC_ZSTD && batcher->zstd)
+    bound = ZSTD_compressBound (body->len);
+  else
+    return 0;
+
+  if (bound > batcher->compressed_capacity) {
+    batcher->compressed_capacity = MAX (bound, 2 *
+        batcher->compressed_capacity);
+    batcher->compressed = (gchar *) g_realloc (batcher->compressed,
+        batcher->compressed_capacity);
+  }
+
+  if (config->codec == NVDS_WIRE_CODEC_LZ4) {
+    /* Negative levels trade ratio for speed, levels above 1 use LZ4HC. */
+    if (config->level > 1) {
+      size = LZ4_compress_HC (body->str, batcher->compressed, body->len,
+          bound, config->level);
+    } else {
+      size = LZ4_compress_fast (body->str, batcher->compressed, body->len,
+          bound, config->level < 0 ? -config->level : 1);
+    }
+  } else {
+    size = ZSTD_compressCCtx (batcher->zstd, batcher->compressed, bound,
+        body->str, body->len, config->level);
+    if (ZSTD_isError (size))
+      size = 0;
+  }
+  return size < body->len ? size : 0;
+}
+
+/** Send the frame being filled. @full if it holds max-size bytes. */
+static void
+flush_frame (NvDsMsgBatcher * batcher, gint64 now, gboolean full)
+{
+  GString *frame = batcher->frame;
+  gchar header[NVDS_WIRE_HEADER_SIZE] = NVDS_WIRE_FRAME_MAGIC;
+  gsize compressed_size = compress_body (batcher);
+  NvDsWireCodec codec = compressed_size ? batcher->config->codec :
+      NVDS_WIRE_CODEC_NONE;
+
+  header[4] = NVDS_WIRE_FRAME_VERSION;
+  header[5] = (gchar) codec;
+
+  g_string_truncate (frame, 0);
+  g_string_append_len (frame, header, NVDS_WIRE_HEADER_SIZE);
+  nvds_wire_append_varint (frame, batcher->num_messages);
+  nvds_wire_append_varint (frame, batcher->body->len);
+  if (compressed_size)
+    g_string_append_len (frame, batcher->compressed, compressed_size);
+  else
+    g_string_append_len (frame, batcher->body->str, batcher->body->len);
+  g_ptr_array_add (batcher->frames, nvds_payload_new (frame->str, frame->len,
+          batcher->config->comp_id));
+
+  g_mutex_lock (&batcher->lock);
+  batcher->stats.messages += batcher->num_messages;
+  batcher->stats.frames++;
+  if (full)
+    batcher->stats.full_frames++;
+  batcher->stats.message_bytes += batcher->body->len;
+  batcher->stats.frame_bytes += frame->len;
+  batcher->stats.linger_us += now - batcher->first_time;
+  g_mutex_unlock (&batcher->lock);
+
+  g_string_truncate (batcher->body, 0);
+  batcher->num_messages = 0;
+}
+
+static void
+add_message (const NvDsPayload * payload, gpointer user_data)
+{
+  NvDsMsgBatcher *batcher = (NvDsMsgBatcher *) user_data;
+  guint max_size = batcher->config->max_size;
+  gint64 now = batcher->now;
+
+  /* A message larger than max-size gets a frame of its own. */
+  if (batcher->num_messages &&
+      batcher->body->len + payload->payloadSize > max_size)
+    flush_frame (batcher, now, TRUE);
+
+  if (!batcher->num_messages)
+    batcher->first_time = now;
+  nvds_wire_append_varint (batcher->body, payload->componentId);
+  nvds_wire_append_varint (batcher->body, payload->payloadSize);
+  g_string_append_len (batcher->body, (const gchar *) payload->payload,
+      payload->payloadSize);
+  batcher->num_messages++;
+
+  if (batcher->body->len >= max_size)
+    flush_frame (batcher, now, TRUE);
+}
+
+GstBuffer *
+nvds_msg_batcher_process (NvDsMsgBatcher * batcher, GstBuffer * buf)
+{
+  guint linger = batcher->config->linger ? batcher->config->linger :
+      NVDS_MSG_BATCH_DEFAULT_LINGER;
+  gint64 now = g_get_monotonic_time ();
+
+  batcher->now = now;
+  buf = nvds_payload_take (buf, add_message, batcher);
+
+  if (batcher->num_messages && now - batcher->first_time >= linger * 1000)
+    flush_frame (batcher, now, FALSE);
+
+  return nvds_payload_attach (buf, batcher->frames);
+}
+
+GstBuffer *
+nvds_msg_batcher_flush (NvDsMsgBatcher * batcher)
+{
+  if (batcher->num_messages)
+    flush_frame (batcher, g_get_monotonic_time (), FALSE);
+  return nvds_payload_buffer_new (batcher->frames);
+}
+
+void
+nvds_msg_batcher_get_stats (NvDsMsgBatcher * batcher,
+    NvDsMsgBatchStats * stats)
+{
+  g_mutex_lock (&batcher->lock);
+  *stats = batcher->stats;
+  g_mutex_unlock (&batcher->lock);
+}
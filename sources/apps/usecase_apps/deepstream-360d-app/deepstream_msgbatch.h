@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_MSGBATCH_H__
+#define __NVGSTDS_MSGBATCH_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#include "nvds_wire.h"
+
+/**
+ * Packs the message payloads on their way to nvmsgbroker into compressed
+ * frames, see nvds_wire.h, so that the protocol adapter sends one frame
+ * instead of many small messages.
+ */
+
+#define NVDS_MSG_BATCH_DEFAULT_LINGER 100
+/** Longest linger, in ms */
+#define NVDS_MSG_BATCH_MAX_LINGER 60000
+/** Largest frame size, in bytes */
+#define NVDS_MSG_BATCH_MAX_SIZE (16 * 1024 * 1024)
+
+typedef struct _NvDsMsgBatcher NvDsMsgBatcher;
+
+typedef struct
+{
+  /** Bytes of messages a frame holds before it is sent, 0 to send every
+   * message as it is */
+  guint max_size;
+  /** ms the first message of a frame waits for others, 0 for the default */
+  guint linger;
+  NvDsWireCodec codec;
+  /** Compression level, 0 for the default of the codec */
+  gint level;
+  /** Component id of the frames */
+  guint comp_id;
+} NvDsMsgBatchConfig;
+
+typedef struct
+{
+  GstElement *bin;
+  GstElement *sink_queue;
+  NvDsMsgBatcher *batcher;
+  gulong probe_id;
+} NvDsMsgBatchBin;
+
+/** Counts since the start, read by the perf callback. */
+typedef struct
+{
+  guint64 messages;
+  guint64 frames;
+  /** Frames sent because they were full, the others having lingered */
+  guint64 full_frames;
+  /** Bytes of the messages, and of the frames that carried them */
+  guint64 message_bytes;
+  guint64 frame_bytes;
+  /** Sum over the frames of the wait of their first message, in us */
+  guint64 linger_us;
+} NvDsMsgBatchStats;
+
+gboolean create_msg_batch_bin (NvDsMsgBatchConfig * config,
+    NvDsMsgBatchBin * bin);
+
+void destroy_msg_batch_bin (NvDsMsgBatchBin * bin);
+
+NvDsMsgBatcher *nvds_msg_batcher_new (NvDsMsgBatchConfig * config);
+
+void nvds_msg_batcher_free (NvDsMsgBatcher * batcher);
+
+/**
+ * Take the message payloads off @buf, and attach the frames that are full
+ * or whose first message waited for the linger time. Frames only leave
+ * with a buffer, so the linger time is rounded up to the next batch.
+ * Returns @buf, or a writable copy of it if payloads were moved.
+ */
+GstBuffer *nvds_msg_batcher_process (NvDsMsgBatcher * batcher,
+    GstBuffer * buf);
+
+/**
+ * Send the frame being filled without waiting for the linger time, at EOS.
+ * Returns a buffer carrying it, see nvds_payload_buffer_new(), or NULL.
+ */
+GstBuffer *nvds_msg_batcher_flush (NvDsMsgBatcher * batcher);
+
+void nvds_msg_batcher_get_stats (NvDsMsgBatcher * batcher,
+    NvDsMsgBatchStats * stats);
+
+const gchar *nvds_msg_codec_name (NvDsWireCodec codec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
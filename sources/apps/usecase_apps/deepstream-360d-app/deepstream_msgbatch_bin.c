@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include "deepstream_common.h"
+#include "deepstream_msgbatch.h"
+
+static GstPadProbeReturn
+msg_batch_buf_prob (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  NvDsMsgBatcher *batcher = (NvDsMsgBatcher *) u_data;
+
+  GST_PAD_PROBE_INFO_DATA (info) =
+      nvds_msg_batcher_process (batcher, GST_PAD_PROBE_INFO_BUFFER (info));
+  return GST_PAD_PROBE_OK;
+}
+
+/** The frame being filled goes out ahead of EOS, on a buffer of its own. */
+static GstPadProbeReturn
+msg_batch_eos_prob (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  NvDsMsgBatcher *batcher = (NvDsMsgBatcher *) u_data;
+  GstBuffer *buf;
+
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) != GST_EVENT_EOS)
+    return GST_PAD_PROBE_OK;
+
+  buf = nvds_msg_batcher_flush (batcher);
+  if (buf)
+    gst_pad_push (pad, buf);
+  return GST_PAD_PROBE_OK;
+}
+
+gboolean
+create_msg_batch_bin (NvDsMsgBatchConfig * config, NvDsMsgBatchBin * bin)
+{
+  gboolean ret = FALSE;
+
+  bin->bin = gst_bin_new ("msgbatch_bin");
+  if (!bin->bin) {
+    NVGSTDS_ERR_MSG_V ("Failed to create 'msgbatch_bin'");
+    goto done;
+  }
+
+  bin->sink_queue = gst_element_factory_make (NVDS_ELEM_QUEUE, "msgbatch_sink_q");
+  if (!bin->sink_queue) {
+    NVGSTDS_ERR_MSG_V ("Failed to create 'msgbatch_sink_q'");
+    goto done;
+  }
+
+  /* Messages are packed on the streaming thread of the queue, apart from
+   * the rest of the pipeline, right before nvmsgbroker. */
+  gst_bin_add (GST_BIN (bin->bin), bin->sink_queue);
+  bin->batcher = nvds_msg_batcher_new (config);
+  NVGSTDS_ELEM_ADD_PROBE (bin->probe_id, bin->sink_queue, "src",
+      msg_batch_buf_prob, GST_PAD_PROBE_TYPE_BUFFER, bin->batcher);
+  NVGSTDS_ELEM_ADD_PROBE (bin->probe_id, bin->sink_queue, "src",
+      msg_batch_eos_prob, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, bin->batcher);
+  NVGSTDS_BIN_ADD_GHOST_PAD (bin->bin, bin->sink_queue, "sink");
+  NVGSTDS_BIN_ADD_GHOST_PAD (bin->bin, bin->sink_queue, "src");
+
+  ret = TRUE;
+done:
+
+  if (!ret) {
+    NVGSTDS_ERR_MSG_V ("%s failed", __func__);
+  }
+  return ret;
+}
+
+void
+destroy_msg_batch_bin (NvDsMsgBatchBin * bin)
+{
+  nvds_msg_batcher_free (bin->batcher);
+  bin->batcher = NULL;
+}
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include "deepstream_msgqueue.h"
+#include "deepstream_payload.h"
+
+/** Longest wait on the condition, in case a wake-up is missed */
+#define MSG_QUEUE_MAX_WAIT (100 * G_TIME_SPAN_MILLISECOND)
+
+#define LOAD(p) __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#define ADD(p, v) __atomic_add_fetch ((p), (v), __ATOMIC_RELAXED)
+
+/**
+ * A cell of the ring is free for the push at position pos once its seq is
+ * pos, and holds the message for the pop at pos once its seq is pos + 1
+ * (D. Vyukov's bounded MPMC queue).
+ */
+typedef struct
+{
+  guint64 seq;
+  NvDsPayload *payload;
+  gint64 time;
+  gboolean state_change;
+} Cell;
+
+struct _NvDsMsgQueue
+{
+  NvDsMsgQueueConfig *config;
+  Cell *cells;
+  guint64 mask;
+
+  /* Next push and pop positions, apart so that they do not share a line. */
+  guint64 head __attribute__ ((aligned (64)));
+  guint64 tail __attribute__ ((aligned (64)));
+
+  /** Threads about to wait on cond, for room or for a message */
+  gint waiters __attribute__ ((aligned (64)));
+  gint interrupted;
+  GMutex lock;
+  GCond cond;
+
+  NvDsMsgQueueStats stats;
+};
+
+const gchar *
+nvds_msg_queue_policy_name (NvDsMsgQueuePolicy policy)
+{
+  switch (policy) {
+    case NVDS_MSG_QUEUE_DROP_NON_STATE_CHANGE:
+      return "drop-non-state-change";
+    case NVDS_MSG_QUEUE_BLOCK:
+      return "block";
+    default:
+      return "drop-oldest";
+  }
+}
+
+NvDsMsgQueue *
+nvds_msg_queue_new (NvDsMsgQueueConfig * config)
+{
+  NvDsMsgQueue *queue = g_new0 (NvDsMsgQueue, 1);
+  guint64 size = 2;
+  guint64 i;
+
+  while (size < config->max_size)
+    size *= 2;
+
+  queue->config = config;
+  queue->cells = g_new0 (Cell, size);
+  queue->mask = size - 1;
+  for (i = 0; i < size; i++)
+    queue->cells[i].seq = i;
+  g_mutex_init (&queue->lock);
+  g_cond_init (&queue->cond);
+  return queue;
+}
+
+static gboolean
+try_push (NvDsMsgQueue * queue, NvDsPayload * payload, gboolean state_change)
+{
+  guint64 pos = LOAD (&queue->head);
+  Cell *cell;
+  gint64 diff;
+
+  for (;;) {
+    cell = &queue->cells[pos & queue->mask];
+    diff = (gint64) (LOAD (&cell->seq) - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n (&queue->head, &pos, pos + 1, TRUE,
+              __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      return FALSE;
+    } else {
+      pos = LOAD (&queue->head);
+    }
+  }
+
+  cell->payload = payload;
+  cell->time = g_get_monotonic_time ();
+  cell->state_change = state_change;
+  STORE (&cell->seq, pos + 1);
+  return TRUE;
+}
+
+static NvDsPayload *
+try_pop (NvDsMsgQueue * queue, gint64 * time, gboolean * state_change)
+{
+  guint64 pos = LOAD (&queue->tail);
+  NvDsPayload *payload;
+  Cell *cell;
+  gint64 diff;
+
+  for (;;) {
+    cell = &queue->cells[pos & queue->mask];
+    diff = (gint64) (LOAD (&cell->seq) - (pos + 1));
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n (&queue->tail, &pos, pos + 1, TRUE,
+              __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      return NULL;
+    } else {
+      pos = LOAD (&queue->tail);
+    }
+  }
+
+  payload = cell->payload;
+  *time = cell->time;
+  *state_change = cell->state_change;
+  STORE (&cell->seq, pos + queue->mask + 1);
+  return payload;
+}
+
+/** Wake up the threads waiting on the other side of the queue, if any. */
+static void
+wake_up (NvDsMsgQueue * queue)
+{
+  /* Orders the push or pop before the read of waiters, against the
+   * increment of waiters before the retry of a waiting thread. */
+  __atomic_thread_fence (__ATOMIC_SEQ_CST);
+  if (!g_atomic_int_get (&queue->waiters))
+    return;
+  g_mutex_lock (&queue->lock);
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+}
+
+static void
+drop (NvDsMsgQueue * queue, NvDsPayload * payload, gboolean state_change)
+{
+  ADD (&queue->stats.dropped, 1);
+  if (state_change)
+    ADD (&queue->stats.dropped_state_changes, 1);
+  nvds_payload_free (payload);
+}
+
+/** Drop the oldest message to make room. */
+static void
+drop_oldest (NvDsMsgQueue * queue)
+{
+  NvDsPayload *oldest;
+  gboolean state_change;
+  gint64 time;
+
+  oldest = try_pop (queue, &time, &state_change);
+  if (oldest)
+    drop (queue, oldest, state_change);
+}
+
+static gboolean
+push_blocking (NvDsMsgQueue * queue, NvDsPayload * payload,
+    gboolean state_change)
+{
+  gint64 start = g_get_monotonic_time ();
+  gboolean pushed = FALSE;
+
+  g_mutex_lock (&queue->lock);
+  g_atomic_int_inc (&queue->waiters);
+  while (!(pushed = try_push (queue, payload, state_change)) &&
+      !g_atomic_int_get (&queue->interrupted)) {
+    g_cond_wait_until (&queue->cond, &queue->lock,
+        g_get_monotonic_time () + MSG_QUEUE_MAX_WAIT);
+  }
+  g_atomic_int_add (&queue->waiters, -1);
+  g_mutex_unlock (&queue->lock);
+
+  ADD (&queue->stats.wait_us, g_get_monotonic_time () - start);
+  return pushed;
+}
+
+gboolean
+nvds_msg_queue_push (NvDsMsgQueue * queue, NvDsPayload * payload,
+    gboolean state_change)
+{
+  gboolean ret = TRUE;
+  guint64 depth;
+
+  while (!try_push (queue, payload, state_change)) {
+    switch (queue->config->policy) {
+      case NVDS_MSG_QUEUE_DROP_NON_STATE_CHANGE:
+        if (!state_change) {
+          drop (queue, payload, FALSE);
+          return FALSE;
+        }
+        drop_oldest (queue);
+        break;
+      case NVDS_MSG_QUEUE_BLOCK:
+        if (!push_blocking (queue, payload, state_change)) {
+          drop (queue, payload, state_change);
+          return FALSE;
+        }
+        goto pushed;
+      default:
+        drop_oldest (queue);
+        break;
+    }
+    ret = FALSE;
+  }
+
+pushed:
+  ADD (&queue->stats.pushed, 1);
+  depth = LOAD (&queue->head) - LOAD (&queue->tail);
+  if (depth <= queue->mask + 1 && depth > LOAD (&queue->stats.max_depth))
+    STORE (&queue->stats.max_depth, (guint) depth);
+  wake_up (queue);
+  return ret;
+}
+
+NvDsPayload *
+nvds_msg_queue_pop (NvDsMsgQueue * queue, gint64 end_time)
+{
+  NvDsPayload *payload;
+  gboolean state_change;
+  gint64 time;
+
+  payload = try_pop (queue, &time, &state_change);
+  if (!payload) {
+    g_mutex_lock (&queue->lock);
+    g_atomic_int_inc (&queue->waiters);
+    while (!(payload = try_pop (queue, &time, &state_change)) &&
+        !g_atomic_int_get (&queue->interrupted) &&
+        g_get_monotonic_time () < end_time) {
+      g_cond_wait_until (&queue->cond, &queue->lock,
+          MIN (end_time, g_get_monotonic_time () + MSG_QUEUE_MAX_WAIT));
+    }
+    g_atomic_int_add (&queue->waiters, -1);
+    g_mutex_unlock (&queue->lock);
+    if (!payload)
+      return NULL;
+  }
+
+  ADD (&queue->stats.popped, 1);
+  ADD (&queue->stats.queue_us, g_get_monotonic_time () - time);
+  if (queue->config->policy == NVDS_MSG_QUEUE_BLOCK)
+    wake_up (queue);
+  return payload;
+}
+
+void
+nvds_msg_queue_interrupt (NvDsMsgQueue * queue)
+{
+  g_mutex_lock (&queue->lock);
+  g_atomic_int_set (&queue->interrupted, TRUE);
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+}
+
+void
+nvds_msg_queue_free (NvDsMsgQueue * queue)
+{
+  NvDsPayload *payload;
+  gboolean state_change;
+  gint64 time;
+
+  if (!queue)
+    return;
+
+  while ((payload = try_pop (queue, &time, &state_change)))
+    nvds_payload_free (payload);
+  g_free (queue->cells);
+  g_mutex_clear (&queue->lock);
+  g_cond_clear (&queue->cond);
+  g_free (queue);
+}
+
+void
+nvds_msg_queue_get_stats (NvDsMsgQueue * queue, NvDsMsgQueueStats * stats)
+{
+  guint64 head = LOAD (&queue->head), tail = LOAD (&queue->tail);
+
+  stats->pushed = LOAD (&queue->stats.pushed);
+  stats->popped = LOAD (&queue->stats.popped);
+  stats->dropped = LOAD (&queue->stats.dropped);
+  stats->dropped_state_changes = LOAD (&queue->stats.dropped_state_changes);
+  stats->wait_us = LOAD (&queue->stats.wait_us);
+  stats->queue_us = LOAD (&queue->stats.queue_us);
+  stats->max_depth = LOAD (&queue->stats.max_depth);
+  /* The two positions are read apart: the tail may have passed the head. */
+  stats->depth = head > tail ? MIN (head - tail, queue->mask + 1) : 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_MSGQUEUE_H__
+#define __NVGSTDS_MSGQUEUE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#include "gstnvdsmeta.h"
+
+/**
+ * Bounded queue of message payloads between common_tee and the broker
+ * branch. The tee thread only copies the payloads of a buffer into a
+ * lock-free ring; a thread of the queue sends them on downstream, so that a
+ * broker slow to send does not hold up the tee, and the video branch with
+ * it. What happens once the ring is full is up to the policy.
+ */
+
+typedef enum
+{
+  /** Drop the oldest message to make room */
+  NVDS_MSG_QUEUE_DROP_OLDEST = 0,
+  /** Drop the new message, unless it is a state change (a spot becoming
+   * parked or empty, an aisle entry or exit), which makes room by dropping
+   * the oldest message */
+  NVDS_MSG_QUEUE_DROP_NON_STATE_CHANGE = 1,
+  /** Wait for room, holding up the tee */
+  NVDS_MSG_QUEUE_BLOCK = 2,
+} NvDsMsgQueuePolicy;
+
+/** Largest queue, in messages */
+#define NVDS_MSG_QUEUE_MAX_SIZE (1 << 20)
+
+typedef struct _NvDsMsgQueue NvDsMsgQueue;
+
+typedef struct
+{
+  /** Messages the queue holds, rounded up to a power of 2. 0 links the
+   * broker branch to the tee without a queue */
+  guint max_size;
+  NvDsMsgQueuePolicy policy;
+} NvDsMsgQueueConfig;
+
+typedef struct
+{
+  GstElement *bin;
+  /** Takes the buffers of the tee */
+  GstElement *sink;
+  /** Pushes the messages downstream, from the thread of the queue */
+  GstPad *src_pad;
+  NvDsMsgQueue *queue;
+  GThread *thread;
+  gboolean stop;
+  /** Set once the tee sent its segment, after which buffers can be pushed */
+  gboolean segment;
+  gboolean eos;
+  gulong probe_id;
+} NvDsMsgQueueBin;
+
+/** Counts since the start, read by the perf callback. */
+typedef struct
+{
+  guint64 pushed;
+  guint64 popped;
+  guint64 dropped;
+  /** Of the dropped messages, the state changes */
+  guint64 dropped_state_changes;
+  /** Time the tee waited for room, with NVDS_MSG_QUEUE_BLOCK, in us */
+  guint64 wait_us;
+  /** Sum of the time the popped messages spent in the queue, in us */
+  guint64 queue_us;
+  guint depth;
+  guint max_depth;
+} NvDsMsgQueueStats;
+
+gboolean create_msg_queue_bin (NvDsMsgQueueConfig * config,
+    NvDsMsgQueueBin * bin);
+
+void destroy_msg_queue_bin (NvDsMsgQueueBin * bin);
+
+NvDsMsgQueue *nvds_msg_queue_new (NvDsMsgQueueConfig * config);
+
+void nvds_msg_queue_free (NvDsMsgQueue * queue);
+
+/**
+ * Queue @payload, which the queue then owns, applying the policy if it is
+ * full. Safe to call from several threads. Returns FALSE if a message was
+ * dropped.
+ */
+gboolean nvds_msg_queue_push (NvDsMsgQueue * queue, NvDsPayload * payload,
+    gboolean state_change);
+
+/**
+ * Take the oldest message, waiting for one until the monotonic @end_time.
+ * Returns NULL on timeout, or once nvds_msg_queue_interrupt() was called and
+ * the queue is empty.
+ */
+NvDsPayload *nvds_msg_queue_pop (NvDsMsgQueue * queue, gint64 end_time);
+
+/** Wake up the waits, and stop blocking nvds_msg_queue_push(). */
+void nvds_msg_queue_interrupt (NvDsMsgQueue * queue);
+
+void nvds_msg_queue_get_stats (NvDsMsgQueue * queue, NvDsMsgQueueStats * stats);
+
+const gchar *nvds_msg_queue_policy_name (NvDsMsgQueuePolicy policy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
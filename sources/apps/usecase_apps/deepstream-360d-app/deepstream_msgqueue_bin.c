@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include "deepstream_common.h"
+#include "deepstream_msgqueue.h"
+#include "deepstream_payload.h"
+
+/** Most messages sent downstream in a buffer */
+#define MSG_QUEUE_MAX_BATCH 64
+
+/**
+ * Time without a message after which an empty buffer is sent, so that
+ * downstream sees time pass as it did with the video frames of the tee
+ * (the linger of the batcher), and the broker, an async sink, prerolls
+ * before the first message.
+ */
+#define MSG_QUEUE_IDLE_INTERVAL (40 * G_TIME_SPAN_MILLISECOND)
+
+static void
+queue_payload (const NvDsPayload * payload, gpointer user_data)
+{
+  NvDsMsgQueueBin *bin = (NvDsMsgQueueBin *) user_data;
+
+  nvds_msg_queue_push (bin->queue, nvds_payload_new ((const gchar *)
+          payload->payload, payload->payloadSize, payload->componentId),
+      nvds_payload_is_state_change (payload));
+}
+
+static GstPadProbeReturn
+msg_queue_buf_prob (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  nvds_payload_foreach (GST_PAD_PROBE_INFO_BUFFER (info), queue_payload,
+      u_data);
+  return GST_PAD_PROBE_OK;
+}
+
+/**
+ * Sticky events go on to the src pad, to be sent before the next buffer;
+ * EOS only once the queue is empty.
+ */
+static GstPadProbeReturn
+msg_queue_event_prob (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  NvDsMsgQueueBin *bin = (NvDsMsgQueueBin *) u_data;
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
+    g_atomic_int_set (&bin->eos, TRUE);
+  } else if (GST_EVENT_IS_STICKY (event)) {
+    gst_pad_store_sticky_event (bin->src_pad, event);
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT)
+      g_atomic_int_set (&bin->segment, TRUE);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static gpointer
+msg_queue_thread (gpointer data)
+{
+  NvDsMsgQueueBin *bin = (NvDsMsgQueueBin *) data;
+  GPtrArray *payloads = g_ptr_array_new ();
+  NvDsPayload *payload;
+  gboolean eos_sent = FALSE, eos;
+  GstBuffer *buf;
+
+  /* Buffers are pushed even when the pad is flushing, for the queue to
+   * keep draining and a blocked tee to go on. */
+  while (!g_atomic_int_get (&bin->stop)) {
+    eos = g_atomic_int_get (&bin->eos);
+    payload = nvds_msg_queue_pop (bin->queue,
+        g_get_monotonic_time () + MSG_QUEUE_IDLE_INTERVAL);
+    if (!payload) {
+      /* Nothing was pushed after EOS: the queue is drained. The stored
+       * sticky events go out ahead of the first buffer. */
+      if (eos && !eos_sent) {
+        gst_pad_push_event (bin->src_pad, gst_event_new_eos ());
+        eos_sent = TRUE;
+      } else if (!eos_sent && g_atomic_int_get (&bin->segment)) {
+        gst_pad_push (bin->src_pad, gst_buffer_new ());
+      }
+      continue;
+    }
+
+    do {
+      g_ptr_array_add (payloads, payload);
+    } while (payloads->len < MSG_QUEUE_MAX_BATCH &&
+        (payload = nvds_msg_queue_pop (bin->queue, 0)));
+
+    buf = nvds_payload_attach (gst_buffer_new (), payloads);
+    gst_pad_push (bin->src_pad, buf);
+  }
+
+  g_ptr_array_free (payloads, TRUE);
+  return NULL;
+}
+
+gboolean
+create_msg_queue_bin (NvDsMsgQueueConfig * config, NvDsMsgQueueBin * bin)
+{
+  gboolean ret = FALSE;
+
+  bin->bin = gst_bin_new ("msgqueue_bin");
+  if (!bin->bin) {
+    NVGSTDS_ERR_MSG_V ("Failed to create 'msgqueue_bin'");
+    goto done;
+  }
+
+  bin->sink = gst_element_factory_make ("fakesink", "msgqueue_sink");
+  if (!bin->sink) {
+    NVGSTDS_ERR_MSG_V ("Failed to create 'msgqueue_sink'");
+    goto done;
+  }
+  g_object_set (G_OBJECT (bin->sink), "sync", FALSE, "async", FALSE, NULL);
+
+  /* The payloads are copied into the queue on the streaming thread of the
+   * tee, and sent on from the thread of the queue through a pad of the bin
+   * of its own. It is kept until the thread is joined, after the pipeline
+   * is gone. */
+  bin->src_pad = gst_pad_new ("src", GST_PAD_SRC);
+  gst_object_ref (bin->src_pad);
+  gst_element_add_pad (bin->bin, bin->src_pad);
+
+  gst_bin_add (GST_BIN (bin->bin), bin->sink);
+  bin->queue = nvds_msg_queue_new (config);
+  NVGSTDS_ELEM_ADD_PROBE (bin->probe_id, bin->sink, "sink",
+      msg_queue_buf_prob, GST_PAD_PROBE_TYPE_BUFFER, bin);
+  NVGSTDS_ELEM_ADD_PROBE (bin->probe_id, bin->sink, "sink",
+      msg_queue_event_prob, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, bin);
+  NVGSTDS_BIN_ADD_GHOST_PAD (bin->bin, bin->sink, "sink");
+
+  bin->thread = g_thread_new ("msgqueue", msg_queue_thread, bin);
+
+  ret = TRUE;
+done:
+
+  if (!ret) {
+    NVGSTDS_ERR_MSG_V ("%s failed", __func__);
+  }
+  return ret;
+}
+
+void
+destroy_msg_queue_bin (NvDsMsgQueueBin * bin)
+{
+  if (bin->thread) {
+    g_atomic_int_set (&bin->stop, TRUE);
+    nvds_msg_queue_interrupt (bin->queue);
+    g_thread_join (bin->thread);
+    bin->thread = NULL;
+  }
+  nvds_msg_queue_free (bin->queue);
+  bin->queue = NULL;
+  if (bin->src_pad) {
+    gst_object_unref (bin->src_pad);
+    bin->src_pad = NULL;
+  }
+}
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <dlfcn.h>
+#include <string.h>
+
+#include "nvds_msgapi.h"
+#include "deepstream_common.h"
+#include "deepstream_msgsender.h"
+#include "deepstream_payload.h"
+
+/** Longest wait for a message before polling the adapter, in us */
+#define MSG_SENDER_POLL_INTERVAL 100000
+
+typedef NvDsMsgApiHandle (*ConnectFunc) (char *connection_str,
+    nvds_msgapi_connect_cb_t connect_cb, char *config_path);
+typedef NvDsMsgApiErrorType (*SendFunc) (NvDsMsgApiHandle h_ptr, char *topic,
+    const uint8_t * payload, size_t nbuf);
+typedef void (*DoWorkFunc) (NvDsMsgApiHandle h_ptr);
+typedef NvDsMsgApiErrorType (*DisconnectFunc) (NvDsMsgApiHandle h_ptr);
+
+struct _NvDsMsgSender
+{
+  NvDsMsgSenderConfig *config;
+  NvDsSpool *spool;
+  gpointer lib;
+  ConnectFunc connect;
+  SendFunc send;
+  DoWorkFunc do_work;
+  DisconnectFunc disconnect;
+  gchar *topic;
+
+  GThread *thread;
+  NvDsMsgApiHandle handle;
+  /** Set by the adapter when it loses the connection */
+  gint broken;
+  gboolean stop;
+  GMutex lock;
+  GCond cond;
+  NvDsMsgSenderStats stats;
+};
+
+/* The adapter does not pass user data to the connect callback: find the
+ * sender of a connection here. */
+G_LOCK_DEFINE_STATIC (connections);
+static GHashTable *connections;
+
+static void
+connect_cb (NvDsMsgApiHandle h_ptr, NvDsMsgApiEventType ds_evt)
+{
+  NvDsMsgSender *sender;
+
+  if (ds_evt != NVDS_MSGAPI_EVT_SERVICE_DOWN &&
+      ds_evt != NVDS_MSGAPI_EVT_DISCONNECT)
+    return;
+
+  G_LOCK (connections);
+  sender = connections ? (NvDsMsgSender *) g_hash_table_lookup (connections,
+      h_ptr) : NULL;
+  if (sender)
+    g_atomic_int_set (&sender->broken, TRUE);
+  G_UNLOCK (connections);
+}
+
+static void
+set_handle (NvDsMsgSender * sender, NvDsMsgApiHandle handle)
+{
+  G_LOCK (connections);
+  if (!connections)
+    connections = g_hash_table_new (g_direct_hash, g_direct_equal);
+  if (sender->handle)
+    g_hash_table_remove (connections, sender->handle);
+  if (handle)
+    g_hash_table_insert (connections, handle, sender);
+  sender->handle = handle;
+  g_atomic_int_set (&sender->broken, FALSE);
+  G_UNLOCK (connections);
+}
+
+static void
+disconnect (NvDsMsgSender * sender)
+{
+  NvDsMsgApiHandle handle = sender->handle;
+
+  set_handle (sender, NULL);
+  sender->disconnect (handle);
+  g_mutex_lock (&sender->lock);
+  sender->stats.connected = FALSE;
+  g_mutex_unlock (&sender->lock);
+}
+
+/** Wait for @interval ms unless stopped. Returns FALSE once stopped. */
+static gboolean
+wait_retry (NvDsMsgSender * sender, guint interval)
+{
+  gint64 end_time = g_get_monotonic_time () + interval * G_TIME_SPAN_MILLISECOND;
+  gboolean stop;
+
+  g_mutex_lock (&sender->lock);
+  while (!sender->stop &&
+      g_cond_wait_until (&sender->cond, &sender->lock, end_time));
+  stop = sender->stop;
+  g_mutex_unlock (&sender->lock);
+  return !stop;
+}
+
+static gpointer
+drain_thread (gpointer data)
+{
+  NvDsMsgSender *sender = (NvDsMsgSender *) data;
+  guint retry_interval = sender->config->retry_interval ?
+      sender->config->retry_interval : NVDS_MSG_SENDER_DEFAULT_RETRY_INTERVAL;
+  guint interval = retry_interval;
+  GString *record = g_string_new (NULL);
+  gboolean connected_once = FALSE;
+  /** Start of the backlog being replayed, 0 if none */
+  gint64 replay_start = 0;
+  NvDsSpoolStats spool_stats;
+  guint comp_id;
+  guint64 token;
+
+  for (;;) {
+    if (!sender->handle) {
+      NvDsMsgApiHandle handle = sender->connect (sender->config->conn_str,
+          connect_cb, sender->config->config_file);
+
+      if (!handle) {
+        g_mutex_lock (&sender->lock);
+        sender->stats.failures++;
+        g_mutex_unlock (&sender->lock);
+        if (!wait_retry (sender, interval))
+          break;
+        interval = MIN (interval * 2, NVDS_MSG_SENDER_MAX_RETRY_INTERVAL);
+        continue;
+      }
+      set_handle (sender, handle);
+      nvds_spool_get_stats (sender->spool, &spool_stats);
+      if (spool_stats.pending)
+        replay_start = g_get_monotonic_time ();
+      g_mutex_lock (&sender->lock);
+      if (connected_once)
+        sender->stats.reconnects++;
+      sender->stats.connected = TRUE;
+      g_mutex_unlock (&sender->lock);
+      connected_once = TRUE;
+    }
+
+    if (!nvds_spool_peek (sender->spool, record, &comp_id, &token,
+            g_get_monotonic_time () + MSG_SENDER_POLL_INTERVAL)) {
+      g_mutex_lock (&sender->lock);
+      if (sender->stop) {
+        g_mutex_unlock (&sender->lock);
+        break;
+      }
+      g_mutex_unlock (&sender->lock);
+      sender->do_work (sender->handle);
+      continue;
+    }
+
+    /* A message counts as sent once the adapter took it, without error
+     * reported for the connection since. */
+    if (sender->send (sender->handle, sender->topic,
+            (const uint8_t *) record->str, record->len) == NVDS_MSGAPI_OK) {
+      sender->do_work (sender->handle);
+    } else {
+      g_atomic_int_set (&sender->broken, TRUE);
+    }
+
+    if (g_atomic_int_get (&sender->broken)) {
+      gint64 now = g_get_monotonic_time ();
+
+      g_mutex_lock (&sender->lock);
+      sender->stats.failures++;
+      if (replay_start)
+        sender->stats.replay_us += now - replay_start;
+      g_mutex_unlock (&sender->lock);
+      replay_start = 0;
+      disconnect (sender);
+      if (!wait_retry (sender, interval))
+        break;
+      interval = MIN (interval * 2, NVDS_MSG_SENDER_MAX_RETRY_INTERVAL);
+      continue;
+    }
+
+    nvds_spool_consume (sender->spool, token);
+    interval = retry_interval;
+    g_mutex_lock (&sender->lock);
+    sender->stats.sent++;
+    if (replay_start)
+      sender->stats.replayed++;
+    g_mutex_unlock (&sender->lock);
+
+    if (replay_start) {
+      nvds_spool_get_stats (sender->spool, &spool_stats);
+      if (!spool_stats.pending) {
+        g_mutex_lock (&sender->lock);
+        sender->stats.replay_us += g_get_monotonic_time () - replay_start;
+        g_mutex_unlock (&sender->lock);
+        replay_start = 0;
+      }
+    }
+  }
+
+  if (sender->handle)
+    disconnect (sender);
+  g_string_free (record, TRUE);
+  return NULL;
+}
+
+static gboolean
+load_adapter (NvDsMsgSender * sender)
+{
+  sender->lib = dlopen (sender->config->proto_lib, RTLD_LAZY);
+  if (!sender->lib) {
+    NVGSTDS_ERR_MSG_V ("Failed to load protocol adapter '%s': %s",
+        sender->config->proto_lib, dlerror ());
+    return FALSE;
+  }
+
+  sender->connect = (ConnectFunc) dlsym (sender->lib, "nvds_msgapi_connect");
+  sender->send = (SendFunc) dlsym (sender->lib, "nvds_msgapi_send");
+  sender->do_work = (DoWorkFunc) dlsym (sender->lib, "nvds_msgapi_do_work");
+  sender->disconnect = (DisconnectFunc) dlsym (sender->lib,
+      "nvds_msgapi_disconnect");
+  if (!sender->connect || !sender->send || !sender->do_work ||
+      !sender->disconnect) {
+    NVGSTDS_ERR_MSG_V ("'%s' is not a protocol adapter",
+        sender->config->proto_lib);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/** The adapter gets the connection string as nvmsgbroker passes it; the
+ * messages are sent to the topic at its end. */
+static gboolean
+parse_conn_str (NvDsMsgSender * sender)
+{
+  gchar **fields = g_strsplit (sender->config->conn_str ?
+      sender->config->conn_str : "", ";", 3);
+  gboolean ret = FALSE;
+
+  if (g_strv_length (fields) < 3 || !*fields[2]) {
+    NVGSTDS_ERR_MSG_V ("Connection string '%s' has no topic",
+        sender->config->conn_str);
+    goto done;
+  }
+  sender->topic = g_strdup (fields[2]);
+  ret = TRUE;
+
+done:
+  g_strfreev (fields);
+  return ret;
+}
+
+NvDsMsgSender *
+nvds_msg_sender_new (NvDsMsgSenderConfig * config)
+{
+  NvDsMsgSender *sender = g_new0 (NvDsMsgSender, 1);
+
+  sender->config = config;
+  g_mutex_init (&sender->lock);
+  g_cond_init (&sender->cond);
+
+  if (!parse_conn_str (sender) || !load_adapter (sender))
+    goto error;
+  sender->spool = nvds_spool_open (&config->spool);
+  if (!sender->spool)
+    goto error;
+
+  sender->thread = g_thread_new ("msgsender", drain_thread, sender);
+  return sender;
+
+error:
+  nvds_msg_sender_free (sender);
+  return NULL;
+}
+
+void
+nvds_msg_sender_free (NvDsMsgSender * sender)
+{
+  if (!sender)
+    return;
+
+  if (sender->thread) {
+    g_mutex_lock (&sender->lock);
+    sender->stop = TRUE;
+    g_cond_broadcast (&sender->cond);
+    g_mutex_unlock (&sender->lock);
+    nvds_spool_interrupt (sender->spool);
+    g_thread_join (sender->thread);
+  }
+  nvds_spool_close (sender->spool);
+  if (sender->lib)
+    dlclose (sender->lib);
+  g_free (sender->topic);
+  g_mutex_clear (&sender->lock);
+  g_cond_clear (&sender->cond);
+  g_free (sender);
+}
+
+static void
+spool_message (const NvDsPayload * payload, gpointer user_data)
+{
+  NvDsMsgSender *sender = (NvDsMsgSender *) user_data;
+
+  nvds_spool_append (sender->spool, (const guint8 *) payload->payload,
+      payload->payloadSize, payload->componentId);
+}
+
+void
+nvds_msg_sender_process (NvDsMsgSender * sender, GstBuffer * buf)
+{
+  nvds_payload_foreach (buf, spool_message, sender);
+}
+
+void
+nvds_msg_sender_get_stats (NvDsMsgSender * sender, NvDsMsgSenderStats * stats)
+{
+  g_mutex_lock (&sender->lock);
+  *stats = sender->stats;
+  g_mutex_unlock (&sender->lock);
+  nvds_spool_get_stats (sender->spool, &stats->spool);
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_MSGSENDER_H__
+#define __NVGSTDS_MSGSENDER_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#include "deepstream_spool.h"
+
+/**
+ * Sends the message payloads through the protocol adapter in place of
+ * nvmsgbroker, by way of a spool on disk.
+ *
+ * The pipeline only appends the messages to the spool, so it never waits on
+ * the network. A thread of the sender drains the spool in order, and keeps
+ * the messages there while the broker is down, retrying with a backoff and
+ * replaying the backlog once it is up again.
+ */
+
+#define NVDS_MSG_SENDER_DEFAULT_RETRY_INTERVAL 1000
+/** Longest wait between two retries, in ms */
+#define NVDS_MSG_SENDER_MAX_RETRY_INTERVAL 30000
+
+typedef struct _NvDsMsgSender NvDsMsgSender;
+
+typedef struct
+{
+  NvDsSpoolConfig spool;
+  /** ms to the first retry after a failure, doubled on each retry up to
+   * 30 s. 0 for the default */
+  guint retry_interval;
+  /* Set by the pipeline from [message-broker]. */
+  gchar *proto_lib;
+  /** host;port;topic */
+  gchar *conn_str;
+  gchar *config_file;
+} NvDsMsgSenderConfig;
+
+typedef struct
+{
+  GstElement *bin;
+  GstElement *sink_queue;
+  GstElement *sink;
+  NvDsMsgSender *sender;
+  gulong probe_id;
+} NvDsMsgSenderBin;
+
+/** Counts since the start, read by the perf callback. */
+typedef struct
+{
+  guint64 sent;
+  /** Sends and connections that failed */
+  guint64 failures;
+  guint64 reconnects;
+  /** Messages sent while draining a backlog, and the time it took in us */
+  guint64 replayed;
+  guint64 replay_us;
+  gboolean connected;
+  NvDsSpoolStats spool;
+} NvDsMsgSenderStats;
+
+gboolean create_msg_sender_bin (NvDsMsgSenderConfig * config,
+    NvDsMsgSenderBin * bin);
+
+void destroy_msg_sender_bin (NvDsMsgSenderBin * bin);
+
+/**
+ * Open the spool and load the protocol adapter, then start draining.
+ * Returns NULL on error.
+ */
+NvDsMsgSender *nvds_msg_sender_new (NvDsMsgSenderConfig * config);
+
+/** Stop draining; the messages left stay in the spool for the next run. */
+void nvds_msg_sender_free (NvDsMsgSender * sender);
+
+/** Append the message payloads of @buf to the spool. */
+void nvds_msg_sender_process (NvDsMsgSender * sender, GstBuffer * buf);
+
+void nvds_msg_sender_get_stats (NvDsMsgSender * sender,
+    NvDsMsgSenderStats * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
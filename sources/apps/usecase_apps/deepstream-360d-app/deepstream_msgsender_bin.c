@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include "deepstream_common.h"
+#include "deepstream_msgsender.h"
+
+static GstPadProbeReturn
+msg_sender_buf_prob (GstPad * pad, GstPadProbeInfo * info, gpointer u_data)
+{
+  NvDsMsgSender *sender = (NvDsMsgSender *) u_data;
+
+  nvds_msg_sender_process (sender, GST_PAD_PROBE_INFO_BUFFER (info));
+  return GST_PAD_PROBE_OK;
+}
+
+gboolean
+create_msg_sender_bin (NvDsMsgSenderConfig * config, NvDsMsgSenderBin * bin)
+{
+  gboolean ret = FALSE;
+
+  bin->bin = gst_bin_new ("msgsender_bin");
+  if (!bin->bin) {
+    NVGSTDS_ERR_MSG_V ("Failed to create 'msgsender_bin'");
+    goto done;
+  }
+
+  bin->sink_queue = gst_element_factory_make (NVDS_ELEM_QUEUE,
+      "msgsender_sink_q");
+  if (!bin->sink_queue) {
+    NVGSTDS_ERR_MSG_V ("Failed to create 'msgsender_sink_q'");
+    goto done;
+  }
+
+  bin->sink = gst_element_factory_make ("fakesink", "msgsender_sink");
+  if (!bin->sink) {
+    NVGSTDS_ERR_MSG_V ("Failed to create 'msgsender_sink'");
+    goto done;
+  }
+  g_object_set (G_OBJECT (bin->sink), "sync", FALSE, "async", FALSE, NULL);
+
+  bin->sender = nvds_msg_sender_new (config);
+  if (!bin->sender)
+    goto done;
+
+  /* Messages are spooled on the streaming thread of the queue; the network
+   * is only waited on by the thread of the sender. */
+  gst_bin_add_many (GST_BIN (bin->bin), bin->sink_queue, bin->sink, NULL);
+  NVGSTDS_LINK_ELEMENT (bin->sink_queue, bin->sink);
+  NVGSTDS_ELEM_ADD_PROBE (bin->probe_id, bin->sink_queue, "src",
+      msg_sender_buf_prob, GST_PAD_PROBE_TYPE_BUFFER, bin->sender);
+  NVGSTDS_BIN_ADD_GHOST_PAD (bin->bin, bin->sink_queue, "sink");
+
+  ret = TRUE;
+done:
+
+  if (!ret) {
+    NVGSTDS_ERR_MSG_V ("%s failed", __func__);
+  }
+  return ret;
+}
+
+void
+destroy_msg_sender_bin (NvDsMsgSenderBin * bin)
+{
+  nvds_msg_sender_free (bin->sender);
+  bin->sender = NULL;
+}
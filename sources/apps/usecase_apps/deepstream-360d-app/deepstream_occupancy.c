@@ -0,0 +1,549 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deepstream_common.h"
+#include "deepstream_occupancy.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OCCUPANCY_X86 1
+#endif
+
+G_STATIC_ASSERT (NVDS_OCCUPANCY_BLOCK == 8);
+
+#define BENCHMARK_DETECTIONS 8
+#define BENCHMARK_ITERATIONS 20000
+#define BENCHMARK_SPOT_WIDTH 120
+#define BENCHMARK_SPOT_GAP 10
+
+typedef void (*EvalFunc) (const NvDsSpotTable * table,
+    const NvDsDetectionBatch * detections, guint32 * occupied);
+
+typedef struct
+{
+  gfloat left;
+  gfloat top;
+  gfloat right;
+  gfloat bottom;
+  guint32 record;
+} SpotRect;
+
+static int
+compare_spot_left (const void *a, const void *b)
+{
+  const SpotRect *ra = (const SpotRect *) a;
+  const SpotRect *rb = (const SpotRect *) b;
+
+  if (ra->left != rb->left)
+    return ra->left < rb->left ? -1 : 1;
+  return ra->record < rb->record ? -1 : ra->record > rb->record;
+}
+
+void
+nvds_spot_table_init (NvDsSpotTable * table, guint num_spots,
+    const gfloat * rects, const guint32 * records, gfloat coverage)
+{
+  SpotRect *spots;
+  guint num_lanes;
+  gfloat *data;
+  guint i, b;
+
+  memset (table, 0, sizeof (NvDsSpotTable));
+  if (num_spots == 0)
+    return;
+
+  /* The corners are given in any order. */
+  spots = g_new (SpotRect, num_spots);
+  for (i = 0; i < num_spots; i++) {
+    spots[i].left = MIN (rects[4 * i], rects[4 * i + 2]);
+    spots[i].right = MAX (rects[4 * i], rects[4 * i + 2]);
+    spots[i].top = MIN (rects[4 * i + 1], rects[4 * i + 3]);
+    spots[i].bottom = MAX (rects[4 * i + 1], rects[4 * i + 3]);
+    spots[i].record = records[i];
+  }
+  qsort (spots, num_spots, sizeof (SpotRect), compare_spot_left);
+
+  table->num_spots = num_spots;
+  table->num_blocks = (num_spots + NVDS_OCCUPANCY_BLOCK - 1) /
+      NVDS_OCCUPANCY_BLOCK;
+  num_lanes = table->num_blocks * NVDS_OCCUPANCY_BLOCK;
+
+  data = g_new (gfloat, 5 * num_lanes + 3 * table->num_blocks);
+  table->left = data;
+  table->top = data + num_lanes;
+  table->right = data + 2 * num_lanes;
+  table->bottom = data + 3 * num_lanes;
+  table->min_overlap = data + 4 * num_lanes;
+  table->block_left = data + 5 * num_lanes;
+  table->block_right = table->block_left + table->num_blocks;
+  table->block_reach = table->block_right + table->num_blocks;
+  table->record = g_new0 (guint32, num_lanes);
+
+  for (i = 0; i < num_lanes; i++) {
+    if (i >= num_spots) {
+      table->left[i] = table->top[i] = table->right[i] = table->bottom[i] = 0;
+      table->min_overlap[i] = FLT_MAX;
+      continue;
+    }
+    table->left[i] = spots[i].left;
+    table->top[i] = spots[i].top;
+    table->right[i] = spots[i].right;
+    table->bottom[i] = spots[i].bottom;
+    /* At least a non-empty overlap, even for degenerate spots. */
+    table->min_overlap[i] = MAX (coverage *
+        (spots[i].right - spots[i].left) * (spots[i].bottom - spots[i].top),
+        FLT_MIN);
+    table->record[i] = spots[i].record;
+  }
+
+  for (b = 0; b < table->num_blocks; b++) {
+    guint first = b * NVDS_OCCUPANCY_BLOCK;
+    guint last = MIN (first + NVDS_OCCUPANCY_BLOCK, num_spots);
+
+    table->block_left[b] = table->left[first];
+    table->block_right[b] = table->right[first];
+    for (i = first + 1; i < last; i++)
+      table->block_right[b] = MAX (table->block_right[b], table->right[i]);
+    table->block_reach[b] = b ? MAX (table->block_reach[b - 1],
+        table->block_right[b]) : table->block_right[b];
+  }
+  g_free (spots);
+}
+
+void
+nvds_spot_table_build (NvDsSpotTable * table, const NvDsCalibration * calib,
+    const NvDsCalibRange * range, gfloat coverage)
+{
+  const NvDsSpotCalibRecord *records = nvds_calibration_spots (calib);
+  gfloat *rects = g_new (gfloat, 4 * range->count);
+  guint32 *spots = g_new (guint32, range->count);
+  guint num_spots = 0;
+  guint i;
+
+  for (i = range->first; i < range->first + range->count; i++) {
+    if (!g_strcmp0 (nvds_calibration_string (calib, records[i].spot_str),
+            "IGNORE"))
+      continue;
+    memcpy (&rects[4 * num_spots], records[i].spot_roi, 4 * sizeof (gfloat));
+    spots[num_spots++] = i;
+  }
+  nvds_spot_table_init (table, num_spots, rects, spots, coverage);
+  g_free (rects);
+  g_free (spots);
+}
+
+void
+nvds_spot_table_clear (NvDsSpotTable * table)
+{
+  g_free (table->left);
+  g_free (table->record);
+  memset (table, 0, sizeof (NvDsSpotTable));
+}
+
+void
+nvds_detection_batch_free (NvDsDetectionBatch * batch)
+{
+  g_free (batch->left);
+  g_free (batch->top);
+  g_free (batch->right);
+  g_free (batch->bottom);
+  memset (batch, 0, sizeof (NvDsDetectionBatch));
+}
+
+void
+nvds_detection_batch_add (NvDsDetectionBatch * batch, gfloat left,
+    gfloat top, gfloat width, gfloat height)
+{
+  if (batch->count == batch->capacity) {
+    batch->capacity = MAX (32, batch->capacity * 2);
+    batch->left = g_renew (gfloat, batch->left, batch->capacity);
+    batch->top = g_renew (gfloat, batch->top, batch->capacity);
+    batch->right = g_renew (gfloat, batch->right, batch->capacity);
+    batch->bottom = g_renew (gfloat, batch->bottom, batch->capacity);
+  }
+  batch->left[batch->count] = left;
+  batch->top[batch->count] = top;
+  batch->right[batch->count] = left + width;
+  batch->bottom[batch->count] = top + height;
+  batch->count++;
+}
+
+void
+nvds_occupancy_eval_scalar (const NvDsSpotTable * table,
+    const NvDsDetectionBatch * detections, guint32 * occupied)
+{
+  guint d, i;
+
+  memset (occupied, 0,
+      NVDS_OCCUPANCY_WORDS (table->num_spots) * sizeof (guint32));
+  for (d = 0; d < detections->count; d++) {
+    for (i = 0; i < table->num_spots; i++) {
+      gfloat w = MIN (detections->right[d], table->right[i]) -
+          MAX (detections->left[d], table->left[i]);
+      gfloat h = MIN (detections->bottom[d], table->bottom[i]) -
+          MAX (detections->top[d], table->top[i]);
+      if (MAX (w, 0) * MAX (h, 0) >= table->min_overlap[i])
+        occupied[i / 32] |= 1u << (i % 32);
+    }
+  }
+}
+
+/** First block that may reach past @left, i.e. with block_reach > @left. */
+static guint
+first_block (const NvDsSpotTable * table, gfloat left)
+{
+  guint lo = 0, hi = table->num_blocks;
+
+  while (lo < hi) {
+    guint mid = (lo + hi) / 2;
+    if (table->block_reach[mid] > left)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return lo;
+}
+
+/*
+ * The vector evaluators below only visit the blocks whose x extent overlaps
+ * the detection: starting at first_block(), until the blocks start right of
+ * it. Blocks are NVDS_OCCUPANCY_BLOCK lanes, so a block never straddles two
+ * words of the occupancy bit set.
+ */
+
+#ifdef OCCUPANCY_X86
+__attribute__ ((target ("sse2")))
+static void
+eval_sse2 (const NvDsSpotTable * table, const NvDsDetectionBatch * detections,
+    guint32 * occupied)
+{
+  __m128 zero = _mm_setzero_ps ();
+  guint d, b, i;
+
+  memset (occupied, 0,
+      NVDS_OCCUPANCY_WORDS (table->num_spots) * sizeof (guint32));
+  for (d = 0; d < detections->count; d++) {
+    __m128 l = _mm_set1_ps (detections->left[d]);
+    __m128 t = _mm_set1_ps (detections->top[d]);
+    __m128 r = _mm_set1_ps (detections->right[d]);
+    __m128 bt = _mm_set1_ps (detections->bottom[d]);
+
+    for (b = first_block (table, detections->left[d]);
+        b < table->num_blocks && table->block_left[b] < detections->right[d];
+        b++) {
+      guint32 hits = 0;
+
+      if (table->block_right[b] <= detections->left[d])
+        continue;
+      for (i = 0; i < NVDS_OCCUPANCY_BLOCK; i += 4) {
+        guint lane = b * NVDS_OCCUPANCY_BLOCK + i;
+        __m128 w = _mm_sub_ps (
+            _mm_min_ps (r, _mm_loadu_ps (table->right + lane)),
+            _mm_max_ps (l, _mm_loadu_ps (table->left + lane)));
+        __m128 h = _mm_sub_ps (
+            _mm_min_ps (bt, _mm_loadu_ps (table->bottom + lane)),
+            _mm_max_ps (t, _mm_loadu_ps (table->top + lane)));
+        __m128 overlap = _mm_mul_ps (_mm_max_ps (w, zero),
+            _mm_max_ps (h, zero));
+        __m128 hit = _mm_cmpge_ps (overlap,
+            _mm_loadu_ps (table->min_overlap + lane));
+        hits |= (guint32) _mm_movemask_ps (hit) << i;
+      }
+      occupied[b * NVDS_OCCUPANCY_BLOCK / 32] |=
+          hits << (b * NVDS_OCCUPANCY_BLOCK % 32);
+    }
+  }
+}
+
+__attribute__ ((target ("avx2")))
+static void
+eval_avx2 (const NvDsSpotTable * table, const NvDsDetectionBatch * detections,
+    guint32 * occupied)
+{
+  __m256 zero = _mm256_setzero_ps ();
+  guint d, b;
+
+  memset (occupied, 0,
+      NVDS_OCCUPANCY_WORDS (table->num_spots) * sizeof (guint32));
+  for (d = 0; d < detections->count; d++) {
+    __m256 l = _mm256_set1_ps (detections->left[d]);
+    __m256 t = _mm256_set1_ps (detections->top[d]);
+    __m256 r = _mm256_set1_ps (detections->right[d]);
+    __m256 bt = _mm256_set1_ps (detections->bottom[d]);
+
+    for (b = first_block (table, detections->left[d]);
+        b < table->num_blocks && table->block_left[b] < detections->right[d];
+        b++) {
+      guint lane = b * NVDS_OCCUPANCY_BLOCK;
+      __m256 w, h, overlap, hit;
+
+      if (table->block_right[b] <= detections->left[d])
+        continue;
+      w = _mm256_sub_ps (_mm256_min_ps (r, _mm256_loadu_ps (table->right + lane)),
+          _mm256_max_ps (l, _mm256_loadu_ps (table->left + lane)));
+      h = _mm256_sub_ps (
+          _mm256_min_ps (bt, _mm256_loadu_ps (table->bottom + lane)),
+          _mm256_max_ps (t, _mm256_loadu_ps (table->top + lane)));
+      overlap = _mm256_mul_ps (_mm256_max_ps (w, zero),
+          _mm256_max_ps (h, zero));
+      hit = _mm256_cmp_ps (overlap,
+          _mm256_loadu_ps (table->min_overlap + lane), _CMP_GE_OQ);
+      occupied[lane / 32] |= (guint32) _mm256_movemask_ps (hit) << (lane % 32);
+    }
+  }
+}
+#endif
+
+/** Portable evaluator with the same block walk as the vector ones. */
+static void
+eval_blocks (const NvDsSpotTable * table,
+    const NvDsDetectionBatch * detections, guint32 * occupied)
+{
+  guint d, b, i;
+
+  memset (occupied, 0,
+      NVDS_OCCUPANCY_WORDS (table->num_spots) * sizeof (guint32));
+  for (d = 0; d < detections->count; d++) {
+    for (b = first_block (table, detections->left[d]);
+        b < table->num_blocks && table->block_left[b] < detections->right[d];
+        b++) {
+      if (table->block_right[b] <= detections->left[d])
+        continue;
+      for (i = b * NVDS_OCCUPANCY_BLOCK;
+          i < (b + 1) * NVDS_OCCUPANCY_BLOCK; i++) {
+        gfloat w = MIN (detections->right[d], table->right[i]) -
+            MAX (detections->left[d], table->left[i]);
+        gfloat h = MIN (detections->bottom[d], table->bottom[i]) -
+            MAX (detections->top[d], table->top[i]);
+        if (MAX (w, 0) * MAX (h, 0) >= table->min_overlap[i])
+          occupied[i / 32] |= 1u << (i % 32);
+      }
+    }
+  }
+}
+
+static EvalFunc eval_func;
+static const gchar *eval_func_name;
+
+static EvalFunc
+get_eval_func (void)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    eval_func = eval_blocks;
+    eval_func_name = "blocks";
+#ifdef OCCUPANCY_X86
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2")) {
+      eval_func = eval_avx2;
+      eval_func_name = "avx2";
+    } else if (__builtin_cpu_supports ("sse2")) {
+      eval_func = eval_sse2;
+      eval_func_name = "sse2";
+    }
+#endif
+    g_once_init_leave (&init, 1);
+  }
+  return eval_func;
+}
+
+void
+nvds_occupancy_eval (const NvDsSpotTable * table,
+    const NvDsDetectionBatch * detections, guint32 * occupied)
+{
+  get_eval_func () (table, detections, occupied);
+}
+
+const gchar *
+nvds_occupancy_kernel_name (void)
+{
+  get_eval_func ();
+  return eval_func_name;
+}
+
+/** Vehicle sized boxes over a @width x @height surface, some on a spot. */
+static void
+add_detections (GRand * rand, NvDsDetectionBatch * batch,
+    const NvDsSpotTable * table, gfloat width, gfloat height)
+{
+  guint d;
+
+  for (d = 0; d < BENCHMARK_DETECTIONS; d++) {
+    gfloat w = g_rand_double_range (rand, 100, 500);
+    gfloat h = g_rand_double_range (rand, 80, 300);
+    gfloat x = g_rand_double_range (rand, 0, MAX (width - w, 1));
+    gfloat y = g_rand_double_range (rand, 0, MAX (height - h, 1));
+    if (d % 3 == 0 && table->num_spots) {
+      guint lane = g_rand_int_range (rand, 0, table->num_spots);
+      x = table->left[lane];
+      y = table->top[lane];
+    }
+    nvds_detection_batch_add (batch, x, y, w, h);
+  }
+}
+
+static gdouble
+time_eval (EvalFunc func, const NvDsSpotTable * tables,
+    const NvDsDetectionBatch * detections, guint num_tables,
+    guint32 * occupied, guint32 * result)
+{
+  gint64 start = g_get_monotonic_time ();
+  guint32 acc = 0;
+  guint n, i;
+
+  for (n = 0; n < BENCHMARK_ITERATIONS; n++) {
+    for (i = 0; i < num_tables; i++) {
+      func (&tables[i], &detections[i], occupied);
+      acc ^= occupied[0] + n;
+    }
+  }
+  *result = acc;
+  return (g_get_monotonic_time () - start) * 1000.0 /
+      ((gdouble) BENCHMARK_ITERATIONS * num_tables);
+}
+
+/** Check the evaluators against each other on @tables and time them. */
+static gboolean
+run_benchmark (const gchar * name, const NvDsSpotTable * tables,
+    const NvDsDetectionBatch * detections, guint num_tables)
+{
+  guint max_spots = 0;
+  guint32 *expected, *occupied;
+  guint32 scalar_result, vector_result;
+  gdouble scalar_ns, vector_ns;
+  gboolean ret = FALSE;
+  guint i;
+
+  for (i = 0; i < num_tables; i++)
+    max_spots = MAX (max_spots, tables[i].num_spots);
+  expected = g_new0 (guint32, NVDS_OCCUPANCY_WORDS (max_spots) + 1);
+  occupied = g_new0 (guint32, NVDS_OCCUPANCY_WORDS (max_spots) + 1);
+
+  for (i = 0; i < num_tables; i++) {
+    gsize size = NVDS_OCCUPANCY_WORDS (tables[i].num_spots) * sizeof (guint32);
+
+    nvds_occupancy_eval_scalar (&tables[i], &detections[i], expected);
+    nvds_occupancy_eval (&tables[i], &detections[i], occupied);
+    if (memcmp (expected, occupied, size)) {
+      NVGSTDS_ERR_MSG_V ("%s evaluator disagrees with the scalar one",
+          nvds_occupancy_kernel_name ());
+      goto done;
+    }
+  }
+
+  scalar_ns = time_eval (nvds_occupancy_eval_scalar, tables, detections,
+      num_tables, occupied, &scalar_result);
+  vector_ns = time_eval (get_eval_func (), tables, detections, num_tables,
+      occupied, &vector_result);
+
+  g_print ("%s, %u detections each:\n", name, BENCHMARK_DETECTIONS);
+  g_print ("  scalar %8.1f ns/surface\n", scalar_ns);
+  g_print ("  %-6s %8.1f ns/surface\n", nvds_occupancy_kernel_name (),
+      vector_ns);
+  ret = scalar_result == vector_result;
+
+done:
+  g_free (expected);
+  g_free (occupied);
+  return ret;
+}
+
+/** A single row of @num_spots spots, as seen by a long panoramic surface. */
+static gboolean
+benchmark_row (GRand * rand, guint num_spots)
+{
+  NvDsSpotTable table;
+  NvDsDetectionBatch detections = { 0 };
+  gfloat *rects = g_new (gfloat, 4 * num_spots);
+  guint32 *records = g_new (guint32, num_spots);
+  gfloat width = num_spots * (BENCHMARK_SPOT_WIDTH + BENCHMARK_SPOT_GAP);
+  gchar *name;
+  gboolean ret;
+  guint i;
+
+  for (i = 0; i < num_spots; i++) {
+    rects[4 * i] = i * (BENCHMARK_SPOT_WIDTH + BENCHMARK_SPOT_GAP);
+    rects[4 * i + 1] = 100;
+    rects[4 * i + 2] = rects[4 * i] + BENCHMARK_SPOT_WIDTH;
+    rects[4 * i + 3] = 400;
+    records[i] = i;
+  }
+  nvds_spot_table_init (&table, num_spots, rects, records,
+      NVDS_OCCUPANCY_DEFAULT_COVERAGE);
+  add_detections (rand, &detections, &table, width, 666);
+
+  name = g_strdup_printf ("Occupancy of a row of %u spots", num_spots);
+  ret = run_benchmark (name, &table, &detections, 1);
+
+  g_free (name);
+  nvds_detection_batch_free (&detections);
+  nvds_spot_table_clear (&table);
+  g_free (rects);
+  g_free (records);
+  return ret;
+}
+
+gboolean
+nvds_occupancy_benchmark (const gchar * path)
+{
+  NvDsCalibration *calib = nvds_calibration_acquire (path,
+      NVDS_CALIB_KIND_SPOT);
+  NvDsSpotTable *tables = NULL;
+  NvDsDetectionBatch *detections = NULL;
+  GRand *rand = g_rand_new_with_seed (360);
+  guint num_tables = 0;
+  gchar *name = NULL;
+  gboolean ret = FALSE;
+  guint i;
+
+  if (!calib)
+    goto done;
+
+  tables = g_new0 (NvDsSpotTable, calib->num_cameras * calib->num_surfaces);
+  detections = g_new0 (NvDsDetectionBatch,
+      calib->num_cameras * calib->num_surfaces);
+
+  for (i = 0; i < calib->num_cameras * calib->num_surfaces; i++) {
+    const NvDsCalibRange *range = &calib->ranges[i];
+    const NvDsSpotCalibRecord *rec;
+
+    if (range->count == 0)
+      continue;
+    rec = &nvds_calibration_spots (calib)[range->first];
+    nvds_spot_table_build (&tables[num_tables], calib, range,
+        NVDS_OCCUPANCY_DEFAULT_COVERAGE);
+    add_detections (rand, &detections[num_tables], &tables[num_tables],
+        rec->dewarp_width, rec->dewarp_height);
+    num_tables++;
+  }
+
+  name = g_strdup_printf ("Occupancy of %u surfaces", num_tables);
+  ret = run_benchmark (name, tables, detections, num_tables) &&
+      benchmark_row (rand, 16) && benchmark_row (rand, 128) &&
+      benchmark_row (rand, 1024);
+
+done:
+  for (i = 0; i < num_tables; i++) {
+    nvds_spot_table_clear (&tables[i]);
+    nvds_detection_batch_free (&detections[i]);
+  }
+  g_free (name);
+  g_free (detections);
+  g_free (tables);
+  g_rand_free (rand);
+  nvds_calibration_unref (calib);
+  return ret;
+}
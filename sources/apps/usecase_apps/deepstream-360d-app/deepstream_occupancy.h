@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_OCCUPANCY_H__
+#define __NVGSTDS_OCCUPANCY_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#include "deepstream_calibration.h"
+
+/** Spots per block of the index, one vector of 8 lanes. */
+#define NVDS_OCCUPANCY_BLOCK 8
+#define NVDS_OCCUPANCY_DEFAULT_COVERAGE 0.5
+
+/** Number of guint32 words of an occupancy bit set of @n spots. */
+#define NVDS_OCCUPANCY_WORDS(n) (((n) + 31) / 32)
+
+/**
+ * Spot rectangles of one camera surface, stored as structure of arrays
+ * sorted by their left edge. The spots are split into blocks of
+ * NVDS_OCCUPANCY_BLOCK; each block is compared against a detection in
+ * parallel vector lanes, and the x extent of the blocks (a one level packed
+ * R-tree along the x axis) limits that to the blocks near the detection.
+ * Unused lanes of the last block can never be occupied.
+ */
+typedef struct
+{
+  guint num_spots;
+  guint num_blocks;
+  /* [num_blocks * NVDS_OCCUPANCY_BLOCK] */
+  gfloat *left;
+  gfloat *top;
+  gfloat *right;
+  gfloat *bottom;
+  /** Overlap area needed to occupy the spot: coverage * spot area. */
+  gfloat *min_overlap;
+  /** Calibration record of each spot */
+  guint32 *record;
+  /* [num_blocks] */
+  gfloat *block_left;
+  gfloat *block_right;
+  /** Largest block_right of blocks 0 .. b, to find the first block to test */
+  gfloat *block_reach;
+} NvDsSpotTable;
+
+/** Detection boxes of one surface, in dewarped surface pixels. */
+typedef struct
+{
+  guint count;
+  guint capacity;
+  gfloat *left;
+  gfloat *top;
+  gfloat *right;
+  gfloat *bottom;
+} NvDsDetectionBatch;
+
+/**
+ * Fill @table with @num_spots spots. @rects holds two opposite corners
+ * (x1, y1, x2, y2, in any order) per spot and @records their calibration
+ * records. A spot is occupied when a detection covers at least @coverage
+ * of it.
+ */
+void nvds_spot_table_init (NvDsSpotTable * table, guint num_spots,
+    const gfloat * rects, const guint32 * records, gfloat coverage);
+
+/** Fill @table with the spots of @range. Spots named IGNORE are left out. */
+void nvds_spot_table_build (NvDsSpotTable * table,
+    const NvDsCalibration * calib, const NvDsCalibRange * range,
+    gfloat coverage);
+
+void nvds_spot_table_clear (NvDsSpotTable * table);
+
+void nvds_detection_batch_free (NvDsDetectionBatch * batch);
+
+void nvds_detection_batch_add (NvDsDetectionBatch * batch, gfloat left,
+    gfloat top, gfloat width, gfloat height);
+
+/**
+ * Set bit i of @occupied (NVDS_OCCUPANCY_WORDS (table->num_spots) words)
+ * if spot i of @table is occupied by one of @detections.
+ */
+void nvds_occupancy_eval (const NvDsSpotTable * table,
+    const NvDsDetectionBatch * detections, guint32 * occupied);
+
+/**
+ * Reference implementation of nvds_occupancy_eval(), testing every
+ * detection against every spot.
+ */
+void nvds_occupancy_eval_scalar (const NvDsSpotTable * table,
+    const NvDsDetectionBatch * detections, guint32 * occupied);
+
+const gchar *nvds_occupancy_kernel_name (void);
+
+/**
+ * Time the scalar and the vector evaluator over every surface of the spot
+ * calibration @path, and over synthetic rows of spots, with synthetic
+ * detections and print the cost per surface. Fails if the two disagree.
+ */
+gboolean nvds_occupancy_benchmark (const gchar * path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
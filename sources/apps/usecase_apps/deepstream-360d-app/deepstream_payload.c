@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "deepstream_payload.h"
+#include "nvds_wire.h"
+
+void
+nvds_json_append_string (GString * str, const gchar * value)
+{
+  const gchar *p;
+
+  g_string_append_c (str, '"');
+  for (p = value; *p; p++) {
+    if (*p == '"' || *p == '\\')
+      g_string_append_printf (str, "\\%c", *p);
+    else if ((guchar) * p < 0x20)
+      g_string_append_printf (str, "\\u%04x", (guint) (guchar) * p);
+    else
+      g_string_append_c (str, *p);
+  }
+  g_string_append_c (str, '"');
+}
+
+void
+nvds_json_append_timestamp (GString * str, guint64 timestamp_ns)
+{
+  time_t seconds = timestamp_ns / 1000000000;
+  struct tm tm;
+  gchar buf[32];
+
+  gmtime_r (&seconds, &tm);
+  strftime (buf, sizeof (buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  g_string_append_printf (str, "\"%s.%03uZ\"", buf,
+      (guint) (timestamp_ns / 1000000 % 1000));
+}
+
+guint64
+nvds_frame_timestamp (const NvDsFrameMeta * frame_meta)
+{
+  if (frame_meta->ntp_timestamp)
+    return frame_meta->ntp_timestamp;
+  return (guint64) g_get_real_time () * 1000;
+}
+
+void
+nvds_payload_free (NvDsPayload * payload)
+{
+  g_free (payload->payload);
+  g_free (payload);
+}
+
+NvDsPayload *
+nvds_payload_new (const gchar * data, gsize size, guint comp_id)
+{
+  NvDsPayload *payload = g_new0 (NvDsPayload, 1);
+
+  /* NUL terminated, so text payloads can be logged as they are. */
+  payload->payload = g_malloc (size + 1);
+  memcpy (payload->payload, data, size);
+  ((gchar *) payload->payload)[size] = '\0';
+  payload->payloadSize = size;
+  payload->componentId = comp_id;
+  return payload;
+}
+
+GstBuffer *
+nvds_payload_attach (GstBuffer * buf, GPtrArray * payloads)
+{
+  guint i;
+
+  if (payloads->len == 0)
+    return buf;
+
+  buf = gst_buffer_make_writable (buf);
+  for (i = 0; i < payloads->len; i++) {
+    NvDsMeta *meta = gst_buffer_add_nvds_meta (buf,
+        g_ptr_array_index (payloads, i), (GDestroyNotify) nvds_payload_free);
+    meta->meta_type = NVDS_META_PAYLOAD;
+  }
+  g_ptr_array_set_size (payloads, 0);
+  return buf;
+}
+
+GstBuffer *
+nvds_payload_buffer_new (GPtrArray * payloads)
+{
+  if (payloads->len == 0)
+    return NULL;
+  return nvds_payload_attach (gst_buffer_new (), payloads);
+}
+
+static gboolean
+is_wire_state_change (const NvDsPayload * payload)
+{
+  NvDsWireReader reader;
+  NvDsWireAisleRecord rec;
+
+  if (nvds_wire_reader_init (&reader, payload->payload,
+          payload->payloadSize) < 0)
+    return FALSE;
+  if (reader.kind == NVDS_WIRE_KIND_SPOT)
+    return TRUE;
+  if (reader.kind != NVDS_WIRE_KIND_AISLE)
+    return FALSE;
+  while (nvds_wire_read_aisle (&reader, &rec) > 0) {
+    if (rec.event == NVDS_WIRE_AISLE_ENTRY ||
+        rec.event == NVDS_WIRE_AISLE_EXIT)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+gboolean
+nvds_payload_is_state_change (const NvDsPayload * payload)
+{
+  static const gchar *events[] = { "\"type\":\"parked\"",
+    "\"type\":\"empty\"", "\"type\":\"entry\"", "\"type\":\"exit\""
+  };
+  const gchar *data = (const gchar *) payload->payload;
+  guint i;
+
+  if (nvds_wire_is_binary (payload->payload, payload->payloadSize))
+    return is_wire_state_change (payload);
+  /* Frames of messages are not looked into. */
+  if (nvds_wire_is_frame (payload->payload, payload->payloadSize))
+    return TRUE;
+
+  for (i = 0; i < G_N_ELEMENTS (events); i++) {
+    if (g_strstr_len (data, payload->payloadSize, events[i]))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean
+is_payload_meta (GstMeta * meta)
+{
+  static GQuark dsmeta_quark;
+
+  if (!dsmeta_quark)
+    dsmeta_quark = g_quark_from_static_string (NVDS_META_STRING);
+  return gst_meta_api_type_has_tag (meta->info->api, dsmeta_quark) &&
+      ((NvDsMeta *) meta)->meta_type == NVDS_META_PAYLOAD;
+}
+
+void
+nvds_payload_foreach (GstBuffer * buf, NvDsPayloadFunc func,
+    gpointer user_data)
+{
+  GstMeta *meta;
+  gpointer state = NULL;
+
+  while ((meta = gst_buffer_iterate_meta (buf, &state))) {
+    if (is_payload_meta (meta))
+      func ((const NvDsPayload *) ((NvDsMeta *) meta)->meta_data, user_data);
+  }
+}
+
+GstBuffer *
+nvds_payload_take (GstBuffer * buf, NvDsPayloadFunc func, gpointer user_data)
+{
+  GPtrArray *metas;
+  GstMeta *meta;
+  gpointer state = NULL;
+  guint i;
+
+  /* Most buffers carry no message: only copy those that do. */
+  while ((meta = gst_buffer_iterate_meta (buf, &state))) {
+    if (is_payload_meta (meta))
+      break;
+  }
+  if (!meta)
+    return buf;
+
+  buf = gst_buffer_make_writable (buf);
+  nvds_payload_foreach (buf, func, user_data);
+  metas = g_ptr_array_new ();
+  state = NULL;
+  while ((meta = gst_buffer_iterate_meta (buf, &state))) {
+    if (is_payload_meta (meta))
+      g_ptr_array_add (metas, meta);
+  }
+  for (i = 0; i < metas->len; i++)
+    gst_buffer_remove_meta (buf, (GstMeta *) g_ptr_array_index (metas, i));
+  g_ptr_array_free (metas, TRUE);
+  return buf;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_PAYLOAD_H__
+#define __NVGSTDS_PAYLOAD_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#include "gstnvdsmeta.h"
+
+/** Helpers shared by the in-app analyses to build message payloads. */
+
+void nvds_json_append_string (GString * str, const gchar * value);
+
+/** Append @timestamp_ns (since the epoch) as a quoted ISO 8601 UTC time. */
+void nvds_json_append_timestamp (GString * str, guint64 timestamp_ns);
+
+/** Capture time of a frame: its NTP timestamp, or the current time. */
+guint64 nvds_frame_timestamp (const NvDsFrameMeta * frame_meta);
+
+NvDsPayload *nvds_payload_new (const gchar * data, gsize size, guint comp_id);
+
+void nvds_payload_free (NvDsPayload * payload);
+
+/**
+ * Whether @payload reports a change of state: a spot becoming parked or
+ * empty, or an aisle entry or exit, as opposed to a position update, a
+ * trajectory or counts. JSON payloads, of the msgconv plugins too, are
+ * told by their event type, binary ones by their kind and events.
+ */
+gboolean nvds_payload_is_state_change (const NvDsPayload * payload);
+
+/**
+ * Attach the NvDsPayload's of @payloads to @buf as NVDS_META_PAYLOAD metas
+ * and empty the array. Returns @buf, or a writable copy of it.
+ */
+GstBuffer *nvds_payload_attach (GstBuffer * buf, GPtrArray * payloads);
+
+/**
+ * Buffer without memory that only carries @payloads, for the messages left
+ * once no frame is coming any more, i.e. at EOS. NULL if @payloads is empty.
+ * The display branch drops these buffers.
+ */
+GstBuffer *nvds_payload_buffer_new (GPtrArray * payloads);
+
+typedef void (*NvDsPayloadFunc) (const NvDsPayload * payload,
+    gpointer user_data);
+
+/** Call @func on the payload of each NVDS_META_PAYLOAD meta of @buf. */
+void nvds_payload_foreach (GstBuffer * buf, NvDsPayloadFunc func,
+    gpointer user_data);
+
+/**
+ * Call @func on each payload of @buf like nvds_payload_foreach(), then remove
+ * their metas, which frees them. Returns @buf, or a writable copy of it if
+ * it carried any payload.
+ */
+GstBuffer *nvds_payload_take (GstBuffer * buf, NvDsPayloadFunc func,
+    gpointer user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <math.h>
+
+#include "deepstream_payload.h"
+#include "deepstream_ratelimit.h"
+
+/**
+ * Most messages held back per sensor. Past that, as when the tracks of a
+ * sensor keep changing faster than its rate, the oldest is dropped.
+ */
+#define RATE_LIMIT_MAX_PENDING 4096
+
+typedef struct
+{
+  guint64 key;
+  NvDsPayload *payload;
+} Pending;
+
+typedef struct
+{
+  NvDsRateLimitSensorStats stats;
+  gchar *name;
+  gdouble tokens;
+  /** Monotonic time (us) tokens were last added */
+  gint64 refill_time;
+  /** Pending's, oldest first */
+  GQueue order;
+  /** key -> Pending */
+  GHashTable *pending;
+} Sensor;
+
+struct _NvDsRateLimiter
+{
+  NvDsRateLimitConfig *config;
+  gdouble burst;
+  /** Name -> Sensor */
+  GHashTable *sensors;
+  /** Sensors with messages held back */
+  GQueue backlog;
+  /** Taken by the streaming thread and the readers of the counts */
+  GMutex lock;
+};
+
+static void
+free_sensor (gpointer data)
+{
+  Sensor *sensor = (Sensor *) data;
+  Pending *pending;
+
+  /* The table is keyed by the Pending's. */
+  g_hash_table_destroy (sensor->pending);
+  while ((pending = (Pending *) g_queue_pop_head (&sensor->order))) {
+    nvds_payload_free (pending->payload);
+    g_free (pending);
+  }
+  g_free (sensor->name);
+  g_free (sensor);
+}
+
+NvDsRateLimiter *
+nvds_rate_limiter_new (NvDsRateLimitConfig * config)
+{
+  NvDsRateLimiter *limiter = g_new0 (NvDsRateLimiter, 1);
+
+  limiter->config = config;
+  limiter->burst = config->burst ? config->burst : MAX (ceil (config->rate),
+      1);
+  limiter->sensors = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      free_sensor);
+  g_queue_init (&limiter->backlog);
+  g_mutex_init (&limiter->lock);
+  return limiter;
+}
+
+void
+nvds_rate_limiter_free (NvDsRateLimiter * limiter)
+{
+  if (!limiter)
+    return;
+
+  g_queue_clear (&limiter->backlog);
+  g_hash_table_destroy (limiter->sensors);
+  g_mutex_clear (&limiter->lock);
+  g_free (limiter);
+}
+
+static Sensor *
+get_sensor (NvDsRateLimiter * limiter, const gchar * name, gint64 now)
+{
+  Sensor *sensor = (Sensor *) g_hash_table_lookup (limiter->sensors, name);
+
+  if (sensor)
+    return sensor;
+
+  sensor = g_new0 (Sensor, 1);
+  sensor->name = g_strdup (name);
+  sensor->stats.sensor = sensor->name;
+  sensor->tokens = limiter->burst;
+  sensor->refill_time = now;
+  g_queue_init (&sensor->order);
+  sensor->pending = g_hash_table_new (g_int64_hash, g_int64_equal);
+  g_hash_table_insert (limiter->sensors, sensor->name, sensor);
+  return sensor;
+}
+
+static void
+refill (NvDsRateLimiter * limiter, Sensor * sensor, gint64 now)
+{
+  if (now <= sensor->refill_time)
+    return;
+  sensor->tokens = MIN (limiter->burst, sensor->tokens +
+      (now - sensor->refill_time) * limiter->config->rate / G_USEC_PER_SEC);
+  sensor->refill_time = now;
+}
+
+static NvDsPayload *
+pop_pending (Sensor * sensor)
+{
+  Pending *pending = (Pending *) g_queue_pop_head (&sensor->order);
+  NvDsPayload *payload = pending->payload;
+
+  g_hash_table_remove (sensor->pending, &pending->key);
+  g_free (pending);
+  return payload;
+}
+
+static void
+hold (NvDsRateLimiter * limiter, Sensor * sensor, guint64 key,
+    NvDsPayload * payload)
+{
+  Pending *pending = (Pending *) g_hash_table_lookup (sensor->pending, &key);
+
+  /* The latest value takes the place of the previous one in the order. */
+  if (pending) {
+    nvds_payload_free (pending->payload);
+    pending->payload = payload;
+    sensor->stats.suppressed++;
+    return;
+  }
+
+  if (g_queue_is_empty (&sensor->order))
+    g_queue_push_tail (&limiter->backlog, sensor);
+  if (g_queue_get_length (&sensor->order) >= RATE_LIMIT_MAX_PENDING) {
+    nvds_payload_free (pop_pending (sensor));
+    sensor->stats.dropped++;
+  }
+  pending = g_new (Pending, 1);
+  pending->key = key;
+  pending->payload = payload;
+  g_queue_push_tail (&sensor->order, pending);
+  g_hash_table_insert (sensor->pending, &pending->key, pending);
+}
+
+void
+nvds_rate_limiter_submit (NvDsRateLimiter * limiter, const gchar * sensor_name,
+    guint64 key, NvDsPayload * payload, GPtrArray * payloads, gint64 now)
+{
+  Sensor *sensor;
+
+  g_mutex_lock (&limiter->lock);
+  sensor = get_sensor (limiter, sensor_name, now);
+  refill (limiter, sensor, now);
+  if (g_queue_is_empty (&sensor->order) && sensor->tokens >= 1) {
+    sensor->tokens -= 1;
+    sensor->stats.sent++;
+    g_ptr_array_add (payloads, payload);
+  } else {
+    hold (limiter, sensor, key, payload);
+  }
+  sensor->stats.pending = g_queue_get_length (&sensor->order);
+  g_mutex_unlock (&limiter->lock);
+}
+
+void
+nvds_rate_limiter_flush (NvDsRateLimiter * limiter, GPtrArray * payloads,
+    gint64 now)
+{
+  guint i, num_backlogged;
+
+  g_mutex_lock (&limiter->lock);
+  num_backlogged = g_queue_get_length (&limiter->backlog);
+  for (i = 0; i < num_backlogged; i++) {
+    Sensor *sensor = (Sensor *) g_queue_pop_head (&limiter->backlog);
+
+    refill (limiter, sensor, now);
+    while (sensor->tokens >= 1 && !g_queue_is_empty (&sensor->order)) {
+      sensor->tokens -= 1;
+      sensor->stats.sent++;
+      sensor->stats.delayed++;
+      g_ptr_array_add (payloads, pop_pending (sensor));
+    }
+    sensor->stats.pending = g_queue_get_length (&sensor->order);
+    if (sensor->stats.pending)
+      g_queue_push_tail (&limiter->backlog, sensor);
+  }
+  g_mutex_unlock (&limiter->lock);
+}
+
+void
+nvds_rate_limiter_drain (NvDsRateLimiter * limiter, GPtrArray * payloads)
+{
+  Sensor *sensor;
+
+  g_mutex_lock (&limiter->lock);
+  while ((sensor = (Sensor *) g_queue_pop_head (&limiter->backlog))) {
+    while (!g_queue_is_empty (&sensor->order)) {
+      sensor->stats.sent++;
+      sensor->stats.delayed++;
+      g_ptr_array_add (payloads, pop_pending (sensor));
+    }
+    sensor->stats.pending = 0;
+  }
+  g_mutex_unlock (&limiter->lock);
+}
+
+void
+nvds_rate_limiter_foreach_sensor (NvDsRateLimiter * limiter,
+    NvDsRateLimitFunc func, gpointer user_data)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_mutex_lock (&limiter->lock);
+  g_hash_table_iter_init (&iter, limiter->sensors);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    func (&((Sensor *) value)->stats, user_data);
+  g_mutex_unlock (&limiter->lock);
+}
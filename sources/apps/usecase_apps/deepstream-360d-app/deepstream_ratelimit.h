@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_RATELIMIT_H__
+#define __NVGSTDS_RATELIMIT_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#include "gstnvdsmeta.h"
+
+/**
+ * Rate limiter of the messages of the in-app analyses, with a token bucket
+ * per sensor. A message of a sensor out of tokens is held back, keyed by
+ * what it is about (a spot, a track); a later message with the same key
+ * replaces it, so that only the latest value goes out once the bucket
+ * refills. Held messages go out in the order they were first held.
+ */
+
+typedef struct
+{
+  /** Messages per second per sensor, 0 to not limit */
+  gdouble rate;
+  /** Messages a sensor may send at once, 0 for rate rounded up */
+  guint burst;
+} NvDsRateLimitConfig;
+
+typedef struct _NvDsRateLimiter NvDsRateLimiter;
+
+/** Counts of one sensor since the start. */
+typedef struct
+{
+  const gchar *sensor;
+  guint64 sent;
+  /** Of the sent messages, those that were held back first */
+  guint64 delayed;
+  /** Messages replaced by a later one with the same key, never sent */
+  guint64 suppressed;
+  /** Held messages dropped, oldest first, past the 4096 a sensor may hold */
+  guint64 dropped;
+  /** Messages held back now */
+  guint pending;
+} NvDsRateLimitSensorStats;
+
+typedef void (*NvDsRateLimitFunc) (const NvDsRateLimitSensorStats * stats,
+    gpointer user_data);
+
+NvDsRateLimiter *nvds_rate_limiter_new (NvDsRateLimitConfig * config);
+
+void nvds_rate_limiter_free (NvDsRateLimiter * limiter);
+
+/**
+ * Add @payload of @sensor to @payloads if the sensor has a token left at the
+ * monotonic time @now (us) and no message held back, else hold it back
+ * under @key. Takes @payload.
+ */
+void nvds_rate_limiter_submit (NvDsRateLimiter * limiter, const gchar * sensor,
+    guint64 key, NvDsPayload * payload, GPtrArray * payloads, gint64 now);
+
+/** Add to @payloads the held messages of the sensors that got tokens back. */
+void nvds_rate_limiter_flush (NvDsRateLimiter * limiter, GPtrArray * payloads,
+    gint64 now);
+
+/**
+ * Add to @payloads every held message, whatever the tokens, for none to be
+ * lost at EOS. They are counted as sent late.
+ */
+void nvds_rate_limiter_drain (NvDsRateLimiter * limiter, GPtrArray * payloads);
+
+/** Call @func on the counts of each sensor. Can be called from any thread. */
+void nvds_rate_limiter_foreach_sensor (NvDsRateLimiter * limiter,
+    NvDsRateLimitFunc func, gpointer user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+
+#include "deepstream_roievents.h"
+#include "deepstream_timerwheel.h"
+
+#define NS_PER_MS 1000000
+
+enum
+{
+  TIMER_ENTRY,
+  TIMER_EXIT,
+  TIMER_STALE,
+  NUM_TIMERS
+};
+
+typedef struct
+{
+  guint source;
+  guint64 tracking_id;
+  NvDsTimer timers[NUM_TIMERS];
+  /** Entry was reported */
+  gboolean entered;
+  /** When the track entered the entry ROI, or was last in the exit ROI */
+  guint64 entry_time;
+  guint64 exit_time;
+  /** Last observation */
+  guint8 data[];
+} RoiTrack;
+
+struct _NvDsRoiEvents
+{
+  guint entry_latency;
+  guint exit_latency;
+  guint stop_latency;
+  gsize data_size;
+
+  /** RoiTrack set, keyed by source and tracking id */
+  GHashTable *tracks;
+  NvDsTimerWheel wheel;
+  gboolean started;
+
+  /* Valid during nvds_roi_events_advance() */
+  NvDsRoiEventFunc func;
+  gpointer user_data;
+};
+
+static guint
+track_hash (gconstpointer key)
+{
+  const RoiTrack *track = (const RoiTrack *) key;
+
+  return (guint) (track->tracking_id ^ (track->tracking_id >> 32)) ^
+      (track->source * 0x9e3779b1u);
+}
+
+static gboolean
+track_equal (gconstpointer a, gconstpointer b)
+{
+  const RoiTrack *ta = (const RoiTrack *) a;
+  const RoiTrack *tb = (const RoiTrack *) b;
+
+  return ta->source == tb->source && ta->tracking_id == tb->tracking_id;
+}
+
+NvDsRoiEvents *
+nvds_roi_events_new (guint entry_latency, guint exit_latency,
+    guint stop_latency, gsize data_size)
+{
+  NvDsRoiEvents *events = g_new0 (NvDsRoiEvents, 1);
+
+  events->entry_latency = entry_latency;
+  events->exit_latency = exit_latency;
+  events->stop_latency = stop_latency ? stop_latency :
+      NVDS_ROI_EVENTS_DEFAULT_STOP_LATENCY;
+  events->data_size = data_size;
+  events->tracks = g_hash_table_new_full (track_hash, track_equal, g_free,
+      NULL);
+  return events;
+}
+
+void
+nvds_roi_events_free (NvDsRoiEvents * events)
+{
+  if (!events)
+    return;
+
+  g_hash_table_destroy (events->tracks);
+  g_free (events);
+}
+
+void
+nvds_roi_events_reset (NvDsRoiEvents * events)
+{
+  /* The wheel is initialized again by the next observation. */
+  g_hash_table_remove_all (events->tracks);
+  events->started = FALSE;
+}
+
+void
+nvds_roi_events_update (NvDsRoiEvents * events, NvDsRoiDataFunc func,
+    gpointer user_data)
+{
+  GHashTableIter iter;
+  gpointer key;
+  guint i;
+
+  g_hash_table_iter_init (&iter, events->tracks);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    RoiTrack *track = (RoiTrack *) key;
+
+    if (func (track->data, user_data))
+      continue;
+    for (i = 0; i < NUM_TIMERS; i++)
+      nvds_timer_wheel_cancel (&events->wheel, &track->timers[i]);
+    g_hash_table_iter_remove (&iter);
+  }
+}
+
+guint
+nvds_roi_events_num_tracks (NvDsRoiEvents * events)
+{
+  return g_hash_table_size (events->tracks);
+}
+
+void
+nvds_roi_events_observe (NvDsRoiEvents * events, guint source,
+    guint64 tracking_id, gboolean in_entry, gboolean in_exit,
+    guint64 timestamp_ns, gconstpointer data)
+{
+  NvDsTimerWheel *wheel = &events->wheel;
+  guint64 now = timestamp_ns / NS_PER_MS;
+  RoiTrack key, *track;
+  guint i;
+
+  if (!events->started) {
+    nvds_timer_wheel_init (wheel, now);
+    events->started = TRUE;
+  }
+
+  key.source = source;
+  key.tracking_id = tracking_id;
+  track = (RoiTrack *) g_hash_table_lookup (events->tracks, &key);
+  if (!track) {
+    track = (RoiTrack *) g_malloc0 (sizeof (RoiTrack) + events->data_size);
+    track->source = source;
+    track->tracking_id = tracking_id;
+    for (i = 0; i < NUM_TIMERS; i++) {
+      nvds_timer_init (&track->timers[i]);
+      track->timers[i].tag = i;
+    }
+    g_hash_table_insert (events->tracks, track, track);
+  }
+  memcpy (track->data, data, events->data_size);
+
+  if (!track->entered) {
+    if (!in_entry) {
+      nvds_timer_wheel_cancel (wheel, &track->timers[TIMER_ENTRY]);
+    } else if (!nvds_timer_pending (&track->timers[TIMER_ENTRY])) {
+      track->entry_time = timestamp_ns;
+      nvds_timer_wheel_add (wheel, &track->timers[TIMER_ENTRY],
+          now + events->entry_latency);
+    }
+  }
+
+  /* Each sighting in the exit ROI pushes the exit back. */
+  if (in_exit) {
+    track->exit_time = timestamp_ns;
+    nvds_timer_wheel_add (wheel, &track->timers[TIMER_EXIT],
+        now + events->exit_latency);
+  }
+
+  nvds_timer_wheel_add (wheel, &track->timers[TIMER_STALE],
+      now + events->stop_latency);
+}
+
+static void
+on_timer (NvDsTimer * timer, gpointer user_data)
+{
+  NvDsRoiEvents *events = (NvDsRoiEvents *) user_data;
+  RoiTrack *track = (RoiTrack *) ((guint8 *) (timer - timer->tag) -
+      G_STRUCT_OFFSET (RoiTrack, timers));
+
+  switch (timer->tag) {
+    case TIMER_ENTRY:
+      track->entered = TRUE;
+      events->func (NVDS_ROI_EVENT_ENTRY, track->entry_time, track->data,
+          events->user_data);
+      break;
+    case TIMER_EXIT:
+      events->func (NVDS_ROI_EVENT_EXIT, track->exit_time, track->data,
+          events->user_data);
+      break;
+    case TIMER_STALE:
+      /* Keep the track until its exit is reported. */
+      if (nvds_timer_pending (&track->timers[TIMER_EXIT])) {
+        nvds_timer_wheel_add (&events->wheel, timer,
+            track->timers[TIMER_EXIT].expires + 1);
+        break;
+      }
+      nvds_timer_wheel_cancel (&events->wheel, &track->timers[TIMER_ENTRY]);
+      g_hash_table_remove (events->tracks, track);
+      break;
+  }
+}
+
+void
+nvds_roi_events_advance (NvDsRoiEvents * events, guint64 now_ns,
+    NvDsRoiEventFunc func, gpointer user_data)
+{
+  if (!events->started)
+    return;
+
+  events->func = func;
+  events->user_data = user_data;
+  nvds_timer_wheel_advance (&events->wheel, now_ns / NS_PER_MS, on_timer,
+      events);
+  events->func = NULL;
+  events->user_data = NULL;
+}
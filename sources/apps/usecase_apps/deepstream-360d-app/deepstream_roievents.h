@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_ROIEVENTS_H__
+#define __NVGSTDS_ROIEVENTS_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+/**
+ * Entry and exit events of tracks, confirmed over time instead of being
+ * reported on every frame the foot point is in an entry or exit ROI.
+ *
+ * - entry: the track stayed in the entry ROI for the entry latency. It is
+ *   reported once per track.
+ * - exit: the track was in the exit ROI and then was not seen there for the
+ *   exit latency, either because it left the ROI or the camera view.
+ *
+ * A track not seen for the stop latency is forgotten, once its pending exit
+ * was reported. The timers of all tracks live in one timing wheel.
+ */
+
+typedef enum
+{
+  NVDS_ROI_EVENT_ENTRY,
+  NVDS_ROI_EVENT_EXIT,
+} NvDsRoiEventType;
+
+#define NVDS_ROI_EVENTS_DEFAULT_STOP_LATENCY 2000
+
+typedef struct _NvDsRoiEvents NvDsRoiEvents;
+
+/**
+ * @timestamp_ns is when the track entered the entry ROI, or was last seen
+ * in the exit ROI. @data is the copy of the last observation of the track.
+ */
+typedef void (*NvDsRoiEventFunc) (NvDsRoiEventType type, guint64 timestamp_ns,
+    gconstpointer data, gpointer user_data);
+
+/** Update the last observation @data of a track. FALSE to forget the track. */
+typedef gboolean (*NvDsRoiDataFunc) (gpointer data, gpointer user_data);
+
+/**
+ * Latencies are in ms; a stop latency of 0 selects the default. @data_size
+ * bytes of each observation are kept for the events.
+ */
+NvDsRoiEvents *nvds_roi_events_new (guint entry_latency, guint exit_latency,
+    guint stop_latency, gsize data_size);
+
+void nvds_roi_events_free (NvDsRoiEvents * events);
+
+/** Forget every track, e.g. when the data they hold becomes invalid. */
+void nvds_roi_events_reset (NvDsRoiEvents * events);
+
+/**
+ * Call @func on the last observation of every track, e.g. when what the
+ * data refers to is replaced. The pending events of the tracks are kept,
+ * unless @func returns FALSE.
+ */
+void nvds_roi_events_update (NvDsRoiEvents * events, NvDsRoiDataFunc func,
+    gpointer user_data);
+
+/** Record that track @tracking_id of @source was seen at @timestamp_ns. */
+void nvds_roi_events_observe (NvDsRoiEvents * events, guint source,
+    guint64 tracking_id, gboolean in_entry, gboolean in_exit,
+    guint64 timestamp_ns, gconstpointer data);
+
+/** Report, through @func, the events confirmed up to @now_ns. */
+void nvds_roi_events_advance (NvDsRoiEvents * events, guint64 now_ns,
+    NvDsRoiEventFunc func, gpointer user_data);
+
+guint nvds_roi_events_num_tracks (NvDsRoiEvents * events);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deepstream_roimask.h"
+
+static gint
+compare_float (gconstpointer a, gconstpointer b)
+{
+  gfloat fa = *(const gfloat *) a;
+  gfloat fb = *(const gfloat *) b;
+
+  return (fa > fb) - (fa < fb);
+}
+
+static void
+set_span (NvDsRoiMask * mask, guint row, guint first, guint last)
+{
+  guint64 *words = mask->bits + row * mask->words_per_row;
+  guint c;
+
+  for (c = first; c <= last; c++)
+    words[c >> 6] |= G_GUINT64_CONSTANT (1) << (c & 63);
+}
+
+void
+nvds_roi_mask_build (NvDsRoiMask * mask, const gfloat * points,
+    guint num_points, guint surface_width, guint surface_height,
+    gfloat y_offset, guint cell_size)
+{
+  gfloat *crossings;
+  guint cell;
+  guint row;
+  guint i;
+
+  memset (mask, 0, sizeof (NvDsRoiMask));
+  mask->cell_shift = g_bit_storage (MAX (cell_size, 1)) - 1;
+  cell = 1 << mask->cell_shift;
+  mask->width = (surface_width + cell - 1) >> mask->cell_shift;
+  mask->height = (surface_height + cell - 1) >> mask->cell_shift;
+  mask->words_per_row = (mask->width + 63) / 64;
+
+  if (num_points < 3 || mask->width == 0 || mask->height == 0)
+    return;
+
+  mask->bits = g_new0 (guint64, mask->words_per_row * mask->height);
+  crossings = g_new (gfloat, num_points);
+
+  /* Even-odd scanline fill, sampled at the cell centers. */
+  for (row = 0; row < mask->height; row++) {
+    gfloat y = (row + 0.5f) * cell + y_offset;
+    guint num_crossings = 0;
+
+    for (i = 0; i < num_points; i++) {
+      const gfloat *a = &points[2 * i];
+      const gfloat *b = &points[2 * ((i + 1) % num_points)];
+      if ((a[1] <= y) != (b[1] <= y)) {
+        crossings[num_crossings++] =
+            a[0] + (y - a[1]) * (b[0] - a[0]) / (b[1] - a[1]);
+      }
+    }
+    qsort (crossings, num_crossings, sizeof (gfloat), compare_float);
+
+    for (i = 0; i + 1 < num_crossings; i += 2) {
+      /* Cells whose center c * cell + cell / 2 lies in [x0, x1) */
+      gfloat first = ceilf (crossings[i] / cell - 0.5f);
+      gfloat last = ceilf (crossings[i + 1] / cell - 0.5f) - 1;
+      if (first < 0)
+        first = 0;
+      if (last > mask->width - 1)
+        last = mask->width - 1;
+      if (first <= last)
+        set_span (mask, row, (guint) first, (guint) last);
+    }
+  }
+  g_free (crossings);
+}
+
+void
+nvds_roi_mask_clear (NvDsRoiMask * mask)
+{
+  g_free (mask->bits);
+  memset (mask, 0, sizeof (NvDsRoiMask));
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_ROIMASK_H__
+#define __NVGSTDS_ROIMASK_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#define NVDS_ROI_MASK_DEFAULT_CELL_SIZE 4
+/** Largest cell, in pixels per side */
+#define NVDS_ROI_MASK_MAX_CELL_SIZE 256
+
+/**
+ * Polygon rasterized over a surface at a resolution of one bit per
+ * (1 << cell_shift) x (1 << cell_shift) pixels. A cell is inside when its
+ * center is inside the polygon, so a membership test costs one bit lookup
+ * whatever the number of vertices.
+ */
+typedef struct
+{
+  guint width;
+  guint height;
+  guint cell_shift;
+  guint words_per_row;
+  /** NULL if the polygon has less than 3 vertices; nothing is inside. */
+  guint64 *bits;
+} NvDsRoiMask;
+
+/**
+ * Rasterize the polygon @points (x0, y0, x1, y1 ...) of @num_points vertices
+ * over a @surface_width x @surface_height surface. @y_offset is subtracted
+ * from the vertices, for polygons given in the coordinates of all surfaces
+ * of a camera stacked vertically. @cell_size is rounded down to a power of
+ * two.
+ */
+void nvds_roi_mask_build (NvDsRoiMask * mask, const gfloat * points,
+    guint num_points, guint surface_width, guint surface_height,
+    gfloat y_offset, guint cell_size);
+
+void nvds_roi_mask_clear (NvDsRoiMask * mask);
+
+static inline gboolean
+nvds_roi_mask_test (const NvDsRoiMask * mask, gfloat x, gfloat y)
+{
+  guint cx, cy;
+
+  if (!mask->bits || x < 0 || y < 0)
+    return FALSE;
+  cx = (guint) x >> mask->cell_shift;
+  cy = (guint) y >> mask->cell_shift;
+  if (cx >= mask->width || cy >= mask->height)
+    return FALSE;
+  return (mask->bits[cy * mask->words_per_row + (cx >> 6)] >> (cx & 63)) & 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
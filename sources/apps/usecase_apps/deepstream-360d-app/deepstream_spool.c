@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "deepstream_common.h"
+#include "deepstream_spool.h"
+
+#define SPOOL_MAGIC "NVDSSPL1"
+#define SPOOL_CURSOR_FILE "cursor"
+#define SPOOL_SEGMENT_SUFFIX ".seg"
+/** Magic and sequence number */
+#define SPOOL_SEGMENT_HEADER 16
+/** Records consumed between two saves of the cursor */
+#define SPOOL_CURSOR_INTERVAL 64
+
+#define SPOOL_ALIGN(n) (((n) + 7) & ~(gsize) 7)
+
+/** Header of a record, followed by its bytes padded to 8. */
+typedef struct
+{
+  /** Written last: 0 where the records of a segment end */
+  guint32 size;
+  /** Over comp_id then the bytes */
+  guint32 crc;
+  guint32 comp_id;
+  guint32 reserved;
+} SpoolRecord;
+
+typedef struct
+{
+  guint64 seq;
+  gchar *path;
+  guint8 *data;
+  gsize size;
+} SpoolSegment;
+
+typedef struct
+{
+  guint64 seq;
+  guint64 offset;
+} SpoolCursor;
+
+struct _NvDsSpool
+{
+  gchar *dir;
+  gsize segment_size;
+  guint max_segments;
+  gint cursor_fd;
+
+  GMutex lock;
+  GCond cond;
+  /** SpoolSegment's, the one read first and the one written last */
+  GQueue segments;
+  gsize read_offset;
+  gsize write_offset;
+  /** Changes whenever the oldest record does */
+  guint64 read_token;
+  guint uncommitted;
+  gboolean interrupted;
+  NvDsSpoolStats stats;
+};
+
+static guint32
+record_crc (guint32 comp_id, const guint8 * data, gsize size)
+{
+  guint32 crc = crc32 (0, (const Bytef *) &comp_id, sizeof (comp_id));
+
+  return crc32 (crc, data, size);
+}
+
+/**
+ * The valid record at @offset of @segment, or NULL where its records end:
+ * past its last record, at a torn one, or at a corrupted one.
+ */
+static const SpoolRecord *
+get_record (NvDsSpool * spool, const SpoolSegment * segment, gsize offset,
+    gboolean count_corrupted)
+{
+  const SpoolRecord *rec = (const SpoolRecord *) (segment->data + offset);
+
+  if (offset + sizeof (SpoolRecord) > segment->size || !rec->size ||
+      rec->size > segment->size - offset - sizeof (SpoolRecord))
+    return NULL;
+  if (rec->crc != record_crc (rec->comp_id, (const guint8 *) (rec + 1),
+          rec->size)) {
+    if (count_corrupted)
+      spool->stats.corrupted++;
+    return NULL;
+  }
+  return rec;
+}
+
+static gsize
+record_span (const SpoolRecord * rec)
+{
+  return sizeof (SpoolRecord) + SPOOL_ALIGN (rec->size);
+}
+
+static void
+save_cursor (NvDsSpool * spool)
+{
+  SpoolSegment *head = (SpoolSegment *) g_queue_peek_head (&spool->segments);
+  SpoolCursor cursor;
+
+  if (!head || spool->cursor_fd < 0)
+    return;
+  cursor.seq = head->seq;
+  cursor.offset = spool->read_offset;
+  if (pwrite (spool->cursor_fd, &cursor, sizeof (cursor), 0) !=
+      sizeof (cursor)) {
+    NVGSTDS_WARN_MSG_V ("Failed to save the spool cursor: %s",
+        g_strerror (errno));
+  }
+  spool->uncommitted = 0;
+}
+
+static void
+unmap_segment (SpoolSegment * segment, gboolean remove)
+{
+  munmap (segment->data, segment->size);
+  if (remove)
+    unlink (segment->path);
+  g_free (segment->path);
+  g_free (segment);
+}
+
+static SpoolSegment *
+map_segment (const gchar * path, guint64 seq, gsize size, gboolean create)
+{
+  SpoolSegment *segment = NULL;
+  gint fd;
+  gint err;
+  struct stat st;
+  gpointer data;
+
+  fd = open (path, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+  if (fd < 0) {
+    NVGSTDS_ERR_MSG_V ("Failed to open spool segment '%s': %s", path,
+        g_strerror (errno));
+    return NULL;
+  }
+  if (create) {
+    /* Reserve the blocks now: writing a hole of a full disk through the
+     * mapping would raise SIGBUS. */
+    err = posix_fallocate (fd, 0, size);
+    if (err) {
+      NVGSTDS_ERR_MSG_V ("Failed to allocate spool segment '%s': %s", path,
+          g_strerror (err));
+      close (fd);
+      unlink (path);
+      return NULL;
+    }
+  } else if (fstat (fd, &st) || (gsize) st.st_size < SPOOL_SEGMENT_HEADER) {
+    close (fd);
+    return NULL;
+  } else {
+    size = st.st_size;
+  }
+
+  data = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED) {
+    NVGSTDS_ERR_MSG_V ("Failed to map spool segment '%s': %s", path,
+        g_strerror (errno));
+    if (create)
+      unlink (path);
+    return NULL;
+  }
+
+  segment = g_new0 (SpoolSegment, 1);
+  segment->seq = seq;
+  segment->path = g_strdup (path);
+  segment->data = (guint8 *) data;
+  segment->size = size;
+  if (create) {
+    memcpy (segment->data, SPOOL_MAGIC, 8);
+    memcpy (segment->data + 8, &seq, sizeof (seq));
+  } else if (memcmp (segment->data, SPOOL_MAGIC, 8) ||
+      memcmp (segment->data + 8, &seq, sizeof (seq))) {
+    unmap_segment (segment, FALSE);
+    return NULL;
+  }
+  return segment;
+}
+
+static gchar *
+segment_path (NvDsSpool * spool, guint64 seq)
+{
+  gchar name[32];
+
+  g_snprintf (name, sizeof (name), "%020" G_GUINT64_FORMAT
+      SPOOL_SEGMENT_SUFFIX, seq);
+  return g_build_filename (spool->dir, name, NULL);
+}
+
+static gboolean
+add_segment (NvDsSpool * spool, guint64 seq)
+{
+  gchar *path = segment_path (spool, seq);
+  SpoolSegment *segment = map_segment (path, seq, spool->segment_size, TRUE);
+
+  g_free (path);
+  if (!segment)
+    return FALSE;
+  g_queue_push_tail (&spool->segments, segment);
+  spool->write_offset = SPOOL_SEGMENT_HEADER;
+  return TRUE;
+}
+
+/** Count the records of @segment from @offset; returns where they end. */
+static gsize
+scan_segment (NvDsSpool * spool, const SpoolSegment * segment, gsize offset,
+    guint64 * records, guint64 * bytes)
+{
+  const SpoolRecord *rec;
+
+  while ((rec = get_record (spool, segment, offset, TRUE))) {
+    (*records)++;
+    *bytes += rec->size;
+    offset += record_span (rec);
+  }
+  return offset;
+}
+
+/** Remove the oldest segment; its records that were not read are lost. */
+static void
+remove_head (NvDsSpool * spool, gboolean dropped)
+{
+  SpoolSegment *head = (SpoolSegment *) g_queue_pop_head (&spool->segments);
+  guint64 records = 0, bytes = 0;
+
+  if (dropped) {
+    scan_segment (spool, head, spool->read_offset, &records, &bytes);
+    spool->stats.dropped += records;
+    spool->stats.pending -= records;
+    spool->stats.pending_bytes -= bytes;
+    spool->read_token++;
+  }
+  unmap_segment (head, TRUE);
+  spool->read_offset = SPOOL_SEGMENT_HEADER;
+  save_cursor (spool);
+}
+
+static gint
+compare_seq (gconstpointer a, gconstpointer b)
+{
+  guint64 sa = *(const guint64 *) a, sb = *(const guint64 *) b;
+
+  return sa < sb ? -1 : sa > sb;
+}
+
+/** Map the segments left by the previous run, from its cursor on. */
+static gboolean
+recover (NvDsSpool * spool)
+{
+  GDir *dir;
+  const gchar *name;
+  GArray *seqs = g_array_new (FALSE, FALSE, sizeof (guint64));
+  SpoolCursor cursor = { 0, 0 };
+  guint i;
+
+  if (pread (spool->cursor_fd, &cursor, sizeof (cursor), 0) !=
+      sizeof (cursor))
+    memset (&cursor, 0, sizeof (cursor));
+
+  dir = g_dir_open (spool->dir, 0, NULL);
+  while (dir && (name = g_dir_read_name (dir))) {
+    gchar *end;
+    guint64 seq;
+
+    if (!g_str_has_suffix (name, SPOOL_SEGMENT_SUFFIX))
+      continue;
+    seq = g_ascii_strtoull (name, &end, 10);
+    if (!g_strcmp0 (end, SPOOL_SEGMENT_SUFFIX))
+      g_array_append_val (seqs, seq);
+  }
+  if (dir)
+    g_dir_close (dir);
+  g_array_sort (seqs, compare_seq);
+
+  for (i = 0; i < seqs->len; i++) {
+    guint64 seq = g_array_index (seqs, guint64, i);
+    gchar *path = segment_path (spool, seq);
+    SpoolSegment *segment = NULL;
+
+    if (seq >= cursor.seq)
+      segment = map_segment (path, seq, 0, FALSE);
+    if (segment) {
+      g_queue_push_tail (&spool->segments, segment);
+    } else {
+      /* Consumed, or not a segment of ours. */
+      if (seq >= cursor.seq)
+        NVGSTDS_WARN_MSG_V ("Dropping invalid spool segment '%s'", path);
+      unlink (path);
+    }
+    g_free (path);
+  }
+  g_array_free (seqs, TRUE);
+
+  if (g_queue_is_empty (&spool->segments))
+    return add_segment (spool, cursor.seq + 1);
+
+  spool->read_offset = SPOOL_SEGMENT_HEADER;
+  if (((SpoolSegment *) g_queue_peek_head (&spool->segments))->seq ==
+      cursor.seq && cursor.offset >= SPOOL_SEGMENT_HEADER)
+    spool->read_offset = SPOOL_ALIGN (cursor.offset);
+
+  for (i = 0; i < g_queue_get_length (&spool->segments); i++) {
+    SpoolSegment *segment =
+        (SpoolSegment *) g_queue_peek_nth (&spool->segments, i);
+
+    /* Appends go on after the last valid record, over a torn one. */
+    spool->write_offset = scan_segment (spool, segment,
+        i ? SPOOL_SEGMENT_HEADER : spool->read_offset, &spool->stats.pending,
+        &spool->stats.pending_bytes);
+  }
+  if (spool->stats.pending) {
+    NVGSTDS_INFO_MSG_V ("Spool '%s' holds %" G_GUINT64_FORMAT
+        " messages of the previous run", spool->dir, spool->stats.pending);
+  }
+  return TRUE;
+}
+
+NvDsSpool *
+nvds_spool_open (const NvDsSpoolConfig * config)
+{
+  NvDsSpool *spool = g_new0 (NvDsSpool, 1);
+  guint64 max_size = config->max_size ? config->max_size :
+      NVDS_SPOOL_DEFAULT_MAX_SIZE;
+  gchar *path;
+
+  spool->dir = g_strdup (config->dir);
+  spool->segment_size = SPOOL_ALIGN (config->segment_size ?
+      config->segment_size : NVDS_SPOOL_DEFAULT_SEGMENT_SIZE);
+  spool->max_segments = MAX (max_size / spool->segment_size, 2);
+  spool->read_offset = SPOOL_SEGMENT_HEADER;
+  g_mutex_init (&spool->lock);
+  g_cond_init (&spool->cond);
+  g_queue_init (&spool->segments);
+
+  if (g_mkdir_with_parents (spool->dir, 0755)) {
+    NVGSTDS_ERR_MSG_V ("Failed to create spool directory '%s': %s",
+        spool->dir, g_strerror (errno));
+    spool->cursor_fd = -1;
+    goto error;
+  }
+  path = g_build_filename (spool->dir, SPOOL_CURSOR_FILE, NULL);
+  spool->cursor_fd = open (path, O_RDWR | O_CREAT, 0644);
+  g_free (path);
+  if (spool->cursor_fd < 0) {
+    NVGSTDS_ERR_MSG_V ("Failed to open the cursor of spool '%s': %s",
+        spool->dir, g_strerror (errno));
+    goto error;
+  }
+  if (!recover (spool))
+    goto error;
+  return spool;
+
+error:
+  nvds_spool_close (spool);
+  return NULL;
+}
+
+void
+nvds_spool_close (NvDsSpool * spool)
+{
+  SpoolSegment *segment;
+
+  if (!spool)
+    return;
+
+  save_cursor (spool);
+  while ((segment = (SpoolSegment *) g_queue_pop_head (&spool->segments)))
+    unmap_segment (segment, FALSE);
+  if (spool->cursor_fd >= 0)
+    close (spool->cursor_fd);
+  g_mutex_clear (&spool->lock);
+  g_cond_clear (&spool->cond);
+  g_free (spool->dir);
+  g_free (spool);
+}
+
+gboolean
+nvds_spool_append (NvDsSpool * spool, const guint8 * data, gsize size,
+    guint comp_id)
+{
+  gsize span = sizeof (SpoolRecord) + SPOOL_ALIGN (size);
+  SpoolSegment *tail;
+  SpoolRecord *rec;
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&spool->lock);
+  if (!size || span > spool->segment_size - SPOOL_SEGMENT_HEADER) {
+    spool->stats.dropped++;
+    goto done;
+  }
+
+  tail = (SpoolSegment *) g_queue_peek_tail (&spool->segments);
+  if (spool->write_offset + span > tail->size) {
+    if (g_queue_get_length (&spool->segments) >= spool->max_segments)
+      remove_head (spool, TRUE);
+    if (!add_segment (spool, tail->seq + 1)) {
+      spool->stats.dropped++;
+      goto done;
+    }
+    tail = (SpoolSegment *) g_queue_peek_tail (&spool->segments);
+  }
+
+  rec = (SpoolRecord *) (tail->data + spool->write_offset);
+  memcpy (rec + 1, data, size);
+  rec->comp_id = comp_id;
+  rec->reserved = 0;
+  rec->crc = record_crc (comp_id, data, size);
+  /* The size makes the record visible after a crash: store it last. */
+  __atomic_store_n (&rec->size, (guint32) size, __ATOMIC_RELEASE);
+  spool->write_offset += span;
+
+  spool->stats.appended++;
+  spool->stats.pending++;
+  spool->stats.pending_bytes += size;
+  g_cond_signal (&spool->cond);
+  ret = TRUE;
+
+done:
+  g_mutex_unlock (&spool->lock);
+  return ret;
+}
+
+gboolean
+nvds_spool_peek (NvDsSpool * spool, GString * record, guint * comp_id,
+    guint64 * token, gint64 end_time)
+{
+  gboolean ret = FALSE;
+
+  g_mutex_lock (&spool->lock);
+  while (!spool->interrupted) {
+    SpoolSegment *head = (SpoolSegment *) g_queue_peek_head (&spool->segments);
+    const SpoolRecord *rec = get_record (spool, head, spool->read_offset,
+        head != g_queue_peek_tail (&spool->segments) ||
+        spool->read_offset < spool->write_offset);
+
+    if (rec) {
+      g_string_truncate (record, 0);
+      g_string_append_len (record, (const gchar *) (rec + 1), rec->size);
+      *comp_id = rec->comp_id;
+      *token = spool->read_token;
+      ret = TRUE;
+      break;
+    }
+    /* The records of a segment end once a later one is written. */
+    if (head != g_queue_peek_tail (&spool->segments)) {
+      remove_head (spool, FALSE);
+      continue;
+    }
+    if (!g_cond_wait_until (&spool->cond, &spool->lock, end_time))
+      break;
+  }
+  g_mutex_unlock (&spool->lock);
+  return ret;
+}
+
+void
+nvds_spool_consume (NvDsSpool * spool, guint64 token)
+{
+  SpoolSegment *head;
+  const SpoolRecord *rec;
+
+  g_mutex_lock (&spool->lock);
+  head = (SpoolSegment *) g_queue_peek_head (&spool->segments);
+  rec = get_record (spool, head, spool->read_offset, FALSE);
+  if (token == spool->read_token && rec) {
+    spool->read_offset += record_span (rec);
+    spool->read_token++;
+    spool->stats.consumed++;
+    spool->stats.pending--;
+    spool->stats.pending_bytes -= rec->size;
+    if (++spool->uncommitted >= SPOOL_CURSOR_INTERVAL)
+      save_cursor (spool);
+  }
+  g_mutex_unlock (&spool->lock);
+}
+
+void
+nvds_spool_interrupt (NvDsSpool * spool)
+{
+  g_mutex_lock (&spool->lock);
+  spool->interrupted = TRUE;
+  g_cond_broadcast (&spool->cond);
+  g_mutex_unlock (&spool->lock);
+}
+
+void
+nvds_spool_get_stats (NvDsSpool * spool, NvDsSpoolStats * stats)
+{
+  g_mutex_lock (&spool->lock);
+  *stats = spool->stats;
+  stats->segments = g_queue_get_length (&spool->segments);
+  g_mutex_unlock (&spool->lock);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_SPOOL_H__
+#define __NVGSTDS_SPOOL_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+/**
+ * Append-only log of messages on disk, read in order by one consumer.
+ *
+ * The log is a directory of fixed-size segment files, memory-mapped, named
+ * after their sequence number. Each record is CRC-checked, so that a record
+ * torn by a crash ends the log instead of being sent. The position of the
+ * consumer is saved in a cursor file now and then, and at close: messages
+ * that were not consumed are read again after a restart, and a few that
+ * were may be too. Once the log holds max-size bytes, the oldest segment is
+ * dropped to make room, whether it was read or not.
+ */
+
+#define NVDS_SPOOL_DEFAULT_MAX_SIZE (1024 * 1024 * 1024ULL)
+#define NVDS_SPOOL_DEFAULT_SEGMENT_SIZE (16 * 1024 * 1024)
+
+typedef struct _NvDsSpool NvDsSpool;
+
+typedef struct
+{
+  gchar *dir;
+  /** Bytes of the segments, 0 for the default */
+  guint64 max_size;
+  /** Bytes of a segment, 0 for the default */
+  guint segment_size;
+} NvDsSpoolConfig;
+
+/** Counts since the spool was opened, plus its backlog. */
+typedef struct
+{
+  guint64 appended;
+  guint64 consumed;
+  /** Records dropped with the oldest segment, or too large for one */
+  guint64 dropped;
+  /** Records whose CRC did not match */
+  guint64 corrupted;
+  /** Records not consumed yet, and their size */
+  guint64 pending;
+  guint64 pending_bytes;
+  guint segments;
+} NvDsSpoolStats;
+
+/**
+ * Open the spool in config->dir, creating it if needed, and recover the
+ * records left by the previous run. Returns NULL on error.
+ */
+NvDsSpool *nvds_spool_open (const NvDsSpoolConfig * config);
+
+/** Save the position of the consumer and release the segments. */
+void nvds_spool_close (NvDsSpool * spool);
+
+/** Append a record; returns FALSE if it was dropped. Never blocks on I/O
+ * beyond the creation of a segment. */
+gboolean nvds_spool_append (NvDsSpool * spool, const guint8 * data, gsize size,
+    guint comp_id);
+
+/**
+ * Copy the oldest record that was not consumed into @record, waiting for
+ * one until the monotonic @end_time. Returns FALSE on timeout or once
+ * nvds_spool_interrupt() was called. The record stays the oldest until
+ * nvds_spool_consume() is called with @token.
+ */
+gboolean nvds_spool_peek (NvDsSpool * spool, GString * record,
+    guint * comp_id, guint64 * token, gint64 end_time);
+
+/** Consume the record peeked with @token, unless it was dropped since. */
+void nvds_spool_consume (NvDsSpool * spool, guint64 token);
+
+/** Wake up and fail the current and later nvds_spool_peek() calls. */
+void nvds_spool_interrupt (NvDsSpool * spool);
+
+void nvds_spool_get_stats (NvDsSpool * spool, NvDsSpoolStats * stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,658 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+
+#include "deepstream_common.h"
+#include "deepstream_debounce.h"
+#include "deepstream_occupancy.h"
+#include "deepstream_payload.h"
+#include "deepstream_spotanalysis.h"
+#include "deepstream_spotcounts.h"
+
+/**
+ * Occupancy of the spots of one surface. Unlike NvSpotResult, which is
+ * shared with the nvspotanalysis plugin, the number of spots is not bounded.
+ */
+typedef struct
+{
+  const NvDsFrameMeta *frame_meta;
+  const NvDsSpotTable *table;
+  /** Bit i is set if spot i of the table is seen occupied in the frame */
+  guint32 *observed;
+  /** Confirmed occupancy of the spots, see NvDsDebouncer */
+  const guint32 *occupied;
+  guint num_statechanged;
+  /** Spots of the table whose state changed */
+  guint32 *statechanged;
+} NvDsSpotViewResult;
+
+struct _NvDsSpotAnalysis
+{
+  NvDsSpotConfig *config;
+  GQuark dsmeta_quark;
+  NvDsDetectionBatch detections;
+  /** Per-camera limit of the per-spot messages, NULL unless rate-limit is
+   * set */
+  NvDsRateLimiter *limiter;
+  NvDsSpotViewResult result;
+  /** Spots the result buffers are allocated for */
+  guint result_capacity;
+  GPtrArray *payloads;
+  GString *message;
+  /** Writer of the binary messages, NVDS_PAYLOAD_BINARY */
+  NvDsWireWriter wire;
+
+  /** Calibration the spot tables were built for, referenced. */
+  NvDsCalibration *table_calib;
+  /** [num_cameras][num_surfaces], like NvDsCalibration::ranges */
+  NvDsSpotTable *tables;
+  /** First word of the state bit sets of each table */
+  guint *state_offsets;
+  /** Last published occupancy of the spots of every table */
+  guint32 *published;
+  /** Spots whose occupancy was published at least once */
+  guint32 *known;
+  NvDsDebouncer debouncer;
+  NvDsSpotCounts counts;
+  /** Monotonic time (us) of the last roll-up message */
+  gint64 last_rollup;
+  guint64 rollup_seq;
+
+  /* Changes waiting for the next batched message, NVDS_SPOT_PUBLISH_BATCHED.
+   * Bit sets laid out like published. */
+  guint32 *pending;
+  /** Published state of a pending spot before its first change */
+  guint32 *origin;
+  /** Whether that state had been published at all */
+  guint32 *origin_known;
+  /** Timestamp of the last change of every pending spot, [num_words * 32] */
+  guint64 *pending_time;
+  guint num_pending;
+  /** Monotonic time (us) the current batching window started */
+  gint64 window_start;
+  guint64 batch_seq;
+
+  /* Read by nvds_spot_analysis_get_stats() from other threads. */
+  volatile gint raw_changes;
+  volatile gint published_changes;
+  volatile gint messages;
+};
+
+NvDsSpotAnalysis *
+nvds_spot_analysis_new (NvDsSpotConfig * config)
+{
+  NvDsSpotAnalysis *analysis = g_new0 (NvDsSpotAnalysis, 1);
+
+  analysis->config = config;
+  analysis->dsmeta_quark = g_quark_from_static_string (NVDS_META_STRING);
+  analysis->payloads = g_ptr_array_new ();
+  analysis->message = g_string_sized_new (1024);
+  if (config->payload_type == NVDS_PAYLOAD_BINARY)
+    nvds_wire_writer_init (&analysis->wire);
+  /* Batched messages are already limited by the publish interval. */
+  if (config->rate_limit.rate > 0 &&
+      config->publish_mode == NVDS_SPOT_PUBLISH_PER_SPOT)
+    analysis->limiter = nvds_rate_limiter_new (&config->rate_limit);
+
+  GST_INFO ("Spot analysis uses the %s occupancy kernel",
+      nvds_occupancy_kernel_name ());
+  return analysis;
+}
+
+static void
+free_tables (NvDsSpotAnalysis * analysis)
+{
+  const NvDsCalibration *calib = analysis->table_calib;
+  guint i;
+
+  if (!calib)
+    return;
+
+  for (i = 0; i < calib->num_cameras * calib->num_surfaces; i++)
+    nvds_spot_table_clear (&analysis->tables[i]);
+  g_free (analysis->tables);
+  g_free (analysis->state_offsets);
+  g_free (analysis->published);
+  g_free (analysis->known);
+  g_free (analysis->pending);
+  g_free (analysis->origin);
+  g_free (analysis->origin_known);
+  g_free (analysis->pending_time);
+  nvds_debouncer_clear (&analysis->debouncer);
+  nvds_spot_counts_clear (&analysis->counts);
+  nvds_calibration_unref (analysis->table_calib);
+  analysis->tables = NULL;
+  analysis->state_offsets = NULL;
+  analysis->published = NULL;
+  analysis->known = NULL;
+  analysis->pending = NULL;
+  analysis->origin = NULL;
+  analysis->origin_known = NULL;
+  analysis->pending_time = NULL;
+  analysis->num_pending = 0;
+  analysis->table_calib = NULL;
+}
+
+/**
+ * Build the spot tables of @calib, unless that was done already. After a
+ * calibration reload the state of every spot is published again, once it is
+ * confirmed.
+ */
+static void
+update_tables (NvDsSpotAnalysis * analysis, const NvDsCalibration * calib)
+{
+  NvDsSpotConfig *config = analysis->config;
+  guint num_tables = calib->num_cameras * calib->num_surfaces;
+  gdouble coverage = config->occupancy_coverage > 0 ?
+      config->occupancy_coverage : NVDS_OCCUPANCY_DEFAULT_COVERAGE;
+  guint num_words = 0;
+  guint *num_spots;
+  guint i;
+
+  if (analysis->table_calib == calib)
+    return;
+
+  free_tables (analysis);
+  analysis->table_calib = nvds_calibration_ref ((NvDsCalibration *) calib);
+  analysis->tables = g_new (NvDsSpotTable, num_tables);
+  analysis->state_offsets = g_new (guint, num_tables);
+  num_spots = g_new (guint, num_tables);
+
+  for (i = 0; i < num_tables; i++) {
+    nvds_spot_table_build (&analysis->tables[i], calib, &calib->ranges[i],
+        coverage);
+    num_spots[i] = analysis->tables[i].num_spots;
+    analysis->state_offsets[i] = num_words;
+    num_words += NVDS_OCCUPANCY_WORDS (analysis->tables[i].num_spots);
+    if (analysis->tables[i].num_spots > analysis->result_capacity)
+      analysis->result_capacity = analysis->tables[i].num_spots;
+  }
+  analysis->published = g_new0 (guint32, num_words);
+  nvds_spot_counts_init (&analysis->counts, calib, analysis->tables,
+      analysis->state_offsets, num_tables);
+  analysis->known = g_new0 (guint32, num_words);
+  if (config->publish_mode == NVDS_SPOT_PUBLISH_BATCHED) {
+    analysis->pending = g_new0 (guint32, num_words);
+    analysis->origin = g_new0 (guint32, num_words);
+    analysis->origin_known = g_new0 (guint32, num_words);
+    analysis->pending_time = g_new (guint64, (gsize) num_words * 32);
+  }
+
+  /* debounce-frames takes precedence over result-threshold (seconds). The
+   * debouncer clamps the window; this only keeps it from wrapping. */
+  if (config->debounce_frames)
+    nvds_debouncer_init (&analysis->debouncer, num_spots, num_tables,
+        config->debounce_frames, FALSE);
+  else
+    nvds_debouncer_init (&analysis->debouncer, num_spots, num_tables,
+        MIN ((guint64) config->result_threshold * 1000, G_MAXUINT), TRUE);
+  g_free (num_spots);
+
+  g_free (analysis->result.observed);
+  g_free (analysis->result.statechanged);
+  analysis->result.observed = g_new (guint32,
+      NVDS_OCCUPANCY_WORDS (analysis->result_capacity));
+  analysis->result.statechanged = g_new (guint32, analysis->result_capacity);
+}
+
+void
+nvds_spot_analysis_free (NvDsSpotAnalysis * analysis)
+{
+  if (!analysis)
+    return;
+
+  free_tables (analysis);
+  nvds_detection_batch_free (&analysis->detections);
+  g_free (analysis->result.observed);
+  g_free (analysis->result.statechanged);
+  g_ptr_array_free (analysis->payloads, TRUE);
+  g_string_free (analysis->message, TRUE);
+  nvds_wire_writer_clear (&analysis->wire);
+  nvds_rate_limiter_free (analysis->limiter);
+  g_free (analysis);
+}
+
+/** Append the members of the message of one spot, from "@timestamp" on. */
+static void
+append_spot_event (GString * str, const NvDsCalibration * calib,
+    const NvDsSpotCalibRecord * rec, guint64 timestamp, gboolean occupied)
+{
+  gdouble x = 0, y = 0;
+  guint i;
+
+  for (i = 0; i < NVDS_CALIB_QUAD_POINTS; i++) {
+    x += rec->world[2 * i] / NVDS_CALIB_QUAD_POINTS;
+    y += rec->world[2 * i + 1] / NVDS_CALIB_QUAD_POINTS;
+  }
+
+  g_string_append (str, "\"@timestamp\":");
+  nvds_json_append_timestamp (str, timestamp);
+
+  g_string_append (str, ",\"place\":{\"id\":");
+  nvds_json_append_string (str, nvds_calibration_string (calib, rec->spot_str));
+  g_string_append (str, ",\"type\":");
+  nvds_json_append_string (str, nvds_calibration_string (calib, rec->type));
+  g_string_append (str, ",\"level\":");
+  nvds_json_append_string (str, nvds_calibration_string (calib, rec->level));
+  g_string_append_printf (str, ",\"coordinate\":{\"x\":%.4f,\"y\":%.4f,"
+      "\"z\":0}", x, y);
+
+  g_string_append (str, "},\"sensor\":{\"id\":");
+  nvds_json_append_string (str, nvds_calibration_string (calib,
+          rec->sensor_str));
+  g_string_append (str, ",\"type\":\"Camera\",\"description\":");
+  nvds_json_append_string (str, nvds_calibration_string (calib, rec->cam_desc));
+  g_string_append_printf (str, "},\"event\":{\"type\":\"%s\"}",
+      occupied ? "parked" : "empty");
+}
+
+/** Binary counterpart of append_spot_event(), as one record. */
+static void
+put_spot_record (NvDsWireWriter * wire, const NvDsCalibration * calib,
+    const NvDsSpotCalibRecord * rec, guint64 timestamp, gboolean occupied)
+{
+  gdouble x = 0, y = 0;
+  guint i;
+
+  for (i = 0; i < NVDS_CALIB_QUAD_POINTS; i++) {
+    x += rec->world[2 * i] / NVDS_CALIB_QUAD_POINTS;
+    y += rec->world[2 * i + 1] / NVDS_CALIB_QUAD_POINTS;
+  }
+
+  nvds_wire_writer_record (wire);
+  nvds_wire_put_time (wire, timestamp);
+  nvds_wire_put_string (wire, nvds_calibration_string (calib, rec->spot_str));
+  nvds_wire_put_string (wire, nvds_calibration_string (calib, rec->type));
+  nvds_wire_put_string (wire, nvds_calibration_string (calib, rec->level));
+  nvds_wire_put_string (wire, nvds_calibration_string (calib,
+          rec->sensor_str));
+  nvds_wire_put_string (wire, nvds_calibration_string (calib, rec->cam_desc));
+  nvds_wire_put_sint (wire, nvds_wire_quantize (x));
+  nvds_wire_put_sint (wire, nvds_wire_quantize (y));
+  nvds_wire_put_uint (wire, occupied ? NVDS_WIRE_SPOT_PARKED :
+      NVDS_WIRE_SPOT_EMPTY);
+}
+
+static void
+build_message (GString * str, const NvDsCalibration * calib,
+    const NvDsSpotCalibRecord * rec, const NvDsFrameMeta * frame_meta,
+    gboolean occupied)
+{
+  g_string_truncate (str, 0);
+  g_string_append (str, "{\"messageid\":");
+  g_string_append_printf (str, "\"%s-%d-%u\"",
+      nvds_calibration_string (calib, rec->sensor_str), frame_meta->frame_num,
+      rec->spot_index);
+  g_string_append (str, ",\"mdsversion\":\"1.0\",");
+  append_spot_event (str, calib, rec, nvds_frame_timestamp (frame_meta),
+      occupied);
+  g_string_append_c (str, '}');
+}
+
+/**
+ * Remember the spots @changed of state word @word for the next batched
+ * message, along with their published state before the first change.
+ * Must be called before published and known are updated.
+ */
+static void
+add_pending (NvDsSpotAnalysis * analysis, guint word, guint32 changed,
+    guint64 timestamp)
+{
+  guint32 first = changed & ~analysis->pending[word];
+  gint bit = -1;
+
+  analysis->origin[word] = (analysis->origin[word] & ~first) |
+      (analysis->published[word] & first);
+  analysis->origin_known[word] = (analysis->origin_known[word] & ~first) |
+      (analysis->known[word] & first);
+  analysis->pending[word] |= changed;
+  while ((bit = g_bit_nth_lsf (changed, bit)) >= 0)
+    analysis->pending_time[(gsize) word * 32 + bit] = timestamp;
+
+  if (analysis->num_pending == 0)
+    analysis->window_start = g_get_monotonic_time ();
+  analysis->num_pending += __builtin_popcount (first);
+}
+
+/**
+ * Queue one payload with the pending spots of all views whose state differs
+ * from the one published before the window, and empty the window. Spots
+ * that went back to their previous state are left out.
+ */
+static void
+flush_pending (NvDsSpotAnalysis * analysis, const NvDsCalibration * calib)
+{
+  GString *str = analysis->message;
+  gboolean binary = analysis->config->payload_type == NVDS_PAYLOAD_BINARY;
+  guint64 now = (guint64) g_get_real_time () * 1000;
+  guint num_tables = calib->num_cameras * calib->num_surfaces;
+  guint num_events = 0;
+  guint view, w;
+
+  if (analysis->num_pending == 0)
+    return;
+
+  if (binary) {
+    nvds_wire_writer_begin (&analysis->wire, NVDS_WIRE_KIND_SPOT, now);
+  } else {
+    g_string_truncate (str, 0);
+    g_string_append_printf (str, "{\"messageid\":\"spot-%u-%"
+        G_GUINT64_FORMAT "\",\"mdsversion\":\"1.0\",\"@timestamp\":",
+        analysis->config->comp_id, analysis->batch_seq);
+    nvds_json_append_timestamp (str, now);
+    g_string_append (str, ",\"events\":[");
+  }
+
+  for (view = 0; view < num_tables; view++) {
+    const NvDsSpotTable *table = &analysis->tables[view];
+    guint offset = analysis->state_offsets[view];
+
+    for (w = 0; w < NVDS_OCCUPANCY_WORDS (table->num_spots); w++) {
+      guint32 *pending = &analysis->pending[offset + w];
+      guint32 *published = &analysis->published[offset + w];
+      guint32 emit = *pending & ((*published ^ analysis->origin[offset + w]) |
+          ~analysis->origin_known[offset + w]);
+      gint bit = -1;
+
+      while ((bit = g_bit_nth_lsf (emit, bit)) >= 0) {
+        const NvDsSpotCalibRecord *rec =
+            &nvds_calibration_spots (calib)[table->record[w * 32 + bit]];
+        guint64 timestamp =
+            analysis->pending_time[(gsize) (offset + w) * 32 + bit];
+
+        if (binary) {
+          put_spot_record (&analysis->wire, calib, rec, timestamp,
+              (*published >> bit) & 1);
+          num_events++;
+          continue;
+        }
+        if (num_events++)
+          g_string_append_c (str, ',');
+        g_string_append_c (str, '{');
+        append_spot_event (str, calib, rec, timestamp, (*published >> bit) & 1);
+        g_string_append_c (str, '}');
+      }
+      *pending = 0;
+    }
+  }
+  analysis->num_pending = 0;
+
+  if (num_events == 0)
+    return;
+
+  if (binary) {
+    g_ptr_array_add (analysis->payloads,
+        nvds_wire_writer_finish (&analysis->wire, analysis->config->comp_id));
+  } else {
+    g_string_append (str, "]}");
+    g_ptr_array_add (analysis->payloads, nvds_payload_new (str->str, str->len,
+            analysis->config->comp_id));
+  }
+  analysis->batch_seq++;
+  g_atomic_int_add (&analysis->published_changes, num_events);
+  g_atomic_int_inc (&analysis->messages);
+}
+
+/**
+ * Evaluate the spots of one spot surface against its objects, and record
+ * the spots whose confirmed occupancy changed in the view result.
+ */
+static gboolean
+evaluate_view (NvDsSpotAnalysis * analysis, const NvDsCalibration * calib,
+    const NvDsFrameMeta * frame_meta)
+{
+  NvDsSpotConfig *config = analysis->config;
+  NvDsSpotViewResult *result = &analysis->result;
+  const NvDsCalibRange *range;
+  const NvDsSpotCalibRecord *rec;
+  const NvDsSpotTable *table;
+  const guint32 *decided;
+  guint32 *published, *known;
+  guint64 timestamp = nvds_frame_timestamp (frame_meta);
+  gfloat scale_x, scale_y;
+  guint view, i, w, raw_changes;
+
+  range = nvds_calibration_lookup (calib,
+      config->source_serials[frame_meta->stream_id],
+      frame_meta->surface_index);
+  if (!range || range->count == 0)
+    return FALSE;
+
+  view = range - calib->ranges;
+  table = &analysis->tables[view];
+  if (table->num_spots == 0)
+    return FALSE;
+
+  rec = &nvds_calibration_spots (calib)[range->first];
+  scale_x = (gfloat) rec->dewarp_width / config->frame_width;
+  scale_y = (gfloat) rec->dewarp_height / config->frame_height;
+
+  analysis->detections.count = 0;
+  for (i = 0; i < frame_meta->num_rects; i++) {
+    const NvOSD_RectParams *rect = &frame_meta->obj_params[i].rect_params;
+
+    nvds_detection_batch_add (&analysis->detections, rect->left * scale_x,
+        rect->top * scale_y, rect->width * scale_x, rect->height * scale_y);
+  }
+
+  result->frame_meta = frame_meta;
+  result->table = table;
+  result->num_statechanged = 0;
+  nvds_occupancy_eval (table, &analysis->detections, result->observed);
+
+  raw_changes = nvds_debouncer_update (&analysis->debouncer, view,
+      result->observed, timestamp);
+  if (raw_changes)
+    g_atomic_int_add (&analysis->raw_changes, raw_changes);
+  result->occupied = nvds_debouncer_state (&analysis->debouncer, view);
+  decided = nvds_debouncer_decided (&analysis->debouncer, view);
+
+  /* Compare whole words against the published state, so that the cost
+   * hardly depends on the number of spots. */
+  published = &analysis->published[analysis->state_offsets[view]];
+  known = &analysis->known[analysis->state_offsets[view]];
+  for (w = 0; w < NVDS_OCCUPANCY_WORDS (table->num_spots); w++) {
+    guint32 valid = (w + 1) * 32 <= table->num_spots ? G_MAXUINT32 :
+        (1u << (table->num_spots % 32)) - 1;
+    guint32 changed = ((result->occupied[w] ^ published[w]) | ~known[w]) &
+        decided[w] & valid;
+    gint bit = -1;
+
+    while ((bit = g_bit_nth_lsf (changed, bit)) >= 0) {
+      result->statechanged[result->num_statechanged++] = w * 32 + bit;
+      nvds_spot_counts_update (&analysis->counts,
+          (analysis->state_offsets[view] + w) * 32 + bit, (known[w] >> bit) & 1,
+          (result->occupied[w] >> bit) & 1);
+    }
+    if (analysis->pending && changed)
+      add_pending (analysis, analysis->state_offsets[view] + w, changed,
+          timestamp);
+    published[w] = result->occupied[w];
+    known[w] = decided[w] & valid;
+  }
+  if (analysis->pending)
+    return FALSE;
+
+  if (result->num_statechanged)
+    g_atomic_int_add (&analysis->published_changes, result->num_statechanged);
+  return result->num_statechanged > 0;
+}
+
+/**
+ * Rate limiter key of a spot: FNV-1a of its id, which, unlike its record,
+ * stays the same across calibration reloads.
+ */
+static guint64
+spot_key (const gchar * spot)
+{
+  const guint8 *bytes = (const guint8 *) spot;
+  guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+  gsize i;
+
+  for (i = 0; bytes[i]; i++)
+    hash = (hash ^ bytes[i]) * G_GUINT64_CONSTANT (0x100000001b3);
+  return hash;
+}
+
+/** Queue one payload per spot of the view result whose state changed. */
+static void
+publish_view (NvDsSpotAnalysis * analysis, const NvDsCalibration * calib)
+{
+  const NvDsSpotViewResult *result = &analysis->result;
+  guint i;
+
+  for (i = 0; i < result->num_statechanged; i++) {
+    guint spot = result->statechanged[i];
+    const NvDsSpotCalibRecord *rec =
+        &nvds_calibration_spots (calib)[result->table->record[spot]];
+    gboolean occupied = (result->occupied[spot / 32] >> (spot % 32)) & 1;
+    NvDsPayload *payload;
+
+    if (analysis->config->payload_type == NVDS_PAYLOAD_BINARY) {
+      guint64 timestamp = nvds_frame_timestamp (result->frame_meta);
+
+      nvds_wire_writer_begin (&analysis->wire, NVDS_WIRE_KIND_SPOT, timestamp);
+      put_spot_record (&analysis->wire, calib, rec, timestamp, occupied);
+      payload = nvds_wire_writer_finish (&analysis->wire,
+          analysis->config->comp_id);
+    } else {
+      build_message (analysis->message, calib, rec, result->frame_meta,
+          occupied);
+      payload = nvds_payload_new (analysis->message->str,
+          analysis->message->len, analysis->config->comp_id);
+    }
+
+    /* A spot flickering faster than the camera may send is only reported
+     * in its latest state. */
+    if (analysis->limiter) {
+      nvds_rate_limiter_submit (analysis->limiter,
+          nvds_calibration_string (calib, rec->sensor_str),
+          spot_key (nvds_calibration_string (calib, rec->spot_str)), payload,
+          analysis->payloads, g_get_monotonic_time ());
+    } else {
+      g_ptr_array_add (analysis->payloads, payload);
+    }
+  }
+  g_atomic_int_add (&analysis->messages, result->num_statechanged);
+}
+
+/** Queue a message with the occupancy of every level, zone and spot type. */
+static void
+publish_rollup (NvDsSpotAnalysis * analysis)
+{
+  GString *str = analysis->message;
+  guint64 now = (guint64) g_get_real_time () * 1000;
+
+  if (analysis->config->payload_type == NVDS_PAYLOAD_BINARY) {
+    nvds_wire_writer_begin (&analysis->wire, NVDS_WIRE_KIND_ROLLUP, now);
+    nvds_spot_counts_put_wire (&analysis->counts, &analysis->wire);
+    g_ptr_array_add (analysis->payloads,
+        nvds_wire_writer_finish (&analysis->wire, analysis->config->comp_id));
+    analysis->rollup_seq++;
+    return;
+  }
+
+  g_string_truncate (str, 0);
+  g_string_append_printf (str, "{\"messageid\":\"spot-rollup-%u-%"
+      G_GUINT64_FORMAT "\",\"mdsversion\":\"1.0\",\"@timestamp\":",
+      analysis->config->comp_id, analysis->rollup_seq++);
+  nvds_json_append_timestamp (str, now);
+  g_string_append_c (str, ',');
+  nvds_spot_counts_append_json (&analysis->counts, str);
+  g_string_append_c (str, '}');
+  g_ptr_array_add (analysis->payloads, nvds_payload_new (str->str, str->len,
+          analysis->config->comp_id));
+}
+
+void
+nvds_spot_analysis_get_stats (NvDsSpotAnalysis * analysis,
+    NvDsSpotAnalysisStats * stats)
+{
+  stats->raw_changes = g_atomic_int_get (&analysis->raw_changes);
+  stats->published_changes = g_atomic_int_get (&analysis->published_changes);
+  stats->messages = g_atomic_int_get (&analysis->messages);
+}
+
+NvDsRateLimiter *
+nvds_spot_analysis_get_rate_limiter (NvDsSpotAnalysis * analysis)
+{
+  return analysis->limiter;
+}
+
+GstBuffer *
+nvds_spot_analysis_process (NvDsSpotAnalysis * analysis, GstBuffer * buf)
+{
+  NvDsSpotConfig *config = analysis->config;
+  const NvDsCalibration *calib;
+  GstMeta *meta;
+  gpointer state = NULL;
+  gint phase;
+
+  if (!config->calibration || !config->frame_width || !config->frame_height)
+    return buf;
+
+  calib = nvds_calib_read_begin (config->calibration, &phase);
+  /* Pending changes refer to the spot tables of the previous calibration. */
+  if (analysis->table_calib && analysis->table_calib != calib)
+    flush_pending (analysis, analysis->table_calib);
+  update_tables (analysis, calib);
+
+  while ((meta = gst_buffer_iterate_meta (buf, &state))) {
+    NvDsMeta *dsmeta = (NvDsMeta *) meta;
+    NvDsFrameMeta *frame_meta;
+
+    if (!gst_meta_api_type_has_tag (meta->info->api, analysis->dsmeta_quark) ||
+        dsmeta->meta_type != NVDS_META_FRAME_INFO) {
+      continue;
+    }
+
+    /* Frames without objects are evaluated too, they empty the spots. */
+    frame_meta = (NvDsFrameMeta *) dsmeta->meta_data;
+    if (frame_meta->surface_type != NVDS_CALIB_SURFACE_PUSHBROOM ||
+        frame_meta->stream_id >= config->num_sources) {
+      continue;
+    }
+    if (evaluate_view (analysis, calib, frame_meta))
+      publish_view (analysis, calib);
+  }
+
+  /* The changes of all cameras of the batch, or of all batches of the
+   * window, go out as one message. */
+  if (analysis->num_pending && (g_get_monotonic_time () -
+          analysis->window_start) / 1000 >= config->publish_interval) {
+    flush_pending (analysis, calib);
+  }
+  if (config->rollup_interval && (g_get_monotonic_time () -
+          analysis->last_rollup) / 1000 >= config->rollup_interval) {
+    publish_rollup (analysis);
+    analysis->last_rollup = g_get_monotonic_time ();
+  }
+  if (analysis->limiter) {
+    nvds_rate_limiter_flush (analysis->limiter, analysis->payloads,
+        g_get_monotonic_time ());
+  }
+  nvds_calib_read_end (config->calibration, phase);
+
+  /* Payloads are attached after the meta iteration above. */
+  return nvds_payload_attach (buf, analysis->payloads);
+}
+
+GstBuffer *
+nvds_spot_analysis_flush (NvDsSpotAnalysis * analysis)
+{
+  /* The pending changes refer to the tables, which hold their calibration. */
+  if (analysis->table_calib)
+    flush_pending (analysis, analysis->table_calib);
+  if (analysis->limiter)
+    nvds_rate_limiter_drain (analysis->limiter, analysis->payloads);
+  return nvds_payload_buffer_new (analysis->payloads);
+}
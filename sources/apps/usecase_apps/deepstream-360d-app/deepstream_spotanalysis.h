@@ -19,24 +19,116 @@ extern "C"
 
 #include <gst/gst.h>
 
+#include "deepstream_calibration_watch.h"
+#include "deepstream_ratelimit.h"
+#include "deepstream_wire.h"
+
+/** Which implementation decides the occupancy of the spots. */
+typedef enum
+{
+  /** nvspotanalysis + nvmsgconv plugins */
+  NVDS_SPOT_ENGINE_PLUGIN = 0,
+  /** In-app analysis, see deepstream_spotanalysis.c */
+  NVDS_SPOT_ENGINE_APP = 1,
+} NvDsSpotEngine;
+
+/** How the in-app analysis publishes occupancy changes. */
+typedef enum
+{
+  /** One message per spot and change */
+  NVDS_SPOT_PUBLISH_PER_SPOT = 0,
+  /** One message with the changes of all cameras of a batch or window */
+  NVDS_SPOT_PUBLISH_BATCHED = 1,
+} NvDsSpotPublishMode;
+
+typedef struct _NvDsSpotAnalysis NvDsSpotAnalysis;
+
+typedef struct
+{
+  /** Occupancy changes seen in the frames */
+  guint raw_changes;
+  /** Occupancy changes confirmed and published */
+  guint published_changes;
+  /** Messages they were published in */
+  guint messages;
+} NvDsSpotAnalysisStats;
+
 typedef struct
 {
   GstElement *bin;
   GstElement *sink_queue;
   GstElement *nvspotanalysis;
   GstElement *msg_conv;
+  NvDsSpotAnalysis *analysis;
+  gulong probe_id;
 } NvDsSpotBin;
 
 typedef struct
 {
   gboolean enable;
   gchar *calibration_file;
+  NvDsCalibHandle *calibration;
+  /** Calibration file poll interval in ms, 0 disables reloading. */
+  guint reload_interval;
+  /** Seconds a spot must keep a new state before it is published */
   guint result_threshold;
+  /** Same in frames, for the in-app analysis; overrides result_threshold */
+  guint debounce_frames;
   guint comp_id;
+  NvDsSpotEngine engine;
+  /** Fraction of a spot a detection must cover to occupy it */
+  gdouble occupancy_coverage;
+  NvDsSpotPublishMode publish_mode;
+  /** Batching window in ms for NVDS_SPOT_PUBLISH_BATCHED, 0 for per batch */
+  guint publish_interval;
+  /** Interval in ms of the level/zone/type roll-up messages, 0 for none */
+  guint rollup_interval;
+  /** Limit of the per-spot messages of each camera, see NvDsRateLimiter */
+  NvDsRateLimitConfig rate_limit;
+
+  /* Filled in by the pipeline for the in-app analysis. */
+  /** camera-id of each source, i.e. its calibration serial */
+  guint *source_serials;
+  guint num_sources;
+  /** Resolution of the batched frames the object boxes refer to. */
+  guint frame_width;
+  guint frame_height;
+  /** Encoding of the messages, from [message-broker] payload-type */
+  NvDsPayloadType payload_type;
 } NvDsSpotConfig;
 
 gboolean create_spotanalysis_bin (NvDsSpotConfig * config, NvDsSpotBin * bin);
 
+void destroy_spotanalysis_bin (NvDsSpotBin * bin);
+
+NvDsSpotAnalysis *nvds_spot_analysis_new (NvDsSpotConfig * config);
+
+void nvds_spot_analysis_free (NvDsSpotAnalysis * analysis);
+
+/**
+ * Decide the occupancy of the spots of every spot surface in @buf and attach
+ * message payloads for the spots whose state changed, see
+ * NvDsSpotPublishMode. Returns @buf, or a writable copy of it if payloads
+ * were attached.
+ */
+GstBuffer *nvds_spot_analysis_process (NvDsSpotAnalysis * analysis,
+    GstBuffer * buf);
+
+/**
+ * Queue the changes still waiting in the batching window, and the messages
+ * held back by the rate limiter, at EOS. Returns a buffer carrying the
+ * payloads, see nvds_payload_buffer_new(), or NULL.
+ */
+GstBuffer *nvds_spot_analysis_flush (NvDsSpotAnalysis * analysis);
+
+/** Can be called from any thread. */
+void nvds_spot_analysis_get_stats (NvDsSpotAnalysis * analysis,
+    NvDsSpotAnalysisStats * stats);
+
+/** NULL unless rate-limit is set. */
+NvDsRateLimiter *nvds_spot_analysis_get_rate_limiter (NvDsSpotAnalysis *
+    analysis);
+
 #ifdef __cplusplus
 }
 #endif
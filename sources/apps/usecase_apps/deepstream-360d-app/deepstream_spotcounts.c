@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+
+#include "deepstream_common.h"
+#include "deepstream_payload.h"
+#include "deepstream_spotcounts.h"
+
+static const gchar *group_arrays[NVDS_SPOT_GROUP_KINDS] = {
+  "levels", "zones", "types"
+};
+
+/** Index of the group @name in @index, added to @groups if new. */
+static guint
+group_index (GHashTable * index, GArray * groups, const gchar * name,
+    gsize name_len)
+{
+  gchar *key = g_strndup (name, name_len);
+  gpointer value;
+  NvDsSpotGroupCount group = { 0 };
+
+  if (g_hash_table_lookup_extended (index, key, NULL, &value)) {
+    g_free (key);
+    return GPOINTER_TO_UINT (value);
+  }
+
+  group.name = key;
+  g_array_append_val (groups, group);
+  g_hash_table_insert (index, key, GUINT_TO_POINTER (groups->len - 1));
+  return groups->len - 1;
+}
+
+void
+nvds_spot_counts_init (NvDsSpotCounts * counts, const NvDsCalibration * calib,
+    const NvDsSpotTable * tables, const guint * word_offsets, guint num_tables)
+{
+  const NvDsSpotCalibRecord *records = nvds_calibration_spots (calib);
+  GHashTable *index[NVDS_SPOT_GROUP_KINDS];
+  GArray *groups[NVDS_SPOT_GROUP_KINDS];
+  guint num_slots = 0;
+  guint i, s, k;
+
+  memset (counts, 0, sizeof (NvDsSpotCounts));
+  for (i = 0; i < num_tables; i++) {
+    num_slots = MAX (num_slots, 32 * word_offsets[i] +
+        NVDS_OCCUPANCY_WORDS (tables[i].num_spots) * 32);
+  }
+  counts->spot_groups = g_new0 (guint16,
+      (gsize) num_slots * NVDS_SPOT_GROUP_KINDS);
+
+  /* The indexes borrow the names owned by the groups. */
+  for (k = 0; k < NVDS_SPOT_GROUP_KINDS; k++) {
+    index[k] = g_hash_table_new (g_str_hash, g_str_equal);
+    groups[k] = g_array_new (FALSE, FALSE, sizeof (NvDsSpotGroupCount));
+  }
+
+  for (i = 0; i < num_tables; i++) {
+    for (s = 0; s < tables[i].num_spots; s++) {
+      const NvDsSpotCalibRecord *rec = &records[tables[i].record[s]];
+      const gchar *spot = nvds_calibration_string (calib, rec->spot_str);
+      const gchar *dash = strrchr (spot, '-');
+      const gchar *level = nvds_calibration_string (calib, rec->level);
+      const gchar *type = nvds_calibration_string (calib, rec->type);
+      guint16 *slot = &counts->spot_groups[(32 * word_offsets[i] + s) *
+          NVDS_SPOT_GROUP_KINDS];
+
+      slot[NVDS_SPOT_GROUP_LEVEL] = group_index (index[NVDS_SPOT_GROUP_LEVEL],
+          groups[NVDS_SPOT_GROUP_LEVEL], level, strlen (level));
+      slot[NVDS_SPOT_GROUP_ZONE] = group_index (index[NVDS_SPOT_GROUP_ZONE],
+          groups[NVDS_SPOT_GROUP_ZONE], spot,
+          dash ? (gsize) (dash - spot) : strlen (spot));
+      slot[NVDS_SPOT_GROUP_TYPE] = group_index (index[NVDS_SPOT_GROUP_TYPE],
+          groups[NVDS_SPOT_GROUP_TYPE], type, strlen (type));
+
+      for (k = 0; k < NVDS_SPOT_GROUP_KINDS; k++) {
+        NvDsSpotGroupCount *group = &g_array_index (groups[k],
+            NvDsSpotGroupCount, slot[k]);
+
+        group->total++;
+        group->unknown++;
+      }
+    }
+  }
+
+  for (k = 0; k < NVDS_SPOT_GROUP_KINDS; k++) {
+    g_hash_table_destroy (index[k]);
+    counts->num_groups[k] = groups[k]->len;
+    counts->groups[k] = (NvDsSpotGroupCount *) g_array_free (groups[k], FALSE);
+  }
+}
+
+void
+nvds_spot_counts_clear (NvDsSpotCounts * counts)
+{
+  guint i, k;
+
+  for (k = 0; k < NVDS_SPOT_GROUP_KINDS; k++) {
+    for (i = 0; i < counts->num_groups[k]; i++)
+      g_free (counts->groups[k][i].name);
+    g_free (counts->groups[k]);
+  }
+  g_free (counts->spot_groups);
+  memset (counts, 0, sizeof (NvDsSpotCounts));
+}
+
+void
+nvds_spot_counts_append_json (NvDsSpotCounts * counts, GString * str)
+{
+  guint i, k;
+
+  for (k = 0; k < NVDS_SPOT_GROUP_KINDS; k++) {
+    g_string_append_printf (str, "%s\"%s\":[", k ? "," : "", group_arrays[k]);
+    for (i = 0; i < counts->num_groups[k]; i++) {
+      const NvDsSpotGroupCount *group = &counts->groups[k][i];
+
+      g_string_append (str, i ? ",{\"id\":" : "{\"id\":");
+      nvds_json_append_string (str, group->name);
+      g_string_append_printf (str, ",\"total\":%u,\"occupied\":%u,"
+          "\"free\":%u,\"unknown\":%u}", group->total, group->occupied,
+          group->total - group->occupied - group->unknown, group->unknown);
+    }
+    g_string_append_c (str, ']');
+  }
+}
+
+void
+nvds_spot_counts_put_wire (NvDsSpotCounts * counts, NvDsWireWriter * wire)
+{
+  guint i, k;
+
+  for (k = 0; k < NVDS_SPOT_GROUP_KINDS; k++) {
+    for (i = 0; i < counts->num_groups[k]; i++) {
+      const NvDsSpotGroupCount *group = &counts->groups[k][i];
+
+      nvds_wire_writer_record (wire);
+      nvds_wire_put_uint (wire, k);
+      nvds_wire_put_string (wire, group->name);
+      nvds_wire_put_uint (wire, group->total);
+      nvds_wire_put_uint (wire, group->occupied);
+      nvds_wire_put_uint (wire, group->unknown);
+    }
+  }
+}
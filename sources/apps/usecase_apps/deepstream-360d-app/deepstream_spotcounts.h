@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_SPOTCOUNTS_H__
+#define __NVGSTDS_SPOTCOUNTS_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#include "deepstream_occupancy.h"
+#include "deepstream_wire.h"
+
+/**
+ * Occupancy of the garage by level, zone and spot type, kept up to date on
+ * every state change of a spot so that a roll-up costs the number of
+ * groups, not the number of spots. The zone of a spot is its id up to the
+ * last '-', e.g. P1-PS for P1-PS-440.
+ */
+
+typedef enum
+{
+  NVDS_SPOT_GROUP_LEVEL,
+  NVDS_SPOT_GROUP_ZONE,
+  NVDS_SPOT_GROUP_TYPE,
+  NVDS_SPOT_GROUP_KINDS
+} NvDsSpotGroupKind;
+
+typedef struct
+{
+  gchar *name;
+  guint total;
+  guint occupied;
+  /** Spots whose state is not known yet */
+  guint unknown;
+} NvDsSpotGroupCount;
+
+typedef struct
+{
+  NvDsSpotGroupCount *groups[NVDS_SPOT_GROUP_KINDS];
+  guint num_groups[NVDS_SPOT_GROUP_KINDS];
+  /** Group of every kind of each spot slot, [slot * NVDS_SPOT_GROUP_KINDS] */
+  guint16 *spot_groups;
+} NvDsSpotCounts;
+
+/**
+ * Set up the groups of the spots of @tables of @calib, all of unknown
+ * state. The spots of table i use slots 32 * @word_offsets[i] onwards.
+ */
+void nvds_spot_counts_init (NvDsSpotCounts * counts,
+    const NvDsCalibration * calib, const NvDsSpotTable * tables,
+    const guint * word_offsets, guint num_tables);
+
+void nvds_spot_counts_clear (NvDsSpotCounts * counts);
+
+/**
+ * Account for the new state @occupied of the spot in @slot, whose previous
+ * state was known if @was_known.
+ */
+static inline void
+nvds_spot_counts_update (NvDsSpotCounts * counts, guint slot,
+    gboolean was_known, gboolean occupied)
+{
+  guint k;
+
+  for (k = 0; k < NVDS_SPOT_GROUP_KINDS; k++) {
+    NvDsSpotGroupCount *group = &counts->groups[k][counts->spot_groups[slot *
+            NVDS_SPOT_GROUP_KINDS + k]];
+
+    if (!was_known)
+      group->unknown--;
+    else if (!occupied)
+      group->occupied--;
+    if (occupied)
+      group->occupied++;
+  }
+}
+
+/**
+ * Append the "levels", "zones" and "types" arrays of a roll-up message,
+ * without the enclosing braces.
+ */
+void nvds_spot_counts_append_json (NvDsSpotCounts * counts, GString * str);
+
+/** Put a record of every group into a roll-up message started in @wire. */
+void nvds_spot_counts_put_wire (NvDsSpotCounts * counts,
+    NvDsWireWriter * wire);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
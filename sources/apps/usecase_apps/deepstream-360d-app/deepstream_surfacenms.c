@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "gstnvdsmeta.h"
+#include "deepstream_bboxfilter.h"
+#include "deepstream_surfacenms.h"
+
+/** Points along each side of a box mapped to the fisheye plane */
+#define NMS_SIDE_POINTS 3
+
+/** Fisheye plane position of the points of a grid over a surface. */
+typedef struct
+{
+  guint projection_type;
+  guint surface_index;
+  /** Frame pixels to surface pixels */
+  gfloat scale_x;
+  gfloat scale_y;
+  guint cols;
+  guint rows;
+  /** x, y pairs in radians, row after row */
+  gfloat *xy;
+} SurfaceGrid;
+
+typedef struct
+{
+  guint stream_id;
+  guint projection_type;
+  guint surface;
+  /** Index of the object among all those of the batch */
+  guint object;
+  /** Bounds in the fisheye plane */
+  gfloat left;
+  gfloat top;
+  gfloat right;
+  gfloat bottom;
+  gfloat area;
+} NmsBox;
+
+struct _NvDsSurfaceNms
+{
+  GQuark dsmeta_quark;
+  gfloat overlap;
+  SurfaceGrid *grids;
+  guint num_grids;
+
+  /* Reused from batch to batch. */
+  GArray *boxes;
+  GPtrArray *frames;
+  /** Flag of each object of the batch */
+  guint8 *removed;
+  guint removed_capacity;
+};
+
+static void
+build_grid (SurfaceGrid * grid, const NvDsDewarpSurface * surface,
+    guint frame_width, guint frame_height)
+{
+  guint i, j;
+
+  grid->projection_type = surface->projection_type;
+  grid->surface_index = surface->surface_index;
+  grid->scale_x = (gfloat) surface->width / frame_width;
+  grid->scale_y = (gfloat) surface->height / frame_height;
+  /* One more point past the last pixel, to interpolate up to it. */
+  grid->cols = surface->width / NVDS_SURFACE_NMS_CELL_SIZE + 2;
+  grid->rows = surface->height / NVDS_SURFACE_NMS_CELL_SIZE + 2;
+  grid->xy = g_new (gfloat, 2 * grid->cols * grid->rows);
+
+  for (j = 0; j < grid->rows; j++) {
+    for (i = 0; i < grid->cols; i++) {
+      gfloat *xy = &grid->xy[2 * (j * grid->cols + i)];
+      gdouble ray[3], theta, rho;
+
+      nvds_dewarp_surface_ray (surface, i * NVDS_SURFACE_NMS_CELL_SIZE,
+          j * NVDS_SURFACE_NMS_CELL_SIZE, ray);
+      theta = acos (CLAMP (ray[2], -1, 1));
+      rho = sqrt (ray[0] * ray[0] + ray[1] * ray[1]);
+      xy[0] = rho > 1e-12 ? theta * ray[0] / rho : 0;
+      xy[1] = rho > 1e-12 ? theta * ray[1] / rho : 0;
+    }
+  }
+}
+
+/** Fisheye plane position of the surface pixel @u, @v. */
+static inline void
+grid_lookup (const SurfaceGrid * grid, gfloat u, gfloat v, gfloat * x,
+    gfloat * y)
+{
+  gfloat fu = CLAMP (u / NVDS_SURFACE_NMS_CELL_SIZE, 0, grid->cols - 1.001f);
+  gfloat fv = CLAMP (v / NVDS_SURFACE_NMS_CELL_SIZE, 0, grid->rows - 1.001f);
+  guint i = (guint) fu, j = (guint) fv;
+  const gfloat *p = &grid->xy[2 * (j * grid->cols + i)];
+  const gfloat *q = p + 2 * grid->cols;
+  gfloat a = fu - i, b = fv - j;
+
+  *x = (1 - b) * ((1 - a) * p[0] + a * p[2]) + b * ((1 - a) * q[0] + a * q[2]);
+  *y = (1 - b) * ((1 - a) * p[1] + a * p[3]) + b * ((1 - a) * q[1] + a * q[3]);
+}
+
+NvDsSurfaceNms *
+nvds_surface_nms_new (const NvDsDewarpSurface * surfaces, guint num_surfaces,
+    guint frame_width, guint frame_height, gfloat overlap)
+{
+  NvDsSurfaceNms *nms = g_new0 (NvDsSurfaceNms, 1);
+  guint i;
+
+  nms->dsmeta_quark = g_quark_from_static_string (NVDS_META_STRING);
+  nms->overlap = overlap;
+  nms->num_grids = num_surfaces;
+  nms->grids = g_new0 (SurfaceGrid, num_surfaces);
+  for (i = 0; i < num_surfaces; i++)
+    build_grid (&nms->grids[i], &surfaces[i], frame_width, frame_height);
+
+  nms->boxes = g_array_new (FALSE, FALSE, sizeof (NmsBox));
+  nms->frames = g_ptr_array_new ();
+  return nms;
+}
+
+void
+nvds_surface_nms_free (NvDsSurfaceNms * nms)
+{
+  guint i;
+
+  if (!nms)
+    return;
+
+  for (i = 0; i < nms->num_grids; i++)
+    g_free (nms->grids[i].xy);
+  g_free (nms->grids);
+  g_array_free (nms->boxes, TRUE);
+  g_ptr_array_free (nms->frames, TRUE);
+  g_free (nms->removed);
+  g_free (nms);
+}
+
+static gint
+compare_boxes (gconstpointer a, gconstpointer b)
+{
+  const NmsBox *ba = (const NmsBox *) a;
+  const NmsBox *bb = (const NmsBox *) b;
+
+  if (ba->stream_id != bb->stream_id)
+    return ba->stream_id < bb->stream_id ? -1 : 1;
+  if (ba->projection_type != bb->projection_type)
+    return ba->projection_type < bb->projection_type ? -1 : 1;
+  /* Largest first: a box cut by the edge of its surface loses. */
+  if (ba->area != bb->area)
+    return ba->area > bb->area ? -1 : 1;
+  return ba->object < bb->object ? -1 : ba->object > bb->object;
+}
+
+/** Bounds, in the fisheye plane, of the box @rect of a frame of @grid. */
+static void
+map_box (const SurfaceGrid * grid, const NvOSD_RectParams * rect, NmsBox * box)
+{
+  gfloat l = rect->left * grid->scale_x;
+  gfloat t = rect->top * grid->scale_y;
+  gfloat w = rect->width * grid->scale_x;
+  gfloat h = rect->height * grid->scale_y;
+  guint k;
+
+  box->left = box->top = G_MAXFLOAT;
+  box->right = box->bottom = -G_MAXFLOAT;
+  /* The sides are curves in the fisheye plane; sample them. */
+  for (k = 0; k < 4 * (NMS_SIDE_POINTS - 1); k++) {
+    guint side = k / (NMS_SIDE_POINTS - 1);
+    gfloat s = (gfloat) (k % (NMS_SIDE_POINTS - 1)) / (NMS_SIDE_POINTS - 1);
+    gfloat u, v, x, y;
+
+    switch (side) {
+      case 0:
+        u = l + s * w;
+        v = t;
+        break;
+      case 1:
+        u = l + w;
+        v = t + s * h;
+        break;
+      case 2:
+        u = l + w - s * w;
+        v = t + h;
+        break;
+      default:
+        u = l;
+        v = t + h - s * h;
+        break;
+    }
+    grid_lookup (grid, u, v, &x, &y);
+    box->left = MIN (box->left, x);
+    box->top = MIN (box->top, y);
+    box->right = MAX (box->right, x);
+    box->bottom = MAX (box->bottom, y);
+  }
+  box->area = (box->right - box->left) * (box->bottom - box->top);
+}
+
+static const SurfaceGrid *
+find_grid (NvDsSurfaceNms * nms, const NvDsFrameMeta * frame_meta, guint * index)
+{
+  guint i;
+
+  for (i = 0; i < nms->num_grids; i++) {
+    if (nms->grids[i].projection_type == frame_meta->surface_type &&
+        nms->grids[i].surface_index == frame_meta->surface_index) {
+      *index = i;
+      return &nms->grids[i];
+    }
+  }
+  return NULL;
+}
+
+/** Suppress the boxes of @boxes covered by a larger one of another surface. */
+static guint
+suppress (NvDsSurfaceNms * nms, NmsBox * boxes, guint num_boxes)
+{
+  guint num_removed = 0;
+  guint i, j;
+
+  for (i = 0; i < num_boxes; i++) {
+    const NmsBox *a = &boxes[i];
+
+    if (nms->removed[a->object])
+      continue;
+
+    for (j = i + 1; j < num_boxes; j++) {
+      const NmsBox *b = &boxes[j];
+      gfloat iw, ih;
+
+      if (b->stream_id != a->stream_id ||
+          b->projection_type != a->projection_type)
+        break;
+      if (b->surface == a->surface || nms->removed[b->object])
+        continue;
+
+      iw = MIN (a->right, b->right) - MAX (a->left, b->left);
+      ih = MIN (a->bottom, b->bottom) - MAX (a->top, b->top);
+      if (iw > 0 && ih > 0 && iw * ih >= nms->overlap * b->area) {
+        nms->removed[b->object] = TRUE;
+        num_removed++;
+      }
+    }
+  }
+  return num_removed;
+}
+
+/** @user_data: the removed flags of the objects of the frame */
+static gboolean
+object_kept (guint index, gpointer user_data)
+{
+  return !((const guint8 *) user_data)[index];
+}
+
+guint
+nvds_surface_nms_process (NvDsSurfaceNms * nms, GstBuffer * buf)
+{
+  guint num_objects = 0;
+  guint num_removed;
+  guint f, i;
+  GstMeta *meta;
+  gpointer state = NULL;
+
+  g_array_set_size (nms->boxes, 0);
+  g_ptr_array_set_size (nms->frames, 0);
+
+  while ((meta = gst_buffer_iterate_meta (buf, &state))) {
+    NvDsMeta *dsmeta = (NvDsMeta *) meta;
+    NvDsFrameMeta *frame_meta;
+    const SurfaceGrid *grid;
+    guint surface;
+
+    if (!gst_meta_api_type_has_tag (meta->info->api, nms->dsmeta_quark) ||
+        dsmeta->meta_type != NVDS_META_FRAME_INFO) {
+      continue;
+    }
+
+    frame_meta = (NvDsFrameMeta *) dsmeta->meta_data;
+    grid = find_grid (nms, frame_meta, &surface);
+    if (!grid || !frame_meta->num_rects)
+      continue;
+
+    g_ptr_array_add (nms->frames, frame_meta);
+    for (i = 0; i < frame_meta->num_rects; i++) {
+      NmsBox box;
+
+      box.stream_id = frame_meta->stream_id;
+      box.projection_type = grid->projection_type;
+      box.surface = surface;
+      box.object = num_objects++;
+      map_box (grid, &frame_meta->obj_params[i].rect_params, &box);
+      g_array_append_val (nms->boxes, box);
+    }
+  }
+  if (nms->frames->len < 2)
+    return 0;
+
+  if (num_objects > nms->removed_capacity) {
+    nms->removed_capacity = MAX (num_objects, 2 * nms->removed_capacity);
+    nms->removed = g_renew (guint8, nms->removed, nms->removed_capacity);
+  }
+  memset (nms->removed, 0, num_objects);
+  g_array_sort (nms->boxes, compare_boxes);
+  num_removed = suppress (nms, (NmsBox *) nms->boxes->data, nms->boxes->len);
+  if (!num_removed)
+    return 0;
+
+  /* Objects were numbered in the order of the frames. */
+  num_objects = 0;
+  for (f = 0; f < nms->frames->len; f++) {
+    NvDsFrameMeta *frame_meta =
+        (NvDsFrameMeta *) g_ptr_array_index (nms->frames, f);
+    guint num_rects = frame_meta->num_rects;
+
+    nvds_frame_remove_objects (frame_meta, object_kept,
+        nms->removed + num_objects);
+    num_objects += num_rects;
+  }
+  return num_removed;
+}
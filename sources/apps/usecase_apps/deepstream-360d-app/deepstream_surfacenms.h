@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_SURFACENMS_H__
+#define __NVGSTDS_SURFACENMS_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+#include "deepstream_cpu_dewarper.h"
+
+/**
+ * Suppression of the detections seen twice by overlapping surfaces of the
+ * same camera. The boxes are mapped from their surface to the equidistant
+ * plane of the fisheye (angle from the optical axis along its azimuth), in
+ * which every surface of a camera agrees, through a coarse table of the
+ * line of sight of each surface. Only surfaces of the same projection type
+ * are compared, since the spot and aisle analyses do not share surfaces.
+ */
+
+/** Surface pixels between the points of the angle tables */
+#define NVDS_SURFACE_NMS_CELL_SIZE 16
+
+typedef struct _NvDsSurfaceNms NvDsSurfaceNms;
+
+/**
+ * @surfaces are those of the dewarper, whose frames are scaled to
+ * @frame_width x @frame_height. A detection is removed when @overlap of its
+ * box, or more, is covered by a larger one of a sibling surface.
+ */
+NvDsSurfaceNms *nvds_surface_nms_new (const NvDsDewarpSurface * surfaces,
+    guint num_surfaces, guint frame_width, guint frame_height,
+    gfloat overlap);
+
+void nvds_surface_nms_free (NvDsSurfaceNms * nms);
+
+/** Remove the duplicates from the frames of @buf; returns their number. */
+guint nvds_surface_nms_process (NvDsSurfaceNms * nms, GstBuffer * buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include "deepstream_timerwheel.h"
+
+#define SLOT_MASK (NVDS_TIMER_WHEEL_SLOTS - 1)
+#define MAX_DELTA G_MAXUINT32
+
+static inline void
+list_init (NvDsTimer * head)
+{
+  head->prev = head->next = head;
+}
+
+static inline void
+list_append (NvDsTimer * head, NvDsTimer * timer)
+{
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+static inline void
+list_unlink (NvDsTimer * timer)
+{
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = timer->next = NULL;
+}
+
+/** Move the timers of @head to the empty list @to. */
+static inline void
+list_move (NvDsTimer * head, NvDsTimer * to)
+{
+  if (head->next == head)
+    return;
+  to->next = head->next;
+  to->prev = head->prev;
+  to->next->prev = to;
+  to->prev->next = to;
+  list_init (head);
+}
+
+/**
+ * A timer lives in the finest level whose span covers its distance from the
+ * current tick, in the slot of its expiry tick at that level. A slot of
+ * level n is moved down when the ticks of level n - 1 wrap around to it.
+ */
+static void
+place (NvDsTimerWheel * wheel, NvDsTimer * timer)
+{
+  guint64 delta = timer->expires - wheel->now;
+  guint level = 0;
+
+  while (level < NVDS_TIMER_WHEEL_LEVELS - 1 &&
+      delta >> (NVDS_TIMER_WHEEL_BITS * (level + 1)))
+    level++;
+  list_append (&wheel->slots[level][(timer->expires >>
+              (NVDS_TIMER_WHEEL_BITS * level)) & SLOT_MASK], timer);
+}
+
+void
+nvds_timer_wheel_init (NvDsTimerWheel * wheel, guint64 now)
+{
+  guint l, s;
+
+  wheel->now = now;
+  wheel->num_timers = 0;
+  for (l = 0; l < NVDS_TIMER_WHEEL_LEVELS; l++) {
+    for (s = 0; s < NVDS_TIMER_WHEEL_SLOTS; s++)
+      list_init (&wheel->slots[l][s]);
+  }
+}
+
+void
+nvds_timer_wheel_add (NvDsTimerWheel * wheel, NvDsTimer * timer,
+    guint64 expires)
+{
+  if (nvds_timer_pending (timer))
+    list_unlink (timer);
+  else
+    wheel->num_timers++;
+
+  if (expires <= wheel->now)
+    expires = wheel->now + 1;
+  else if (expires - wheel->now > MAX_DELTA)
+    expires = wheel->now + MAX_DELTA;
+  timer->expires = expires;
+  place (wheel, timer);
+}
+
+void
+nvds_timer_wheel_cancel (NvDsTimerWheel * wheel, NvDsTimer * timer)
+{
+  if (!nvds_timer_pending (timer))
+    return;
+  list_unlink (timer);
+  wheel->num_timers--;
+}
+
+static void
+cascade (NvDsTimerWheel * wheel, guint level)
+{
+  NvDsTimer list;
+
+  list_init (&list);
+  list_move (&wheel->slots[level][(wheel->now >>
+              (NVDS_TIMER_WHEEL_BITS * level)) & SLOT_MASK], &list);
+  while (list.next != &list) {
+    NvDsTimer *timer = list.next;
+
+    list_unlink (timer);
+    place (wheel, timer);
+  }
+}
+
+void
+nvds_timer_wheel_advance (NvDsTimerWheel * wheel, guint64 now,
+    NvDsTimerFunc func, gpointer user_data)
+{
+  NvDsTimer expired;
+
+  list_init (&expired);
+  while (wheel->now < now) {
+    guint level;
+
+    /* Nothing left to fire, jump ahead. */
+    if (!wheel->num_timers) {
+      wheel->now = now;
+      break;
+    }
+
+    wheel->now++;
+    for (level = 1; level < NVDS_TIMER_WHEEL_LEVELS; level++) {
+      if (wheel->now & ((G_GUINT64_CONSTANT (1) <<
+                  (NVDS_TIMER_WHEEL_BITS * level)) - 1))
+        break;
+      cascade (wheel, level);
+    }
+
+    /* The callbacks may cancel timers that are still on the list. */
+    list_move (&wheel->slots[0][wheel->now & SLOT_MASK], &expired);
+    while (expired.next != &expired) {
+      NvDsTimer *timer = expired.next;
+
+      list_unlink (timer);
+      wheel->num_timers--;
+      func (timer, user_data);
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_TIMERWHEEL_H__
+#define __NVGSTDS_TIMERWHEEL_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+/**
+ * Hierarchical timing wheel with a tick of one ms. Timers are embedded in
+ * the structures they belong to; adding and cancelling them is O(1), and
+ * each tick only looks at one slot, plus one slot of a coarser level every
+ * 256 ticks. Timers up to 2^32 ms ahead are supported.
+ */
+
+#define NVDS_TIMER_WHEEL_LEVELS 4
+#define NVDS_TIMER_WHEEL_BITS 8
+#define NVDS_TIMER_WHEEL_SLOTS (1 << NVDS_TIMER_WHEEL_BITS)
+
+typedef struct _NvDsTimer NvDsTimer;
+
+struct _NvDsTimer
+{
+  NvDsTimer *prev;
+  NvDsTimer *next;
+  /** Tick the timer fires at */
+  guint64 expires;
+  /** Free for the owner, e.g. to tell its timers apart */
+  guint tag;
+};
+
+typedef struct
+{
+  /** Last tick processed */
+  guint64 now;
+  guint num_timers;
+  /** List heads */
+  NvDsTimer slots[NVDS_TIMER_WHEEL_LEVELS][NVDS_TIMER_WHEEL_SLOTS];
+} NvDsTimerWheel;
+
+typedef void (*NvDsTimerFunc) (NvDsTimer * timer, gpointer user_data);
+
+void nvds_timer_wheel_init (NvDsTimerWheel * wheel, guint64 now);
+
+static inline void
+nvds_timer_init (NvDsTimer * timer)
+{
+  timer->prev = timer->next = NULL;
+}
+
+static inline gboolean
+nvds_timer_pending (const NvDsTimer * timer)
+{
+  return timer->next != NULL;
+}
+
+/** (Re)start @timer to fire at tick @expires, or at the next tick if past. */
+void nvds_timer_wheel_add (NvDsTimerWheel * wheel, NvDsTimer * timer,
+    guint64 expires);
+
+void nvds_timer_wheel_cancel (NvDsTimerWheel * wheel, NvDsTimer * timer);
+
+/**
+ * Process the ticks up to @now, calling @func for every timer that fires.
+ * @func may add and cancel timers. Does nothing if @now is in the past.
+ */
+void nvds_timer_wheel_advance (NvDsTimerWheel * wheel, guint64 now,
+    NvDsTimerFunc func, gpointer user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <math.h>
+
+#include "deepstream_common.h"
+#include "deepstream_trackfusion.h"
+
+/** Track of one camera, bound to a vehicle. */
+typedef struct
+{
+  guint64 tracking_id;
+  guint source;
+  guint64 vehicle;
+  guint64 last_seen;
+} CameraTrack;
+
+struct _NvDsTrackFusion
+{
+  gfloat radius;
+  guint64 max_age;
+  guint64 batch;
+  guint64 next_id;
+  /** NvDsFusedTrack by id, owned */
+  GHashTable *vehicles;
+  /** CameraTrack by source and tracking id, owned */
+  GHashTable *tracks;
+  /** First NvDsFusedTrack of each world cell */
+  GHashTable *grid;
+};
+
+static guint
+camera_track_hash (gconstpointer key)
+{
+  const CameraTrack *track = (const CameraTrack *) key;
+
+  return (guint) (track->tracking_id ^ (track->tracking_id >> 32)) ^
+      (track->source * 0x9e3779b1u);
+}
+
+static gboolean
+camera_track_equal (gconstpointer a, gconstpointer b)
+{
+  const CameraTrack *ta = (const CameraTrack *) a;
+  const CameraTrack *tb = (const CameraTrack *) b;
+
+  return ta->tracking_id == tb->tracking_id && ta->source == tb->source;
+}
+
+static guint64
+cell_key (NvDsTrackFusion * fusion, gfloat x, gfloat y, gint dx, gint dy)
+{
+  gint32 cx = (gint32) floorf (x / fusion->radius) + dx;
+  gint32 cy = (gint32) floorf (y / fusion->radius) + dy;
+
+  return ((guint64) (guint32) cx << 32) | (guint32) cy;
+}
+
+static void
+grid_insert (NvDsTrackFusion * fusion, NvDsFusedTrack * vehicle)
+{
+  vehicle->cell = cell_key (fusion, vehicle->x, vehicle->y, 0, 0);
+  vehicle->next = g_hash_table_lookup (fusion->grid, &vehicle->cell);
+  g_hash_table_replace (fusion->grid, &vehicle->cell, vehicle);
+}
+
+NvDsTrackFusion *
+nvds_track_fusion_new (gfloat radius, guint max_age_ms)
+{
+  NvDsTrackFusion *fusion = g_new0 (NvDsTrackFusion, 1);
+
+  fusion->radius = radius;
+  fusion->max_age = (guint64) max_age_ms * GST_MSECOND;
+  fusion->next_id = 1;
+  fusion->vehicles = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL,
+      g_free);
+  fusion->tracks = g_hash_table_new_full (camera_track_hash,
+      camera_track_equal, NULL, g_free);
+  fusion->grid = g_hash_table_new (g_int64_hash, g_int64_equal);
+  return fusion;
+}
+
+void
+nvds_track_fusion_free (NvDsTrackFusion * fusion)
+{
+  if (!fusion)
+    return;
+
+  g_hash_table_destroy (fusion->grid);
+  g_hash_table_destroy (fusion->tracks);
+  g_hash_table_destroy (fusion->vehicles);
+  g_free (fusion);
+}
+
+void
+nvds_track_fusion_begin (NvDsTrackFusion * fusion, guint64 now_ns)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  fusion->batch++;
+  g_hash_table_remove_all (fusion->grid);
+
+  g_hash_table_iter_init (&iter, fusion->vehicles);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    NvDsFusedTrack *vehicle = (NvDsFusedTrack *) value;
+
+    if (now_ns > vehicle->last_seen + fusion->max_age)
+      g_hash_table_iter_remove (&iter);
+    else
+      grid_insert (fusion, vehicle);
+  }
+
+  g_hash_table_iter_init (&iter, fusion->tracks);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    CameraTrack *track = (CameraTrack *) value;
+
+    if (now_ns > track->last_seen + fusion->max_age)
+      g_hash_table_iter_remove (&iter);
+  }
+}
+
+/**
+ * Nearest vehicle within the radius of @x, @y not seen by @source_bit in
+ * this batch, searching the 3 x 3 cells around the point.
+ */
+static NvDsFusedTrack *
+find_vehicle (NvDsTrackFusion * fusion, gfloat x, gfloat y,
+    guint64 source_bit)
+{
+  NvDsFusedTrack *best = NULL;
+  gfloat best_dist = fusion->radius * fusion->radius;
+  gint dx, dy;
+
+  for (dy = -1; dy <= 1; dy++) {
+    for (dx = -1; dx <= 1; dx++) {
+      guint64 cell = cell_key (fusion, x, y, dx, dy);
+      NvDsFusedTrack *vehicle = g_hash_table_lookup (fusion->grid, &cell);
+
+      for (; vehicle; vehicle = (NvDsFusedTrack *) vehicle->next) {
+        gfloat dist = (vehicle->x - x) * (vehicle->x - x) +
+            (vehicle->y - y) * (vehicle->y - y);
+
+        if (vehicle->batch == fusion->batch && (vehicle->sources & source_bit))
+          continue;
+        if (dist <= best_dist) {
+          best = vehicle;
+          best_dist = dist;
+        }
+      }
+    }
+  }
+  return best;
+}
+
+const NvDsFusedTrack *
+nvds_track_fusion_assign (NvDsTrackFusion * fusion, guint source,
+    guint64 tracking_id, gfloat x, gfloat y, guint64 timestamp_ns)
+{
+  guint64 source_bit = G_GUINT64_CONSTANT (1) << (source % 64);
+  CameraTrack key = { tracking_id, source, 0, 0 };
+  CameraTrack *track = g_hash_table_lookup (fusion->tracks, &key);
+  NvDsFusedTrack *vehicle = NULL;
+
+  if (track)
+    vehicle = g_hash_table_lookup (fusion->vehicles, &track->vehicle);
+
+  /* A new track, or one whose vehicle was forgotten. */
+  if (!vehicle) {
+    vehicle = find_vehicle (fusion, x, y, source_bit);
+    if (!vehicle) {
+      vehicle = g_new0 (NvDsFusedTrack, 1);
+      vehicle->id = fusion->next_id++;
+      vehicle->x = x;
+      vehicle->y = y;
+      g_hash_table_insert (fusion->vehicles, &vehicle->id, vehicle);
+      grid_insert (fusion, vehicle);
+    }
+    if (!track) {
+      track = g_new (CameraTrack, 1);
+      *track = key;
+      g_hash_table_insert (fusion->tracks, track, track);
+    }
+    track->vehicle = vehicle->id;
+  }
+  track->last_seen = timestamp_ns;
+
+  if (vehicle->batch != fusion->batch) {
+    vehicle->batch = fusion->batch;
+    vehicle->num_observations = 0;
+    vehicle->sources = 0;
+  }
+  vehicle->x = (vehicle->x * vehicle->num_observations + x) /
+      (vehicle->num_observations + 1);
+  vehicle->y = (vehicle->y * vehicle->num_observations + y) /
+      (vehicle->num_observations + 1);
+  vehicle->num_observations++;
+  vehicle->sources |= source_bit;
+  vehicle->last_seen = MAX (vehicle->last_seen, timestamp_ns);
+  return vehicle;
+}
+
+void
+nvds_track_fusion_get_counts (NvDsTrackFusion * fusion, guint * num_vehicles,
+    guint * num_tracks)
+{
+  *num_vehicles = g_hash_table_size (fusion->vehicles);
+  *num_tracks = g_hash_table_size (fusion->tracks);
+}
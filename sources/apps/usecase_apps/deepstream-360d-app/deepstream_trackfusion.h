@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_TRACKFUSION_H__
+#define __NVGSTDS_TRACKFUSION_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+/**
+ * Association of the tracks of the aisle cameras into vehicles with a
+ * global id, in world coordinates. A track seen for the first time joins
+ * the nearest vehicle within the fusion radius that no other track of the
+ * same source was seen on in the batch, or starts a new vehicle. Vehicles
+ * are found through a hash of the world grid cells of the radius size, so
+ * a batch costs about the number of tracks.
+ */
+
+typedef struct
+{
+  guint64 id;
+  /** World position, mean of the observations of the current batch */
+  gfloat x;
+  gfloat y;
+  /** Timestamp (ns) of the last observation */
+  guint64 last_seen;
+
+  /* Internal */
+  guint num_observations;
+  guint64 batch;
+  /** Sources (modulo 64) that saw the vehicle in the batch */
+  guint64 sources;
+  /** World cell, and next vehicle of the same cell */
+  guint64 cell;
+  gpointer next;
+} NvDsFusedTrack;
+
+typedef struct _NvDsTrackFusion NvDsTrackFusion;
+
+/**
+ * @radius: largest distance, in world units, between the observations of
+ * one vehicle by two cameras. @max_age_ms: time after which a track or
+ * vehicle that was not seen is forgotten.
+ */
+NvDsTrackFusion *nvds_track_fusion_new (gfloat radius, guint max_age_ms);
+
+void nvds_track_fusion_free (NvDsTrackFusion * fusion);
+
+/**
+ * Start a batch of observations made up to @now_ns: forget what was not
+ * seen for the maximum age and index the vehicles by world cell.
+ */
+void nvds_track_fusion_begin (NvDsTrackFusion * fusion, guint64 now_ns);
+
+/**
+ * Return the vehicle of track @tracking_id of source @source, seen at @x, @y
+ * at @timestamp_ns. The pointer is valid until the next
+ * nvds_track_fusion_begin().
+ */
+const NvDsFusedTrack *nvds_track_fusion_assign (NvDsTrackFusion * fusion,
+    guint source, guint64 tracking_id, gfloat x, gfloat y,
+    guint64 timestamp_ns);
+
+/** Number of vehicles and of camera tracks currently known. */
+void nvds_track_fusion_get_counts (NvDsTrackFusion * fusion,
+    guint * num_vehicles, guint * num_tracks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
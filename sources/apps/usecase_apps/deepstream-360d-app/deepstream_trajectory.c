@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+
+#include "deepstream_timerwheel.h"
+#include "deepstream_trajectory.h"
+
+#define NS_PER_MS 1000000
+
+enum
+{
+  TIMER_REPORT,
+  TIMER_END,
+  NUM_TIMERS
+};
+
+typedef struct
+{
+  guint source;
+  guint64 tracking_id;
+  NvDsTimer timers[NUM_TIMERS];
+  /** Positions since the last vertex, which is the first one */
+  NvDsTrajectoryPoint window[NVDS_TRAJECTORY_WINDOW];
+  guint num_window;
+  /** Vertices not reported yet */
+  GArray *vertices;
+  gboolean reported;
+  /** Last observation, 8-byte aligned for the struct it holds */
+  guint64 data[];
+} TrajectoryTrack;
+
+struct _NvDsTrajectories
+{
+  gfloat tolerance;
+  guint interval;
+  guint end_latency;
+  gsize data_size;
+
+  /** TrajectoryTrack set, keyed by source and tracking id */
+  GHashTable *tracks;
+  NvDsTimerWheel wheel;
+  gboolean started;
+
+  /* Valid during nvds_trajectories_advance() */
+  NvDsTrajectoryFunc func;
+  gpointer user_data;
+};
+
+/** Squared distance of @p to the segment @a @b. */
+static inline gfloat
+segment_distance2 (const NvDsTrajectoryPoint * p,
+    const NvDsTrajectoryPoint * a, const NvDsTrajectoryPoint * b)
+{
+  gfloat dx = b->x - a->x;
+  gfloat dy = b->y - a->y;
+  gfloat px = p->x - a->x;
+  gfloat py = p->y - a->y;
+  gfloat len2 = dx * dx + dy * dy;
+  gfloat t = len2 > 0 ? (px * dx + py * dy) / len2 : 0;
+
+  t = CLAMP (t, 0, 1);
+  px -= t * dx;
+  py -= t * dy;
+  return px * px + py * py;
+}
+
+guint
+nvds_trajectory_simplify (const NvDsTrajectoryPoint * points,
+    guint num_points, gfloat tolerance, gboolean * keep)
+{
+  guint local[2 * NVDS_TRAJECTORY_WINDOW];
+  guint *stack = num_points <= NVDS_TRAJECTORY_WINDOW ? local :
+      g_new (guint, 2 * num_points);
+  gfloat tolerance2 = tolerance * tolerance;
+  guint depth = 0;
+  guint num_kept = 0;
+  guint i;
+
+  if (num_points <= 2) {
+    for (i = 0; i < num_points; i++)
+      keep[i] = TRUE;
+    num_kept = num_points;
+    goto done;
+  }
+
+  memset (keep, 0, num_points * sizeof (gboolean));
+  keep[0] = keep[num_points - 1] = TRUE;
+  num_kept = 2;
+
+  /* Ranges still to split, as first and last index. */
+  stack[depth++] = 0;
+  stack[depth++] = num_points - 1;
+  while (depth) {
+    guint last = stack[--depth];
+    guint first = stack[--depth];
+    gfloat max_d2 = tolerance2;
+    guint split = 0;
+
+    for (i = first + 1; i < last; i++) {
+      gfloat d2 = segment_distance2 (&points[i], &points[first],
+          &points[last]);
+
+      if (d2 > max_d2) {
+        max_d2 = d2;
+        split = i;
+      }
+    }
+    if (!split)
+      continue;
+
+    keep[split] = TRUE;
+    num_kept++;
+    if (split - first > 1) {
+      stack[depth++] = first;
+      stack[depth++] = split;
+    }
+    if (last - split > 1) {
+      stack[depth++] = split;
+      stack[depth++] = last;
+    }
+  }
+
+done:
+  if (stack != local)
+    g_free (stack);
+  return num_kept;
+}
+
+static guint
+track_hash (gconstpointer key)
+{
+  const TrajectoryTrack *track = (const TrajectoryTrack *) key;
+
+  return (guint) (track->tracking_id ^ (track->tracking_id >> 32)) ^
+      (track->source * 0x9e3779b1u);
+}
+
+static gboolean
+track_equal (gconstpointer a, gconstpointer b)
+{
+  const TrajectoryTrack *ta = (const TrajectoryTrack *) a;
+  const TrajectoryTrack *tb = (const TrajectoryTrack *) b;
+
+  return ta->source == tb->source && ta->tracking_id == tb->tracking_id;
+}
+
+static void
+track_free (gpointer data)
+{
+  TrajectoryTrack *track = (TrajectoryTrack *) data;
+
+  g_array_free (track->vertices, TRUE);
+  g_free (track);
+}
+
+NvDsTrajectories *
+nvds_trajectories_new (gfloat tolerance, guint interval, guint end_latency,
+    gsize data_size)
+{
+  NvDsTrajectories *trajectories = g_new0 (NvDsTrajectories, 1);
+
+  trajectories->tolerance = tolerance;
+  trajectories->interval = interval;
+  trajectories->end_latency = end_latency ? end_latency :
+      NVDS_TRAJECTORY_DEFAULT_END_LATENCY;
+  trajectories->data_size = data_size;
+  trajectories->tracks = g_hash_table_new_full (track_hash, track_equal,
+      track_free, NULL);
+  return trajectories;
+}
+
+void
+nvds_trajectories_free (NvDsTrajectories * trajectories)
+{
+  if (!trajectories)
+    return;
+
+  g_hash_table_destroy (trajectories->tracks);
+  g_free (trajectories);
+}
+
+/** Move the vertices of the window but its last point to the track's. */
+static void
+simplify_window (NvDsTrajectories * trajectories, TrajectoryTrack * track)
+{
+  gboolean keep[NVDS_TRAJECTORY_WINDOW];
+  guint n = track->num_window;
+  guint i;
+
+  if (n < 2)
+    return;
+
+  nvds_trajectory_simplify (track->window, n, trajectories->tolerance, keep);
+  for (i = 0; i < n - 1; i++) {
+    if (keep[i])
+      g_array_append_val (track->vertices, track->window[i]);
+  }
+  track->window[0] = track->window[n - 1];
+  track->num_window = 1;
+}
+
+/**
+ * Report the vertices since the last report, which end at the last
+ * position of the track. Unless the track ended, nothing is reported if
+ * there are none.
+ */
+static void
+report (NvDsTrajectories * trajectories, TrajectoryTrack * track,
+    gboolean final, NvDsTrajectoryFunc func, gpointer user_data)
+{
+  simplify_window (trajectories, track);
+  if (!track->vertices->len && track->reported && !final)
+    return;
+
+  g_array_append_val (track->vertices, track->window[0]);
+  func ((const NvDsTrajectoryPoint *) track->vertices->data,
+      track->vertices->len, final, track->data, user_data);
+  g_array_set_size (track->vertices, 0);
+  track->reported = TRUE;
+}
+
+void
+nvds_trajectories_add (NvDsTrajectories * trajectories, guint source,
+    guint64 tracking_id, gfloat x, gfloat y, guint64 timestamp_ns,
+    gconstpointer data)
+{
+  NvDsTimerWheel *wheel = &trajectories->wheel;
+  guint64 now = timestamp_ns / NS_PER_MS;
+  TrajectoryTrack key, *track;
+  NvDsTrajectoryPoint *point;
+  guint i;
+
+  if (!trajectories->started) {
+    nvds_timer_wheel_init (wheel, now);
+    trajectories->started = TRUE;
+  }
+
+  key.source = source;
+  key.tracking_id = tracking_id;
+  track = (TrajectoryTrack *) g_hash_table_lookup (trajectories->tracks, &key);
+  if (!track) {
+    track = (TrajectoryTrack *) g_malloc0 (sizeof (TrajectoryTrack) +
+        trajectories->data_size);
+    track->source = source;
+    track->tracking_id = tracking_id;
+    track->vertices = g_array_new (FALSE, FALSE, sizeof (NvDsTrajectoryPoint));
+    for (i = 0; i < NUM_TIMERS; i++) {
+      nvds_timer_init (&track->timers[i]);
+      track->timers[i].tag = i;
+    }
+    if (trajectories->interval) {
+      nvds_timer_wheel_add (wheel, &track->timers[TIMER_REPORT],
+          now + trajectories->interval);
+    }
+    g_hash_table_insert (trajectories->tracks, track, track);
+  }
+  memcpy (track->data, data, trajectories->data_size);
+
+  if (track->num_window == NVDS_TRAJECTORY_WINDOW)
+    simplify_window (trajectories, track);
+  point = &track->window[track->num_window++];
+  point->x = x;
+  point->y = y;
+  point->timestamp = timestamp_ns;
+
+  nvds_timer_wheel_add (wheel, &track->timers[TIMER_END],
+      now + trajectories->end_latency);
+}
+
+static void
+on_timer (NvDsTimer * timer, gpointer user_data)
+{
+  NvDsTrajectories *trajectories = (NvDsTrajectories *) user_data;
+  TrajectoryTrack *track = (TrajectoryTrack *) ((guint8 *) (timer -
+          timer->tag) - G_STRUCT_OFFSET (TrajectoryTrack, timers));
+
+  switch (timer->tag) {
+    case TIMER_REPORT:
+      report (trajectories, track, FALSE, trajectories->func,
+          trajectories->user_data);
+      nvds_timer_wheel_add (&trajectories->wheel, timer,
+          timer->expires + trajectories->interval);
+      break;
+    case TIMER_END:
+      report (trajectories, track, TRUE, trajectories->func,
+          trajectories->user_data);
+      nvds_timer_wheel_cancel (&trajectories->wheel,
+          &track->timers[TIMER_REPORT]);
+      g_hash_table_remove (trajectories->tracks, track);
+      break;
+  }
+}
+
+void
+nvds_trajectories_advance (NvDsTrajectories * trajectories, guint64 now_ns,
+    NvDsTrajectoryFunc func, gpointer user_data)
+{
+  if (!trajectories->started)
+    return;
+
+  trajectories->func = func;
+  trajectories->user_data = user_data;
+  nvds_timer_wheel_advance (&trajectories->wheel, now_ns / NS_PER_MS,
+      on_timer, trajectories);
+  trajectories->func = NULL;
+  trajectories->user_data = NULL;
+}
+
+void
+nvds_trajectories_flush (NvDsTrajectories * trajectories,
+    NvDsTrajectoryFunc func, gpointer user_data)
+{
+  GHashTableIter iter;
+  gpointer track;
+
+  g_hash_table_iter_init (&iter, trajectories->tracks);
+  while (g_hash_table_iter_next (&iter, &track, NULL))
+    report (trajectories, (TrajectoryTrack *) track, TRUE, func, user_data);
+
+  /* The wheel is initialized again by the next position. */
+  g_hash_table_remove_all (trajectories->tracks);
+  trajectories->started = FALSE;
+}
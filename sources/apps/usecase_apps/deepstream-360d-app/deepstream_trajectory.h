@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_TRAJECTORY_H__
+#define __NVGSTDS_TRAJECTORY_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <gst/gst.h>
+
+/**
+ * Simplified trajectories of tracks in world coordinates. The positions of
+ * a track are gathered in a window of NVDS_TRAJECTORY_WINDOW points which is
+ * simplified with Douglas-Peucker whenever it fills up, starting the next
+ * window at its last point. Every position stays within the tolerance of the
+ * polyline, which is reported at a fixed interval and when the track ends.
+ */
+
+#define NVDS_TRAJECTORY_WINDOW 64
+#define NVDS_TRAJECTORY_DEFAULT_END_LATENCY 2000
+
+typedef struct
+{
+  gfloat x;
+  gfloat y;
+  guint64 timestamp;
+} NvDsTrajectoryPoint;
+
+typedef struct _NvDsTrajectories NvDsTrajectories;
+
+/**
+ * @points continue the polyline last reported for the track, starting at
+ * its last vertex. @data is the copy of the last observation of the track.
+ * @final is set when the track ended.
+ */
+typedef void (*NvDsTrajectoryFunc) (const NvDsTrajectoryPoint * points,
+    guint num_points, gboolean final, gconstpointer data, gpointer user_data);
+
+/**
+ * Mark which of @num_points @points are kept by Douglas-Peucker with
+ * @tolerance in @keep. The first and last ones always are. Returns the
+ * number of points kept.
+ */
+guint nvds_trajectory_simplify (const NvDsTrajectoryPoint * points,
+    guint num_points, gfloat tolerance, gboolean * keep);
+
+/**
+ * @interval: ms between reports of a track, 0 to report it only at its end.
+ * @end_latency: ms after which a track that was not seen ends, 0 for the
+ * default. @data_size bytes of each observation are kept for the reports.
+ */
+NvDsTrajectories *nvds_trajectories_new (gfloat tolerance, guint interval,
+    guint end_latency, gsize data_size);
+
+void nvds_trajectories_free (NvDsTrajectories * trajectories);
+
+/** Add the position of track @tracking_id of @source at @timestamp_ns. */
+void nvds_trajectories_add (NvDsTrajectories * trajectories, guint source,
+    guint64 tracking_id, gfloat x, gfloat y, guint64 timestamp_ns,
+    gconstpointer data);
+
+/** Report, through @func, the trajectories due up to @now_ns. */
+void nvds_trajectories_advance (NvDsTrajectories * trajectories,
+    guint64 now_ns, NvDsTrajectoryFunc func, gpointer user_data);
+
+/** End every track and report what is left of it. */
+void nvds_trajectories_flush (NvDsTrajectories * trajectories,
+    NvDsTrajectoryFunc func, gpointer user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
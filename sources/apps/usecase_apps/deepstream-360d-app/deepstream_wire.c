@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+
+#include "deepstream_payload.h"
+#include "deepstream_wire.h"
+
+void
+nvds_wire_append_varint (GString * str, guint64 value)
+{
+  while (value >= 0x80) {
+    g_string_append_c (str, (gchar) (value | 0x80));
+    value >>= 7;
+  }
+  g_string_append_c (str, (gchar) value);
+}
+
+static void
+append_u32le (GString * str, guint32 value)
+{
+  gchar bytes[4];
+
+  bytes[0] = (gchar) value;
+  bytes[1] = (gchar) (value >> 8);
+  bytes[2] = (gchar) (value >> 16);
+  bytes[3] = (gchar) (value >> 24);
+  g_string_append_len (str, bytes, 4);
+}
+
+void
+nvds_wire_writer_init (NvDsWireWriter * writer)
+{
+  memset (writer, 0, sizeof (NvDsWireWriter));
+  /* Keys are the strings of the calibration and of the spot counts, only
+   * held while a message is built. */
+  writer->ids = g_hash_table_new (g_str_hash, g_str_equal);
+  writer->offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+  writer->strings = g_string_sized_new (256);
+  writer->records = g_string_sized_new (256);
+  writer->message = g_string_sized_new (512);
+}
+
+void
+nvds_wire_writer_clear (NvDsWireWriter * writer)
+{
+  if (!writer->ids)
+    return;
+
+  g_hash_table_destroy (writer->ids);
+  g_array_free (writer->offsets, TRUE);
+  g_string_free (writer->strings, TRUE);
+  g_string_free (writer->records, TRUE);
+  g_string_free (writer->message, TRUE);
+  memset (writer, 0, sizeof (NvDsWireWriter));
+}
+
+void
+nvds_wire_writer_begin (NvDsWireWriter * writer, NvDsWireKind kind,
+    guint64 timestamp_ns)
+{
+  writer->kind = kind;
+  writer->timestamp_ms = timestamp_ns / 1000000;
+  writer->num_records = 0;
+  g_hash_table_remove_all (writer->ids);
+  g_array_set_size (writer->offsets, 0);
+  g_string_truncate (writer->strings, 0);
+  g_string_truncate (writer->records, 0);
+}
+
+void
+nvds_wire_put_uint (NvDsWireWriter * writer, guint64 value)
+{
+  nvds_wire_append_varint (writer->records, value);
+}
+
+void
+nvds_wire_put_string (NvDsWireWriter * writer, const gchar * str)
+{
+  guint id = GPOINTER_TO_UINT (g_hash_table_lookup (writer->ids, str));
+
+  if (!id) {
+    guint32 end;
+
+    g_string_append (writer->strings, str);
+    end = writer->strings->len;
+    g_array_append_val (writer->offsets, end);
+    id = writer->offsets->len;
+    g_hash_table_insert (writer->ids, (gpointer) str, GUINT_TO_POINTER (id));
+  }
+  nvds_wire_append_varint (writer->records, id - 1);
+}
+
+NvDsPayload *
+nvds_wire_writer_finish (NvDsWireWriter * writer, guint comp_id)
+{
+  GString *msg = writer->message;
+  gchar header[NVDS_WIRE_HEADER_SIZE] = NVDS_WIRE_MAGIC;
+  guint i;
+
+  header[4] = NVDS_WIRE_VERSION;
+  header[5] = (gchar) writer->kind;
+
+  g_string_truncate (msg, 0);
+  g_string_append_len (msg, header, NVDS_WIRE_HEADER_SIZE);
+  nvds_wire_append_varint (msg, comp_id);
+  nvds_wire_append_varint (msg, writer->timestamp_ms);
+  nvds_wire_append_varint (msg, NVDS_WIRE_DEFAULT_QUANTUM);
+
+  nvds_wire_append_varint (msg, writer->offsets->len);
+  for (i = 0; i < writer->offsets->len; i++)
+    append_u32le (msg, g_array_index (writer->offsets, guint32, i));
+  g_string_append_len (msg, writer->strings->str, writer->strings->len);
+
+  nvds_wire_append_varint (msg, writer->num_records);
+  g_string_append_len (msg, writer->records->str, writer->records->len);
+  /* Drop the keys before the strings they point to go away. */
+  g_hash_table_remove_all (writer->ids);
+  return nvds_payload_new (msg->str, msg->len, comp_id);
+}
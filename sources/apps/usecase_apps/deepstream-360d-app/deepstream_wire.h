@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVGSTDS_WIRE_H__
+#define __NVGSTDS_WIRE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <math.h>
+#include <gst/gst.h>
+
+#include "gstnvdsmeta.h"
+#include "nvds_wire.h"
+
+/**
+ * Writer of the binary messages described in nvds_wire.h. The strings and
+ * the records of a message are gathered apart, and put together behind the
+ * header by nvds_wire_writer_finish().
+ */
+
+/** [message-broker] payload-type */
+typedef enum
+{
+  NVDS_PAYLOAD_JSON = 0,
+  NVDS_PAYLOAD_BINARY = 1,
+} NvDsPayloadType;
+
+typedef struct
+{
+  NvDsWireKind kind;
+  guint64 timestamp_ms;
+  guint num_records;
+  /** Index + 1 of each string of the message, by content */
+  GHashTable *ids;
+  /** End offset of each string in strings */
+  GArray *offsets;
+  GString *strings;
+  GString *records;
+  GString *message;
+} NvDsWireWriter;
+
+/** Append @value to @str as an unsigned LEB128 varint. */
+void nvds_wire_append_varint (GString * str, guint64 value);
+
+void nvds_wire_writer_init (NvDsWireWriter * writer);
+
+void nvds_wire_writer_clear (NvDsWireWriter * writer);
+
+/** Start a message of @kind whose times are relative to @timestamp_ns. */
+void nvds_wire_writer_begin (NvDsWireWriter * writer, NvDsWireKind kind,
+    guint64 timestamp_ns);
+
+/** Start the next record. */
+static inline void
+nvds_wire_writer_record (NvDsWireWriter * writer)
+{
+  writer->num_records++;
+}
+
+void nvds_wire_put_uint (NvDsWireWriter * writer, guint64 value);
+
+static inline void
+nvds_wire_put_sint (NvDsWireWriter * writer, gint64 value)
+{
+  nvds_wire_put_uint (writer, ((guint64) value << 1) ^ (guint64) (value >> 63));
+}
+
+/** Time @timestamp_ns of an event, relative to that of the message. */
+static inline void
+nvds_wire_put_time (NvDsWireWriter * writer, guint64 timestamp_ns)
+{
+  nvds_wire_put_sint (writer,
+      (gint64) (timestamp_ns / 1000000) - (gint64) writer->timestamp_ms);
+}
+
+/** World coordinate @value in quanta, see NVDS_WIRE_DEFAULT_QUANTUM. */
+static inline gint64
+nvds_wire_quantize (gdouble value)
+{
+  return (gint64) llround (value * NVDS_WIRE_DEFAULT_QUANTUM);
+}
+
+/** Put the index of @str in the strings of the message, added if new. */
+void nvds_wire_put_string (NvDsWireWriter * writer, const gchar * str);
+
+/** Put the message together and return it as a payload. */
+NvDsPayload *nvds_wire_writer_finish (NvDsWireWriter * writer, guint comp_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVDS_LOOPBACK_H__
+#define __NVDS_LOOPBACK_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+/**
+ * Stream between the loopback protocol adapter (sources/libs/
+ * nvds_loopback_proto) and the sink it sends to (sources/tools/
+ * nvds_loopback_sink), over TCP or a Unix socket. Each message is
+ *
+ *   header    NVDS_LOOPBACK_HEADER_SIZE bytes, see below
+ *   topic     topic_len bytes, not NUL terminated
+ *   payload   size bytes
+ *
+ * The integers of the header are in network byte order. send_time is the
+ * CLOCK_REALTIME time, in ns, the adapter was handed the message, so that
+ * the sink can tell how long it took to arrive.
+ */
+
+#define NVDS_LOOPBACK_MAGIC 0x4e564c42  /* "NVLB" */
+#define NVDS_LOOPBACK_VERSION 1
+#define NVDS_LOOPBACK_HEADER_SIZE 24
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t topic_len;
+  uint32_t size;
+  /** Messages sent before this one on the connection */
+  uint32_t seq;
+  uint64_t send_time;
+} NvDsLoopbackHeader;
+
+static inline void
+nvds_loopback_header_pack (const NvDsLoopbackHeader * header,
+    uint8_t out[NVDS_LOOPBACK_HEADER_SIZE])
+{
+  uint32_t u32;
+  uint16_t u16;
+
+  u32 = htonl (header->magic);
+  memcpy (out, &u32, 4);
+  u16 = htons (header->version);
+  memcpy (out + 4, &u16, 2);
+  u16 = htons (header->topic_len);
+  memcpy (out + 6, &u16, 2);
+  u32 = htonl (header->size);
+  memcpy (out + 8, &u32, 4);
+  u32 = htonl (header->seq);
+  memcpy (out + 12, &u32, 4);
+  u32 = htonl ((uint32_t) (header->send_time >> 32));
+  memcpy (out + 16, &u32, 4);
+  u32 = htonl ((uint32_t) header->send_time);
+  memcpy (out + 20, &u32, 4);
+}
+
+/** Returns -1 if @in is not a header of this version. */
+static inline int
+nvds_loopback_header_unpack (const uint8_t in[NVDS_LOOPBACK_HEADER_SIZE],
+    NvDsLoopbackHeader * header)
+{
+  uint32_t u32, lo;
+  uint16_t u16;
+
+  memcpy (&u32, in, 4);
+  header->magic = ntohl (u32);
+  memcpy (&u16, in + 4, 2);
+  header->version = ntohs (u16);
+  memcpy (&u16, in + 6, 2);
+  header->topic_len = ntohs (u16);
+  memcpy (&u32, in + 8, 4);
+  header->size = ntohl (u32);
+  memcpy (&u32, in + 12, 4);
+  header->seq = ntohl (u32);
+  memcpy (&u32, in + 16, 4);
+  memcpy (&lo, in + 20, 4);
+  header->send_time = (uint64_t) ntohl (u32) << 32 | ntohl (lo);
+
+  if (header->magic != NVDS_LOOPBACK_MAGIC ||
+      header->version != NVDS_LOOPBACK_VERSION)
+    return -1;
+  return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
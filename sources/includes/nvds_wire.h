@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVDS_WIRE_H__
+#define __NVDS_WIRE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Binary encoding of the spot and aisle messages of the 360d app, selected
+ * with payload-type=1 under [message-broker]. See nvds_wire.schema in
+ * sources/libs/nvds_wire for the layout. In short, a message is
+ *
+ *   header    "NVDW", version, kind, 2 reserved bytes, then varints
+ *             comp-id, timestamp (ms since the epoch), coordinate quantum
+ *   strings   varint count, u32 end offset of each, then their bytes
+ *   records   varint count, then the records of the kind
+ *
+ * Every string of a message (sensor, spot, level, ...) is stored once and
+ * referred to by its index. Unsigned integers are LEB128 varints, signed
+ * ones zigzag varints; coordinates are multiples of 1 / quantum world units
+ * and times are ms relative to the header timestamp. The string table has
+ * fixed-size offsets, so that the reader below can hand out strings in
+ * place, without copying or allocating anything.
+ */
+
+#define NVDS_WIRE_MAGIC "NVDW"
+#define NVDS_WIRE_VERSION 1
+#define NVDS_WIRE_HEADER_SIZE 8
+
+/** Coordinate quantum of the app, i.e. the precision of its JSON payloads */
+#define NVDS_WIRE_DEFAULT_QUANTUM 10000
+/** Quanta of the speed (per world unit per second) and heading (per degree) */
+#define NVDS_WIRE_SPEED_QUANTUM 100
+#define NVDS_WIRE_HEADING_QUANTUM 10
+
+typedef enum
+{
+  /** Spot occupancy changes, one record each */
+  NVDS_WIRE_KIND_SPOT = 1,
+  /** Aisle objects, one record each */
+  NVDS_WIRE_KIND_AISLE = 2,
+  /** Occupancy counts by level, zone and spot type */
+  NVDS_WIRE_KIND_ROLLUP = 3,
+} NvDsWireKind;
+
+typedef enum
+{
+  NVDS_WIRE_SPOT_EMPTY = 0,
+  NVDS_WIRE_SPOT_PARKED = 1,
+} NvDsWireSpotEventType;
+
+typedef enum
+{
+  NVDS_WIRE_AISLE_MOVING = 0,
+  NVDS_WIRE_AISLE_ENTRY = 1,
+  NVDS_WIRE_AISLE_EXIT = 2,
+  NVDS_WIRE_AISLE_TRAJECTORY = 3,
+} NvDsWireAisleEventType;
+
+/** Flags of an aisle record */
+#define NVDS_WIRE_AISLE_HAS_SPEED 0x1
+/** The trajectory of the record is the last of its track */
+#define NVDS_WIRE_AISLE_FINAL 0x2
+/** The entry or exit was confirmed, not seen in a single frame */
+#define NVDS_WIRE_AISLE_CONFIRMED 0x4
+
+/** Group kinds of a roll-up record */
+typedef enum
+{
+  NVDS_WIRE_GROUP_LEVEL = 0,
+  NVDS_WIRE_GROUP_ZONE = 1,
+  NVDS_WIRE_GROUP_TYPE = 2,
+} NvDsWireGroupKind;
+
+/** A string of the message, in place; not NUL terminated. */
+typedef struct
+{
+  const char *data;
+  uint32_t len;
+} NvDsWireString;
+
+typedef struct
+{
+  /** ms since the epoch */
+  uint64_t timestamp;
+  NvDsWireString place;
+  NvDsWireString type;
+  NvDsWireString level;
+  NvDsWireString sensor;
+  NvDsWireString description;
+  /** World coordinate of the center of the spot */
+  double x;
+  double y;
+  NvDsWireSpotEventType event;
+} NvDsWireSpotRecord;
+
+typedef struct
+{
+  /** ms since the epoch; for a trajectory, that of its first point */
+  uint64_t timestamp;
+  NvDsWireString place;
+  NvDsWireString name;
+  NvDsWireString level;
+  NvDsWireString sensor;
+  NvDsWireString description;
+  uint64_t object_id;
+  uint32_t frame_num;
+  /** Box in the pixels of the aisle surface */
+  uint32_t left;
+  uint32_t top;
+  uint32_t right;
+  uint32_t bottom;
+  double x;
+  double y;
+  /** Valid with NVDS_WIRE_AISLE_HAS_SPEED */
+  double speed;
+  double direction;
+  uint32_t flags;
+  NvDsWireAisleEventType event;
+  /** Points to read with nvds_wire_read_point() for a trajectory */
+  uint32_t num_points;
+} NvDsWireAisleRecord;
+
+typedef struct
+{
+  double x;
+  double y;
+  /** ms since the epoch */
+  uint64_t timestamp;
+} NvDsWirePoint;
+
+typedef struct
+{
+  NvDsWireGroupKind kind;
+  NvDsWireString id;
+  uint32_t total;
+  uint32_t occupied;
+  uint32_t unknown;
+} NvDsWireGroupRecord;
+
+/**
+ * Cursor over a message. It points into the message, which must stay
+ * valid and unchanged while it is read.
+ */
+typedef struct
+{
+  uint32_t version;
+  NvDsWireKind kind;
+  uint32_t comp_id;
+  /** ms since the epoch */
+  uint64_t timestamp;
+  uint32_t quantum;
+  uint32_t num_strings;
+  uint32_t num_records;
+
+  /* Private */
+  const uint8_t *offsets;
+  const uint8_t *strings;
+  uint32_t strings_size;
+  const uint8_t *cur;
+  const uint8_t *end;
+  uint32_t records_left;
+  uint32_t points_left;
+  int64_t last_x;
+  int64_t last_y;
+  uint64_t last_time;
+} NvDsWireReader;
+
+/**
+ * Frames of messages, sent instead of the messages themselves when
+ * batch-max-size is set under [message-broker]. A frame is
+ *
+ *   header    "NVDF", version, codec, 2 reserved bytes, then varints
+ *             number of messages and size of the uncompressed body
+ *   body      compressed with the codec: for each message, varints of its
+ *             comp-id and size, then its bytes, JSON or binary
+ *
+ * The codec of a frame is NONE when compression would not make it smaller.
+ * The reader does not decompress: nvds_wire_frame_init() gives the body,
+ * to be decompressed with liblz4 or libzstd into a buffer of raw_size
+ * bytes, whose messages nvds_wire_frame_next() returns in place.
+ */
+
+#define NVDS_WIRE_FRAME_MAGIC "NVDF"
+#define NVDS_WIRE_FRAME_VERSION 1
+
+typedef enum
+{
+  NVDS_WIRE_CODEC_NONE = 0,
+  /** LZ4 block format, LZ4_decompress_safe() */
+  NVDS_WIRE_CODEC_LZ4 = 1,
+  /** Zstandard frame, ZSTD_decompress() */
+  NVDS_WIRE_CODEC_ZSTD = 2,
+} NvDsWireCodec;
+
+typedef struct
+{
+  NvDsWireCodec codec;
+  uint32_t num_messages;
+  /** Size of the body once decompressed */
+  uint32_t raw_size;
+  /** Body of the frame, in place */
+  const uint8_t *body;
+  size_t body_size;
+} NvDsWireFrame;
+
+/** Cursor over the messages of a decompressed frame body. */
+typedef struct
+{
+  const uint8_t *cur;
+  const uint8_t *end;
+  uint32_t messages_left;
+} NvDsWireFrameCursor;
+
+/** Whether @data starts like a frame rather than a single message. */
+int nvds_wire_is_frame (const void *data, size_t size);
+
+/**
+ * Check the header of the frame @data of @size bytes. Returns 0 on success,
+ * -1 if it is malformed or of an unknown version or codec.
+ */
+int nvds_wire_frame_init (NvDsWireFrame * frame, const void *data,
+    size_t size);
+
+/** Start reading the messages of @frame from its decompressed @body. */
+void nvds_wire_frame_cursor_init (NvDsWireFrameCursor * cursor,
+    const NvDsWireFrame * frame, const void *body);
+
+/**
+ * Next message of the frame. Returns 1 if one was read, 0 after the last
+ * one and -1 if the body is malformed.
+ */
+int nvds_wire_frame_next (NvDsWireFrameCursor * cursor, uint32_t * comp_id,
+    const void **data, size_t * size);
+
+/** Whether @data starts like a binary message rather than a JSON one. */
+int nvds_wire_is_binary (const void *data, size_t size);
+
+/**
+ * Check the header and the string table of the message @data of @size
+ * bytes and set up @reader for its records. Returns 0 on success, -1 if it
+ * is malformed or of an unknown version.
+ */
+int nvds_wire_reader_init (NvDsWireReader * reader, const void *data,
+    size_t size);
+
+/** String @index of the message; returns -1 if there is none. */
+int nvds_wire_reader_string (const NvDsWireReader * reader, uint32_t index,
+    NvDsWireString * str);
+
+/**
+ * Read the next record of a message of the matching kind. Returns 1 if a
+ * record was read, 0 after the last one and -1 if the message is
+ * malformed. The points of an aisle trajectory that are not read are
+ * skipped by the next call.
+ */
+int nvds_wire_read_spot (NvDsWireReader * reader, NvDsWireSpotRecord * rec);
+
+int nvds_wire_read_aisle (NvDsWireReader * reader, NvDsWireAisleRecord * rec);
+
+int nvds_wire_read_point (NvDsWireReader * reader, NvDsWirePoint * point);
+
+int nvds_wire_read_group (NvDsWireReader * reader, NvDsWireGroupRecord * rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "nvds_msgapi.h"
+#include "nvds_loopback.h"
+
+/**
+ * Protocol adapter that sends the messages to nvds_loopback_sink, over TCP
+ * ("host;port") or a Unix socket ("/path;"), instead of to a broker. A topic
+ * after a third ';' is accepted and ignored, like the Kafka adapter.
+ *
+ * Sends are synchronous: a message is written to the socket before
+ * nvds_msgapi_send() returns. The callbacks of nvds_msgapi_send_async() are
+ * called from nvds_msgapi_do_work(). A connection that fails is reported
+ * with NVDS_MSGAPI_EVT_DISCONNECT and opened again on the next send.
+ */
+
+#define LOOPBACK_VERSION "1.0"
+
+typedef struct
+{
+  nvds_msgapi_send_cb_t cb;
+  void *user_ptr;
+  NvDsMsgApiErrorType status;
+} Completion;
+
+typedef struct
+{
+  /** Unix socket path, or host and port */
+  char *path;
+  char *host;
+  char *port;
+  nvds_msgapi_connect_cb_t connect_cb;
+  int fd;
+  uint32_t seq;
+
+  pthread_mutex_t lock;
+  Completion *completions;
+  size_t num_completions;
+  size_t max_completions;
+
+  /* Counts printed at disconnect. */
+  uint64_t messages;
+  uint64_t bytes;
+  uint64_t failures;
+  uint64_t send_ns;
+  uint64_t max_send_ns;
+} Loopback;
+
+static uint64_t
+now_ns (clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime (clock, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+parse_conn_str (Loopback * lb, const char *conn_str)
+{
+  const char *sep = strchr (conn_str, ';');
+  const char *end;
+  size_t len = sep ? (size_t) (sep - conn_str) : strlen (conn_str);
+
+  if (!len)
+    return -1;
+  if (conn_str[0] == '/') {
+    lb->path = strndup (conn_str, len);
+    return 0;
+  }
+  if (!sep)
+    return -1;
+  lb->host = strndup (conn_str, len);
+  end = strchr (sep + 1, ';');
+  lb->port = end ? strndup (sep + 1, end - sep - 1) : strdup (sep + 1);
+  return *lb->port ? 0 : -1;
+}
+
+static int
+open_socket (Loopback * lb)
+{
+  struct addrinfo hints, *res, *ai;
+  int fd = -1;
+  int one = 1;
+
+  if (lb->path) {
+    struct sockaddr_un addr;
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strncpy (addr.sun_path, lb->path, sizeof (addr.sun_path) - 1);
+    fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect (fd, (struct sockaddr *) &addr, sizeof (addr))) {
+      close (fd);
+      fd = -1;
+    }
+    return fd;
+  }
+
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo (lb->host, lb->port, &hints, &res))
+    return -1;
+  for (ai = res; ai; ai = ai->ai_next) {
+    fd = socket (ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+        ai->ai_protocol);
+    if (fd < 0)
+      continue;
+    if (!connect (fd, ai->ai_addr, ai->ai_addrlen))
+      break;
+    close (fd);
+    fd = -1;
+  }
+  freeaddrinfo (res);
+  /* Messages are small and latency is measured: do not coalesce them. */
+  if (fd >= 0)
+    setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+  return fd;
+}
+
+static void
+free_loopback (Loopback * lb)
+{
+  free (lb->path);
+  free (lb->host);
+  free (lb->port);
+  free (lb->completions);
+  pthread_mutex_destroy (&lb->lock);
+  free (lb);
+}
+
+NvDsMsgApiHandle
+nvds_msgapi_connect (char *connection_str, nvds_msgapi_connect_cb_t connect_cb,
+    char *config_path)
+{
+  Loopback *lb = (Loopback *) calloc (1, sizeof (Loopback));
+
+  /* The adapter has no settings beyond the connection string. */
+  (void) config_path;
+  pthread_mutex_init (&lb->lock, NULL);
+  lb->connect_cb = connect_cb;
+  if (!connection_str || parse_conn_str (lb, connection_str)) {
+    fprintf (stderr, "nvds_loopback: invalid connection string '%s', "
+        "expected 'host;port' or '/path;'\n", connection_str);
+    free_loopback (lb);
+    return NULL;
+  }
+
+  lb->fd = open_socket (lb);
+  if (lb->fd < 0) {
+    fprintf (stderr, "nvds_loopback: failed to connect to '%s'\n",
+        connection_str);
+    free_loopback (lb);
+    return NULL;
+  }
+  return (NvDsMsgApiHandle) lb;
+}
+
+/** Write all of @iov; returns -1 on error. */
+static int
+write_all (int fd, struct iovec *iov, int iovcnt)
+{
+  struct msghdr msg;
+  ssize_t n;
+
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iovcnt;
+  while (msg.msg_iovlen) {
+    n = sendmsg (fd, &msg, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    while (msg.msg_iovlen && (size_t) n >= msg.msg_iov->iov_len) {
+      n -= msg.msg_iov->iov_len;
+      msg.msg_iov++;
+      msg.msg_iovlen--;
+    }
+    if (msg.msg_iovlen) {
+      msg.msg_iov->iov_base = (uint8_t *) msg.msg_iov->iov_base + n;
+      msg.msg_iov->iov_len -= n;
+    }
+  }
+  return 0;
+}
+
+NvDsMsgApiErrorType
+nvds_msgapi_send (NvDsMsgApiHandle h_ptr, char *topic, const uint8_t * payload,
+    size_t nbuf)
+{
+  Loopback *lb = (Loopback *) h_ptr;
+  NvDsLoopbackHeader header;
+  uint8_t packed[NVDS_LOOPBACK_HEADER_SIZE];
+  struct iovec iov[3];
+  uint64_t start = now_ns (CLOCK_MONOTONIC), elapsed;
+  size_t topic_len = topic ? strlen (topic) : 0;
+  int broken = 0;
+
+  if (!lb || topic_len > UINT16_MAX || nbuf > UINT32_MAX)
+    return NVDS_MSGAPI_ERR;
+
+  pthread_mutex_lock (&lb->lock);
+  if (lb->fd < 0) {
+    lb->fd = open_socket (lb);
+    lb->seq = 0;
+  }
+  if (lb->fd < 0) {
+    lb->failures++;
+    pthread_mutex_unlock (&lb->lock);
+    return NVDS_MSGAPI_ERR;
+  }
+
+  header.magic = NVDS_LOOPBACK_MAGIC;
+  header.version = NVDS_LOOPBACK_VERSION;
+  header.topic_len = topic_len;
+  header.size = nbuf;
+  header.seq = lb->seq;
+  header.send_time = now_ns (CLOCK_REALTIME);
+  nvds_loopback_header_pack (&header, packed);
+  iov[0].iov_base = packed;
+  iov[0].iov_len = sizeof (packed);
+  iov[1].iov_base = topic;
+  iov[1].iov_len = topic_len;
+  iov[2].iov_base = (void *) payload;
+  iov[2].iov_len = nbuf;
+
+  if (write_all (lb->fd, iov, 3)) {
+    close (lb->fd);
+    lb->fd = -1;
+    lb->failures++;
+    broken = 1;
+  } else {
+    lb->seq++;
+    lb->messages++;
+    lb->bytes += nbuf;
+    elapsed = now_ns (CLOCK_MONOTONIC) - start;
+    lb->send_ns += elapsed;
+    if (elapsed > lb->max_send_ns)
+      lb->max_send_ns = elapsed;
+  }
+  pthread_mutex_unlock (&lb->lock);
+
+  if (broken) {
+    if (lb->connect_cb)
+      lb->connect_cb (h_ptr, NVDS_MSGAPI_EVT_DISCONNECT);
+    return NVDS_MSGAPI_ERR;
+  }
+  return NVDS_MSGAPI_OK;
+}
+
+NvDsMsgApiErrorType
+nvds_msgapi_send_async (NvDsMsgApiHandle h_ptr, char *topic,
+    const uint8_t * payload, size_t nbuf, nvds_msgapi_send_cb_t send_callback,
+    void *user_ptr)
+{
+  Loopback *lb = (Loopback *) h_ptr;
+  NvDsMsgApiErrorType status = nvds_msgapi_send (h_ptr, topic, payload, nbuf);
+
+  if (!lb || !send_callback)
+    return status;
+
+  pthread_mutex_lock (&lb->lock);
+  if (lb->num_completions == lb->max_completions) {
+    lb->max_completions = lb->max_completions ? 2 * lb->max_completions : 64;
+    lb->completions = (Completion *) realloc (lb->completions,
+        lb->max_completions * sizeof (Completion));
+  }
+  lb->completions[lb->num_completions].cb = send_callback;
+  lb->completions[lb->num_completions].user_ptr = user_ptr;
+  lb->completions[lb->num_completions].status = status;
+  lb->num_completions++;
+  pthread_mutex_unlock (&lb->lock);
+  return NVDS_MSGAPI_OK;
+}
+
+void
+nvds_msgapi_do_work (NvDsMsgApiHandle h_ptr)
+{
+  Loopback *lb = (Loopback *) h_ptr;
+  Completion *completions;
+  size_t num, max, i;
+
+  if (!lb)
+    return;
+
+  /* Call back without the lock, so the callbacks may send again. */
+  pthread_mutex_lock (&lb->lock);
+  completions = lb->completions;
+  num = lb->num_completions;
+  max = lb->max_completions;
+  lb->completions = NULL;
+  lb->num_completions = lb->max_completions = 0;
+  pthread_mutex_unlock (&lb->lock);
+
+  for (i = 0; i < num; i++)
+    completions[i].cb (completions[i].user_ptr, completions[i].status);
+
+  pthread_mutex_lock (&lb->lock);
+  if (!lb->completions) {
+    lb->completions = completions;
+    lb->max_completions = max;
+    completions = NULL;
+  }
+  pthread_mutex_unlock (&lb->lock);
+  free (completions);
+}
+
+NvDsMsgApiErrorType
+nvds_msgapi_disconnect (NvDsMsgApiHandle h_ptr)
+{
+  Loopback *lb = (Loopback *) h_ptr;
+
+  if (!lb)
+    return NVDS_MSGAPI_ERR;
+
+  nvds_msgapi_do_work (h_ptr);
+  printf ("nvds_loopback: %llu messages, %.2f MB, %llu failures, "
+      "send %.1f us mean, %.1f us max\n", (unsigned long long) lb->messages,
+      lb->bytes / (1024.0 * 1024.0), (unsigned long long) lb->failures,
+      lb->messages ? lb->send_ns / 1000.0 / lb->messages : 0.0,
+      lb->max_send_ns / 1000.0);
+  if (lb->fd >= 0)
+    close (lb->fd);
+  free_loopback (lb);
+  return NVDS_MSGAPI_OK;
+}
+
+char *
+nvds_msgapi_getversion (void)
+{
+  return (char *) LOOPBACK_VERSION;
+}
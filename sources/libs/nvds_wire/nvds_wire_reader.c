@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <string.h>
+
+#include "nvds_wire.h"
+
+/* Varints longer than this are malformed. */
+#define MAX_VARINT_BYTES 10
+
+static int
+decode_uint (const uint8_t ** cur, const uint8_t * end, uint64_t * value)
+{
+  const uint8_t *p = *cur;
+  uint64_t v = 0;
+  unsigned shift = 0;
+
+  while (p < end && shift < 7 * MAX_VARINT_BYTES) {
+    uint8_t b = *p++;
+
+    v |= (uint64_t) (b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      *cur = p;
+      *value = v;
+      return 0;
+    }
+    shift += 7;
+  }
+  return -1;
+}
+
+static int
+decode_uint32 (const uint8_t ** cur, const uint8_t * end, uint32_t * value)
+{
+  uint64_t v;
+
+  if (decode_uint (cur, end, &v) || v > UINT32_MAX)
+    return -1;
+  *value = (uint32_t) v;
+  return 0;
+}
+
+static int
+read_uint (NvDsWireReader * reader, uint64_t * value)
+{
+  return decode_uint (&reader->cur, reader->end, value);
+}
+
+static int
+read_uint32 (NvDsWireReader * reader, uint32_t * value)
+{
+  return decode_uint32 (&reader->cur, reader->end, value);
+}
+
+static int
+read_sint (NvDsWireReader * reader, int64_t * value)
+{
+  uint64_t v;
+
+  if (read_uint (reader, &v))
+    return -1;
+  *value = (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+  return 0;
+}
+
+static int
+read_string (NvDsWireReader * reader, NvDsWireString * str)
+{
+  uint32_t index;
+
+  if (read_uint32 (reader, &index))
+    return -1;
+  return nvds_wire_reader_string (reader, index, str);
+}
+
+static uint32_t
+load_u32le (const uint8_t * p)
+{
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 |
+      (uint32_t) p[3] << 24;
+}
+
+int
+nvds_wire_is_binary (const void *data, size_t size)
+{
+  return size >= NVDS_WIRE_HEADER_SIZE &&
+      !memcmp (data, NVDS_WIRE_MAGIC, 4);
+}
+
+int
+nvds_wire_reader_init (NvDsWireReader * reader, const void *data, size_t size)
+{
+  const uint8_t *p = (const uint8_t *) data;
+  uint64_t timestamp;
+  uint32_t i, prev = 0;
+
+  memset (reader, 0, sizeof (NvDsWireReader));
+  if (!nvds_wire_is_binary (data, size) || p[4] != NVDS_WIRE_VERSION)
+    return -1;
+
+  reader->version = p[4];
+  reader->kind = (NvDsWireKind) p[5];
+  reader->cur = p + NVDS_WIRE_HEADER_SIZE;
+  reader->end = p + size;
+  if (read_uint32 (reader, &reader->comp_id) ||
+      read_uint (reader, &timestamp) ||
+      read_uint32 (reader, &reader->quantum) || !reader->quantum ||
+      read_uint32 (reader, &reader->num_strings))
+    return -1;
+  reader->timestamp = timestamp;
+
+  if (reader->num_strings > (size_t) (reader->end - reader->cur) / 4)
+    return -1;
+  reader->offsets = reader->cur;
+  reader->strings = reader->cur + 4 * (size_t) reader->num_strings;
+  for (i = 0; i < reader->num_strings; i++) {
+    uint32_t offset = load_u32le (reader->offsets + 4 * (size_t) i);
+
+    if (offset < prev)
+      return -1;
+    prev = offset;
+  }
+  if (prev > (size_t) (reader->end - reader->strings))
+    return -1;
+  reader->strings_size = prev;
+  reader->cur = reader->strings + prev;
+
+  if (read_uint32 (reader, &reader->num_records))
+    return -1;
+  reader->records_left = reader->num_records;
+  return 0;
+}
+
+int
+nvds_wire_reader_string (const NvDsWireReader * reader, uint32_t index,
+    NvDsWireString * str)
+{
+  uint32_t start, end;
+
+  if (index >= reader->num_strings)
+    return -1;
+  start = index ? load_u32le (reader->offsets + 4 * (size_t) (index - 1)) : 0;
+  end = load_u32le (reader->offsets + 4 * (size_t) index);
+  str->data = (const char *) reader->strings + start;
+  str->len = end - start;
+  return 0;
+}
+
+/** Start the next record; returns 1 if there is one. */
+static int
+next_record (NvDsWireReader * reader, NvDsWireKind kind)
+{
+  NvDsWirePoint point;
+
+  if (reader->kind != kind)
+    return -1;
+  while (reader->points_left) {
+    if (nvds_wire_read_point (reader, &point) < 0)
+      return -1;
+  }
+  if (!reader->records_left)
+    return 0;
+  reader->records_left--;
+  return 1;
+}
+
+static int
+read_time (NvDsWireReader * reader, uint64_t * timestamp)
+{
+  int64_t dt;
+
+  if (read_sint (reader, &dt))
+    return -1;
+  *timestamp = reader->timestamp + dt;
+  return 0;
+}
+
+int
+nvds_wire_read_spot (NvDsWireReader * reader, NvDsWireSpotRecord * rec)
+{
+  int64_t x, y;
+  uint32_t event;
+  int ret = next_record (reader, NVDS_WIRE_KIND_SPOT);
+
+  if (ret <= 0)
+    return ret;
+  if (read_time (reader, &rec->timestamp) ||
+      read_string (reader, &rec->place) ||
+      read_string (reader, &rec->type) ||
+      read_string (reader, &rec->level) ||
+      read_string (reader, &rec->sensor) ||
+      read_string (reader, &rec->description) ||
+      read_sint (reader, &x) || read_sint (reader, &y) ||
+      read_uint32 (reader, &event))
+    return -1;
+  rec->x = (double) x / reader->quantum;
+  rec->y = (double) y / reader->quantum;
+  rec->event = (NvDsWireSpotEventType) event;
+  return 1;
+}
+
+int
+nvds_wire_read_aisle (NvDsWireReader * reader, NvDsWireAisleRecord * rec)
+{
+  int64_t x, y;
+  uint32_t event;
+  int ret = next_record (reader, NVDS_WIRE_KIND_AISLE);
+
+  if (ret <= 0)
+    return ret;
+  if (read_time (reader, &rec->timestamp) ||
+      read_string (reader, &rec->place) ||
+      read_string (reader, &rec->name) ||
+      read_string (reader, &rec->level) ||
+      read_string (reader, &rec->sensor) ||
+      read_string (reader, &rec->description) ||
+      read_uint (reader, &rec->object_id) ||
+      read_uint32 (reader, &rec->frame_num) ||
+      read_uint32 (reader, &rec->left) || read_uint32 (reader, &rec->top) ||
+      read_uint32 (reader, &rec->right) || read_uint32 (reader, &rec->bottom) ||
+      read_sint (reader, &x) || read_sint (reader, &y) ||
+      read_uint32 (reader, &rec->flags))
+    return -1;
+  rec->x = (double) x / reader->quantum;
+  rec->y = (double) y / reader->quantum;
+
+  rec->speed = rec->direction = 0;
+  if (rec->flags & NVDS_WIRE_AISLE_HAS_SPEED) {
+    uint32_t speed, direction;
+
+    if (read_uint32 (reader, &speed) || read_uint32 (reader, &direction))
+      return -1;
+    rec->speed = (double) speed / NVDS_WIRE_SPEED_QUANTUM;
+    rec->direction = (double) direction / NVDS_WIRE_HEADING_QUANTUM;
+  }
+
+  if (read_uint32 (reader, &event))
+    return -1;
+  rec->event = (NvDsWireAisleEventType) event;
+  rec->num_points = 0;
+  if (rec->event == NVDS_WIRE_AISLE_TRAJECTORY &&
+      read_uint32 (reader, &rec->num_points))
+    return -1;
+
+  reader->points_left = rec->num_points;
+  reader->last_x = reader->last_y = 0;
+  reader->last_time = rec->timestamp;
+  return 1;
+}
+
+int
+nvds_wire_read_point (NvDsWireReader * reader, NvDsWirePoint * point)
+{
+  int64_t dx, dy;
+  uint64_t dt;
+
+  if (!reader->points_left)
+    return 0;
+  if (read_sint (reader, &dx) || read_sint (reader, &dy) ||
+      read_uint (reader, &dt))
+    return -1;
+  reader->points_left--;
+  reader->last_x += dx;
+  reader->last_y += dy;
+  reader->last_time += dt;
+  point->x = (double) reader->last_x / reader->quantum;
+  point->y = (double) reader->last_y / reader->quantum;
+  point->timestamp = reader->last_time;
+  return 1;
+}
+
+int
+nvds_wire_read_group (NvDsWireReader * reader, NvDsWireGroupRecord * rec)
+{
+  uint32_t kind;
+  int ret = next_record (reader, NVDS_WIRE_KIND_ROLLUP);
+
+  if (ret <= 0)
+    return ret;
+  if (read_uint32 (reader, &kind) || read_string (reader, &rec->id) ||
+      read_uint32 (reader, &rec->total) ||
+      read_uint32 (reader, &rec->occupied) ||
+      read_uint32 (reader, &rec->unknown))
+    return -1;
+  rec->kind = (NvDsWireGroupKind) kind;
+  return 1;
+}
+
+int
+nvds_wire_is_frame (const void *data, size_t size)
+{
+  return size >= NVDS_WIRE_HEADER_SIZE &&
+      !memcmp (data, NVDS_WIRE_FRAME_MAGIC, 4);
+}
+
+int
+nvds_wire_frame_init (NvDsWireFrame * frame, const void *data, size_t size)
+{
+  const uint8_t *p = (const uint8_t *) data;
+  const uint8_t *cur = p + NVDS_WIRE_HEADER_SIZE;
+  const uint8_t *end = p + size;
+
+  memset (frame, 0, sizeof (NvDsWireFrame));
+  if (!nvds_wire_is_frame (data, size) || p[4] != NVDS_WIRE_FRAME_VERSION ||
+      p[5] > NVDS_WIRE_CODEC_ZSTD)
+    return -1;
+
+  frame->codec = (NvDsWireCodec) p[5];
+  if (decode_uint32 (&cur, end, &frame->num_messages) ||
+      decode_uint32 (&cur, end, &frame->raw_size))
+    return -1;
+  frame->body = cur;
+  frame->body_size = end - cur;
+  if (frame->codec == NVDS_WIRE_CODEC_NONE &&
+      frame->body_size != frame->raw_size)
+    return -1;
+  return 0;
+}
+
+void
+nvds_wire_frame_cursor_init (NvDsWireFrameCursor * cursor,
+    const NvDsWireFrame * frame, const void *body)
+{
+  cursor->cur = (const uint8_t *) body;
+  cursor->end = cursor->cur + frame->raw_size;
+  cursor->messages_left = frame->num_messages;
+}
+
+int
+nvds_wire_frame_next (NvDsWireFrameCursor * cursor, uint32_t * comp_id,
+    const void **data, size_t * size)
+{
+  uint64_t len;
+
+  if (!cursor->messages_left)
+    return 0;
+  if (decode_uint32 (&cursor->cur, cursor->end, comp_id) ||
+      decode_uint (&cursor->cur, cursor->end, &len) ||
+      len > (size_t) (cursor->end - cursor->cur))
+    return -1;
+  *data = cursor->cur;
+  *size = len;
+  cursor->cur += len;
+  cursor->messages_left--;
+  return 1;
+}
@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "nvds_loopback.h"
+
+/**
+ * Receives the messages of libnvds_loopback_proto and prints, every
+ * interval and at exit, their rate, sizes and latency: the time from the
+ * adapter being handed a message to the sink having read all of it.
+ */
+
+#define MAX_CLIENTS 64
+#define READ_SIZE (256 * 1024)
+
+/**
+ * Latencies are counted in a histogram of 16 buckets per power of two, so
+ * that a run of any length takes the same memory. The percentiles are the
+ * upper bounds of their buckets, at most 1/16 above the actual latency;
+ * below 16 us they are exact.
+ */
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS ((32 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+typedef struct
+{
+  int fd;
+  uint8_t *buf;
+  size_t len;
+  size_t capacity;
+  /** Sequence number expected next */
+  uint32_t seq;
+} Client;
+
+typedef struct
+{
+  uint64_t messages;
+  uint64_t bytes;
+  uint32_t min_size;
+  uint32_t max_size;
+  /** Latency histogram, see LATENCY_SUB_BITS, and largest latency, in us */
+  uint64_t latencies[LATENCY_BUCKETS];
+  uint32_t max_latency;
+  uint64_t start_ns;
+} Stats;
+
+static volatile sig_atomic_t quit;
+static uint64_t lost;
+
+static void
+on_signal (int sig)
+{
+  (void) sig;
+  quit = 1;
+}
+
+static uint64_t
+now_ns (clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime (clock, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+stats_reset (Stats * stats)
+{
+  stats->messages = stats->bytes = 0;
+  stats->min_size = UINT32_MAX;
+  stats->max_size = 0;
+  memset (stats->latencies, 0, sizeof (stats->latencies));
+  stats->max_latency = 0;
+  stats->start_ns = now_ns (CLOCK_MONOTONIC);
+}
+
+/** Values below LATENCY_SUB_BUCKETS have a bucket each. */
+static unsigned
+latency_bucket (uint32_t latency_us)
+{
+  unsigned shift = 0;
+
+  if (latency_us < LATENCY_SUB_BUCKETS)
+    return latency_us;
+  while (latency_us >> shift >= 2 * LATENCY_SUB_BUCKETS)
+    shift++;
+  return (shift + 1) * LATENCY_SUB_BUCKETS +
+      ((latency_us >> shift) - LATENCY_SUB_BUCKETS);
+}
+
+/** Largest latency of @bucket. */
+static uint32_t
+latency_bucket_max (unsigned bucket)
+{
+  unsigned shift;
+
+  if (bucket < LATENCY_SUB_BUCKETS)
+    return bucket;
+  shift = bucket / LATENCY_SUB_BUCKETS - 1;
+  return (uint32_t) ((((uint64_t) (bucket % LATENCY_SUB_BUCKETS +
+                  LATENCY_SUB_BUCKETS + 1)) << shift) - 1);
+}
+
+static void
+stats_add (Stats * stats, uint32_t size, uint32_t latency_us)
+{
+  stats->messages++;
+  stats->bytes += size;
+  if (size < stats->min_size)
+    stats->min_size = size;
+  if (size > stats->max_size)
+    stats->max_size = size;
+  stats->latencies[latency_bucket (latency_us)]++;
+  if (latency_us > stats->max_latency)
+    stats->max_latency = latency_us;
+}
+
+static uint32_t
+percentile (const Stats * stats, double p)
+{
+  uint64_t rank = (uint64_t) (p * (stats->messages - 1) + 0.5);
+  uint64_t count = 0;
+  unsigned i;
+
+  for (i = 0; i < LATENCY_BUCKETS; i++) {
+    count += stats->latencies[i];
+    if (count > rank)
+      break;
+  }
+  /* The largest latency is known exactly. */
+  if (i == LATENCY_BUCKETS || latency_bucket_max (i) > stats->max_latency)
+    return stats->max_latency;
+  return latency_bucket_max (i);
+}
+
+static void
+stats_print (Stats * stats, const char *label)
+{
+  double seconds = (now_ns (CLOCK_MONOTONIC) - stats->start_ns) / 1e9;
+
+  if (!stats->messages) {
+    printf ("%s: no messages in %.1f s\n", label, seconds);
+    return;
+  }
+  printf ("%s: %llu messages in %.1f s, %.0f msg/s, %.2f MB/s, "
+      "size %u/%.0f/%u B, latency p50 %u us, p99 %u us, max %u us, "
+      "%llu lost\n", label, (unsigned long long) stats->messages, seconds,
+      stats->messages / seconds, stats->bytes / seconds / (1024 * 1024),
+      stats->min_size, (double) stats->bytes / stats->messages,
+      stats->max_size, percentile (stats, 0.5), percentile (stats, 0.99),
+      stats->max_latency, (unsigned long long) lost);
+  fflush (stdout);
+}
+
+static int
+listen_socket (const char *path, int port)
+{
+  int fd;
+  int one = 1;
+
+  if (path) {
+    struct sockaddr_un addr;
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    strncpy (addr.sun_path, path, sizeof (addr.sun_path) - 1);
+    unlink (path);
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind (fd, (struct sockaddr *) &addr, sizeof (addr)))
+      goto error;
+  } else {
+    struct sockaddr_in6 addr;
+
+    memset (&addr, 0, sizeof (addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons (port);
+    fd = socket (AF_INET6, SOCK_STREAM, 0);
+    if (fd < 0)
+      goto error;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+    if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)))
+      goto error;
+  }
+  if (listen (fd, MAX_CLIENTS))
+    goto error;
+  return fd;
+
+error:
+  perror ("nvds_loopback_sink: listen");
+  if (fd >= 0)
+    close (fd);
+  return -1;
+}
+
+/**
+ * Account for the whole messages buffered for @client. Returns -1 if the
+ * stream is not one of the adapter.
+ */
+static int
+parse_messages (Client * client, Stats * interval, Stats * total,
+    unsigned delay_us)
+{
+  size_t offset = 0;
+  NvDsLoopbackHeader header;
+  uint64_t now = now_ns (CLOCK_REALTIME);
+  uint32_t latency;
+  size_t size;
+
+  while (client->len - offset >= NVDS_LOOPBACK_HEADER_SIZE) {
+    if (nvds_loopback_header_unpack (client->buf + offset, &header))
+      return -1;
+    size = NVDS_LOOPBACK_HEADER_SIZE + header.topic_len + header.size;
+    if (client->len - offset < size)
+      break;
+
+    /* A connection starts again from 0 after the adapter reconnects. */
+    if (header.seq > client->seq)
+      lost += header.seq - client->seq;
+    client->seq = header.seq + 1;
+    if (!total->messages)
+      total->start_ns = now_ns (CLOCK_MONOTONIC);
+    latency = now > header.send_time ? (now - header.send_time) / 1000 : 0;
+    stats_add (interval, header.size, latency);
+    stats_add (total, header.size, latency);
+    offset += size;
+    if (delay_us)
+      usleep (delay_us);
+  }
+
+  memmove (client->buf, client->buf + offset, client->len - offset);
+  client->len -= offset;
+  return 0;
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "Usage: %s [-p port | -u socket-path] [-i interval-s] "
+      "[-n messages] [-d delay-us]\n"
+      "  -p  TCP port to listen on (default 5555)\n"
+      "  -u  Unix socket to listen on instead\n"
+      "  -i  seconds between two reports (default 5)\n"
+      "  -n  exit after that many messages\n"
+      "  -d  wait that long after each message, to act as a slow broker\n",
+      name);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *path = NULL;
+  int port = 5555;
+  unsigned interval_s = 5;
+  unsigned long long max_messages = 0;
+  unsigned delay_us = 0;
+  struct pollfd fds[MAX_CLIENTS + 1];
+  Client clients[MAX_CLIENTS];
+  int num_clients = 0;
+  Stats interval, total;
+  uint64_t next_report;
+  int opt, i;
+
+  while ((opt = getopt (argc, argv, "p:u:i:n:d:h")) != -1) {
+    switch (opt) {
+      case 'p':
+        port = atoi (optarg);
+        break;
+      case 'u':
+        path = optarg;
+        break;
+      case 'i':
+        interval_s = atoi (optarg);
+        break;
+      case 'n':
+        max_messages = strtoull (optarg, NULL, 10);
+        break;
+      case 'd':
+        delay_us = atoi (optarg);
+        break;
+      default:
+        usage (argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (!interval_s)
+    interval_s = 1;
+
+  fds[0].fd = listen_socket (path, port);
+  if (fds[0].fd < 0)
+    return 1;
+  fds[0].events = POLLIN;
+  signal (SIGINT, on_signal);
+  signal (SIGTERM, on_signal);
+  signal (SIGPIPE, SIG_IGN);
+  if (path)
+    printf ("nvds_loopback_sink: listening on %s\n", path);
+  else
+    printf ("nvds_loopback_sink: listening on port %d\n", port);
+  fflush (stdout);
+
+  stats_reset (&interval);
+  stats_reset (&total);
+  next_report = now_ns (CLOCK_MONOTONIC) + interval_s * 1000000000ULL;
+
+  while (!quit && (!max_messages || total.messages < max_messages)) {
+    uint64_t now = now_ns (CLOCK_MONOTONIC);
+    int timeout = now < next_report ? (next_report - now) / 1000000 + 1 : 0;
+
+    for (i = 0; i < num_clients; i++) {
+      fds[i + 1].fd = clients[i].fd;
+      fds[i + 1].events = POLLIN;
+    }
+    if (poll (fds, num_clients + 1, timeout) < 0 && errno != EINTR)
+      break;
+
+    if (now_ns (CLOCK_MONOTONIC) >= next_report) {
+      stats_print (&interval, "interval");
+      stats_reset (&interval);
+      next_report += interval_s * 1000000000ULL;
+    }
+
+    for (i = num_clients - 1; i >= 0; i--) {
+      Client *client = &clients[i];
+      ssize_t n;
+
+      if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      if (client->capacity - client->len < READ_SIZE) {
+        client->capacity = client->len + READ_SIZE;
+        client->buf = (uint8_t *) realloc (client->buf, client->capacity);
+      }
+      n = read (client->fd, client->buf + client->len, READ_SIZE);
+      if (n > 0) {
+        client->len += n;
+        if (!parse_messages (client, &interval, &total, delay_us))
+          continue;
+        fprintf (stderr, "nvds_loopback_sink: bad stream, closing\n");
+      } else if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      close (client->fd);
+      free (client->buf);
+      clients[i] = clients[--num_clients];
+    }
+
+    if ((fds[0].revents & POLLIN) && num_clients < MAX_CLIENTS) {
+      int fd = accept (fds[0].fd, NULL, NULL);
+
+      if (fd >= 0) {
+        memset (&clients[num_clients], 0, sizeof (Client));
+        clients[num_clients++].fd = fd;
+      }
+    }
+  }
+
+  stats_print (&total, "total");
+  for (i = 0; i < num_clients; i++) {
+    close (clients[i].fd);
+    free (clients[i].buf);
+  }
+  close (fds[0].fd);
+  if (path)
+    unlink (path);
+  return 0;
+}